@@ -0,0 +1,158 @@
+/**
+ * @file factorisations.hpp
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * @brief LU factorisations with partial pivoting used by the spectral solvers
+ * DenseLU is the textbook O(n^3) factorisation of a row-major matrix.
+ * BandedLU factorises a matrix with kl sub- and ku super-diagonals in
+ * O(n kl (kl+ku)) and solves in O(n (2kl+ku)); row interchanges fill in at
+ * most kl extra super-diagonals, which are reserved up front.
+ * Both solve a block of nb right-hand sides stored row-major (n x nb): every
+ * entry of the factors is loaded once per block and applied to nb
+ * contiguous values, instead of once per right-hand side.
+ */
+#ifndef _MY_SPECTRE_FACTORISATIONS_HPP
+#define _MY_SPECTRE_FACTORISATIONS_HPP
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <assert.h>
+
+namespace ODE {
+
+    /**
+     * @brief PA = LU of a dense (n x n) row-major matrix
+     */
+    template <class T>
+    class DenseLU {
+        std::size_t n;
+        std::vector<T> LU;              //! unit lower L below, U on and above the diagonal
+        std::vector<std::size_t> piv;   //! row swapped with row k at step k
+        public:
+        DenseLU(): n(0) {}
+        DenseLU(std::size_t n, const std::vector<T>& A): n(n), LU(A), piv(n) {
+            assert(A.size()==n*n);
+            for (std::size_t k=0; k<n; k++) {
+                std::size_t p = k;
+                for (std::size_t i=k+1; i<n; i++)
+                    if (std::abs(LU[i*n+k]) > std::abs(LU[p*n+k])) p = i;
+                piv[k] = p;
+                if (p!=k) std::swap_ranges(&LU[k*n],&LU[k*n]+n,&LU[p*n]);
+                const T pivot = LU[k*n+k];
+                assert(pivot!=static_cast<T>(0));
+                for (std::size_t i=k+1; i<n; i++) {
+                    const T l = LU[i*n+k] /= pivot;
+                    if (l==static_cast<T>(0)) continue;
+                    for (std::size_t j=k+1; j<n; j++) LU[i*n+j] -= l*LU[k*n+j];
+                }
+            }
+        }
+        std::size_t size() const { return n; }
+        //! Overwrite b (n x nb, row-major) with the solution of A X = B
+        void solve(T* b, std::size_t nb=1) const {
+            for (std::size_t k=0; k<n; k++)
+                if (piv[k]!=k) std::swap_ranges(b+k*nb,b+(k+1)*nb,b+piv[k]*nb);
+            for (std::size_t i=1; i<n; i++) {
+                T* bi = b+i*nb;
+                for (std::size_t j=0; j<i; j++) {
+                    const T l = LU[i*n+j];
+                    const T* bj = b+j*nb;
+                    for (std::size_t c=0; c<nb; c++) bi[c] -= l*bj[c];
+                }
+            }
+            for (std::size_t i=n; i-->0;) {
+                T* bi = b+i*nb;
+                for (std::size_t j=i+1; j<n; j++) {
+                    const T u = LU[i*n+j];
+                    const T* bj = b+j*nb;
+                    for (std::size_t c=0; c<nb; c++) bi[c] -= u*bj[c];
+                }
+                const T d = LU[i*n+i];
+                for (std::size_t c=0; c<nb; c++) bi[c] /= d;
+            }
+        }
+    };
+
+    /**
+     * @brief PA = LU of a banded (n x n) matrix.
+     * The input band uses the OperatorStorage layout: row i holds columns
+     * i-kl..i+ku at i*(kl+ku+1) + j + kl - i. Internally each row is widened
+     * to columns i-kl..i+kl+ku to hold the fill-in of row interchanges.
+     */
+    template <class T>
+    class BandedLU {
+        std::size_t n, kl, ku, w;       //! w = 2 kl + ku + 1 entries per stored row
+        std::vector<T> ab;              //! row i, column j at i*w + j + kl - i
+        std::vector<std::size_t> piv;
+        T& at(std::size_t i, std::size_t j) { return ab[i*w+j+kl-i]; }
+        const T& at(std::size_t i, std::size_t j) const { return ab[i*w+j+kl-i]; }
+        public:
+        BandedLU(): n(0), kl(0), ku(0), w(1) {}
+        BandedLU(std::size_t n, std::size_t kl, std::size_t ku, const std::vector<T>& band): n(n), kl(kl), ku(ku), w(2*kl+ku+1),
+            ab(n*(2*kl+ku+1),static_cast<T>(0)), piv(n) {
+            const std::size_t wb = kl+ku+1;
+            assert(band.size()==n*wb);
+            for (std::size_t i=0; i<n; i++)
+                std::copy(&band[i*wb],&band[i*wb]+wb,&ab[i*w]);
+            for (std::size_t k=0; k<n; k++) {
+                const std::size_t rlast = std::min(n-1,k+kl), clast = std::min(n-1,k+kl+ku);
+                std::size_t p = k;
+                for (std::size_t i=k+1; i<=rlast; i++)
+                    if (std::abs(at(i,k)) > std::abs(at(p,k))) p = i;
+                piv[k] = p;
+                // only columns >= k are interchanged, multipliers of earlier steps stay with their row
+                if (p!=k)
+                    for (std::size_t j=k; j<=clast; j++) std::swap(at(k,j),at(p,j));
+                const T pivot = at(k,k);
+                assert(pivot!=static_cast<T>(0));
+                for (std::size_t i=k+1; i<=rlast; i++) {
+                    const T l = at(i,k) /= pivot;
+                    if (l==static_cast<T>(0)) continue;
+                    for (std::size_t j=k+1; j<=clast; j++) at(i,j) -= l*at(k,j);
+                }
+            }
+        }
+        std::size_t size() const { return n; }
+        std::size_t lower_bandwidth() const { return kl; }
+        std::size_t upper_bandwidth() const { return ku; }
+        //! Overwrite b (n x nb, row-major) with the solution of A X = B
+        void solve(T* b, std::size_t nb=1) const {
+            if (nb==1) {
+                for (std::size_t k=0; k<n; k++) {
+                    std::swap(b[k],b[piv[k]]);
+                    const T bk = b[k];
+                    for (std::size_t i=k+1; i<=std::min(n-1,k+kl); i++) b[i] -= at(i,k)*bk;
+                }
+                for (std::size_t i=n; i-->0;) {
+                    T acc = b[i];
+                    for (std::size_t j=i+1; j<=std::min(n-1,i+kl+ku); j++) acc -= at(i,j)*b[j];
+                    b[i] = acc/at(i,i);
+                }
+                return;
+            }
+            for (std::size_t k=0; k<n; k++) {
+                if (piv[k]!=k) std::swap_ranges(b+k*nb,b+(k+1)*nb,b+piv[k]*nb);
+                const T* bk = b+k*nb;
+                for (std::size_t i=k+1; i<=std::min(n-1,k+kl); i++) {
+                    const T l = at(i,k);
+                    T* bi = b+i*nb;
+                    for (std::size_t c=0; c<nb; c++) bi[c] -= l*bk[c];
+                }
+            }
+            for (std::size_t i=n; i-->0;) {
+                T* bi = b+i*nb;
+                for (std::size_t j=i+1; j<=std::min(n-1,i+kl+ku); j++) {
+                    const T u = at(i,j);
+                    const T* bj = b+j*nb;
+                    for (std::size_t c=0; c<nb; c++) bi[c] -= u*bj[c];
+                }
+                const T d = at(i,i);
+                for (std::size_t c=0; c<nb; c++) bi[c] /= d;
+            }
+        }
+    };
+
+};
+
+#endif
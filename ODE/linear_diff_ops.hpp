@@ -7,6 +7,10 @@
 #define _MY_LINEAR_OPERATORS_HPP
 
 #include "../polybases/polybases.hpp"
+#include "../polybases/plan_registry.hpp"
+#include "../polybases/static_basis.hpp"
+#include "operator_expressions.hpp"
+#include <memory>
 #include <algorithm>
 #include <functional>
 #include <iostream>
@@ -15,59 +19,130 @@ using namespace FunctionalBases;
 
 namespace Operators {
 
+    /**
+     * @brief Linear operator acting on spectral coefficients.
+     * The matrix lives in an immutable OperatorStorage held through a shared
+     * pointer, so operators assembled by the PlanRegistry are borrowed, not
+     * copied. Sums, scalar multiples and compositions of operators build
+     * expression templates (operator_expressions.hpp); assigning one to a
+     * LinearOperator materialises it once in the sparsest format that holds
+     * the result, keeping the symbolic form of the expression alongside.
+     */
     template<class T>
-    class LinearOperator {
+    class LinearOperator : public OperatorExpr<LinearOperator<T>> {
         unsigned int N;
-        std::vector<T> L_ij;
+        std::shared_ptr<const OperatorStorage<T>> L;
+        typename OperatorTree<T>::pointer sym; //! symbolic form, null if set from a matrix
         public:
-        LinearOperator<T>(unsigned int N=0): N(N){} //! Constructor
-        void print_Lij() {
+        typedef T value_type;
+        //! Zero operator of order N, an empty CSR matrix (O(N) memory) until set_Lij or set_storage
+        LinearOperator<T>(unsigned int N=0): N(N),
+            L(std::make_shared<const OperatorStorage<T>>(OperatorStorage<T>::csr(N+1,std::vector<std::size_t>(N+2,0),{},{}))) {}
+        //! Materialise an operator expression
+        template <class E> LinearOperator<T>(const OperatorExpr<E>& expr): N(expr.self().size()-1),
+            L(std::make_shared<const OperatorStorage<T>>(expr.self().materialise())), sym(expr.self().tree()) {}
+        template <class E> LinearOperator<T>& operator=(const OperatorExpr<E>& expr) {
+            N = expr.self().size()-1;
+            L = std::make_shared<const OperatorStorage<T>>(expr.self().materialise());
+            sym = expr.self().tree();
+            return *this;
+        }
+        void print_Lij() const {
             int imax = N;
             for (int i=0;i<imax+1;i++){
                 for (int j=0;j<imax+1;j++){
-                    int ind2d = j + (N+1)*i;
-                    std::cout << L_ij[ind2d] << "\t"; 
+                    std::cout << L->get(i,j) << "\t"; 
                 }
                 std::cout << "\n";
             }
         }
-        void print_N() { std::cout << N << "\n"; }
+        void print_N() const { std::cout << N << "\n"; }
+        //! Set a dense (N+1)x(N+1) row-major matrix, stored in the sparsest format that holds it
         void set_Lij(const std::vector<T>& Lij){
-            L_ij = Lij;
+            L = std::make_shared<const OperatorStorage<T>>(OperatorStorage<T>::compress(N+1,Lij));
+            sym = nullptr;
+        }
+        //! Borrow shared storage without copying it
+        void set_storage(const std::shared_ptr<const OperatorStorage<T>>& S){
+            L = S;
+            sym = nullptr;
+        }
+        //! Attach the symbolic form of the stored matrix
+        void set_tree(const typename OperatorTree<T>::pointer& t){
+            sym = t;
         }
+        const typename OperatorTree<T>::pointer& tree() const { return sym; }
+        const OperatorStorage<T>& get_storage() const { return *L; }
+        StorageFormat format() const { return L->format(); }
+        //! Dense row-major copy of the matrix
+        void get_Lij(std::vector<T>& Lij) const { L->to_dense(Lij); }
+        unsigned int get_N() const { return N; }
         void set_N(const int n){
             N = n;
         }
+        /**
+         * @brief Apply the operator to spectral coefficients, out = L coeffs
+         * @param coeffs N+1 input coefficients
+         * @param out N+1 output coefficients, must not alias coeffs
+         */
+        void apply(Span<const T> coeffs, Span<T> out) const {
+            assert(coeffs.size()==L->size() && out.size()==L->size());
+            L->apply(coeffs.data(),out.data());
+        }
+        void apply(const std::vector<T>& coeffs, std::vector<T>& out) const {
+            out.resize(L->size());
+            apply(Span<const T>(coeffs),Span<T>(out));
+        }
+        // expression interface ------
+        std::size_t size() const { return L->size(); }
+        void apply_add(const T* x, T* y, const T& alpha) const { L->apply_add(x,y,alpha); }
+        const OperatorStorage<T>& materialise() const { return *L; }
+        // in-place arithmetic -------
         LinearOperator<T>& operator+=(const LinearOperator<T>& rhs) 
         {                      
-            //std::transform(L_ij.begin(),L_ij.end(),rhs.L_ij.begin(),rhs.L_ij.end(),std::back_inserter(tmp),std::plus<T>());
-            for(int i=0; i<L_ij.size();i++){
-                L_ij[i] += rhs.L_ij[i];
-            }
+            L = std::make_shared<const OperatorStorage<T>>(OperatorStorage<T>::sum(*L,*rhs.L));
+            sym = OperatorTree<T>::node(OperatorTree<T>::Sum,sym,rhs.sym);
             return *this; 
         }
-        const LinearOperator<T> operator+(const LinearOperator<T>& rhs) {
-            return LinearOperator<T>(*this) += rhs;
-        }
         LinearOperator<T>& operator*=(const T& rhs) {
-             for(auto& val : L_ij) val *= rhs;
-             return *this;
-         }
+            L = std::make_shared<const OperatorStorage<T>>(L->scaled(rhs));
+            sym = OperatorTree<T>::node(OperatorTree<T>::Scale,sym,nullptr,rhs);
+            return *this;
+        }
+    };
 
-        const LinearOperator<T> operator*(const T&& alpha) {
-            return LinearOperator<T>(*this) *= alpha;
+    /*
+     * The operators below are built from a runtime polymorphic FunctionalBase
+     * or directly from a StaticBasis, in which case the basis pointer stays
+     * null and the registry calls the basis without virtual dispatch.
+     */
+    template<class T>
+    class Identity: public LinearOperator<T> {
+        const FunctionalBase<T>* basis;
+        public:
+        Identity<T>(const FunctionalBase<T>* b): LinearOperator<T>(), basis(b) { init(*basis); }
+        template <class B> Identity<T>(const StaticBasis<B,T>* b): LinearOperator<T>(), basis(nullptr) { init(b->derived()); }
+        private:
+        template <class Basis> inline void init(const Basis& b) {
+            LinearOperator<T>::set_N(b.get_N());
+            // one row per coefficient, K (Ne+1) rather than N+1 on a multi-domain basis
+            LinearOperator<T>::set_storage(std::make_shared<const OperatorStorage<T>>(OperatorStorage<T>::identity(b.num_coeffs())));
+            LinearOperator<T>::set_tree(OperatorTree<T>::leaf(OperatorTree<T>::Identity,BasisTag::of(b)));
         }
     };
 
     template<class T>
     class Derivative: public LinearOperator<T> {
-        FunctionalBase<T>* basis;
+        const FunctionalBase<T>* basis;
         public:
-        Derivative<T>(FunctionalBase<T>* b): basis(b), LinearOperator<T>() {
-            std::vector<T> L_ij ;
-            basis->calc_deriv(L_ij);
-            LinearOperator<T>::set_N(basis->get_N());
-            LinearOperator<T>::set_Lij(L_ij);
+        Derivative<T>(const FunctionalBase<T>* b): LinearOperator<T>(), basis(b) { init(*basis); }
+        template <class B> Derivative<T>(const StaticBasis<B,T>* b): LinearOperator<T>(), basis(nullptr) { init(b->derived()); }
+        private:
+        template <class Basis> inline void init(const Basis& b) {
+            SPECTRE_PROFILE_SCOPE("Derivative::assemble",b.get_N(),0);
+            LinearOperator<T>::set_N(b.get_N());
+            LinearOperator<T>::set_storage(PlanRegistry::instance().get_operator<T>(b,OperatorKind::Derivative));
+            LinearOperator<T>::set_tree(OperatorTree<T>::leaf(OperatorTree<T>::Derivative,BasisTag::of(b)));
         }
         
     };
@@ -75,13 +150,16 @@ namespace Operators {
     
     template<class T>
     class SecondDerivative: public LinearOperator<T> {
-        FunctionalBase<T>* basis;
+        const FunctionalBase<T>* basis;
         public:
-        SecondDerivative<T>(FunctionalBase<T>* b): basis(b), LinearOperator<T>() {
-            std::vector<T> L_ij ;
-            basis->calc_second_deriv(L_ij);
-            LinearOperator<T>::set_N(basis->get_N());
-            LinearOperator<T>::set_Lij(L_ij);
+        SecondDerivative<T>(const FunctionalBase<T>* b): LinearOperator<T>(), basis(b) { init(*basis); }
+        template <class B> SecondDerivative<T>(const StaticBasis<B,T>* b): LinearOperator<T>(), basis(nullptr) { init(b->derived()); }
+        private:
+        template <class Basis> inline void init(const Basis& b) {
+            SPECTRE_PROFILE_SCOPE("SecondDerivative::assemble",b.get_N(),0);
+            LinearOperator<T>::set_N(b.get_N());
+            LinearOperator<T>::set_storage(PlanRegistry::instance().get_operator<T>(b,OperatorKind::SecondDerivative));
+            LinearOperator<T>::set_tree(OperatorTree<T>::leaf(OperatorTree<T>::SecondDerivative,BasisTag::of(b)));
         }
         
     }; 
@@ -90,13 +168,16 @@ namespace Operators {
     template<class T>
     class TimesX: public LinearOperator<T> {
 
-        FunctionalBase<T>* basis;
+        const FunctionalBase<T>* basis;
         public:
-        TimesX<T>(FunctionalBase<T>* b): basis(b), LinearOperator<T>() {
-            std::vector<T> L_ij ;
-            basis->calc_times_x(L_ij);
-            LinearOperator<T>::set_N(basis->get_N());
-            LinearOperator<T>::set_Lij(L_ij);
+        TimesX<T>(const FunctionalBase<T>* b): LinearOperator<T>(), basis(b) { init(*basis); }
+        template <class B> TimesX<T>(const StaticBasis<B,T>* b): LinearOperator<T>(), basis(nullptr) { init(b->derived()); }
+        private:
+        template <class Basis> inline void init(const Basis& b) {
+            SPECTRE_PROFILE_SCOPE("TimesX::assemble",b.get_N(),0);
+            LinearOperator<T>::set_N(b.get_N());
+            LinearOperator<T>::set_storage(PlanRegistry::instance().get_operator<T>(b,OperatorKind::TimesX));
+            LinearOperator<T>::set_tree(OperatorTree<T>::leaf(OperatorTree<T>::TimesX,BasisTag::of(b)));
         }
     };
 };
@@ -2,6 +2,18 @@
  * @file odesolvers.hpp
  * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
  * @brief Implementation of spectral solvers for Ordinary Boundary Value Problems
+ * Linear problems L u = f on [-1,1] with L built from Identity, Derivative,
+ * SecondDerivative and TimesX on a Chebyshev basis and one boundary condition
+ * per differential order, or on the elements of a PiecewiseChebyshevBase
+ * coupled by continuity of u and u' at the interfaces; operators of other
+ * bases are rejected. ODESolver discretises L in the ultraspherical basis, where it is
+ * banded, and solves in O(N); DenseODESolver is the classical Chebyshev tau
+ * method with a dense O(N^3) factorisation, kept as a reference.
+ * RefinedODESolver factorises in a narrow type (float) and refines the
+ * solution by iterative refinement to the accuracy of a wide one (double).
+ * IMEXRungeKutta and SBDF integrate u_t = L u + N(u) by the method of lines,
+ * L implicit through cached ODESolver factorisations of I - dt a L and N
+ * explicit.
  */
 
 #ifndef _MY_SPECTRE_ODE_
@@ -12,20 +24,818 @@
 #include <iostream>
 #include <memory>
 #include <fstream>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
 #include "../functions.hpp"
 #include "../polybases/polybases.hpp"
+#include "linear_diff_ops.hpp"
+#include "ultraspherical.hpp"
+#include "factorisations.hpp"
+#include "../polybases/parallel.hpp"
 
 using namespace FunctionalBases;
 using namespace Functions;
 
 namespace ODE{
 
+    //! End of the domain, [-1,1] on a ChebyshevBase, a boundary condition is imposed at
+    enum class Boundary { Left, Right };
+
+    /**
+     * @brief Boundary condition alpha u(x_b) + beta u'(x_b) = value at an end x_b of the domain
+     */
+    template <class T>
+    struct BoundaryCondition {
+        Boundary side;
+        T alpha, beta, value;
+        static BoundaryCondition Dirichlet(Boundary side, const T& value) { return {side,static_cast<T>(1),static_cast<T>(0),value}; }
+        static BoundaryCondition Neumann(Boundary side, const T& value) { return {side,static_cast<T>(0),static_cast<T>(1),value}; }
+        static BoundaryCondition Robin(Boundary side, const T& alpha, const T& beta, const T& value) { return {side,alpha,beta,value}; }
+        /**
+         * @brief The condition as a row acting on n Chebyshev coefficients
+         * Uses T_j(1) = 1, T_j'(1) = j^2 and T_j(-x) = (-1)^j T_j(x).
+         */
+        void row(std::size_t n, T* r) const {
+            for (std::size_t j=0; j<n; j++) {
+                const T tj = static_cast<T>(j);
+                const T sign = (side==Boundary::Left && j%2) ? static_cast<T>(-1) : static_cast<T>(1);
+                r[j] = sign*alpha + (side==Boundary::Left ? -sign : sign)*beta*tj*tj;
+            }
+        }
+    };
+
+    /**
+     * @brief Sparse spectral solver for linear boundary value problems.
+     * The operator is lowered from its symbolic form to the banded map from
+     * Chebyshev coefficients to C^(m) coefficients, m the differential order.
+     * The last m rows of that system are replaced by the boundary rows. The
+     * resulting almost-banded system is solved by elimination of the first m
+     * unknowns: with A = [A0 Ar] split after column m and the boundary rows
+     * B = [B0 Br],
+     *   Ar y = g,  (B0 - Br Ar^{-1} A0) u0 = b - Br y,  ur = y - Ar^{-1} A0 u0,
+     * where Ar is banded with a non-zero diagonal. Construction factorises Ar
+     * and the m x m Schur complement once, in O(N); every solve is O(N) and
+     * only reads the factorisation, so one solver serves any number of
+     * right-hand sides, also concurrently.
+     * On a multi-domain Chebyshev basis (PiecewiseChebyshevBase) every element
+     * is lowered on its own, see element_form, and the last m rows of every
+     * element block are replaced by constraint rows: the boundary conditions
+     * at the ends of the domain and, at each of the K-1 interfaces, continuity
+     * of u and, for m = 2, of u'
+     *   sum_j c^k_j T_j(1) - c^{k+1}_j T_j(-1) = 0,
+     *   (2/h_k) sum_j c^k_j T_j'(1) - (2/h_{k+1}) sum_j c^{k+1}_j T_j'(-1) = 0.
+     * Eliminating the first m unknowns of every element leaves a dense
+     * mK x mK Schur complement coupling the elements.
+     */
     template <class T>
     class ODESolver {
-        Function<T,
+        std::size_t n;                       //! number of Chebyshev coefficients, N+1, or K (Ne+1) on K elements
+        std::size_t K;                       //! number of elements, 1 on [-1,1]
+        std::size_t ne;                      //! coefficients per element, n/K
+        unsigned int m;                      //! differential order, number of boundary conditions
+        std::vector<BoundaryCondition<T>> bcs;
+        std::vector<BandedLU<T>> lu;         //! Ar of every element, rows 0..ne-m-1 and columns m..ne-1 of its ultraspherical operator
+        std::vector<T> W;                    //! Ar^{-1} A0 of every element, m columns of ne-m entries each
+        std::vector<std::size_t> first;      //! first of the at most two neighbouring elements a constraint row touches
+        std::vector<T> Br;                   //! constraint rows restricted to columns m..ne-1 of those two elements, row-major
+        std::vector<T> value;                //! right-hand side of every constraint row, 0 at interfaces
+        DenseLU<T> schur;                    //! B0 - Br W, mK x mK
+        public:
+        /**
+         * @brief Lower and factorise L with the given boundary conditions
+         * @param L operator with a symbolic form, i.e. built from Identity, Derivative, SecondDerivative and TimesX on a ChebyshevBase or a PiecewiseChebyshevBase
+         * @param bcs one boundary condition per differential order of L, imposed at the ends of the domain
+         * @throws std::invalid_argument if L has no symbolic form, acts on
+         * another basis than a (multi-domain) Chebyshev one, see ultraspherical_form,
+         * or is of order above 2 on several elements
+         * L may be a LinearOperator or an unevaluated expression; only its
+         * symbolic form is used, so passing the expression avoids
+         * materialising its Chebyshev matrix.
+         */
+        template <class E> ODESolver(const Operators::OperatorExpr<E>& L, const std::vector<BoundaryCondition<T>>& bcs):
+            ODESolver(L.self().tree(),L.self().size(),bcs) {}
+        ODESolver(const typename Operators::OperatorTree<T>::pointer& tree, std::size_t n, const std::vector<BoundaryCondition<T>>& bcs);
+        std::size_t size() const { return n; }
+        unsigned int order() const { return m; }
+        //! Number of elements the operator was lowered on
+        std::size_t num_elements() const { return K; }
+        /**
+         * @brief Solve L u = f
+         * @param f n Chebyshev coefficients of the right hand side
+         * @param u n Chebyshev coefficients of the solution
+         */
+        void solve(Span<const T> f, Span<T> u) const;
+        void solve(const std::vector<T>& f, std::vector<T>& u) const {
+            u.resize(n);
+            solve(Span<const T>(f),Span<T>(u));
+        }
+        template <class B, unsigned int N> Function<T,B,N> solve(const Function<T,B,N>& f) const {
+            std::vector<T> ft, u;
+            f.get_spectral_coeffs(ft);
+            solve(ft,u);
+            return Function<T,B,N>::from_spectral_coeffs(f.get_basis(),u);
+        }
+        /**
+         * @brief Solve L U = F for a block of right-hand sides, reusing the factorisation
+         * Columns are transposed in blocks of rhs_block into thread-local row-major scratch
+         * so the triangular solves stream the factors once per block; blocks
+         * are distributed over threads.
+         * @param F n x nrhs column-major Chebyshev coefficients of the right hand sides
+         * @param U n x nrhs column-major Chebyshev coefficients of the solutions
+         * @param nrhs number of right-hand sides
+         * @param nthreads threads of the global pool to use
+         */
+        void solve(Span<const T> F, Span<T> U, std::size_t nrhs, unsigned int nthreads=1) const;
+        /**
+         * @brief Solve the discretised system itself, e.g. for a residual correction
+         * @param g n entries, overwritten by the solution: in every element block,
+         * rows 0..ne-m-1 hold the right-hand side in the C^(m) basis and rows
+         * ne-m..ne-1 the values of the constraint rows m k..m k+m-1, i.e. the
+         * boundary values first and the interface values (usually 0) after them
+         */
+        void solve_system(T* g) const;
+        //! Right-hand sides per block of the multi-RHS solve
+        static constexpr std::size_t rhs_block = 16;
+        private:
+        //! Solve in place for nb right-hand sides stored row-major (n x nb)
+        void solve_block(T* g, std::size_t nb) const;
+        //! solve_block after the conversion to C^(m), with constraint values b (mK x nb) or those of the rows if null
+        void eliminate(T* g, std::size_t nb, const T* b) const;
+    };
+
+    template <class T> ODESolver<T>::ODESolver(const typename Operators::OperatorTree<T>::pointer& tree, std::size_t n,
+                                               const std::vector<BoundaryCondition<T>>& bcs): n(n), bcs(bcs)
+    {
+        if (!tree) throw std::invalid_argument("ODESolver: operator has no symbolic form");
+        // a single Chebyshev series on [-1,1], or K elements of one multi-domain basis
+        const Operators::BasisTag& basis = tree->leftmost_basis();
+        const bool single = tree->chebyshev();
+        if (!single && (basis.num_elements()==0 || !tree->on_basis(basis)))
+            throw std::invalid_argument("ODESolver: operator not built on a single Chebyshev or multi-domain Chebyshev basis");
+        K = single ? 1 : basis.num_elements();
+        std::vector<T> breaks(K+1);
+        for (std::size_t k=0; k<=K; k++) breaks[k] = single ? static_cast<T>(2*static_cast<int>(k)-1) : static_cast<T>(basis.elements[k]);
+        assert(n%K==0);
+        ne = n/K;
+        lu.resize(K);
+        std::size_t nr = 0;
+        for (std::size_t e=0; e<K; e++) {
+            const UltrasphericalForm<T> F = ultraspherical_form(single ? *tree : *element_form(*tree,breaks[e],breaks[e+1]),ne);
+            if (e==0) {
+                m = F.order;
+                assert(bcs.size()==m && ne>m);
+                if (K>1 && m>2) throw std::invalid_argument("ODESolver: interface conditions of order above 2 are not supported");
+                nr = ne-m;
+                W.assign(K*m*nr,static_cast<T>(0));
+            }
+            const std::size_t kl = F.A.lower_bandwidth(), ku = F.A.upper_bandwidth();
+            assert(ku>=m);
+            // Ar(i,c) = A(i,c+m)
+            const std::size_t rkl = kl+m, rku = ku-m, rw = rkl+rku+1;
+            std::vector<T> band(nr*rw,static_cast<T>(0));
+            for (std::size_t i=0; i<nr; i++)
+                for (std::size_t c=(i>rkl ? i-rkl : 0); c<std::min(nr,i+rku+1); c++) band[i*rw+c+rkl-i] = F.A.get(i,c+m);
+            lu[e] = BandedLU<T>(nr,rkl,rku,band);
+            for (unsigned int k=0; k<m; k++) {
+                T* w = &W[(e*m+k)*nr];
+                for (std::size_t i=0; i<std::min(nr,k+kl+1); i++) w[i] = F.A.get(i,k);
+                lu[e].solve(w);
+            }
+        }
+        // constraint rows: the boundary conditions, then m rows per interface
+        const std::size_t nc = m*K;
+        first.assign(nc,0);
+        value.assign(nc,static_cast<T>(0));
+        Br.assign(2*nc*nr,static_cast<T>(0));
+        std::vector<T> row(2*ne), S(nc*nc,static_cast<T>(0));
+        for (std::size_t r=0; r<nc; r++) {
+            std::fill(row.begin(),row.end(),static_cast<T>(0));
+            if (r<m) {
+                BoundaryCondition<T> bc = bcs[r];
+                const std::size_t e = bc.side==Boundary::Left ? 0 : K-1;
+                bc.beta *= static_cast<T>(2)/(breaks[e+1]-breaks[e]);
+                bc.row(ne,row.data());
+                first[r] = e;
+                value[r] = bc.value;
+            } else {
+                const std::size_t e = (r-m)/m;
+                const bool flux = (r-m)%m==1;
+                BoundaryCondition<T> left = flux ? BoundaryCondition<T>::Neumann(Boundary::Right,0) : BoundaryCondition<T>::Dirichlet(Boundary::Right,0);
+                BoundaryCondition<T> right = flux ? BoundaryCondition<T>::Neumann(Boundary::Left,0) : BoundaryCondition<T>::Dirichlet(Boundary::Left,0);
+                left.beta *= static_cast<T>(2)/(breaks[e+1]-breaks[e]);
+                right.alpha = -right.alpha;
+                right.beta *= static_cast<T>(-2)/(breaks[e+2]-breaks[e+1]);
+                left.row(ne,row.data());
+                right.row(ne,row.data()+ne);
+                first[r] = e;
+            }
+            for (std::size_t s=0; s<2 && first[r]+s<K; s++) {
+                const std::size_t e = first[r]+s;
+                const T* re = row.data()+s*ne;
+                T* br = &Br[(2*r+s)*nr];
+                std::copy(re+m,re+ne,br);
+                for (unsigned int k=0; k<m; k++) {
+                    T acc = re[k];
+                    for (std::size_t i=0; i<nr; i++) acc -= br[i]*W[(e*m+k)*nr+i];
+                    S[r*nc+e*m+k] = acc;
+                }
+            }
+        }
+        schur = DenseLU<T>(nc,S);
+    }
+
+    template <class T> void ODESolver<T>::solve_block(T* g, std::size_t nb) const
+    {
+        for (std::size_t e=0; e<K; e++) chebyshev_to_ultraspherical(g+e*ne*nb,ne,m,nb);
+        eliminate(g,nb,nullptr);
+    }
+
+    template <class T> void ODESolver<T>::solve_system(T* g) const
+    {
+        // the constraint values sit where the shift below writes y; the scratch
+        // only grows, so repeated solves of any order do not allocate
+        static thread_local std::vector<T> b;
+        if (b.size() < m*K) b.resize(m*K);
+        for (std::size_t r=0; r<m*K; r++) b[r] = g[(r/m)*ne+ne-m+r%m];
+        eliminate(g,1,b.data());
+    }
+
+    template <class T> void ODESolver<T>::eliminate(T* g, std::size_t nb, const T* bvals) const
+    {
+        const std::size_t nr = ne-m, nc = m*K;
+        // y = Ar^{-1} g occupies rows m..ne-1 of every element block once shifted down
+        for (std::size_t e=0; e<K; e++) {
+            T* ge = g+e*ne*nb;
+            std::copy_backward(ge,ge+nr*nb,ge+ne*nb);
+            lu[e].solve(ge+m*nb,nb);
+        }
+        static thread_local std::vector<T> scratch;
+        if (scratch.size() < nc*nb) scratch.resize(nc*nb);
+        T* b = scratch.data();
+        for (std::size_t r=0; r<nc; r++) {
+            T* br = b+r*nb;
+            if (bvals) std::copy(bvals+r*nb,bvals+(r+1)*nb,br);
+            else std::fill(br,br+nb,value[r]);
+            for (std::size_t s=0; s<2 && first[r]+s<K; s++) {
+                const T* a = &Br[(2*r+s)*nr];
+                const T* y = g+((first[r]+s)*ne+m)*nb;
+                for (std::size_t i=0; i<nr; i++) {
+                    const T* yi = y+i*nb;
+                    for (std::size_t c=0; c<nb; c++) br[c] -= a[i]*yi[c];
+                }
+            }
+        }
+        schur.solve(b,nb);
+        for (std::size_t e=0; e<K; e++) {
+            // the first m unknowns of the element take their rows back
+            T* ge = g+e*ne*nb;
+            std::copy(b+e*m*nb,b+(e+1)*m*nb,ge);
+            T* y = ge+m*nb;
+            for (std::size_t i=0; i<nr; i++) {
+                T* yi = y+i*nb;
+                for (unsigned int k=0; k<m; k++) {
+                    const T w = W[(e*m+k)*nr+i];
+                    const T* bk = ge+k*nb;
+                    for (std::size_t c=0; c<nb; c++) yi[c] -= w*bk[c];
+                }
+            }
+        }
+    }
+
+    template <class T> void ODESolver<T>::solve(Span<const T> f, Span<T> u) const
+    {
+        assert(f.size()==n && u.size()==n);
+        std::copy(f.begin(),f.end(),u.begin());
+        solve_block(u.data(),1);
+    }
+
+    template <class T> void ODESolver<T>::solve(Span<const T> F, Span<T> U, std::size_t nrhs, unsigned int nthreads) const
+    {
+        assert(F.size()==n*nrhs && U.size()==n*nrhs);
+        const std::size_t nblocks = (nrhs+rhs_block-1)/rhs_block;
+        Parallel::parallel_for(nblocks,[&](std::size_t blk) {
+            const std::size_t c0 = blk*rhs_block, nb = std::min(rhs_block,nrhs-c0);
+            static thread_local std::vector<T> g;
+            g.resize(n*nb);
+            for (std::size_t c=0; c<nb; c++)
+                for (std::size_t i=0; i<n; i++) g[i*nb+c] = F[(c0+c)*n+i];
+            solve_block(g.data(),nb);
+            for (std::size_t c=0; c<nb; c++)
+                for (std::size_t i=0; i<n; i++) U[(c0+c)*n+i] = g[i*nb+c];
+        },nthreads);
+    }
+
+    /**
+     * @brief Chebyshev tau solver with a dense LU factorisation.
+     * The last m rows of the (N+1) x (N+1) Chebyshev matrix of L are replaced
+     * by the boundary rows. O(N^3) to build and O(N^2) per solve; accepts any
+     * operator matrix, including ones without a symbolic form.
+     */
+    template <class T>
+    class DenseODESolver {
+        std::size_t n;
+        std::vector<BoundaryCondition<T>> bcs;
+        DenseLU<T> lu;
+        public:
+        DenseODESolver(const Operators::LinearOperator<T>& L, const std::vector<BoundaryCondition<T>>& bcs): n(L.size()), bcs(bcs) {
+            const std::size_t m = bcs.size();
+            assert(n>m);
+            std::vector<T> A;
+            L.get_Lij(A);
+            for (std::size_t r=0; r<m; r++) bcs[r].row(n,&A[(n-m+r)*n]);
+            lu = DenseLU<T>(n,A);
+        }
+        std::size_t size() const { return n; }
+        void solve(const std::vector<T>& f, std::vector<T>& u) const {
+            assert(f.size()==n);
+            u = f;
+            for (std::size_t r=0; r<bcs.size(); r++) u[n-bcs.size()+r] = bcs[r].value;
+            lu.solve(u.data());
+        }
+    };
+
+    namespace detail {
+        /*
+         * Flush-to-zero and denormals-are-zero on x86 for the lifetime of the
+         * object, restored afterwards. The decaying Chebyshev coefficients of a
+         * correction drop below the float normal range within the triangular
+         * solves, where subnormal arithmetic costs some ten times more.
+         */
+        struct FlushSubnormals {
+#ifdef SPECTRE_X86_SIMD
+            unsigned int csr;
+            FlushSubnormals(): csr(_mm_getcsr()) { _mm_setcsr(csr | 0x8040u); }
+            ~FlushSubnormals() { _mm_setcsr(csr); }
+#endif
+        };
+    }
+
+    //! Outcome of one RefinedODESolver::solve
+    struct RefinementInfo {
+        unsigned int sweeps = 0;   //! correction sweeps after the first low precision solve
+        bool promoted = false;     //! the refinement stalled and the high precision solver was used
+        double correction = 0.0;   //! last |d|_inf / |u|_inf
+    };
+
+    /**
+     * @brief ODESolver factorised in Low, with the solution refined to High accuracy.
+     * Mixed precision iterative refinement on the almost-banded system S u = b
+     * that ODESolver builds:
+     *   u_0 = S_Low^{-1} b,  r_k = b - S u_k in High,  u_{k+1} = u_k + S_Low^{-1} r_k.
+     * While u_Low cond(S) < 1 each sweep shrinks the error by about that factor,
+     * down to the High residual accuracy. The factorisation and the
+     * factor-streaming triangular solves run in Low, only the O(N) banded
+     * residual is done in High. The loop stops once |d| <= tol |u|. If a sweep
+     * fails to halve the correction the system is too ill-conditioned for Low,
+     * and the solve is promoted: an ODESolver<High> is factorised on first
+     * need and solves directly, from then on for every right-hand side.
+     */
+    template <class Low, class High>
+    class RefinedODESolver {
+        std::size_t n;
+        unsigned int m;
+        typename Operators::OperatorTree<High>::pointer tree;
+        std::vector<BoundaryCondition<High>> bcs;
+        OperatorStorage<High> A;        //! ultraspherical form of L, rows 0..n-m-1 enter S
+        std::vector<High> B;            //! boundary rows, m x n
+        ODESolver<Low> low;
+        High tol;
+        unsigned int max_sweeps;
+        mutable std::shared_ptr<const ODESolver<High>> high; //! built on the first promotion
+        /*
+         * in/|in|_inf rounded to Low, with |in|_inf returned. Entries that would
+         * be subnormal in Low are flushed to zero; they are below u_Low relative
+         * to the largest one, and subnormal arithmetic would slow the solve by
+         * an order of magnitude.
+         */
+        static High narrow(const std::vector<High>& in, std::vector<Low>& out) {
+            High scale = 0;
+            for (const High& v: in) scale = std::max(scale,std::abs(v));
+            out.resize(in.size());
+            const High inv = scale > 0 ? 1/scale : static_cast<High>(1);
+            for (std::size_t i=0; i<in.size(); i++) {
+                const High v = in[i]*inv;
+                out[i] = std::abs(v) < static_cast<High>(std::numeric_limits<Low>::min()) ? static_cast<Low>(0) : static_cast<Low>(v);
+            }
+            return scale > 0 ? scale : static_cast<High>(1);
+        }
+        static OperatorStorage<High> lowered(const typename Operators::OperatorTree<High>::pointer& tree, std::size_t n) {
+            if (!tree) throw std::invalid_argument("RefinedODESolver: operator has no symbolic form");
+            return ultraspherical_form(*tree,n).A;
+        }
+        static std::vector<BoundaryCondition<Low>> narrowed(const std::vector<BoundaryCondition<High>>& bcs) {
+            std::vector<BoundaryCondition<Low>> out;
+            for (const auto& bc: bcs) out.push_back({bc.side,static_cast<Low>(bc.alpha),static_cast<Low>(bc.beta),static_cast<Low>(bc.value)});
+            return out;
+        }
         public:
+        /**
+         * @param L operator with a symbolic form, in High
+         * @param bcs one boundary condition per differential order of L
+         * @param tol relative size of the last correction at which the refinement stops,
+         * by default 8 n u_High
+         * @param max_sweeps correction sweeps before promoting
+         */
+        template <class E> RefinedODESolver(const Operators::OperatorExpr<E>& L, const std::vector<BoundaryCondition<High>>& bcs,
+                                            High tol=static_cast<High>(-1), unsigned int max_sweeps=10):
+            RefinedODESolver(L.self().tree(),L.self().size(),bcs,tol,max_sweeps) {}
+        RefinedODESolver(const typename Operators::OperatorTree<High>::pointer& tree, std::size_t n,
+                         const std::vector<BoundaryCondition<High>>& bcs, High tol=static_cast<High>(-1), unsigned int max_sweeps=10):
+            n(n), tree(tree), bcs(bcs), A(lowered(tree,n)), low(tree->template converted<Low>(),n,narrowed(bcs)),
+            tol(tol > 0 ? tol : 8*static_cast<High>(n)*std::numeric_limits<High>::epsilon()/2), max_sweeps(max_sweeps)
+        {
+            m = low.order();
+            B.resize(m*n);
+            for (unsigned int r=0; r<m; r++) bcs[r].row(n,&B[r*n]);
+        }
+        std::size_t size() const { return n; }
+        //! True once a solve has been promoted to the High solver
+        bool promoted() const { return static_cast<bool>(std::atomic_load(&high)); }
+        /**
+         * @brief Solve L u = f to High accuracy
+         * @param f n Chebyshev coefficients of the right hand side
+         * @param u n Chebyshev coefficients of the solution
+         */
+        RefinementInfo solve(Span<const High> f, Span<High> u) const;
+        RefinementInfo solve(const std::vector<High>& f, std::vector<High>& u) const {
+            u.resize(n);
+            return solve(Span<const High>(f),Span<High>(u));
+        }
     };
 
+    template <class Low, class High> RefinementInfo RefinedODESolver<Low,High>::solve(Span<const High> f, Span<High> u) const
+    {
+        assert(f.size()==n && u.size()==n);
+        RefinementInfo info;
+        if (auto h = std::atomic_load(&high)) {
+            h->solve(f,u);
+            info.promoted = true;
+            return info;
+        }
+        static thread_local std::vector<High> b, r;
+        static thread_local std::vector<Low> d;
+        const std::size_t nr = n-m;
+        // b: converted right-hand side and boundary values
+        b.assign(f.begin(),f.end());
+        chebyshev_to_ultraspherical(b.data(),n,m);
+        for (unsigned int k=0; k<m; k++) b[nr+k] = bcs[k].value;
+        High scale = narrow(b,d);
+        { const detail::FlushSubnormals ftz; low.solve_system(d.data()); }
+        for (std::size_t i=0; i<n; i++) u[i] = scale*static_cast<High>(d[i]);
+        double last = std::numeric_limits<double>::infinity();
+        r.resize(n);
+        for (;;) {
+            A.apply(u.data(),r.data());
+            for (std::size_t i=0; i<nr; i++) r[i] = b[i]-r[i];
+            for (unsigned int k=0; k<m; k++) {
+                High acc = b[nr+k];
+                for (std::size_t j=0; j<n; j++) acc -= B[k*n+j]*u[j];
+                r[nr+k] = acc;
+            }
+            scale = narrow(r,d);
+            { const detail::FlushSubnormals ftz; low.solve_system(d.data()); }
+            High dnorm = 0, unorm = 0;
+            for (std::size_t i=0; i<n; i++) {
+                const High di = scale*static_cast<High>(d[i]);
+                u[i] += di;
+                dnorm = std::max(dnorm,std::abs(di));
+                unorm = std::max(unorm,std::abs(u[i]));
+            }
+            info.sweeps++;
+            info.correction = unorm > 0 ? static_cast<double>(dnorm/unorm) : 0.0;
+            if (dnorm <= tol*unorm) return info;
+            if (info.correction > 0.5*last || info.sweeps >= max_sweeps) break;
+            last = info.correction;
+        }
+        auto h = std::atomic_load(&high);
+        if (!h) {
+            h = std::make_shared<const ODESolver<High>>(tree,n,bcs);
+            std::atomic_store(&high,h);
+        }
+        h->solve(f,u);
+        info.promoted = true;
+        return info;
+    }
+
+    /**
+     * @brief Work done and wall time spent by a time integrator, accumulated over steps
+     */
+    struct StepCounters {
+        std::size_t steps = 0;           //! steps taken
+        std::size_t nonlinear_evals = 0; //! calls of N(u)
+        std::size_t operator_applies = 0;//! products L u
+        std::size_t solves = 0;          //! implicit solves (I - dt a L) u = r
+        double t_nonlinear = 0.0;        //! seconds in N(u)
+        double t_linear = 0.0;           //! seconds in L u and in the stage combinations
+        double t_solve = 0.0;            //! seconds in the implicit solves
+        double t_total = 0.0;            //! seconds in step()
+        double steps_per_second() const { return t_total > 0.0 ? steps/t_total : 0.0; }
+    };
+
+    namespace detail {
+        typedef std::chrono::steady_clock clock;
+        inline double seconds_since(const clock::time_point& t0) {
+            return std::chrono::duration<double>(clock::now()-t0).count();
+        }
+        //! y += a x over n entries
+        template <class T> inline void axpy(std::size_t n, const T& a, const T* x, T* y) {
+            for (std::size_t i=0; i<n; i++) y[i] += a*x[i];
+        }
+        /**
+         * @brief Factorise I - c L with the boundary conditions, c = dt times a method coefficient.
+         * The identity is taken on the basis of L, so ODESolver rejects L unless it is a
+         * Chebyshev operator on [-1,1] or on the elements of a PiecewiseChebyshevBase.
+         * @throws std::invalid_argument if L has no symbolic form or cannot be lowered
+         */
+        template <class T> inline ODESolver<T> implicit_solver(const Operators::LinearOperator<T>& L, const T& c,
+                                                               const std::vector<BoundaryCondition<T>>& bcs) {
+            typedef Operators::OperatorTree<T> Tree;
+            if (!L.tree()) throw std::invalid_argument("implicit_solver: operator has no symbolic form");
+            const typename Tree::pointer I = Tree::leaf(Tree::Identity,L.tree()->leftmost_basis());
+            return ODESolver<T>(Tree::node(Tree::Sum,I,Tree::node(Tree::Scale,L.tree(),nullptr,-c)),L.size(),bcs);
+        }
+    }
+
+    /**
+     * @brief Butcher tableaux of an implicit-explicit Runge-Kutta pair.
+     * Stage i is U_i = u + dt sum_{j<i} Ahat_ij N(U_j) + dt sum_{j<=i} A_ij L U_j,
+     * the step u + dt sum_j (bhat_j N(U_j) + b_j L U_j). A is lower triangular
+     * (diagonally implicit), Ahat strictly lower triangular; both row-major s x s.
+     */
+    template <class T>
+    struct IMEXTableau {
+        unsigned int s;
+        std::vector<T> A, Ahat, b, bhat;
+        //! b and bhat are the last rows of A and Ahat: the step is the last stage, which satisfies the boundary conditions
+        bool stiffly_accurate() const {
+            for (unsigned int j=0; j<s; j++)
+                if (b[j]!=A[(s-1)*s+j] || bhat[j]!=Ahat[(s-1)*s+j]) return false;
+            return true;
+        }
+        //! Forward-backward Euler, ARS(1,1,1), first order
+        static IMEXTableau ars111() {
+            return {2,{0,0, 0,1},{0,0, 1,0},{0,1},{1,0}};
+        }
+        //! ARS(2,2,2) of Ascher, Ruuth and Spiteri (1997), second order, L-stable
+        static IMEXTableau ars222() {
+            const T g = static_cast<T>(1)-std::sqrt(static_cast<T>(0.5)), d = static_cast<T>(1)-static_cast<T>(1)/(2*g);
+            return {3,{0,0,0, 0,g,0, 0,1-g,g},{0,0,0, g,0,0, d,1-d,0},{0,1-g,g},{d,1-d,0}};
+        }
+        //! ARS(4,4,3), third order, L-stable, all implicit stages share the coefficient 1/2
+        static IMEXTableau ars443() {
+            const T h = static_cast<T>(0.5);
+            return {5,{0,0,0,0,0, 0,h,0,0,0, 0,T(1)/6,h,0,0, 0,-h,h,h,0, 0,T(1.5),T(-1.5),h,h},
+                      {0,0,0,0,0, h,0,0,0,0, T(11)/18,T(1)/18,0,0,0, T(5)/6,T(-5)/6,h,0,0, T(0.25),T(1.75),T(0.75),T(-1.75),0},
+                      {0,T(1.5),T(-1.5),h,h},{T(0.25),T(1.75),T(0.75),T(-1.75),0}};
+        }
+    };
+
+    /**
+     * @brief IMEX Runge-Kutta integrator for u_t = L u + N(u) on Chebyshev coefficients.
+     * L is a LinearOperator with a symbolic form (see ODESolver) and N any
+     * callable N(Span<const T> u, Span<T> Nu) acting on coefficients. Each stage
+     * solves (I - dt A_ii L) U_i = r_i with the boundary conditions imposed; one
+     * ODESolver is factorised per distinct diagonal coefficient when dt is set
+     * and reused by every step. Stage buffers are allocated once, so steps do
+     * not touch the heap unless N does. L U_j and N(U_j) are only formed for
+     * stages that later rows of the tableau use.
+     */
+    template <class T>
+    class IMEXRungeKutta {
+        Operators::LinearOperator<T> L;
+        std::vector<BoundaryCondition<T>> bcs;
+        IMEXTableau<T> tab;
+        std::size_t n;                       //! number of coefficients
+        T dt;
+        std::vector<ODESolver<T>> solvers;   //! one per distinct non-zero A_ii
+        std::vector<T> diag;                 //! A_ii of each solver
+        std::vector<int> stage_solver;       //! solver of stage i, -1 for an explicit stage
+        std::vector<char> need_L, need_N;    //! whether L U_j and N(U_j) enter later stages or the step
+        std::vector<T> U, LU, NU, rhs;       //! stage values and buffers, s x n
+        StepCounters stats;
+        public:
+        /**
+         * @brief Set up the scheme and factorise its implicit operators
+         * @param L linear part, treated implicitly
+         * @param bcs boundary conditions imposed at every implicit stage
+         * @param dt time step
+         * @param tab IMEX pair, ARS(4,4,3) by default
+         * @throws std::invalid_argument if ODESolver rejects L
+         */
+        IMEXRungeKutta(const Operators::LinearOperator<T>& L, const std::vector<BoundaryCondition<T>>& bcs, const T& dt,
+                       const IMEXTableau<T>& tab=IMEXTableau<T>::ars443());
+        //! Change the time step, refactorising the implicit operators
+        void set_dt(const T& dt);
+        T get_dt() const { return dt; }
+        std::size_t size() const { return n; }
+        //! Number of factorisations the scheme keeps
+        std::size_t num_factorisations() const { return solvers.size(); }
+        /**
+         * @brief Advance u by one step of dt, in place
+         * @param u n Chebyshev coefficients
+         * @param N explicit term, N(Span<const T> u, Span<T> Nu)
+         */
+        template <class F> void step(Span<T> u, F&& N);
+        //! Advance u by nsteps steps
+        template <class F> void advance(Span<T> u, std::size_t nsteps, F&& N) {
+            for (std::size_t k=0; k<nsteps; k++) step(u,N);
+        }
+        const StepCounters& counters() const { return stats; }
+        void reset_counters() { stats = StepCounters(); }
+    };
+
+    template <class T> IMEXRungeKutta<T>::IMEXRungeKutta(const Operators::LinearOperator<T>& L, const std::vector<BoundaryCondition<T>>& bcs,
+                                                         const T& dt, const IMEXTableau<T>& tab): L(L), bcs(bcs), tab(tab), n(L.size())
+    {
+        const unsigned int s = tab.s;
+        assert(tab.A.size()==s*s && tab.Ahat.size()==s*s && tab.b.size()==s && tab.bhat.size()==s);
+        const bool sa = tab.stiffly_accurate();
+        need_L.assign(s,0);
+        need_N.assign(s,0);
+        for (unsigned int j=0; j<s; j++) {
+            for (unsigned int i=j+1; i<s; i++) {
+                need_L[j] |= tab.A[i*s+j]!=static_cast<T>(0);
+                need_N[j] |= tab.Ahat[i*s+j]!=static_cast<T>(0);
+            }
+            if (!sa) {
+                need_L[j] |= tab.b[j]!=static_cast<T>(0);
+                need_N[j] |= tab.bhat[j]!=static_cast<T>(0);
+            }
+        }
+        U.assign(s*n,static_cast<T>(0));
+        LU.assign(s*n,static_cast<T>(0));
+        NU.assign(s*n,static_cast<T>(0));
+        rhs.assign(n,static_cast<T>(0));
+        set_dt(dt);
+    }
+
+    template <class T> void IMEXRungeKutta<T>::set_dt(const T& dt_new)
+    {
+        dt = dt_new;
+        solvers.clear();
+        diag.clear();
+        stage_solver.assign(tab.s,-1);
+        for (unsigned int i=0; i<tab.s; i++) {
+            const T a = tab.A[i*tab.s+i];
+            if (a==static_cast<T>(0)) continue;
+            const auto it = std::find(diag.begin(),diag.end(),a);
+            if (it!=diag.end()) {
+                stage_solver[i] = static_cast<int>(it-diag.begin());
+                continue;
+            }
+            stage_solver[i] = static_cast<int>(diag.size());
+            diag.push_back(a);
+            solvers.push_back(detail::implicit_solver(L,dt*a,bcs));
+        }
+    }
+
+    template <class T> template <class F> void IMEXRungeKutta<T>::step(Span<T> u, F&& N)
+    {
+        assert(u.size()==n);
+        const auto t_step = detail::clock::now();
+        const unsigned int s = tab.s;
+        for (unsigned int i=0; i<s; i++) {
+            auto t0 = detail::clock::now();
+            std::copy(u.begin(),u.end(),rhs.begin());
+            for (unsigned int j=0; j<i; j++) {
+                const T ah = tab.Ahat[i*s+j], a = tab.A[i*s+j];
+                if (ah!=static_cast<T>(0)) detail::axpy(n,dt*ah,&NU[j*n],rhs.data());
+                if (a!=static_cast<T>(0)) detail::axpy(n,dt*a,&LU[j*n],rhs.data());
+            }
+            stats.t_linear += detail::seconds_since(t0);
+            T* Ui = &U[i*n];
+            if (stage_solver[i] < 0) std::copy(rhs.begin(),rhs.end(),Ui);
+            else {
+                t0 = detail::clock::now();
+                solvers[stage_solver[i]].solve(Span<const T>(rhs),Span<T>(Ui,n));
+                stats.t_solve += detail::seconds_since(t0);
+                stats.solves++;
+            }
+            if (need_L[i]) {
+                t0 = detail::clock::now();
+                L.apply(Span<const T>(Ui,n),Span<T>(&LU[i*n],n));
+                stats.t_linear += detail::seconds_since(t0);
+                stats.operator_applies++;
+            }
+            if (need_N[i]) {
+                t0 = detail::clock::now();
+                N(Span<const T>(Ui,n),Span<T>(&NU[i*n],n));
+                stats.t_nonlinear += detail::seconds_since(t0);
+                stats.nonlinear_evals++;
+            }
+        }
+        const auto t0 = detail::clock::now();
+        if (tab.stiffly_accurate()) std::copy(&U[(s-1)*n],&U[s*n],u.begin());
+        else {
+            for (unsigned int j=0; j<s; j++) {
+                if (tab.bhat[j]!=static_cast<T>(0)) detail::axpy(n,dt*tab.bhat[j],&NU[j*n],u.data());
+                if (tab.b[j]!=static_cast<T>(0)) detail::axpy(n,dt*tab.b[j],&LU[j*n],u.data());
+            }
+        }
+        stats.t_linear += detail::seconds_since(t0);
+        stats.t_total += detail::seconds_since(t_step);
+        stats.steps++;
+    }
+
+    /**
+     * @brief Semi-implicit BDF (SBDF) integrator of order 1 to 3 for u_t = L u + N(u).
+     * Order k solves (I - dt beta_k L) u^{n+1} = sum_j alpha_kj u^{n-j} + dt beta_k sum_j gamma_kj N(u^{n-j}),
+     * one implicit solve and one evaluation of N per step. While the history
+     * fills up, the first k-1 steps are taken by an IMEX Runge-Kutta starter of
+     * the same order (ARS(2,2,2) or ARS(4,4,3)), so the startup does not cost
+     * accuracy. All factorisations are built when dt is set; history and
+     * right-hand side are preallocated.
+     */
+    template <class T>
+    class SBDF {
+        Operators::LinearOperator<T> L;
+        std::vector<BoundaryCondition<T>> bcs;
+        unsigned int order;
+        std::size_t n;
+        T dt;
+        std::vector<ODESolver<T>> solver;    //! I - dt beta_k L, k = order
+        std::unique_ptr<IMEXRungeKutta<T>> starter; //! for the first order-1 steps
+        std::vector<T> hist_u, hist_N;       //! last `order` solutions and N(u), ring buffers of n
+        std::vector<T> rhs;
+        std::size_t head = 0;                //! ring slot of the newest entry
+        std::size_t filled = 0;              //! valid history entries
+        StepCounters stats;
+        static T beta(unsigned int k) { return k==1 ? static_cast<T>(1) : k==2 ? static_cast<T>(2)/3 : static_cast<T>(6)/11; }
+        static T alpha(unsigned int k, unsigned int j) {
+            static const T a[3][3] = {{1,0,0},{T(4)/3,T(-1)/3,0},{T(18)/11,T(-9)/11,T(2)/11}};
+            return a[k-1][j];
+        }
+        static T gamma(unsigned int k, unsigned int j) {
+            static const T g[3][3] = {{1,0,0},{2,-1,0},{3,-3,1}};
+            return g[k-1][j];
+        }
+        public:
+        /**
+         * @brief Set up the scheme and factorise its implicit operators
+         * @param L linear part, treated implicitly
+         * @param bcs boundary conditions imposed at every step
+         * @param dt time step
+         * @param order 1, 2 or 3
+         * @throws std::invalid_argument if ODESolver rejects L
+         */
+        SBDF(const Operators::LinearOperator<T>& L, const std::vector<BoundaryCondition<T>>& bcs, const T& dt, unsigned int order=2):
+            L(L), bcs(bcs), order(order), n(L.size()), hist_u(order*L.size()), hist_N(order*L.size()), rhs(L.size()) {
+            assert(order>=1 && order<=3);
+            set_dt(dt);
+        }
+        //! Change the time step, refactorising and restarting the history
+        void set_dt(const T& dt_new) {
+            dt = dt_new;
+            solver.clear();
+            solver.push_back(detail::implicit_solver(L,dt*beta(order),bcs));
+            if (order>1) starter.reset(new IMEXRungeKutta<T>(L,bcs,dt,order==2 ? IMEXTableau<T>::ars222() : IMEXTableau<T>::ars443()));
+            restart();
+        }
+        //! Forget the history, e.g. after changing u from outside
+        void restart() { filled = 0; }
+        T get_dt() const { return dt; }
+        std::size_t size() const { return n; }
+        //! Advance u by one step of dt, in place, see IMEXRungeKutta::step
+        template <class F> void step(Span<T> u, F&& N);
+        template <class F> void advance(Span<T> u, std::size_t nsteps, F&& N) {
+            for (std::size_t k=0; k<nsteps; k++) step(u,N);
+        }
+        //! Counters of the BDF steps, the starter steps are included in steps and t_total
+        const StepCounters& counters() const { return stats; }
+        void reset_counters() { stats = StepCounters(); }
+    };
+
+    template <class T> template <class F> void SBDF<T>::step(Span<T> u, F&& N)
+    {
+        assert(u.size()==n);
+        const auto t_step = detail::clock::now();
+        head = (head+1)%order;
+        filled = std::min<std::size_t>(filled+1,order);
+        std::copy(u.begin(),u.end(),&hist_u[head*n]);
+        auto t0 = detail::clock::now();
+        N(Span<const T>(u.data(),n),Span<T>(&hist_N[head*n],n));
+        stats.t_nonlinear += detail::seconds_since(t0);
+        stats.nonlinear_evals++;
+        if (filled<order) starter->step(u,N);
+        else {
+            t0 = detail::clock::now();
+            std::fill(rhs.begin(),rhs.end(),static_cast<T>(0));
+            for (unsigned int j=0; j<order; j++) {
+                const std::size_t slot = (head+order-j)%order;
+                detail::axpy(n,alpha(order,j),&hist_u[slot*n],rhs.data());
+                detail::axpy(n,dt*beta(order)*gamma(order,j),&hist_N[slot*n],rhs.data());
+            }
+            stats.t_linear += detail::seconds_since(t0);
+            t0 = detail::clock::now();
+            solver[0].solve(Span<const T>(rhs),u);
+            stats.t_solve += detail::seconds_since(t0);
+            stats.solves++;
+        }
+        stats.t_total += detail::seconds_since(t_step);
+        stats.steps++;
+    }
+
 };
 
-#endif
\ No newline at end of file
+#endif
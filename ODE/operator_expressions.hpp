@@ -0,0 +1,253 @@
+/**
+ * @file operator_expressions.hpp
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * @brief Expression templates for sums, scalar multiples and compositions of linear operators
+ * Writing A + B*2.0 with operators builds a lightweight expression object
+ * instead of a new matrix. An expression can be applied directly to a vector
+ * of coefficients (each term is applied in its own storage format and
+ * accumulated, no intermediate matrix is formed), or materialised once into
+ * an OperatorStorage by assigning it to a LinearOperator.
+ * Leaf operators are held by reference: an expression must not outlive the
+ * operators it was built from.
+ * Every expression also carries a symbolic OperatorTree, which lets solvers
+ * re-discretise the operator in another basis (see ultraspherical.hpp).
+ */
+#ifndef _MY_OPERATOR_EXPRESSIONS_HPP
+#define _MY_OPERATOR_EXPRESSIONS_HPP
+
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <memory>
+#include <typeinfo>
+#include <typeindex>
+#include <string>
+#include "../polybases/operator_storage.hpp"
+#include "../polybases/span.hpp"
+
+namespace Operators {
+
+    namespace detail {
+        //! Per-thread stack of scratch vectors for intermediate results of compositions
+        template <class T> struct ScratchStack {
+            std::vector<std::vector<T>> buffers;
+            std::size_t depth = 0;
+        };
+        template <class T> inline ScratchStack<T>& scratch_stack() {
+            static thread_local ScratchStack<T> stack;
+            return stack;
+        }
+        /**
+         * @brief RAII handle on the next free scratch vector of this thread.
+         * Buffers are kept and reused, so after the first application of an
+         * expression no further allocation happens.
+         */
+        template <class T> class ScratchBuffer {
+            ScratchStack<T>& stack;
+            T* ptr;
+            public:
+            ScratchBuffer(std::size_t n) : stack(scratch_stack<T>()) {
+                if (stack.buffers.size() <= stack.depth) stack.buffers.emplace_back();
+                std::vector<T>& buf = stack.buffers[stack.depth++];
+                if (buf.size() < n) buf.resize(n);
+                ptr = buf.data();
+            }
+            ~ScratchBuffer() { stack.depth--; }
+            ScratchBuffer(const ScratchBuffer&) = delete;
+            ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+            T* data() const { return ptr; }
+        };
+    }
+
+    /**
+     * @brief Basis an elementary operator was assembled on: its dynamic type,
+     * its plan_key() and the breakpoints of the elements its coefficients are
+     * Chebyshev series on (chebyshev_elements()), the only spaces the
+     * ultraspherical solvers handle.
+     */
+    struct BasisTag {
+        std::type_index type = std::type_index(typeid(void));
+        std::string key;
+        std::vector<long double> elements;
+        bool operator==(const BasisTag& rhs) const { return type==rhs.type && key==rhs.key && elements==rhs.elements; }
+        bool operator!=(const BasisTag& rhs) const { return !(*this==rhs); }
+        //! True for a single Chebyshev series on [-1,1]
+        bool chebyshev() const { return elements.size()==2 && elements[0]==-1 && elements[1]==1; }
+        //! Number of Chebyshev elements, 0 if the coefficients are not Chebyshev coefficients
+        std::size_t num_elements() const { return elements.empty() ? 0 : elements.size()-1; }
+        //! Tag of a FunctionalBase or a StaticBasis
+        template <class Basis> static BasisTag of(const Basis& b) {
+            const auto br = b.chebyshev_elements();
+            return BasisTag{std::type_index(typeid(b)),b.plan_key(),std::vector<long double>(br.begin(),br.end())};
+        }
+        //! Chebyshev series on [-1,1] without a concrete basis, the reference element of a multi-domain basis
+        static BasisTag reference_element() { return BasisTag{std::type_index(typeid(void)),std::string(),{-1.0L,1.0L}}; }
+    };
+
+    /**
+     * @brief Symbolic form of an operator expression.
+     * Leaves record which elementary operator they are and the basis they
+     * act on, inner nodes the arithmetic that combined them. Operators set
+     * from a bare matrix have no symbolic form, their tree is a null pointer.
+     */
+    template <class T>
+    struct OperatorTree {
+        enum Kind { Identity, Derivative, SecondDerivative, TimesX, Sum, Scale, Product };
+        typedef std::shared_ptr<const OperatorTree> pointer;
+        Kind kind;
+        T scalar;       //! Scale only
+        pointer lhs;    //! Sum, Product: left operand; Scale: operand
+        pointer rhs;    //! Sum, Product: right operand
+        BasisTag basis; //! leaves only
+        static pointer leaf(Kind k, const BasisTag& b) {
+            return std::make_shared<const OperatorTree>(OperatorTree{k,static_cast<T>(1),nullptr,nullptr,b});
+        }
+        //! Inner node, null if either operand has no symbolic form
+        static pointer node(Kind k, const pointer& a, const pointer& b, const T& s=static_cast<T>(1)) {
+            if (!a || (k!=Scale && !b)) return nullptr;
+            return std::make_shared<const OperatorTree>(OperatorTree{k,s,a,b,BasisTag()});
+        }
+        //! Number of nodes
+        std::size_t count() const { return 1 + (lhs ? lhs->count() : 0) + (rhs ? rhs->count() : 0); }
+        //! True if every leaf acts on Chebyshev coefficients on [-1,1]
+        bool chebyshev() const {
+            if (!lhs) return basis.chebyshev();
+            return lhs->chebyshev() && (!rhs || rhs->chebyshev());
+        }
+        //! True if every leaf acts on the basis b
+        bool on_basis(const BasisTag& b) const {
+            if (!lhs) return basis==b;
+            return lhs->on_basis(b) && (!rhs || rhs->on_basis(b));
+        }
+        //! Basis of the leftmost leaf
+        const BasisTag& leftmost_basis() const { return lhs ? lhs->leftmost_basis() : basis; }
+        //! The same expression over another scalar type, scalars rounded to U
+        template <class U> typename OperatorTree<U>::pointer converted() const {
+            typedef typename OperatorTree<U>::Kind K;
+            if (!lhs) return OperatorTree<U>::leaf(static_cast<K>(kind),basis);
+            return OperatorTree<U>::node(static_cast<K>(kind),lhs->template converted<U>(),
+                                         rhs ? rhs->template converted<U>() : nullptr,static_cast<U>(scalar));
+        }
+    };
+
+    template<class T> class LinearOperator;
+
+    /**
+     * @brief CRTP base of every operator expression.
+     * A derived E provides value_type, size(), apply_add(x,y,alpha) computing
+     * y += alpha E x, materialise() returning an OperatorStorage and tree()
+     * returning its OperatorTree.
+     */
+    template <class E>
+    struct OperatorExpr {
+        const E& self() const { return static_cast<const E&>(*this); }
+        //! y = E x, y must not alias x
+        template <class T> void apply(FunctionalBases::Span<const T> x, FunctionalBases::Span<T> y) const {
+            assert(x.size()==self().size() && y.size()==self().size());
+            std::fill(y.begin(),y.end(),static_cast<T>(0));
+            self().apply_add(x.data(),y.data(),static_cast<T>(1));
+        }
+        template <class T> void apply(const std::vector<T>& x, std::vector<T>& y) const {
+            y.resize(self().size());
+            apply(FunctionalBases::Span<const T>(x),FunctionalBases::Span<T>(y));
+        }
+    };
+
+    //! Leaves (LinearOperator and subclasses) are held by reference, expression nodes by value
+    template <class E> struct expr_ref {
+        typedef typename std::conditional<std::is_base_of<LinearOperator<typename E::value_type>,E>::value, const E&, const E>::type type;
+    };
+
+    //! A + B
+    template <class A, class B>
+    class OpSum : public OperatorExpr<OpSum<A,B>> {
+        typename expr_ref<A>::type a;
+        typename expr_ref<B>::type b;
+        public:
+        typedef typename A::value_type value_type;
+        OpSum(const A& a, const B& b) : a(a), b(b) { assert(a.size()==b.size()); }
+        std::size_t size() const { return a.size(); }
+        void apply_add(const value_type* x, value_type* y, const value_type& alpha) const {
+            a.apply_add(x,y,alpha);
+            b.apply_add(x,y,alpha);
+        }
+        FunctionalBases::OperatorStorage<value_type> materialise() const {
+            return FunctionalBases::OperatorStorage<value_type>::sum(a.materialise(),b.materialise());
+        }
+        typename OperatorTree<value_type>::pointer tree() const {
+            return OperatorTree<value_type>::node(OperatorTree<value_type>::Sum,a.tree(),b.tree());
+        }
+        const A& lhs() const { return a; }
+        const B& rhs() const { return b; }
+    };
+
+    //! s * A
+    template <class A>
+    class OpScale : public OperatorExpr<OpScale<A>> {
+        public:
+        typedef typename A::value_type value_type;
+        private:
+        typename expr_ref<A>::type a;
+        value_type s;
+        public:
+        OpScale(const A& a, const value_type& s) : a(a), s(s) {}
+        std::size_t size() const { return a.size(); }
+        void apply_add(const value_type* x, value_type* y, const value_type& alpha) const {
+            a.apply_add(x,y,alpha*s);
+        }
+        FunctionalBases::OperatorStorage<value_type> materialise() const { return a.materialise().scaled(s); }
+        typename OperatorTree<value_type>::pointer tree() const {
+            return OperatorTree<value_type>::node(OperatorTree<value_type>::Scale,a.tree(),nullptr,s);
+        }
+        const A& operand() const { return a; }
+        const value_type& scalar() const { return s; }
+    };
+
+    //! A * B, the composition x -> A (B x)
+    template <class A, class B>
+    class OpProduct : public OperatorExpr<OpProduct<A,B>> {
+        typename expr_ref<A>::type a;
+        typename expr_ref<B>::type b;
+        public:
+        typedef typename A::value_type value_type;
+        OpProduct(const A& a, const B& b) : a(a), b(b) { assert(a.size()==b.size()); }
+        std::size_t size() const { return a.size(); }
+        void apply_add(const value_type* x, value_type* y, const value_type& alpha) const {
+            detail::ScratchBuffer<value_type> tmp(size());
+            std::fill(tmp.data(),tmp.data()+size(),static_cast<value_type>(0));
+            b.apply_add(x,tmp.data(),static_cast<value_type>(1));
+            a.apply_add(tmp.data(),y,alpha);
+        }
+        FunctionalBases::OperatorStorage<value_type> materialise() const {
+            return FunctionalBases::OperatorStorage<value_type>::product(a.materialise(),b.materialise());
+        }
+        typename OperatorTree<value_type>::pointer tree() const {
+            return OperatorTree<value_type>::node(OperatorTree<value_type>::Product,a.tree(),b.tree());
+        }
+        const A& lhs() const { return a; }
+        const B& rhs() const { return b; }
+    };
+
+    // operators ------------------
+    template <class A, class B> inline OpSum<A,B> operator+(const OperatorExpr<A>& a, const OperatorExpr<B>& b) {
+        return OpSum<A,B>(a.self(),b.self());
+    }
+    template <class A> inline OpScale<A> operator*(const OperatorExpr<A>& a, const typename A::value_type& s) {
+        return OpScale<A>(a.self(),s);
+    }
+    template <class A> inline OpScale<A> operator*(const typename A::value_type& s, const OperatorExpr<A>& a) {
+        return OpScale<A>(a.self(),s);
+    }
+    template <class A> inline OpScale<A> operator-(const OperatorExpr<A>& a) {
+        return OpScale<A>(a.self(),static_cast<typename A::value_type>(-1));
+    }
+    template <class A, class B> inline OpSum<A,OpScale<B>> operator-(const OperatorExpr<A>& a, const OperatorExpr<B>& b) {
+        return OpSum<A,OpScale<B>>(a.self(),OpScale<B>(b.self(),static_cast<typename B::value_type>(-1)));
+    }
+    template <class A, class B> inline OpProduct<A,B> operator*(const OperatorExpr<A>& a, const OperatorExpr<B>& b) {
+        return OpProduct<A,B>(a.self(),b.self());
+    }
+
+};
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * @file ultraspherical.hpp
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * @brief Banded ultraspherical discretisation of linear differential operators
+ * In the Chebyshev basis a k-th derivative is dense. Mapping its result to
+ * the ultraspherical (Gegenbauer) basis C^(k) instead makes it a single
+ * super-diagonal:
+ *   d/dx T_n = n C^(1)_{n-1},   d/dx C^(l)_n = 2l C^(l+1)_{n-1}.
+ * Lower order terms are brought to C^(k) with the banded conversions
+ *   T_n = (C^(1)_n - C^(1)_{n-2})/2,   C^(l)_n = l/(n+l) (C^(l+1)_n - C^(l+1)_{n-2}),
+ * and multiplication by x is tridiagonal in every C^(l), so any operator
+ * built from Identity, Derivative, SecondDerivative and TimesX is banded
+ * from Chebyshev coefficients to C^(k) coefficients.
+ * Reference: Olver & Townsend, "A fast and well-conditioned spectral method", SIAM Review 55 (2013).
+ */
+#ifndef _MY_SPECTRE_ULTRASPHERICAL_HPP
+#define _MY_SPECTRE_ULTRASPHERICAL_HPP
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <assert.h>
+#include "../polybases/operator_storage.hpp"
+#include "operator_expressions.hpp"
+
+namespace ODE {
+
+    /**
+     * @brief An operator mapping Chebyshev coefficients to C^(order) coefficients
+     */
+    template <class T>
+    struct UltrasphericalForm {
+        unsigned int order;
+        FunctionalBases::OperatorStorage<T> A;
+    };
+
+    namespace Ultraspherical {
+
+        //! C^(lambda) -> C^(lambda+1), lambda = 0 meaning the Chebyshev basis
+        template <class T> inline FunctionalBases::OperatorStorage<T> conversion(unsigned int lambda, std::size_t n) {
+            std::vector<T> band(3*n,static_cast<T>(0));
+            for (std::size_t i=0; i<n; i++) {
+                const T l = static_cast<T>(lambda);
+                band[3*i] = lambda==0 ? (i==0 ? static_cast<T>(1) : static_cast<T>(0.5)) : l/(static_cast<T>(i)+l);
+                if (i+2<n) band[3*i+2] = lambda==0 ? static_cast<T>(-0.5) : -l/(static_cast<T>(i+2)+l);
+            }
+            return FunctionalBases::OperatorStorage<T>::banded(n,0,2,band);
+        }
+
+        //! d/dx from C^(lambda) to C^(lambda+1)
+        template <class T> inline FunctionalBases::OperatorStorage<T> differentiation(unsigned int lambda, std::size_t n) {
+            std::vector<T> band(2*n,static_cast<T>(0));
+            for (std::size_t i=0; i+1<n; i++)
+                band[2*i+1] = lambda==0 ? static_cast<T>(i+1) : static_cast<T>(2*lambda);
+            return FunctionalBases::OperatorStorage<T>::banded(n,0,1,band);
+        }
+
+        //! Multiplication by x within C^(lambda)
+        template <class T> inline FunctionalBases::OperatorStorage<T> multiplication_x(unsigned int lambda, std::size_t n) {
+            std::vector<T> band(3*n,static_cast<T>(0));
+            const T l = static_cast<T>(lambda);
+            for (std::size_t i=0; i<n; i++) {
+                const T ti = static_cast<T>(i);
+                if (lambda==0) {
+                    // x T_n = (T_{n+1} + T_{n-1})/2, T_0 feeds T_1 with weight one
+                    if (i>0) band[3*i] = i==1 ? static_cast<T>(1) : static_cast<T>(0.5);
+                    if (i+1<n) band[3*i+2] = static_cast<T>(0.5);
+                } else {
+                    // x C_n = ((n+1) C_{n+1} + (n+2l-1) C_{n-1}) / (2(n+l))
+                    if (i>0) band[3*i] = ti/(2*(ti-1+l));
+                    if (i+1<n) band[3*i+2] = (ti+2*l)/(2*(ti+1+l));
+                }
+            }
+            return FunctionalBases::OperatorStorage<T>::banded(n,1,1,band);
+        }
+
+        //! Bring a form to C^(order) by successive conversions
+        template <class T> inline void raise(UltrasphericalForm<T>& F, unsigned int order, std::size_t n) {
+            for (; F.order<order; F.order++)
+                F.A = FunctionalBases::OperatorStorage<T>::product(conversion<T>(F.order,n),F.A);
+        }
+
+        //! Apply the operator described by tree to the result of F
+        template <class T> inline UltrasphericalForm<T> apply(const Operators::OperatorTree<T>& tree, UltrasphericalForm<T> F, std::size_t n) {
+            typedef Operators::OperatorTree<T> Tree;
+            typedef FunctionalBases::OperatorStorage<T> Storage;
+            switch (tree.kind) {
+            case Tree::Identity:
+                return F;
+            case Tree::TimesX:
+                F.A = Storage::product(multiplication_x<T>(F.order,n),F.A);
+                return F;
+            case Tree::SecondDerivative:
+                F.A = Storage::product(differentiation<T>(F.order,n),F.A);
+                F.order++;
+                // fall through
+            case Tree::Derivative:
+                F.A = Storage::product(differentiation<T>(F.order,n),F.A);
+                F.order++;
+                return F;
+            case Tree::Scale: {
+                UltrasphericalForm<T> G = apply(*tree.lhs,F,n);
+                G.A = G.A.scaled(tree.scalar);
+                return G;
+            }
+            case Tree::Sum: {
+                UltrasphericalForm<T> G = apply(*tree.lhs,F,n), H = apply(*tree.rhs,F,n);
+                const unsigned int order = std::max(G.order,H.order);
+                raise(G,order,n);
+                raise(H,order,n);
+                G.A = Storage::sum(G.A,H.A);
+                return G;
+            }
+            case Tree::Product:
+                return apply(*tree.lhs,apply(*tree.rhs,F,n),n);
+            }
+            return F;
+        }
+
+    }
+
+    /**
+     * @brief Ultraspherical form of the (n x n) Chebyshev operator described by tree.
+     * The products of the truncated factors are computed on a padded size and
+     * cut back to n, so the result is the exact leading block of the infinite
+     * operator.
+     * @param tree symbolic form of the operator
+     * @param n number of Chebyshev coefficients
+     * @throws std::invalid_argument if a leaf of tree was built on a basis other
+     * than a Chebyshev series on [-1,1] (Fourier, Legendre, mapped domains),
+     * whose operators the recurrences above do not describe; operators on a
+     * multi-domain Chebyshev basis are brought to [-1,1] by element_form first
+     */
+    template <class T> inline UltrasphericalForm<T> ultraspherical_form(const Operators::OperatorTree<T>& tree, std::size_t n) {
+        if (!tree.chebyshev())
+            throw std::invalid_argument("ultraspherical_form: operator not built on a Chebyshev basis on [-1,1]");
+        // every factor, including the conversions inserted for sums, reaches at most two coefficients up
+        const std::size_t np = n + 4*tree.count() + 4;
+        UltrasphericalForm<T> F{0u,FunctionalBases::OperatorStorage<T>::identity(np)};
+        F = Ultraspherical::apply(tree,F,np);
+        const std::size_t kl = F.A.lower_bandwidth(), ku = F.A.upper_bandwidth(), w = kl+ku+1;
+        std::vector<T> band(n*w,static_cast<T>(0));
+        for (std::size_t i=0; i<n; i++)
+            for (std::size_t j=(i>kl ? i-kl : 0); j<std::min(n,i+ku+1); j++) band[i*w+j+kl-i] = F.A.get(i,j);
+        return UltrasphericalForm<T>{F.order,FunctionalBases::OperatorStorage<T>::banded(n,kl,ku,band)};
+    }
+
+    /**
+     * @brief The operator described by tree restricted to the element [a,b] of a
+     * multi-domain Chebyshev basis, written on the reference element [-1,1]:
+     *   d/dx -> (2/h) d/dxi,   d2/dx2 -> (2/h)^2 d2/dxi2,   x -> (a+b)/2 + (h/2) xi,
+     * with h = b-a. Its leaves carry BasisTag::reference_element(), so
+     * ultraspherical_form accepts it.
+     */
+    template <class T> inline typename Operators::OperatorTree<T>::pointer element_form(const Operators::OperatorTree<T>& tree, const T& a, const T& b) {
+        typedef Operators::OperatorTree<T> Tree;
+        const Operators::BasisTag ref = Operators::BasisTag::reference_element();
+        const T s = static_cast<T>(2)/(b-a);
+        switch (tree.kind) {
+        case Tree::Identity: return Tree::leaf(Tree::Identity,ref);
+        case Tree::Derivative: return Tree::node(Tree::Scale,Tree::leaf(Tree::Derivative,ref),nullptr,s);
+        case Tree::SecondDerivative: return Tree::node(Tree::Scale,Tree::leaf(Tree::SecondDerivative,ref),nullptr,s*s);
+        case Tree::TimesX:
+            return Tree::node(Tree::Sum,Tree::node(Tree::Scale,Tree::leaf(Tree::Identity,ref),nullptr,static_cast<T>(0.5)*(a+b)),
+                              Tree::node(Tree::Scale,Tree::leaf(Tree::TimesX,ref),nullptr,static_cast<T>(0.5)*(b-a)));
+        default:
+            return Tree::node(tree.kind,element_form(*tree.lhs,a,b),tree.rhs ? element_form(*tree.rhs,a,b) : nullptr,tree.scalar);
+        }
+    }
+
+    /**
+     * @brief Convert n Chebyshev coefficients to C^(order) coefficients in place, O(order n)
+     * @param c coefficients, n x nb row-major for a block of nb vectors
+     */
+    template <class T> inline void chebyshev_to_ultraspherical(T* c, std::size_t n, unsigned int order, std::size_t nb=1) {
+        for (unsigned int lambda=0; lambda<order; lambda++) {
+            const T l = static_cast<T>(lambda);
+            for (std::size_t i=0; i<n; i++) {
+                const T a = lambda==0 ? (i==0 ? static_cast<T>(1) : static_cast<T>(0.5)) : l/(static_cast<T>(i)+l);
+                const T b = lambda==0 ? static_cast<T>(-0.5) : -l/(static_cast<T>(i+2)+l);
+                T* ci = c+i*nb;
+                if (i+2<n) {
+                    const T* next = c+(i+2)*nb;
+                    for (std::size_t k=0; k<nb; k++) ci[k] = a*ci[k] + b*next[k];
+                } else {
+                    for (std::size_t k=0; k<nb; k++) ci[k] *= a;
+                }
+            }
+        }
+    }
+
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "../io/archive.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+
+/*
+ * Warm start from an archive against rebuilding: for each N the tables of a
+ * ChebyshevBase, its derivative and multiplication operators and the dense
+ * product X D (assembled column by column) are built from scratch, written
+ * once, and then mapped back with and without checksum verification. The
+ * mapped views are used as they are, nothing is copied.
+ */
+
+int main()
+{
+    const std::string path = "bench_archive.bin";
+    for (unsigned int N : {256u, 1024u, 4096u}) {
+        Bench::Timer timer;
+        ChebyshevBase<double> basis(N);
+        const OperatorStorage<double> D = basis.deriv_storage();
+        const OperatorStorage<double> D2 = basis.second_deriv_storage();
+        const OperatorStorage<double> X = basis.times_x_storage();
+        const OperatorStorage<double> XD = OperatorStorage<double>::product(X,D);
+        const double t_build = timer.elapsed();
+
+        IO::ArchiveWriter w;
+        w.add_basis("cheb",basis);
+        w.add_operator("D",D);
+        w.add_operator("D2",D2);
+        w.add_operator("X",X);
+        w.add_operator("XD",XD);
+        timer.reset();
+        if (!w.write(path)) {
+            std::printf("cannot write %s\n", path.c_str());
+            return 1;
+        }
+        const double t_write = timer.elapsed();
+
+        std::vector<double> x(N+1,1.0), y(N+1);
+        auto load = [&](bool verify) {
+            auto a = IO::Archive::open(path,verify);
+            a->operator_view<double>("XD").apply(x.data(),y.data());
+            Bench::do_not_optimize(y[0]);
+            return a->file_size();
+        };
+        const double t_fast = Bench::best_time([&]() { load(false); },3);
+        const double t_verify = Bench::best_time([&]() { load(true); },3);
+        const double mb = load(false)/1e6;
+        std::printf("N = %5u  %8.2f MB  build %10.3e s  write %10.3e s  map %10.3e s  map+verify %10.3e s (%6.2f GB/s)  speedup %8.1f\n",
+                    N, mb, t_build, t_write, t_fast, t_verify, mb/1e3/t_verify, t_build/t_fast);
+    }
+    std::remove(path.c_str());
+}
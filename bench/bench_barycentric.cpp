@@ -0,0 +1,73 @@
+#include "../functions.hpp"
+#include "../polybases/barycentric.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+
+/*
+ * Off-grid evaluation and grid-to-grid transfer on Chebyshev grids:
+ *   eval     : points per second of the batched Clenshaw series against the
+ *              barycentric formula on the nodal values, 1 and all threads
+ *   resample : fields per second moved from order N to order 3N/2 by
+ *              coefficients (transform, zero pad, inverse transform) and by
+ *              the precomputed ResamplingMatrix, M fields batched
+ */
+
+void run(unsigned int N, const std::vector<double>& x, std::vector<double>& y)
+{
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    std::vector<double> f(N+1), ft(N+1);
+    for (unsigned int i=0; i<=N; i++) f[i] = std::exp(basis->get_nodes()[i])*std::sin(5*basis->get_nodes()[i]);
+    basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+    BarycentricInterpolator<double> bary(*basis);
+    const double npts = x.size();
+    const unsigned int nthreads = Parallel::default_threads();
+
+    const double t_cl = Bench::best_time([&]() {
+        basis->evaluate_series_batch(Span<const double>(x),ft,Span<double>(y));
+        Bench::do_not_optimize(y[0]);
+    },3);
+    const double t_b1 = Bench::best_time([&]() {
+        bary.eval(Span<const double>(x),Span<const double>(f),Span<double>(y),1);
+        Bench::do_not_optimize(y[0]);
+    },3);
+    const double t_bt = Bench::best_time([&]() {
+        bary.eval(Span<const double>(x),Span<const double>(f),Span<double>(y),nthreads);
+        Bench::do_not_optimize(y[0]);
+    },3);
+    std::printf("eval     N = %5u  Clenshaw %10.3e  barycentric %10.3e  barycentric x%u %10.3e pts/s\n",
+                N, npts/t_cl, npts/t_b1, nthreads, npts/t_bt);
+
+    const unsigned int Nt = 3*N/2;
+    const std::size_t M = 64;
+    auto target = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(Nt);
+    auto R = PlanRegistry::instance().get_resampling<double>(N,Nt);
+    std::vector<double> in(M*(N+1)), out(M*(Nt+1)), c(N+1), cp(Nt+1);
+    for (std::size_t m=0; m<M; m++) std::copy(f.begin(),f.end(),in.begin()+m*(N+1));
+    const double t_coef = Bench::best_time([&]() {
+        for (std::size_t m=0; m<M; m++) {
+            basis->calc_spectral_coeffs(Span<const double>(in.data()+m*(N+1),N+1),Span<double>(c));
+            std::copy(c.begin(),c.end(),cp.begin());
+            std::fill(cp.begin()+N+1,cp.end(),0.0);
+            target->calc_function_values(Span<const double>(cp),Span<double>(out.data()+m*(Nt+1),Nt+1));
+        }
+        Bench::do_not_optimize(out[0]);
+    },3);
+    const double t_mat = Bench::best_time([&]() {
+        R->apply_batch(Span<const double>(in),Span<double>(out),M,BatchLayout::SoA,nthreads);
+        Bench::do_not_optimize(out[0]);
+    },3);
+    std::printf("resample N = %5u -> %5u  coefficients %10.3e  matrix %10.3e fields/s\n", N, Nt, M/t_coef, M/t_mat);
+}
+
+int main()
+{
+    const std::size_t NPTS = 1 << 16;
+    std::vector<double> x(NPTS), y(NPTS);
+    unsigned int seed = 12345;
+    for (auto& v: x) { seed = seed*1103515245u + 12345u; v = 2.0*(seed >> 8)/double(1u << 24) - 1.0; }
+    for (unsigned int N : {16u, 64u, 256u, 1024u}) run(N,x,y);
+}
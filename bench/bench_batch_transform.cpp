@@ -0,0 +1,54 @@
+#include "../polybases/polybases.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace FunctionalBases;
+
+/*
+ * Forward transform of M = 10^4 functions (or argv[1]) sharing the same N:
+ *   loop  : one calc_spectral_coeffs per function
+ *   SoA   : calc_spectral_coeffs_batch, functions stored one after the other
+ *   AoS   : calc_spectral_coeffs_batch, functions interleaved point by point
+ * The batch rows report GFLOP/s (batch_flops / time) and the memory traffic
+ * 2 M (N+1) sizeof(double) / time in GB/s. Around batch_dct_threshold both
+ * paths are timed by forcing the transform type.
+ */
+int main(int argc, char** argv)
+{
+    const std::size_t M = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const unsigned int T = Parallel::default_threads();
+    std::printf("M = %zu functions, %u threads\n", M, T);
+    for (unsigned int N: {8u, 16u, 32u, 64u, 128u, 256u, 512u}) {
+        const std::size_t n1 = N+1;
+        std::vector<double> f(M*n1), ft(M*n1), fm(n1), ftm;
+        for (std::size_t i=0; i<f.size(); i++) f[i] = std::sin(1e-3*i);
+        const double bytes = 2.0*M*n1*sizeof(double);
+
+        ChebyshevBase<double> basis(N);
+        const double t_loop = Bench::best_time([&]() {
+            for (std::size_t m=0; m<M; m++) {
+                std::copy(f.begin()+m*n1,f.begin()+(m+1)*n1,fm.begin());
+                basis.calc_spectral_coeffs(fm,ftm);
+                Bench::do_not_optimize(ftm[0]);
+            }
+        },3);
+        std::printf("N = %4u loop        : %10.3e s\n", N, t_loop);
+
+        for (TransformType type: {TransformType::Auto, TransformType::Quadrature, TransformType::DCT}) {
+            if (type!=TransformType::Auto && (N<128 || N>512)) continue;
+            ChebyshevBase<double> b(N,type);
+            for (BatchLayout layout: {BatchLayout::SoA, BatchLayout::AoS}) {
+                const double t = Bench::best_time([&]() {
+                    b.calc_spectral_coeffs_batch(Span<const double>(f),Span<double>(ft),M,layout,T);
+                    Bench::do_not_optimize(ft[0]);
+                },3);
+                std::printf("N = %4u %s %s: %10.3e s  %7.2f GFLOP/s  %7.2f GB/s  speedup %6.1f\n", N,
+                            layout==BatchLayout::SoA ? "SoA" : "AoS", b.batch_uses_dct() ? "dct " : "gemm",
+                            t, b.batch_flops(M)/t*1e-9, bytes/t*1e-9, t_loop/t);
+            }
+        }
+    }
+}
@@ -0,0 +1,214 @@
+/**
+ * @file bench_common.hpp
+ * @brief Timing helpers shared by the benchmark programs.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * best_time() gives a single best-of figure. measure() collects a
+ * distribution (median and percentiles of per-call latency) and, if the
+ * program defines BENCH_COUNT_ALLOCATIONS before including this header, the
+ * heap allocations per call; the replacement operator new is then defined
+ * here, so only one translation unit may do so. JsonReport writes results
+ * in a stable machine-readable form for tracking regressions.
+ */
+#ifndef _MY_SPECTRE_BENCH_COMMON_HPP
+#define _MY_SPECTRE_BENCH_COMMON_HPP
+
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace Bench {
+
+  namespace detail {
+    inline std::atomic<std::size_t>& allocation_counter() {
+      static std::atomic<std::size_t> count{0};
+      return count;
+    }
+    //! s as the body of a JSON string: quotes, backslashes and control characters escaped
+    inline std::string json_escape(const std::string& s) {
+      std::string r;
+      for (char c : s) {
+        switch (c) {
+        case '"': r += "\\\""; break;
+        case '\\': r += "\\\\"; break;
+        case '\n': r += "\\n"; break;
+        case '\t': r += "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            char u[8];
+            std::snprintf(u,sizeof(u),"\\u%04x",static_cast<unsigned int>(static_cast<unsigned char>(c)));
+            r += u;
+          }
+          else r += c;
+        }
+      }
+      return r;
+    }
+  }
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+  constexpr bool counting_allocations = true;
+#else
+  constexpr bool counting_allocations = false;
+#endif
+  //! Heap allocations so far, zero unless BENCH_COUNT_ALLOCATIONS is defined
+  inline std::size_t allocations() { return detail::allocation_counter().load(std::memory_order_relaxed); }
+
+  //! Wall-clock stopwatch
+  class Timer {
+    std::chrono::steady_clock::time_point t0;
+  public:
+    Timer() : t0(std::chrono::steady_clock::now()) {};
+    inline void reset() { t0 = std::chrono::steady_clock::now(); }
+    //! Seconds since construction or the last reset
+    inline double elapsed() const {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+  };
+
+  /**
+   * @brief Best time in seconds of one call to f, over repeats runs.
+   * Each run calls f enough times to last at least min_time seconds.
+   */
+  template <class F> inline double best_time(F f, const int repeats=5, const double min_time=0.05)
+  {
+    double best = 1e300;
+    for (int r=0; r<repeats; r++) {
+      Timer t;
+      long calls = 0;
+      do { f(); calls++; } while (t.elapsed() < min_time);
+      best = std::min(best, t.elapsed()/calls);
+    }
+    return best;
+  }
+
+  //! Keep the compiler from optimising away a result
+  template <class V> inline void do_not_optimize(const V& value)
+  {
+    asm volatile("" : : "g"(&value) : "memory");
+  }
+
+  //! Distribution of the per-call time of a measured function
+  struct Stats {
+    int samples = 0;
+    long calls_per_sample = 0;
+    double min = 0, p10 = 0, median = 0, p90 = 0, p99 = 0, mean = 0; //! seconds per call
+    double allocs_per_call = -1; //! -1 when allocations are not counted
+  };
+
+  //! Percentile q in [0,1] of sorted values, linear interpolation
+  inline double percentile(const std::vector<double>& sorted, double q)
+  {
+    if (sorted.empty()) return 0;
+    const double pos = q*(sorted.size()-1);
+    const std::size_t i = static_cast<std::size_t>(pos);
+    if (i+1>=sorted.size()) return sorted.back();
+    return sorted[i] + (pos-i)*(sorted[i+1]-sorted[i]);
+  }
+
+  /**
+   * @brief Latency distribution of f over samples runs.
+   * Warm-up runs double the number of calls until one lasts min_sample_time
+   * seconds; every sample then makes that many calls, so short calls are not
+   * dominated by the clock. Allocations are counted over the sampled calls.
+   */
+  template <class F> inline Stats measure(F f, const int samples=21, const double min_sample_time=2e-3)
+  {
+    Timer t;
+    long calls = 1;
+    for (;;) {
+      t.reset();
+      for (long c=0; c<calls; c++) f();
+      if (t.elapsed() >= min_sample_time) break;
+      calls *= 2;
+    }
+    std::vector<double> times(samples);
+    const std::size_t a0 = allocations();
+    for (int s=0; s<samples; s++) {
+      t.reset();
+      for (long c=0; c<calls; c++) f();
+      times[s] = t.elapsed()/calls;
+    }
+    const std::size_t a1 = allocations();
+    Stats st;
+    st.samples = samples;
+    st.calls_per_sample = calls;
+    for (double v : times) st.mean += v/samples;
+    std::sort(times.begin(),times.end());
+    st.min = times.front();
+    st.p10 = percentile(times,0.10);
+    st.median = percentile(times,0.50);
+    st.p90 = percentile(times,0.90);
+    st.p99 = percentile(times,0.99);
+    if (counting_allocations) st.allocs_per_call = static_cast<double>(a1-a0)/(static_cast<double>(samples)*calls);
+    return st;
+  }
+
+  /**
+   * @brief Benchmark results as JSON: one record per case with its area,
+   * name, N, batch size, latency statistics in seconds and throughput in
+   * the given unit per second (items per call / median).
+   */
+  class JsonReport {
+    struct Record {
+      std::string area, name, unit;
+      std::size_t N, batch;
+      double items;
+      Stats st;
+    };
+    std::vector<Record> records;
+    std::vector<std::pair<std::string,std::string>> meta;
+  public:
+    //! Free-form metadata written at the top level, e.g. compiler or CPU features
+    inline void set_meta(const std::string& key, const std::string& value) { meta.emplace_back(key,value); }
+    inline void add(const std::string& area, const std::string& name, std::size_t N, std::size_t batch,
+                    const Stats& st, double items, const std::string& unit) {
+      records.push_back(Record{area,name,unit,N,batch,items,st});
+    }
+    inline std::size_t size() const { return records.size(); }
+    //! Write the report, false if the file cannot be opened
+    inline bool write(const std::string& path) const {
+      std::FILE* out = std::fopen(path.c_str(),"w");
+      if (!out) return false;
+      std::fprintf(out,"{\n  \"schema\": 1,\n");
+      for (const auto& kv : meta)
+        std::fprintf(out,"  \"%s\": \"%s\",\n",detail::json_escape(kv.first).c_str(),detail::json_escape(kv.second).c_str());
+      std::fprintf(out,"  \"results\": [\n");
+      for (std::size_t r=0; r<records.size(); r++) {
+        const Record& x = records[r];
+        std::fprintf(out,"    {\"area\": \"%s\", \"name\": \"%s\", \"N\": %zu, \"batch\": %zu, \"samples\": %d, "
+                     "\"min\": %.6e, \"p10\": %.6e, \"median\": %.6e, \"p90\": %.6e, \"p99\": %.6e, \"mean\": %.6e, "
+                     "\"throughput\": %.6e, \"unit\": \"%s/s\", \"allocs_per_call\": %.3f}%s\n",
+                     detail::json_escape(x.area).c_str(), detail::json_escape(x.name).c_str(), x.N, x.batch, x.st.samples, x.st.min, x.st.p10, x.st.median,
+                     x.st.p90, x.st.p99, x.st.mean, x.items/x.st.median, detail::json_escape(x.unit).c_str(), x.st.allocs_per_call,
+                     r+1<records.size() ? "," : "");
+      }
+      std::fprintf(out,"  ]\n}\n");
+      return std::fclose(out)==0;
+    }
+  };
+
+}
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+// malloc/free pair by construction, GCC cannot see that through inlining
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(std::size_t size) {
+  Bench::detail::allocation_counter().fetch_add(1,std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+#endif
+
+#endif
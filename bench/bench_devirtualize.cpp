@@ -0,0 +1,87 @@
+#include "../functions.hpp"
+#include "../polybases/static_basis.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+
+/*
+ * Cost of virtual dispatch in series evaluation, points per second at NPTS
+ * random points for several series lengths:
+ *   term/virtual : FunctionalBase::evaluate_series, one virtual evaluate_function per term
+ *   term/static  : StaticBasis::evaluate_series, evaluate_function inlined into the sum
+ *   point/virtual: Clenshaw through a FunctionalBase pointer, one virtual call per point
+ *   point/static : Clenshaw through the final ChebyshevBase, inlined into the loop
+ * Both bases of a pair compute the same T_n(x), only the binding differs.
+ */
+
+//! Basis only defining T_n(x), the subclass way
+class VirtualTn: public FunctionalBase<double> {
+public:
+    VirtualTn(unsigned int N): FunctionalBase<double>(N) {}
+    inline double evaluate_function(const double& x, const unsigned int n) const override { return Chebyshev::Tn<double>(x,n); }
+};
+
+//! The same basis through the static interface
+class StaticTn: public StaticBasis<StaticTn,double> {
+    unsigned int N;
+public:
+    StaticTn(unsigned int N): N(N) {}
+    inline int get_N() const { return N; }
+    inline double evaluate_function(const double& x, const unsigned int n) const { return Chebyshev::Tn<double>(x,n); }
+};
+
+//! Hide the dynamic type from the optimiser, as for a basis chosen at run time
+__attribute__((noinline)) const FunctionalBase<double>* opaque(const FunctionalBase<double>* b)
+{
+    asm volatile("" : "+r"(b));
+    return b;
+}
+
+template <unsigned int N> void run(const std::vector<double>& x, std::vector<double>& y)
+{
+    auto f = [](const std::vector<double>& x, std::vector<double>& y) { y.clear(); for (auto v: x) y.push_back(std::exp(v)*std::sin(5*v)); };
+    Function<double,ChebyshevBase<double>,N> g(+f);
+    const std::vector<double>& ft = g.spectral_coeffs();
+    const ChebyshevBase<double>& cheb = *g.get_basis();
+    const FunctionalBase<double>* vcheb = opaque(&cheb);
+    VirtualTn vtn_obj(N);
+    const FunctionalBase<double>* vtn = opaque(&vtn_obj);
+    const StaticTn stn(N);
+    const double npts = x.size();
+
+    const double t_tv = Bench::best_time([&]() {
+        for (std::size_t p=0; p<x.size(); p++) y[p] = vtn->evaluate_series(x[p],ft);
+        Bench::do_not_optimize(y[0]);
+    },3);
+    const double t_ts = Bench::best_time([&]() {
+        for (std::size_t p=0; p<x.size(); p++) y[p] = stn.evaluate_series(x[p],Span<const double>(ft));
+        Bench::do_not_optimize(y[0]);
+    },3);
+    const double t_pv = Bench::best_time([&]() {
+        for (std::size_t p=0; p<x.size(); p++) y[p] = vcheb->evaluate_series(x[p],ft);
+        Bench::do_not_optimize(y[0]);
+    });
+    const double t_ps = Bench::best_time([&]() {
+        for (std::size_t p=0; p<x.size(); p++) y[p] = cheb.evaluate_series(x[p],ft);
+        Bench::do_not_optimize(y[0]);
+    });
+    std::printf("N = %4u  term/virtual %10.3e  term/static %10.3e (x%5.2f)  point/virtual %10.3e  point/static %10.3e (x%5.2f) pts/s\n",
+                N, npts/t_tv, npts/t_ts, t_tv/t_ts, npts/t_pv, npts/t_ps, t_pv/t_ps);
+}
+
+int main()
+{
+    const std::size_t NPTS = 1 << 14;
+    std::vector<double> x(NPTS), y(NPTS);
+    unsigned int seed = 12345;
+    for (auto& v: x) { seed = seed*1103515245u + 12345u; v = 2.0*(seed >> 8)/double(1u << 24) - 1.0; }
+    run<4>(x,y);
+    run<8>(x,y);
+    run<16>(x,y);
+    run<32>(x,y);
+    run<64>(x,y);
+}
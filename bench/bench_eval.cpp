@@ -0,0 +1,63 @@
+#include "../functions.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using Chebyshev::SimdLevel;
+
+/*
+ * Points per second of Function evaluation at NPTS random points for
+ * several series lengths:
+ *   per-term   : sum_n ft_n * evaluate_function(x,n), one virtual call per term
+ *   per-point  : basis->evaluate_series(x), one virtual Clenshaw per point
+ *   batch/...  : clenshaw_batch with each SIMD level available on this CPU
+ */
+template <unsigned int N> void run(const std::vector<double>& x, std::vector<double>& y)
+{
+    auto f = [](const std::vector<double>& x, std::vector<double>& y) { y.clear(); for (auto v: x) y.push_back(std::exp(v)*std::sin(5*v)); };
+    Function<double,ChebyshevBase<double>,N> g(+f);
+    const FunctionalBase<double>* basis = g.get_basis().get();
+    std::vector<double> ft;
+    g.get_spectral_coeffs(ft);
+    const double npts = x.size();
+
+    double t_term = Bench::best_time([&]() {
+        for (std::size_t p=0; p<x.size(); p++) {
+            double tmp = 0.0;
+            for (unsigned int n=0; n<ft.size(); n++) tmp += ft[n] * basis->evaluate_function(x[p],n);
+            y[p] = tmp;
+        }
+        Bench::do_not_optimize(y[0]);
+    },3);
+    double t_point = Bench::best_time([&]() {
+        for (std::size_t p=0; p<x.size(); p++) y[p] = basis->evaluate_series(x[p],ft);
+        Bench::do_not_optimize(y[0]);
+    });
+    std::printf("N = %5u  per-term %10.3e pts/s  per-point %10.3e pts/s", N, npts/t_term, npts/t_point);
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (level > Chebyshev::detected_simd_level()) continue;
+        double t = Bench::best_time([&]() {
+            Chebyshev::clenshaw_batch(ft.data(),ft.size(),x.data(),x.size(),y.data(),level);
+            Bench::do_not_optimize(y[0]);
+        });
+        const char* name = (level==SimdLevel::Scalar) ? "scalar" : (level==SimdLevel::AVX2) ? "avx2" : "avx512";
+        std::printf("  batch/%s %10.3e pts/s", name, npts/t);
+    }
+    std::printf("\n");
+}
+
+int main()
+{
+    const std::size_t NPTS = 1 << 16;
+    std::vector<double> x(NPTS), y(NPTS);
+    unsigned int seed = 12345;
+    for (auto& v: x) { seed = seed*1103515245u + 12345u; v = 2.0*(seed >> 8)/double(1u << 24) - 1.0; }
+    run<8>(x,y);
+    run<16>(x,y);
+    run<32>(x,y);
+    run<64>(x,y);
+    run<256>(x,y);
+}
@@ -0,0 +1,47 @@
+#include "../polybases/fourier.hpp"
+#include "../polybases/plan_registry.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+
+/*
+ * Periodic transforms:
+ *   fft       : complex FFT of length n, powers of two (radix 2), 3*2^k and
+ *               5*2^k (Stockham mixed radix) and primes (Bluestein)
+ *   transform : forward plus inverse transform of one function, FourierBase
+ *               (real FFT of length N+1) against ChebyshevBase of the same N
+ */
+
+int main()
+{
+    std::printf("%-10s %8s  %12s %12s\n","case","n","time[s]","ns/(n log n)");
+    for (std::size_t n: {1024u, 1021u, 1536u, 1280u, 65536u, 65521u, 49152u, 81920u}) {
+        FFT::ComplexPlan<double> P(n);
+        std::vector<std::complex<double>> z(n);
+        for (std::size_t j=0; j<n; j++) z[j] = std::complex<double>(std::sin(0.1*j),0.0);
+        const double t = Bench::best_time([&]() { P.forward(z.data()); Bench::do_not_optimize(z[0]); });
+        std::printf("%-10s %8zu  %12.4e %12.3f\n","fft",n,t,1e9*t/(n*std::log2(static_cast<double>(n))));
+    }
+
+    std::printf("\n%-10s %8s  %12s %12s %8s\n","case","N","fourier[s]","chebyshev[s]","ratio");
+    for (unsigned int N: {63u, 255u, 1023u, 4095u, 65535u}) {
+        auto fb = PlanRegistry::instance().get_basis<FourierBase<double>>(N);
+        auto cb = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+        std::vector<double> f(N+1), ft(N+1);
+        for (unsigned int j=0; j<=N; j++) f[j] = std::exp(std::sin(0.01*j));
+        const double tf = Bench::best_time([&]() {
+            fb->calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+            fb->calc_function_values(Span<const double>(ft),Span<double>(f));
+            Bench::do_not_optimize(f[0]);
+        });
+        const double tc = Bench::best_time([&]() {
+            cb->calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+            cb->calc_function_values(Span<const double>(ft),Span<double>(f));
+            Bench::do_not_optimize(f[0]);
+        });
+        std::printf("%-10s %8u  %12.4e %12.4e %8.2f\n","transform",N,tf,tc,tc/tf);
+    }
+}
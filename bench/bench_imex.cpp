@@ -0,0 +1,80 @@
+#include "../ODE/odesolvers.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Operators;
+using namespace ODE;
+
+/*
+ * Throughput of the IMEX integrators in steps per second, with the split of
+ * each step into nonlinear evaluations, stage combinations and implicit
+ * solves from the integrator counters:
+ *   heat   : u_t = u_xx - u, u(+-1) = 0, for several N
+ *   Burgers: u_t = nu u_xx - (u^2/2)_x, u0 = -sin(pi x), nu = 0.01/pi,
+ *            product dealiased in coefficient space
+ */
+
+template <class Integrator, class F>
+void report(const char* problem, const char* name, unsigned int N, Integrator& integ, std::vector<double> u, std::size_t nsteps, F&& nonlinear)
+{
+    integ.reset_counters();
+    integ.advance(Span<double>(u),nsteps,nonlinear);
+    const StepCounters& c = integ.counters();
+    std::printf("%-8s %-10s N = %5u  %10.3e steps/s  N(u) %5.1f%%  combine %5.1f%%  solve %5.1f%%  (%zu solves)\n",
+                problem, name, N, c.steps_per_second(), 100*c.t_nonlinear/c.t_total, 100*c.t_linear/c.t_total,
+                100*c.t_solve/c.t_total, c.solves);
+}
+
+void heat(unsigned int N)
+{
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    LinearOperator<double> L = SecondDerivative<double>(basis.get());
+    const std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,0.0),
+                                                     BoundaryCondition<double>::Dirichlet(Boundary::Right,0.0)};
+    std::vector<double> f(N+1), u(N+1);
+    for (unsigned int i=0; i<=N; i++) f[i] = std::cos(M_PI*basis->get_nodes()[i]/2);
+    basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(u));
+    auto decay = [](Span<const double> v, Span<double> nv) { for (std::size_t i=0; i<v.size(); i++) nv[i] = -v[i]; };
+    const double dt = 1e-3;
+    const std::size_t nsteps = std::max<std::size_t>(20,4000000/(N+1));
+    IMEXRungeKutta<double> ars2(L,bcs,dt,IMEXTableau<double>::ars222()), ars3(L,bcs,dt);
+    SBDF<double> bdf2(L,bcs,dt,2), bdf3(L,bcs,dt,3);
+    report("heat","ARS(2,2,2)",N,ars2,u,nsteps,decay);
+    report("heat","ARS(4,4,3)",N,ars3,u,nsteps,decay);
+    report("heat","SBDF2",N,bdf2,u,nsteps,decay);
+    report("heat","SBDF3",N,bdf3,u,nsteps,decay);
+}
+
+void burgers(unsigned int N)
+{
+    const double nu = 0.01/M_PI;
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    LinearOperator<double> L = nu*SecondDerivative<double>(basis.get());
+    const std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,0.0),
+                                                     BoundaryCondition<double>::Dirichlet(Boundary::Right,0.0)};
+    std::vector<double> f(N+1), u(N+1), w(N+1);
+    for (unsigned int i=0; i<=N; i++) f[i] = -std::sin(M_PI*basis->get_nodes()[i]);
+    basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(u));
+    auto advect = [&](Span<const double> v, Span<double> nv) {
+        basis->multiply_coeffs(v,v,Span<double>(w));
+        basis->differentiate_coeffs(Span<const double>(w),nv);
+        for (auto& x: nv) x *= -0.5;
+    };
+    const double dt = 1e-4;
+    const std::size_t nsteps = 2000;
+    IMEXRungeKutta<double> ars2(L,bcs,dt,IMEXTableau<double>::ars222()), ars3(L,bcs,dt);
+    SBDF<double> bdf2(L,bcs,dt,2), bdf3(L,bcs,dt,3);
+    report("Burgers","ARS(2,2,2)",N,ars2,u,nsteps,advect);
+    report("Burgers","ARS(4,4,3)",N,ars3,u,nsteps,advect);
+    report("Burgers","SBDF2",N,bdf2,u,nsteps,advect);
+    report("Burgers","SBDF3",N,bdf3,u,nsteps,advect);
+}
+
+int main()
+{
+    for (unsigned int N : {32u, 128u, 512u, 2048u}) heat(N);
+    for (unsigned int N : {128u, 512u}) burgers(N);
+}
@@ -0,0 +1,84 @@
+#include "../polybases/legendre.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+
+/*
+ * Legendre basis:
+ *   gll        : GLL nodes and weights of order N, Newton iteration with the
+ *                asymptotic series, O(N)
+ *   convert    : leg2cheb + cheb2leg of n coefficients, the O(n^2) direct sums
+ *                against the Toeplitz-Hankel plan, with the plan set-up time,
+ *                the Hankel ranks and the largest difference of the Chebyshev
+ *                coefficients. Direct sums stop at n = 16384.
+ *   transform  : forward transform of order N on the GLL grid, O(N^2), against
+ *                values on the Chebyshev grid through DCT and cheb2leg
+ */
+
+int main()
+{
+    std::printf("%-10s %7s  %12s\n","case","N","time[s]");
+    for (unsigned int N: {1000u, 10000u, 100000u}) {
+        std::vector<double> x, w;
+        const double t = Bench::best_time([&]() {
+            Legendre::gll_nodes_and_weights<double>(N,x,w);
+            Bench::do_not_optimize(x[1]);
+        },3,0.0);
+        std::printf("%-10s %7u  %12.4e\n","gll",N,t);
+    }
+
+    std::printf("\n%-10s %7s  %12s %12s %12s %8s %7s  %10s\n","case","n","direct[s]","fast[s]","plan[s]","speedup","ranks","max diff");
+    for (std::size_t n: {std::size_t(1024), std::size_t(4096), std::size_t(16384), std::size_t(65536), std::size_t(100001)}) {
+        std::vector<double> a(n), c(n), l(n), cd(n);
+        for (std::size_t k=0; k<n; k++) a[k] = std::cos(0.37*k)/std::sqrt(1.0+k);
+        Bench::Timer timer;
+        Legendre::ConversionPlan<double> plan(n);
+        const double tplan = timer.elapsed();
+        const double tf = Bench::best_time([&]() {
+            plan.leg2cheb(a.data(),c.data());
+            plan.cheb2leg(c.data(),l.data());
+            Bench::do_not_optimize(l[0]);
+        },3,0.0);
+        double td = 0.0, e = 0.0;
+        if (n <= 16384) {
+            const std::vector<long double> lamld = Legendre::lambda_half(2*n+1);
+            const std::vector<double> lam(lamld.begin(),lamld.end());
+            td = Bench::best_time([&]() {
+                // both triangular sums, the cost of the direct path
+                for (std::size_t j=0; j<n; j++) {
+                    double s = 0.0, r = 0.0;
+                    for (std::size_t k=j; k<n; k+=2) s += lam[k-j]*lam[k+j]*a[k];
+                    for (std::size_t k=j+2; k<n; k+=2) r += k*lam[k-j-2]/(k-j)*lam[k+j-1]/(k+j+1)*a[k];
+                    cd[j] = (j==0 ? 1.0 : 2.0)/Chebyshev::pi<double>*s;
+                    l[j] = r;
+                }
+                Bench::do_not_optimize(l[0]);
+            },1,0.0);
+            plan.leg2cheb(a.data(),c.data());
+            for (std::size_t j=0; j<n; j++) e = std::max(e,std::abs(c[j]-cd[j]));
+        }
+        char ranks[32];
+        std::snprintf(ranks,sizeof(ranks),"%zu/%zu",plan.rank_leg2cheb(),plan.rank_cheb2leg());
+        if (td > 0.0) std::printf("%-10s %7zu  %12.4e %12.4e %12.4e %8.2f %7s  %10.3e\n","convert",n,td,tf,tplan,td/tf,ranks,e);
+        else std::printf("%-10s %7zu  %12s %12.4e %12.4e %8s %7s  %10s\n","convert",n,"-",tf,tplan,"-",ranks,"-");
+    }
+
+    std::printf("\n%-10s %7s  %12s %12s %8s\n","case","N","gll[s]","chebyshev[s]","speedup");
+    for (unsigned int N: {128u, 512u, 2048u, 8192u}) {
+        const LegendreBase<double> basis(N);
+        std::vector<double> f(N+1), ft(N+1);
+        for (unsigned int i=0; i<=N; i++) f[i] = std::sin(0.01*i*i);
+        const double tg = Bench::best_time([&]() {
+            basis.calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+            Bench::do_not_optimize(ft[0]);
+        },3);
+        const double tc = Bench::best_time([&]() {
+            basis.calc_spectral_coeffs_chebyshev(Span<const double>(f),Span<double>(ft));
+            Bench::do_not_optimize(ft[0]);
+        },3);
+        std::printf("%-10s %7u  %12.4e %12.4e %8.2f\n","transform",N,tg,tc,tg/tc);
+    }
+}
@@ -0,0 +1,66 @@
+#include "../ODE/odesolvers.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace Operators;
+using namespace ODE;
+
+/*
+ * Setup (lowering + factorisation) and solve times of the banded
+ * ultraspherical solver against the dense Chebyshev tau reference for
+ * u'' + x u' - u = f, u(+-1) given, exact solution sin(3x) + cos(x).
+ * The dense solver is O(N^3) and is only run up to the size given as the
+ * first argument (default 1024).
+ */
+inline double exact(double x) { return std::sin(3*x) + std::cos(x); }
+inline double rhs(double x) { return -9*std::sin(3*x) - std::cos(x) + x*(3*std::cos(3*x) - std::sin(x)) - exact(x); }
+
+double max_error(const ChebyshevBase<double>& basis, const std::vector<double>& u)
+{
+    double e = 0.0;
+    for (int k=0; k<=200; k++) {
+        const double x = -1.0 + k/100.0;
+        e = std::max(e,std::abs(basis.evaluate_series(x,u)-exact(x)));
+    }
+    return e;
+}
+
+void run(unsigned int N, unsigned int dense_max)
+{
+    ChebyshevBase<double> basis(N);
+    SecondDerivative<double> D2(&basis);
+    Derivative<double> D(&basis);
+    TimesX<double> X(&basis);
+    Identity<double> I(&basis);
+    auto L = D2 + X*D - I;
+    std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,exact(-1.0)),
+                                               BoundaryCondition<double>::Dirichlet(Boundary::Right,exact(1.0))};
+    std::vector<double> x, fx, f, u;
+    basis.get_nodes(x);
+    for (auto v: x) fx.push_back(rhs(v));
+    basis.calc_spectral_coeffs(fx,f);
+
+    Bench::Timer timer;
+    ODESolver<double> solver(L,bcs);
+    const double t_setup = timer.elapsed();
+    const double t_solve = Bench::best_time([&]() { solver.solve(f,u); Bench::do_not_optimize(u[0]); },3);
+    std::printf("N = %6u  banded: setup %10.3e s  solve %10.3e s  error %8.1e", N, t_setup, t_solve, max_error(basis,u));
+    if (N <= dense_max) {
+        timer.reset();
+        DenseODESolver<double> dense(LinearOperator<double>(L),bcs);
+        const double t_dsetup = timer.elapsed();
+        const double t_dsolve = Bench::best_time([&]() { dense.solve(f,u); Bench::do_not_optimize(u[0]); },3);
+        std::printf("   dense: setup %10.3e s  solve %10.3e s  error %8.1e  speedup %8.1f",
+                    t_dsetup, t_dsolve, max_error(basis,u), (t_dsetup+t_dsolve)/(t_setup+t_solve));
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    const unsigned int dense_max = argc > 1 ? std::atoi(argv[1]) : 1024;
+    for (unsigned int N : {16u, 64u, 256u, 1024u, 4096u, 16384u, 65536u, 100000u}) run(N,dense_max);
+}
@@ -0,0 +1,56 @@
+#include "../ODE/odesolvers.hpp"
+#include "../polybases/parallel.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace Operators;
+using namespace ODE;
+
+/*
+ * Solves per second for NRHS right-hand sides against one factorisation of
+ * u'' + x u' - u with Dirichlet conditions:
+ *   loop    : one solve() call per right-hand side
+ *   block   : blocked multi-RHS solve on one thread
+ *   block/T : blocked multi-RHS solve on T threads of the global pool
+ * The one-off factorisation time is shown for comparison.
+ */
+void run(unsigned int N, std::size_t nrhs)
+{
+    const std::size_t n = N+1;
+    ChebyshevBase<double> basis(N);
+    SecondDerivative<double> D2(&basis);
+    Derivative<double> D(&basis);
+    TimesX<double> X(&basis);
+    Identity<double> I(&basis);
+    Bench::Timer timer;
+    ODESolver<double> solver(D2 + X*D - I,{BoundaryCondition<double>::Dirichlet(Boundary::Left,0.0),
+                                         BoundaryCondition<double>::Dirichlet(Boundary::Right,1.0)});
+    const double t_factor = timer.elapsed();
+    std::vector<double> F(n*nrhs), U(n*nrhs);
+    for (std::size_t k=0; k<F.size(); k++) F[k] = std::sin(0.1*k);
+
+    const double t_loop = Bench::best_time([&]() {
+        for (std::size_t c=0; c<nrhs; c++)
+            solver.solve(Span<const double>(&F[c*n],n),Span<double>(&U[c*n],n));
+        Bench::do_not_optimize(U[0]);
+    },3);
+    const double t_block = Bench::best_time([&]() {
+        solver.solve(Span<const double>(F),Span<double>(U),nrhs,1);
+        Bench::do_not_optimize(U[0]);
+    },3);
+    const unsigned int T = Parallel::default_threads();
+    const double t_threads = Bench::best_time([&]() {
+        solver.solve(Span<const double>(F),Span<double>(U),nrhs,T);
+        Bench::do_not_optimize(U[0]);
+    },3);
+    std::printf("N = %5u  factorise %9.3e s  loop %10.3e solves/s  block %10.3e solves/s  block/%u %10.3e solves/s\n",
+                N, t_factor, nrhs/t_loop, nrhs/t_block, T, nrhs/t_threads);
+}
+
+int main()
+{
+    const std::size_t NRHS = 1024;
+    for (unsigned int N : {32u, 128u, 512u, 2048u, 8192u}) run(N,NRHS);
+}
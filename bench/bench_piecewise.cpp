@@ -0,0 +1,50 @@
+#include "../polybases/piecewise_chebyshev.hpp"
+#include "../polybases/parallel.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+
+/*
+ * Strong scaling of the piecewise Chebyshev basis with K = 64 elements of
+ * order 64 (N = 4096) over 1, 2, 4, ... threads up to the hardware count:
+ *   forward  : values -> per-element coefficients
+ *   inverse  : coefficients -> values with interface averaging
+ *   deriv    : element-parallel derivative
+ *   eval     : batched evaluation at NPTS points
+ * The single-domain ChebyshevBase(4096) transform is shown for reference.
+ */
+int main()
+{
+    const unsigned int K = 64, Ne = 64, N = K*Ne;
+    const std::size_t NPTS = 1 << 16;
+    std::vector<double> x, f, ft, df(K*(Ne+1)), pts(NPTS), out(NPTS);
+    for (std::size_t p=0; p<NPTS; p++) pts[p] = -1.0 + 2.0*p/(NPTS-1);
+
+    ChebyshevBase<double> global(N);
+    global.get_nodes(x);
+    for (auto v: x) f.push_back(std::tanh(50*v));
+    const double t_global = Bench::best_time([&]() { global.calc_spectral_coeffs(f,ft); Bench::do_not_optimize(ft[0]); },3);
+    std::printf("single domain N = %u: forward %10.3e s\n", N, t_global);
+
+    for (unsigned int T=1; T<=Parallel::default_threads(); T*=2) {
+        PiecewiseChebyshevBase<double,K> basis(N,-1.0,1.0,T);
+        basis.get_nodes(x);
+        f.clear();
+        for (auto v: x) f.push_back(std::tanh(50*v));
+        const double t_fwd = Bench::best_time([&]() { basis.calc_spectral_coeffs(f,ft); Bench::do_not_optimize(ft[0]); },3);
+        const double t_inv = Bench::best_time([&]() { basis.calc_function_values(ft,f); Bench::do_not_optimize(f[0]); },3);
+        const double t_der = Bench::best_time([&]() {
+            basis.apply_operator(OperatorKind::Derivative,Span<const double>(ft),Span<double>(df));
+            Bench::do_not_optimize(df[0]);
+        },3);
+        const double t_eval = Bench::best_time([&]() {
+            basis.evaluate_series_batch(Span<const double>(pts),ft,Span<double>(out));
+            Bench::do_not_optimize(out[0]);
+        },3);
+        std::printf("K = %u, Ne = %u, threads %2u: forward %10.3e s  inverse %10.3e s  deriv %10.3e s  eval %10.3e pts/s\n",
+                    K, Ne, T, t_fwd, t_inv, t_der, NPTS/t_eval);
+    }
+}
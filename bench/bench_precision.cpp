@@ -0,0 +1,91 @@
+#include "../ODE/odesolvers.hpp"
+#include "../polybases/mixed_precision.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Operators;
+using namespace ODE;
+
+/*
+ * Mixed precision against double throughout:
+ *   eval      : one series of order N at 2^22 points, float points, coefficients
+ *               and results with double Clenshaw (MixedChebyshevBase) against
+ *               all-double, with the largest difference between the two
+ *   transform : batched forward transform of M = 256 functions
+ *   solve     : u'' + x u' - u = f by RefinedODESolver<float,double> against
+ *               ODESolver<double>, and the difference of the solutions
+ */
+
+int main()
+{
+    const std::size_t npts = std::size_t(1) << 22;
+    std::vector<double> xd(npts), yd(npts);
+    std::vector<float> xf(npts), yf(npts);
+    for (std::size_t p=0; p<npts; p++) {
+        xd[p] = std::cos(0.37*p);
+        xf[p] = static_cast<float>(xd[p]);
+        xd[p] = xf[p];
+    }
+    std::printf("%-10s %6s  %12s %12s %8s  %10s\n","case","N","double[s]","mixed[s]","speedup","max diff");
+    for (unsigned int N: {8u, 32u, 128u}) {
+        std::vector<double> ad(N+1);
+        std::vector<float> af(N+1);
+        for (unsigned int n=0; n<=N; n++) { af[n] = 1.0f/(1+n*n); ad[n] = af[n]; }
+        MixedChebyshevBase<float,double> mb(N);
+        const double td = Bench::best_time([&]() {
+            Chebyshev::clenshaw_batch(ad.data(),N+1,xd.data(),npts,yd.data());
+            Bench::do_not_optimize(yd[0]);
+        });
+        const double tm = Bench::best_time([&]() {
+            mb.evaluate_series_batch(Span<const float>(xf),Span<const float>(af),Span<float>(yf));
+            Bench::do_not_optimize(yf[0]);
+        });
+        double e = 0.0;
+        for (std::size_t p=0; p<npts; p++) e = std::max(e,std::abs(yf[p]-yd[p]));
+        std::printf("%-10s %6u  %12.4e %12.4e %8.2f  %10.3e\n","eval",N,td,tm,td/tm,e);
+    }
+
+    const std::size_t M = 256;
+    for (unsigned int N: {64u, 256u, 1024u}) {
+        auto bd = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+        MixedChebyshevBase<float,double> mb(N);
+        std::vector<double> fd(M*(N+1)), ftd(M*(N+1));
+        std::vector<float> ff(M*(N+1)), ftf(M*(N+1));
+        for (std::size_t k=0; k<fd.size(); k++) { ff[k] = static_cast<float>(std::sin(0.01*k)); fd[k] = ff[k]; }
+        const double td = Bench::best_time([&]() {
+            bd->calc_spectral_coeffs_batch(Span<const double>(fd),Span<double>(ftd),M);
+            Bench::do_not_optimize(ftd[0]);
+        });
+        const double tm = Bench::best_time([&]() {
+            mb.calc_spectral_coeffs_batch(Span<const float>(ff),Span<float>(ftf),M);
+            Bench::do_not_optimize(ftf[0]);
+        });
+        double e = 0.0;
+        for (std::size_t k=0; k<fd.size(); k++) e = std::max(e,std::abs(ftf[k]-ftd[k]));
+        std::printf("%-10s %6u  %12.4e %12.4e %8.2f  %10.3e\n","transform",N,td,tm,td/tm,e);
+    }
+
+    for (unsigned int N: {256u, 4096u, 65536u}) {
+        auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+        SecondDerivative<double> D2(basis.get());
+        Derivative<double> D(basis.get());
+        TimesX<double> X(basis.get());
+        Identity<double> I(basis.get());
+        const std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,1.0),
+                                                         BoundaryCondition<double>::Dirichlet(Boundary::Right,-1.0)};
+        ODESolver<double> exact(D2 + X*D - I,bcs);
+        RefinedODESolver<float,double> refined(D2 + X*D - I,bcs);
+        std::vector<double> f(N+1), ue(N+1), ur(N+1);
+        for (unsigned int i=0; i<=N; i++) f[i] = 1.0/(1+i*i);
+        const double td = Bench::best_time([&]() { exact.solve(f,ue); Bench::do_not_optimize(ue[0]); });
+        RefinementInfo info;
+        const double tm = Bench::best_time([&]() { info = refined.solve(f,ur); Bench::do_not_optimize(ur[0]); });
+        double e = 0.0;
+        for (unsigned int i=0; i<=N; i++) e = std::max(e,std::abs(ur[i]-ue[i]));
+        std::printf("%-10s %6u  %12.4e %12.4e %8.2f  %10.3e  (%u sweeps%s)\n","solve",N,td,tm,td/tm,e,
+                    info.sweeps,info.promoted ? ", promoted" : "");
+    }
+}
@@ -0,0 +1,201 @@
+#define BENCH_COUNT_ALLOCATIONS
+#include "../ODE/odesolvers.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using namespace ODE;
+
+/*
+ * Regression benchmark over the main kernels, sweeping N and the batch size:
+ *   Tn        : Chebyshev::Tn(x,N) at a batch of points
+ *   transform : calc_spectral_coeffs / calc_function_values of one function
+ *               and the batched forms over M functions
+ *   eval      : Function::eval at a batch of points
+ *   operator  : LinearOperator construction (cold, and from the PlanRegistry)
+ *               and apply to a batch of vectors
+ *   solver    : ODESolver setup and solve for u'' + x u' - u = f
+ * Each case reports median and 10/90/99th percentile latency per call,
+ * throughput and heap allocations per call.
+ * Usage: bench_suite [--json FILE] [--quick]
+ *   --json  also write the results to FILE
+ *   --quick smaller sweep and fewer samples, for smoke tests
+ */
+
+struct Suite {
+    Bench::JsonReport report;
+    int samples;
+    //! Measure f, print a table row and record it
+    template <class F> void run(const char* area, const std::string& name, std::size_t N, std::size_t batch,
+                                double items, const char* unit, F f) {
+        const Bench::Stats st = Bench::measure(f,samples);
+        std::printf("%-10s %-24s %6zu %6zu  %10.3e %10.3e %10.3e %10.3e  %10.3e %-8s %8.2f\n",
+                    area, name.c_str(), N, batch, st.median, st.p10, st.p90, st.p99, items/st.median, unit, st.allocs_per_call);
+        report.add(area,name,N,batch,st,items,unit);
+    }
+};
+
+inline std::vector<double> random_points(std::size_t n)
+{
+    std::vector<double> x(n);
+    unsigned int seed = 12345;
+    for (auto& v: x) { seed = seed*1103515245u + 12345u; v = 2.0*(seed >> 8)/double(1u << 24) - 1.0; }
+    return x;
+}
+
+void bench_tn(Suite& s, unsigned int N, std::size_t batch)
+{
+    const std::vector<double> x = random_points(batch);
+    std::vector<double> y(batch);
+    s.run("Tn","Tn",N,batch,batch,"evals",[&]() {
+        for (std::size_t p=0; p<batch; p++) y[p] = Chebyshev::Tn<double>(x[p],N);
+        Bench::do_not_optimize(y[0]);
+    });
+}
+
+void bench_transform(Suite& s, unsigned int N, std::size_t M)
+{
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    std::vector<double> f(M*(N+1)), ft(M*(N+1));
+    for (std::size_t k=0; k<f.size(); k++) f[k] = std::sin(0.01*k);
+    const double items = static_cast<double>(M)*(N+1);
+    if (M==1) {
+        s.run("transform","calc_spectral_coeffs",N,M,items,"values",[&]() {
+            basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+            Bench::do_not_optimize(ft[0]);
+        });
+        s.run("transform","calc_function_values",N,M,items,"values",[&]() {
+            basis->calc_function_values(Span<const double>(ft),Span<double>(f));
+            Bench::do_not_optimize(f[0]);
+        });
+        return;
+    }
+    s.run("transform","calc_spectral_coeffs_batch",N,M,items,"values",[&]() {
+        basis->calc_spectral_coeffs_batch(Span<const double>(f),Span<double>(ft),M);
+        Bench::do_not_optimize(ft[0]);
+    });
+    s.run("transform","calc_function_values_batch",N,M,items,"values",[&]() {
+        basis->calc_function_values_batch(Span<const double>(ft),Span<double>(f),M);
+        Bench::do_not_optimize(f[0]);
+    });
+}
+
+template <unsigned int N> void bench_eval(Suite& s, std::size_t batch)
+{
+    auto g = [](const std::vector<double>& x, std::vector<double>& y) { y.clear(); for (auto v: x) y.push_back(std::exp(v)*std::sin(5*v)); };
+    Function<double,ChebyshevBase<double>,N> u(+g);
+    const std::vector<double> x = random_points(batch);
+    std::vector<double> y(batch);
+    s.run("eval","Function::eval",N,batch,batch,"points",[&]() {
+        u.eval(Span<const double>(x),Span<double>(y));
+        Bench::do_not_optimize(y[0]);
+    });
+}
+
+void bench_operator(Suite& s, unsigned int N, std::size_t M)
+{
+    PlanRegistry& registry = PlanRegistry::instance();
+    auto basis = registry.get_basis<ChebyshevBase<double>>(N);
+    if (M==1) {
+        s.run("operator","construct D2 (cold)",N,1,1,"ops",[&]() {
+            registry.clear();
+            SecondDerivative<double> D2(basis.get());
+            Bench::do_not_optimize(D2);
+        });
+        (void)SecondDerivative<double>(basis.get());
+        s.run("operator","construct D2 (registry)",N,1,1,"ops",[&]() {
+            SecondDerivative<double> D2(basis.get());
+            Bench::do_not_optimize(D2);
+        });
+    }
+    SecondDerivative<double> D2(basis.get());
+    Derivative<double> D(basis.get());
+    TimesX<double> X(basis.get());
+    Identity<double> I(basis.get());
+    LinearOperator<double> L = D2 + X*D - I;
+    std::vector<double> in(M*(N+1)), out(M*(N+1));
+    for (std::size_t k=0; k<in.size(); k++) in[k] = 1.0/(1+k%(N+1));
+    const double items = static_cast<double>(M)*(N+1);
+    auto apply = [&](const LinearOperator<double>& op) {
+        for (std::size_t m=0; m<M; m++)
+            op.apply(Span<const double>(in.data()+m*(N+1),N+1),Span<double>(out.data()+m*(N+1),N+1));
+        Bench::do_not_optimize(out[0]);
+    };
+    s.run("operator","apply D2",N,M,items,"coeffs",[&]() { apply(D2); });
+    s.run("operator","apply D2 + X D - I",N,M,items,"coeffs",[&]() { apply(L); });
+}
+
+void bench_solver(Suite& s, unsigned int N)
+{
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    SecondDerivative<double> D2(basis.get());
+    Derivative<double> D(basis.get());
+    TimesX<double> X(basis.get());
+    Identity<double> I(basis.get());
+    auto L = D2 + X*D - I;
+    const std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,1.0),
+                                                     BoundaryCondition<double>::Dirichlet(Boundary::Right,-1.0)};
+    s.run("solver","ODESolver setup",N,1,1,"setups",[&]() {
+        ODESolver<double> solver(L,bcs);
+        Bench::do_not_optimize(solver);
+    });
+    ODESolver<double> solver(L,bcs);
+    std::vector<double> f(N+1), u(N+1);
+    for (unsigned int i=0; i<=N; i++) f[i] = 1.0/(1+i*i);
+    s.run("solver","ODESolver solve",N,1,N+1,"coeffs",[&]() {
+        solver.solve(Span<const double>(f),Span<double>(u));
+        Bench::do_not_optimize(u[0]);
+    });
+}
+
+int main(int argc, char** argv)
+{
+    std::string json;
+    bool quick = false;
+    for (int a=1; a<argc; a++) {
+        if (!std::strcmp(argv[a],"--json") && a+1<argc) json = argv[++a];
+        else if (!std::strcmp(argv[a],"--quick")) quick = true;
+        else {
+            std::printf("usage: %s [--json FILE] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+    Suite s;
+    s.samples = quick ? 5 : 21;
+    s.report.set_meta("compiler",__VERSION__);
+    s.report.set_meta("simd",Chebyshev::detected_simd_level()==Chebyshev::SimdLevel::AVX512 ? "avx512" :
+                             Chebyshev::detected_simd_level()==Chebyshev::SimdLevel::AVX2 ? "avx2" : "scalar");
+    s.report.set_meta("threads",std::to_string(Parallel::default_threads()));
+    s.report.set_meta("mode",quick ? "quick" : "full");
+
+    const std::vector<unsigned int> Ns = quick ? std::vector<unsigned int>{16,256} : std::vector<unsigned int>{16,64,256,1024,4096};
+    const std::vector<std::size_t> batches = quick ? std::vector<std::size_t>{1,64} : std::vector<std::size_t>{1,16,256};
+    std::printf("%-10s %-24s %6s %6s  %10s %10s %10s %10s  %10s %-8s %8s\n",
+                "area", "case", "N", "batch", "median[s]", "p10[s]", "p90[s]", "p99[s]", "throughput", "[/s]", "allocs");
+    for (unsigned int N: Ns)
+        for (std::size_t b: {std::size_t(1),std::size_t(1024)}) bench_tn(s,N,b);
+    for (unsigned int N: Ns)
+        for (std::size_t M: batches) bench_transform(s,N,M);
+    for (std::size_t b: {std::size_t(1),std::size_t(1024)}) {
+        bench_eval<16>(s,b);
+        bench_eval<256>(s,b);
+        if (!quick) bench_eval<4096>(s,b);
+    }
+    for (unsigned int N: Ns)
+        for (std::size_t M: batches) bench_operator(s,N,M);
+    for (unsigned int N: Ns) bench_solver(s,N);
+
+    if (!json.empty()) {
+        if (!s.report.write(json)) {
+            std::printf("cannot write %s\n", json.c_str());
+            return 1;
+        }
+        std::printf("%zu results written to %s\n", s.report.size(), json.c_str());
+    }
+}
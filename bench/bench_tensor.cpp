@@ -0,0 +1,47 @@
+#include "../polybases/tensor_chebyshev.hpp"
+#include "bench_common.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace FunctionalBases;
+
+/*
+ * Sum-factorised kernels of the 3D tensor Chebyshev basis on n^3 grids,
+ * n = 16, 32, ... up to 256 (or argv[1]), on all hardware threads:
+ *   forward : values -> coefficients, three batched 1D transforms
+ *   inverse : coefficients -> values
+ *   d/dx    : derivative along the slowest (most strided) axis
+ *   d/dz    : derivative along the contiguous axis
+ *   eval    : one point, Clenshaw axis by axis
+ * Time per grid point is shown next to each total, a dense O(N^6)
+ * transform would be n^3 times slower per point.
+ */
+int main(int argc, char** argv)
+{
+    const unsigned int nmax = argc > 1 ? std::atoi(argv[1]) : 256;
+    std::printf("%u threads\n", Parallel::default_threads());
+    for (unsigned int n=16; n<=nmax; n*=2) {
+        TensorChebyshevBase<double,3> basis(n-1);
+        const std::size_t size = basis.size();
+        std::vector<double> f(size), ft(size), df(size);
+        for (std::size_t i=0; i<size; i++) f[i] = std::sin(1e-3*i);
+        const int reps = n >= 128 ? 1 : 3;
+        const double t_fwd = Bench::best_time([&]() { basis.calc_spectral_coeffs(Span<const double>(f),Span<double>(ft)); Bench::do_not_optimize(ft[0]); },reps,0.0);
+        const double t_inv = Bench::best_time([&]() { basis.calc_function_values(Span<const double>(ft),Span<double>(f)); Bench::do_not_optimize(f[0]); },reps,0.0);
+        const double t_dx = Bench::best_time([&]() {
+            basis.apply_operator(OperatorKind::Derivative,0,Span<const double>(ft),Span<double>(df));
+            Bench::do_not_optimize(df[0]);
+        },reps,0.0);
+        const double t_dz = Bench::best_time([&]() {
+            basis.apply_operator(OperatorKind::Derivative,2,Span<const double>(ft),Span<double>(df));
+            Bench::do_not_optimize(df[0]);
+        },reps,0.0);
+        const std::array<double,3> x{0.1,-0.3,0.7};
+        const double t_ev = Bench::best_time([&]() { double v = basis.evaluate_series(x,Span<const double>(ft)); Bench::do_not_optimize(v); },reps);
+        std::printf("%4u^3 (%s): forward %9.3e s (%6.2f ns/pt)  inverse %9.3e s  d/dx %9.3e s (%5.2f ns/pt)  d/dz %9.3e s  eval %9.3e s\n",
+                    n, basis.axis_basis(0).batch_uses_dct() ? "dct " : "gemm", t_fwd, t_fwd/size*1e9, t_inv,
+                    t_dx, t_dx/size*1e9, t_dz, t_ev);
+    }
+}
@@ -10,25 +10,36 @@
 
 
 #include "polybases/polybases.hpp"
+#include "polybases/plan_registry.hpp"
+#include "polybases/fixed_chebyshev.hpp"
+#include "polybases/tensor_chebyshev.hpp"
+#include "polybases/static_basis.hpp"
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 namespace FunctionalBases {
 /** 
  * @brief namespace that contains the function class 
  * The function class is meant as a wrapper to contain
  * physical and collocation space representations of a
- * function. It contains a pointer to a FunctionalBase
- * object which is used by the decompose() method to 
+ * function. It borrows a shared FunctionalBase from the
+ * PlanRegistry which is used by the decompose() method to 
  * compute the spectral coefficients.
  */
 namespace Functions {
   /**
    * @brief Function class
+   * FuncBase is any basis with the FunctionalBase member functions. Final
+   * subclasses of FunctionalBase (ChebyshevBase, BasisAdapter) and
+   * StaticBasis types are called without virtual dispatch.
    */
     template <class T, class FuncBase, unsigned int N>
     class Function {
       std::vector<T> f_i;   //! Physical space representation of f
         std::vector<T> ft_i;  //! Collocation space representation of f
-        FuncBase* basis; //! FunctionalBase used for spectral decomposition
+        std::shared_ptr<const FuncBase> basis; //! FunctionalBase used for spectral decomposition, shared through the PlanRegistry
         public:
       // constructors -----------------
       /** 
@@ -36,34 +47,71 @@ namespace Functions {
        * @param f_i vector containing function values at grid nodes
        */
         Function<T,FuncBase,N>(const std::vector<T>& f_i): f_i(f_i) {
-            assert(f_i.size()==N);
-            basis = new FuncBase(N);
+            assert(f_i.size()==N+1);
+            SPECTRE_PROFILE_SCOPE("Function::Function",N,2*(N+1)*sizeof(T));
+            basis = PlanRegistry::instance().get_basis<FuncBase>(N);
             decompose();
         };
       /**
        * @brief Constructor based on function pointer 
        * @param func analytic function, will be evaluated on the grid and decomposed
        */
-        Function<T,FuncBase,N>(void func(const std::vector<T>&, std::vector<T>&)) {
-            basis = new FuncBase(N) ;
+        Function<T,FuncBase,N>(void func(const std::vector<T>&, std::vector<T>&)):
+            Function<T,FuncBase,N>(PlanRegistry::instance().get_basis<FuncBase>(N),func) {}
+      /**
+       * @brief Constructor on a given basis, for bases with parameters beyond N (e.g. a domain)
+       * @param b basis of order N
+       * @param func analytic function, will be evaluated on the grid and decomposed
+       */
+        Function<T,FuncBase,N>(const std::shared_ptr<const FuncBase>& b, void func(const std::vector<T>&, std::vector<T>&)): basis(b) {
+            assert(basis->get_N()==N);
+            SPECTRE_PROFILE_SCOPE("Function::Function",N,3*(N+1)*sizeof(T));
             std::vector<T> n;
             basis->get_nodes(n);
             (*func)(n,f_i);
             decompose();
         }
+      /**
+       * @brief Build a function from its spectral coefficients (e.g. the output of a solver)
+       * @param ft N+1 spectral coefficients, function values are recovered by the inverse transform
+       */
+        static Function from_spectral_coeffs(const std::vector<T>& ft) {
+            return from_spectral_coeffs(PlanRegistry::instance().get_basis<FuncBase>(N),ft);
+        }
+      /**
+       * @brief Build a function on a given basis from its spectral coefficients
+       * @param b basis of order N, e.g. one not default constructible from N
+       * @param ft spectral coefficients, b->num_coeffs() of them
+       */
+        static Function from_spectral_coeffs(const std::shared_ptr<const FuncBase>& b, const std::vector<T>& ft) {
+            assert(b->get_N()==N && ft.size()==b->num_coeffs());
+            Function f(b);
+            f.update_spectral_coeffs(ft);
+            return f;
+        }
       // members --------------------
       /**
        * @brief evaluate function at a point
        * @param x point at which to evaluate f
        * @param f_x reference to output value
        */
-      inline void eval(const T& x, T& f_x);
+      inline void eval(const T& x, T& f_x) const;
       /**
        * @brief evaluate function at a vector of points
        * @param x points at which to evaluate f
        * @param f_x reference to output vector
        */
-      inline void eval(const std::vector<T>& x, std::vector<T>& f_x);
+      inline void eval(const std::vector<T>& x, std::vector<T>& f_x) const;
+      /**
+       * @brief evaluate function at a batch of points into a caller-provided buffer
+       * Runs batched Clenshaw summation across SIMD lanes, does not allocate.
+       * @param x points at which to evaluate f
+       * @param f_x output view, same length as x
+       */
+      inline void eval(Span<const T> x, Span<T> f_x) const {
+          SPECTRE_PROFILE_SCOPE("Function::eval_batch",N,(2*x.size()+N+1)*sizeof(T));
+          basis->evaluate_series_batch(x,ft_i,f_x);
+      }
       /**
        * @brief perform spectral decomposition of f
        * Use FunctionalBasis* member to compute the spectral 
@@ -71,54 +119,488 @@ namespace Functions {
        * FunctionalBasis abstract class.
        */
       inline void decompose(){
-          basis->calc_spectral_coeffs(f_i,ft_i);
+          ft_i.resize(basis->num_coeffs());
+          basis->calc_spectral_coeffs(Span<const T>(f_i),Span<T>(ft_i));
       }
       inline void inverse_transform(){
-        basis->calc_function_values(ft_i,f_i);
+          f_i.resize(basis->get_N()+1);
+          basis->calc_function_values(Span<const T>(ft_i),Span<T>(f_i));
+      }
+      /**
+       * @brief Replace f by its k-th derivative.
+       * The coefficients go through the O(N) recurrence of the basis, no
+       * operator matrix is built; the values at the nodes are refreshed by
+       * one inverse transform.
+       * @param k order of the derivative
+       */
+      inline Function& differentiate(unsigned int k=1) {
+          basis->differentiate_coeffs(Span<const T>(ft_i),Span<T>(ft_i),k);
+          inverse_transform();
+          return *this;
       }
+      /**
+       * @brief Replace f by its antiderivative vanishing at the left end of the domain.
+       * Truncated to the order of the basis, see Chebyshev::antiderivative_coeffs.
+       */
+      inline Function& antiderivative() {
+          basis->antiderivative_coeffs(Span<const T>(ft_i),Span<T>(ft_i));
+          inverse_transform();
+          return *this;
+      }
+      //! Definite integral over the domain of the basis, O(N) from the coefficients
+      inline T integrate() const { return basis->integrate_coeffs(Span<const T>(ft_i)); }
+      // arithmetic -----------------
+      /**
+       * @brief f += a g, on values and coefficients at once
+       * O(N) and without allocating, g must live on the same basis.
+       */
+      inline Function& axpy(const T& a, const Function& g) {
+          assert(basis==g.basis || basis->plan_key()==g.basis->plan_key());
+          for (std::size_t i=0; i<ft_i.size(); i++) ft_i[i] += a*g.ft_i[i];
+          for (std::size_t i=0; i<f_i.size(); i++) f_i[i] += a*g.f_i[i];
+          return *this;
+      }
+      inline Function& operator+=(const Function& g) { return axpy(static_cast<T>(1),g); }
+      inline Function& operator-=(const Function& g) { return axpy(static_cast<T>(-1),g); }
+      inline Function& operator*=(const T& a) {
+          for (auto& v: ft_i) v *= a;
+          for (auto& v: f_i) v *= a;
+          return *this;
+      }
+      /**
+       * @brief f = u v, dealiased and truncated to order N.
+       * The product of the coefficients comes from the basis (multiply_coeffs:
+       * 3/2-rule padding through the DCT, or a direct convolution for small N),
+       * the values from one inverse transform. Reuses the storage of f and the
+       * thread-local work buffers of the basis, so it does not allocate.
+       * u and v may be f itself.
+       */
+      inline Function& set_product(const Function& u, const Function& v) {
+          assert(u.basis->plan_key()==v.basis->plan_key());
+          if (basis!=u.basis) basis = u.basis;
+          ft_i.resize(basis->num_coeffs());
+          basis->multiply_coeffs(Span<const T>(u.ft_i),Span<const T>(v.ft_i),Span<T>(ft_i));
+          inverse_transform();
+          return *this;
+      }
+      inline Function& operator*=(const Function& g) { return set_product(*this,g); }
         // access---------------------
       /**
        * @brief access to spectral coefficients
        * @param y reference to output vector
        */
-        inline void get_spectral_coeffs(std::vector<T>& y){ y = ft_i;};
+        inline void get_spectral_coeffs(std::vector<T>& y) const { y = ft_i;};
       /**
        * @brief access to function values on grid nodes
        * @param y reference to output vector
        */
-        inline void get_func_vals(std::vector<T>& y){ y = f_i; };
+        inline void get_func_vals(std::vector<T>& y) const { y = f_i; };
+        //! Spectral coefficients and function values without copying
+        inline const std::vector<T>& spectral_coeffs() const { return ft_i; };
+        inline const std::vector<T>& func_vals() const { return f_i; };
       /** 
        * @brief Change spectral coefficients from outside (e.g. by a solver)
        * Takes new spectral coefficients as input and recalculates function values
-       * on grid nodes based on new decomposition
+       * on grid nodes based on new decomposition. Once the function has been
+       * built this reuses its storage and does not allocate.
        * @param ft_i_new new values of the spectral coefficients
        */
-        void update_spectral_coeffs(const std::vector<T>& ft_i_new) {
-          ft_i.clear();
-          ft_i = ft_i_new;
+        void update_spectral_coeffs(Span<const T> ft_i_new) {
+          assert(ft_i_new.size()==basis->num_coeffs());
+          ft_i.assign(ft_i_new.begin(),ft_i_new.end());
           inverse_transform(); 
         }
-        // destructor -------------
+        void update_spectral_coeffs(const std::vector<T>& ft_i_new) { update_spectral_coeffs(Span<const T>(ft_i_new)); }
       /**
-       * @brief Destructor. Clean up basis member.
+       * @brief Change function values at the nodes and recompute the coefficients, without allocating
+       * @param f_i_new N+1 new values
        */
-        ~Function<T,FuncBase,N>() { delete basis;};
+        void update_func_vals(Span<const T> f_i_new) {
+          assert(f_i_new.size()==N+1);
+          f_i.assign(f_i_new.begin(),f_i_new.end());
+          decompose();
+        }
+      /**
+       * @brief access to the shared basis
+       */
+        inline const std::shared_ptr<const FuncBase>& get_basis() const { return basis; };
+        private:
+        Function<T,FuncBase,N>(const std::shared_ptr<const FuncBase>& b): basis(b) {}
     };
 
 
-template <class T,class FuncBase, unsigned int N> inline void Function<T,FuncBase,N>::eval(const T& x, T& f_x)
+template <class T,class FuncBase, unsigned int N> inline void Function<T,FuncBase,N>::eval(const T& x, T& f_x) const
 {   
-    for(int n=0; n<ft_i.size(); n++) f_x += ft_i[n] * basis->evaluate_function(x,n);
+    SPECTRE_PROFILE_SCOPE("Function::eval",N,(N+3)*sizeof(T));
+    f_x = basis->evaluate_series(x,ft_i);
 };
 
-template <class T,class FuncBase, unsigned int N> inline void Function<T,FuncBase,N>::eval(const std::vector<T>& x, std::vector<T>& f_x){
-    f_x.clear();
-    for (const auto& xval: x) {
-        T tmp = static_cast<T>(0);
-        for(int n=0; n<ft_i.size(); n++) tmp += ft_i[n] * basis->evaluate_function(xval,n);
-        f_x.push_back(tmp);
-    }
+template <class T,class FuncBase, unsigned int N> inline void Function<T,FuncBase,N>::eval(const std::vector<T>& x, std::vector<T>& f_x) const {
+    f_x.resize(x.size());
+    SPECTRE_PROFILE_SCOPE("Function::eval_batch",N,(2*x.size()+N+1)*sizeof(T));
+    basis->evaluate_series_batch(Span<const T>(x),ft_i,Span<T>(f_x));
 };
+
+/*
+ * Binary arithmetic on Functions of the same basis, for the generic and the
+ * fixed-size Function alike. These return a new Function; in time loops the
+ * compound forms and set_product reuse existing storage instead.
+ */
+template <class T,class FuncBase, unsigned int N> inline Function<T,FuncBase,N> operator+(Function<T,FuncBase,N> u, const Function<T,FuncBase,N>& v) { u += v; return u; }
+template <class T,class FuncBase, unsigned int N> inline Function<T,FuncBase,N> operator-(Function<T,FuncBase,N> u, const Function<T,FuncBase,N>& v) { u -= v; return u; }
+template <class T,class FuncBase, unsigned int N> inline Function<T,FuncBase,N> operator-(Function<T,FuncBase,N> u) { u *= static_cast<T>(-1); return u; }
+template <class T,class FuncBase, unsigned int N> inline Function<T,FuncBase,N> operator*(const T& a, Function<T,FuncBase,N> u) { u *= a; return u; }
+template <class T,class FuncBase, unsigned int N> inline Function<T,FuncBase,N> operator*(Function<T,FuncBase,N> u, const T& a) { u *= a; return u; }
+//! Dealiased product, see Function::set_product
+template <class T,class FuncBase, unsigned int N> inline Function<T,FuncBase,N> operator*(Function<T,FuncBase,N> u, const Function<T,FuncBase,N>& v) { u *= v; return u; }
+
+  /**
+   * @brief Fixed-size Function specialisation on the compile-time Chebyshev basis.
+   * Values and coefficients live in std::arrays, nodes and transform matrices
+   * come from the constexpr ChebyshevTables<T,N>, so objects of this type
+   * never allocate and are trivially copyable. Intended for small N (<= 64).
+   */
+    template <class T, unsigned int N>
+    class Function<T,FixedChebyshevBase<T>,N> {
+      typedef ChebyshevTables<T,N> tables;
+      std::array<T,N+1> f_i;   //! Physical space representation of f
+      std::array<T,N+1> ft_i;  //! Collocation space representation of f
+        public:
+      // constructors -----------------
+      /** 
+       * @brief Constructor based on function values at grid nodes
+       * @param f_i array containing function values at grid nodes
+       */
+        Function(const std::array<T,N+1>& f_i): f_i(f_i) {
+            SPECTRE_PROFILE_SCOPE("Function<Fixed>::Function",N,2*(N+1)*sizeof(T));
+            decompose();
+        };
+      /** 
+       * @brief Constructor based on function values at grid nodes
+       * @param f vector containing function values at grid nodes
+       */
+        Function(const std::vector<T>& f) {
+            assert(f.size()==N+1);
+            SPECTRE_PROFILE_SCOPE("Function<Fixed>::Function",N,2*(N+1)*sizeof(T));
+            std::copy(f.begin(),f.end(),f_i.begin());
+            decompose();
+        };
+      /**
+       * @brief Constructor based on function pointer 
+       * @param func analytic function, will be evaluated on the grid and decomposed
+       */
+        Function(void func(const std::vector<T>&, std::vector<T>&)) {
+            SPECTRE_PROFILE_SCOPE("Function<Fixed>::Function",N,3*(N+1)*sizeof(T));
+            std::vector<T> n(tables::nodes.begin(),tables::nodes.end()), f;
+            (*func)(n,f);
+            assert(f.size()==N+1);
+            std::copy(f.begin(),f.end(),f_i.begin());
+            decompose();
+        }
+      /**
+       * @brief Sample a pointwise callable T(T) on the grid, without allocating
+       * @param func callable evaluated at each node
+       */
+        template <class F> static Function from_callable(F func) {
+            std::array<T,N+1> f;
+            for (unsigned int i=0; i<N+1; i++) f[i] = func(tables::nodes[i]);
+            return Function(f);
+        }
+      // members --------------------
+      /**
+       * @brief evaluate function at a point with unrolled Clenshaw summation
+       * @param x point at which to evaluate f
+       * @param f_x reference to output value
+       */
+        inline void eval(const T& x, T& f_x) const { f_x = clenshaw_fixed(x,ft_i); };
+        inline T operator()(const T& x) const { return clenshaw_fixed(x,ft_i); };
+      /**
+       * @brief evaluate function at a vector of points
+       * @param x points at which to evaluate f
+       * @param f_x reference to output vector
+       */
+        inline void eval(const std::vector<T>& x, std::vector<T>& f_x) const {
+            f_x.resize(x.size());
+            eval(Span<const T>(x),Span<T>(f_x));
+        };
+        inline void eval(Span<const T> x, Span<T> f_x) const {
+            assert(x.size()==f_x.size());
+            SPECTRE_PROFILE_SCOPE("Function<Fixed>::eval_batch",N,(2*x.size()+N+1)*sizeof(T));
+            Chebyshev::clenshaw_batch<T>(ft_i.data(),N+1,x.data(),x.size(),f_x.data());
+        };
+        inline void decompose(){ fixed_spectral_coeffs<T,N>(f_i,ft_i); }
+        inline void inverse_transform(){ fixed_function_values<T,N>(ft_i,f_i); }
+        //! k-th derivative by the O(N) coefficient recurrence, see the generic Function
+        inline Function& differentiate(unsigned int k=1) {
+            for (unsigned int j=0; j<k; j++) Chebyshev::derivative_coeffs(ft_i.data(),ft_i.data(),N+1);
+            inverse_transform();
+            return *this;
+        }
+        //! Antiderivative vanishing at x=-1, truncated to order N
+        inline Function& antiderivative() {
+            Chebyshev::antiderivative_coeffs(ft_i.data(),ft_i.data(),N+1);
+            inverse_transform();
+            return *this;
+        }
+        //! Clenshaw-Curtis integral over [-1,1]
+        inline T integrate() const { return Chebyshev::integral(ft_i.data(),N+1); }
+        // arithmetic -----------------
+        //! f += a g, O(N)
+        inline Function& axpy(const T& a, const Function& g) {
+            for (unsigned int i=0; i<N+1; i++) {
+                ft_i[i] += a*g.ft_i[i];
+                f_i[i] += a*g.f_i[i];
+            }
+            return *this;
+        }
+        inline Function& operator+=(const Function& g) { return axpy(static_cast<T>(1),g); }
+        inline Function& operator-=(const Function& g) { return axpy(static_cast<T>(-1),g); }
+        inline Function& operator*=(const T& a) {
+            for (unsigned int i=0; i<N+1; i++) {
+                ft_i[i] *= a;
+                f_i[i] *= a;
+            }
+            return *this;
+        }
+        //! f = u v truncated to order N, by direct convolution of the coefficients (N is small here)
+        inline Function& set_product(const Function& u, const Function& v) {
+            std::array<T,N+1> c;
+            Chebyshev::product_coeffs(u.ft_i.data(),v.ft_i.data(),N+1,c.data());
+            ft_i = c;
+            inverse_transform();
+            return *this;
+        }
+        inline Function& operator*=(const Function& g) { return set_product(*this,g); }
+        // access---------------------
+        inline void get_spectral_coeffs(std::vector<T>& y) const { y.assign(ft_i.begin(),ft_i.end()); };
+        inline void get_func_vals(std::vector<T>& y) const { y.assign(f_i.begin(),f_i.end()); };
+        inline const std::array<T,N+1>& spectral_coeffs() const { return ft_i; };
+        inline const std::array<T,N+1>& func_vals() const { return f_i; };
+        static constexpr const std::array<T,N+1>& nodes() { return tables::nodes; };
+        void update_spectral_coeffs(const std::array<T,N+1>& ft_i_new) {
+          ft_i = ft_i_new;
+          inverse_transform(); 
+        }
+        void update_spectral_coeffs(const std::vector<T>& ft_i_new) {
+          assert(ft_i_new.size()==N+1);
+          std::copy(ft_i_new.begin(),ft_i_new.end(),ft_i.begin());
+          inverse_transform(); 
+        }
+    };
+
+  /**
+   * @brief Chebyshev expansion whose order is chosen at runtime.
+   * from_callable samples a function on nested Gauss-Lobatto grids
+   * N0, 2 N0, 4 N0, ... (the nodes of order N are the even nodes of order
+   * 2N, so every refinement only evaluates the new odd nodes) until the
+   * tail of the coefficients drops below tol relative to the largest one,
+   * then chops the series to the shortest length above that level. The
+   * basis is borrowed from the PlanRegistry at the final order, so
+   * evaluation, operators and solvers built on get_basis() only pay for
+   * the resolution the function needs.
+   */
+    template <class T>
+    class AdaptiveFunction {
+        std::vector<T> f_i;   //! Physical space representation of f
+        std::vector<T> ft_i;  //! Collocation space representation of f
+        std::shared_ptr<const ChebyshevBase<T>> basis;
+        bool resolved;        //! false if the tail never dropped below the tolerance
+        public:
+        //! Default relative tolerance on the coefficient tail
+        static T default_tolerance() { return static_cast<T>(64)*std::numeric_limits<T>::epsilon(); }
+      /**
+       * @brief Adaptively sample a pointwise callable T(T) on [-1,1]
+       * @param func callable
+       * @param tol relative tolerance on the coefficient tail
+       * @param N0 initial order
+       * @param Nmax largest order tried, the series is kept unchopped if it is reached
+       */
+        template <class F> static AdaptiveFunction from_callable(F func, T tol=default_tolerance(), unsigned int N0=16, unsigned int Nmax=1u<<16);
+      /**
+       * @brief Function from spectral coefficients, on the basis of order ft.size()-1
+       */
+        static AdaptiveFunction from_spectral_coeffs(const std::vector<T>& ft) {
+            assert(ft.size()>=2);
+            AdaptiveFunction f;
+            f.ft_i = ft;
+            f.basis = PlanRegistry::instance().get_basis<ChebyshevBase<T>>(ft.size()-1);
+            f.basis->calc_function_values(f.ft_i,f.f_i);
+            return f;
+        }
+      /**
+       * @brief Drop trailing coefficients below tol times the largest one, keeping order >= 1
+       * Returns false, leaving the function untouched, if the last tail
+       * coefficients are not below tol (the series is not resolved).
+       */
+        bool chop(T tol=default_tolerance());
+        // evaluation ----------------
+        inline void eval(const T& x, T& f_x) const { f_x = basis->evaluate_series(x,ft_i); };
+        inline T operator()(const T& x) const { return basis->evaluate_series(x,ft_i); };
+        inline void eval(const std::vector<T>& x, std::vector<T>& f_x) const {
+            f_x.resize(x.size());
+            eval(Span<const T>(x),Span<T>(f_x));
+        }
+        inline void eval(Span<const T> x, Span<T> f_x) const { basis->evaluate_series_batch(x,ft_i,f_x); }
+        // access---------------------
+        inline unsigned int get_N() const { return ft_i.size()-1; }
+        inline bool is_resolved() const { return resolved; }
+        inline void get_spectral_coeffs(std::vector<T>& y) const { y = ft_i; };
+        inline void get_func_vals(std::vector<T>& y) const { y = f_i; };
+        inline const std::vector<T>& spectral_coeffs() const { return ft_i; };
+        inline const std::vector<T>& func_vals() const { return f_i; };
+        inline const std::shared_ptr<const ChebyshevBase<T>>& get_basis() const { return basis; };
+        private:
+        AdaptiveFunction(): resolved(true) {}
+        //! Index of the last coefficient above tol*scale, or -1 if the tail check fails
+        static long chop_point(const std::vector<T>& ft, T tol);
+    };
+
+    template <class T> long AdaptiveFunction<T>::chop_point(const std::vector<T>& ft, T tol)
+    {
+        T scale = static_cast<T>(0);
+        for (const auto& c: ft) scale = std::max(scale,std::abs(c));
+        if (scale==static_cast<T>(0)) return 0;
+        const T level = tol*scale;
+        // the last eighth of the series (at least 4 coefficients) must be below the level
+        const std::size_t tail = std::max<std::size_t>(4,ft.size()/8);
+        if (tail>=ft.size()) return -1;
+        for (std::size_t n=ft.size()-tail; n<ft.size(); n++)
+            if (std::abs(ft[n])>level) return -1;
+        long last = ft.size()-tail-1;
+        while (last>0 && std::abs(ft[last])<=level) last--;
+        return last;
+    }
+
+    template <class T> bool AdaptiveFunction<T>::chop(T tol)
+    {
+        const long last = chop_point(ft_i,tol);
+        if (last<0) return false;
+        std::vector<T> ft(ft_i.begin(),ft_i.begin()+std::max<long>(last,1)+1);
+        *this = from_spectral_coeffs(ft);
+        return true;
+    }
+
+    template <class T> template <class F> AdaptiveFunction<T> AdaptiveFunction<T>::from_callable(F func, T tol, unsigned int N0, unsigned int Nmax)
+    {
+        assert(N0>=1 && Nmax>=N0);
+        unsigned int N = N0;
+        std::shared_ptr<const ChebyshevBase<T>> b = PlanRegistry::instance().get_basis<ChebyshevBase<T>>(N);
+        std::vector<T> x, f, ft;
+        b->get_nodes(x);
+        for (const auto& v: x) f.push_back(func(v));
+        for (;;) {
+            b->calc_spectral_coeffs(f,ft);
+            if (chop_point(ft,tol)>=0 || 2*N>Nmax) break;
+            // refine: old samples become the even nodes of the grid of order 2N
+            N *= 2;
+            b = PlanRegistry::instance().get_basis<ChebyshevBase<T>>(N);
+            b->get_nodes(x);
+            std::vector<T> g(N+1);
+            for (unsigned int i=0; i<=N; i++) g[i] = (i%2) ? func(x[i]) : f[i/2];
+            f.swap(g);
+        }
+        AdaptiveFunction af;
+        af.basis = b;
+        af.ft_i = ft;
+        af.f_i = f;
+        af.resolved = af.chop(tol);
+        return af;
+    }
+
+  /**
+   * @brief Function on a box in a tensor-product Chebyshev basis.
+   * Values on the tensor Gauss-Lobatto grid and tensor coefficients are both
+   * stored row-major with the last axis fastest, transforms, derivatives and
+   * evaluation go through the sum-factorised kernels of TensorChebyshevBase.
+   */
+    template <class T, unsigned int D>
+    class TensorFunction {
+        typedef TensorChebyshevBase<T,D> Base;
+        std::vector<T> f_i;   //! Physical space representation of f
+        std::vector<T> ft_i;  //! Tensor Chebyshev coefficients of f
+        std::shared_ptr<const Base> basis;
+        public:
+        typedef typename Base::point_type point_type;
+      /**
+       * @brief Sample a callable T(point_type) on the grid and decompose
+       * @param b tensor basis
+       * @param func callable, evaluated once per grid point (in parallel over the first axis)
+       */
+        template <class F> TensorFunction(const std::shared_ptr<const Base>& b, F func);
+      /**
+       * @brief Constructor from values on the grid
+       * @param b tensor basis
+       * @param f b->size() values, row-major
+       */
+        TensorFunction(const std::shared_ptr<const Base>& b, const std::vector<T>& f): f_i(f), basis(b) {
+            assert(f_i.size()==basis->size());
+            decompose();
+        }
+      /**
+       * @brief Build a function from its tensor coefficients
+       */
+        static TensorFunction from_spectral_coeffs(const std::shared_ptr<const Base>& b, const std::vector<T>& ft) {
+            assert(ft.size()==b->size());
+            TensorFunction f(b);
+            f.update_spectral_coeffs(ft);
+            return f;
+        }
+        // members --------------------
+        inline void eval(const point_type& x, T& f_x) const { f_x = basis->evaluate_series(x,Span<const T>(ft_i)); };
+        inline T operator()(const point_type& x) const { return basis->evaluate_series(x,Span<const T>(ft_i)); };
+        inline void eval(Span<const point_type> x, Span<T> f_x) const { basis->evaluate_series_batch(x,Span<const T>(ft_i),f_x); }
+      /**
+       * @brief Partial derivative of the given order along one axis
+       * @param axis direction of differentiation
+       * @param order number of derivatives, 0 returns a copy
+       */
+        TensorFunction derivative(unsigned int axis, unsigned int order=1) const;
+        inline void decompose() { basis->calc_spectral_coeffs(f_i,ft_i); }
+        inline void inverse_transform() { basis->calc_function_values(ft_i,f_i); }
+        // access---------------------
+        inline void get_spectral_coeffs(std::vector<T>& y) const { y = ft_i; };
+        inline void get_func_vals(std::vector<T>& y) const { y = f_i; };
+        inline const std::vector<T>& spectral_coeffs() const { return ft_i; };
+        inline const std::vector<T>& func_vals() const { return f_i; };
+        void update_spectral_coeffs(Span<const T> ft_i_new) {
+            assert(ft_i_new.size()==basis->size());
+            ft_i.assign(ft_i_new.begin(),ft_i_new.end());
+            inverse_transform();
+        }
+        void update_spectral_coeffs(const std::vector<T>& ft_i_new) { update_spectral_coeffs(Span<const T>(ft_i_new)); }
+        inline const std::shared_ptr<const Base>& get_basis() const { return basis; };
+        private:
+        TensorFunction(const std::shared_ptr<const Base>& b): basis(b) {}
+    };
+
+    template <class T, unsigned int D> template <class F> TensorFunction<T,D>::TensorFunction(const std::shared_ptr<const Base>& b, F func): basis(b)
+    {
+        std::array<std::vector<T>,D> x;
+        for (unsigned int d=0; d<D; d++) basis->get_nodes(d,x[d]);
+        f_i.resize(basis->size());
+        const std::size_t slab = basis->size()/basis->extent(0);
+        Parallel::parallel_for(basis->extent(0),[&](std::size_t i0) {
+            point_type p;
+            p[0] = x[0][i0];
+            for (std::size_t j=0; j<slab; j++) {
+                std::size_t idx = j;
+                for (int d=D-1; d>0; d--) {
+                    p[d] = x[d][idx%basis->extent(d)];
+                    idx /= basis->extent(d);
+                }
+                f_i[i0*slab+j] = func(p);
+            }
+        },basis->get_num_threads());
+        decompose();
+    }
+
+    template <class T, unsigned int D> TensorFunction<T,D> TensorFunction<T,D>::derivative(unsigned int axis, unsigned int order) const
+    {
+        std::vector<T> ft(ft_i);
+        for (; order>=2; order-=2) basis->apply_operator(OperatorKind::SecondDerivative,axis,Span<const T>(ft),Span<T>(ft));
+        if (order==1) basis->apply_operator(OperatorKind::Derivative,axis,Span<const T>(ft),Span<T>(ft));
+        return from_spectral_coeffs(basis,ft);
+    }
             
 }
 }
@@ -0,0 +1,489 @@
+/**
+ * @file archive.hpp
+ * @brief Versioned binary archive of coefficients, grids and operator matrices, loaded by mmap.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Layout of an archive, all integers little-endian 64 bit unless noted:
+ *   - Header, 64 bytes: magic "SPECTRE", format version and endianness tag
+ *     (32 bit each), number of entries, offset and checksum of the directory,
+ *     total file size.
+ *   - Data: the arrays of every entry, each starting on a 64-byte boundary so
+ *     that mapped views can be used directly by aligned SIMD kernels.
+ *   - Directory: one fixed-size Entry per named object, with its kind
+ *     (array or operator), scalar type, format metadata, the offsets and
+ *     lengths of up to three arrays and a checksum of their bytes.
+ * Archive::open maps the file read-only and validates header and directory
+ * in O(number of entries); the data checksums, O(file size), are only
+ * checked on request. Arrays and operators are then handed out as Spans and
+ * OperatorViews into the mapping, without copying, and stay valid while the
+ * Archive is alive. A missing name or a wrong kind or scalar type gives an
+ * empty view rather than an error. Scalars are stored in their in-memory
+ * representation, so files move between machines of the same ABI.
+ */
+#ifndef _MY_SPECTRE_ARCHIVE_HPP
+#define _MY_SPECTRE_ARCHIVE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../functions.hpp"
+
+namespace IO {
+
+  using FunctionalBases::Span;
+  using FunctionalBases::OperatorView;
+  using FunctionalBases::OperatorStorage;
+  using FunctionalBases::StorageFormat;
+
+  //! Format version written by ArchiveWriter, readers reject other versions
+  constexpr std::uint32_t format_version = 1;
+  //! Alignment in bytes of every array in the file
+  constexpr std::size_t alignment = 64;
+
+  enum class EntryKind : std::uint32_t { Array = 0, Operator = 1 };
+  enum class ScalarType : std::uint32_t { Float = 1, Double = 2, LongDouble = 3, UInt64 = 4 };
+
+  //! Scalar type code of T in the archive
+  template <class T> constexpr ScalarType scalar_type() {
+    static_assert(std::is_same<T,float>::value || std::is_same<T,double>::value || std::is_same<T,long double>::value ||
+                  std::is_same<T,std::uint64_t>::value || std::is_same<T,std::size_t>::value, "unsupported archive scalar");
+    return std::is_same<T,float>::value ? ScalarType::Float : std::is_same<T,double>::value ? ScalarType::Double :
+           std::is_same<T,long double>::value ? ScalarType::LongDouble : ScalarType::UInt64;
+  }
+
+  namespace detail {
+
+    static_assert(sizeof(std::size_t)==8, "CSR indices are stored as 64-bit integers");
+
+    struct Header {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t endian;
+      std::uint64_t num_entries;
+      std::uint64_t dir_offset;
+      std::uint64_t dir_checksum;
+      std::uint64_t file_size;
+      std::uint64_t reserved[2];
+    };
+    static_assert(sizeof(Header)==64, "archive header must be 64 bytes");
+
+    /*
+     * meta of an Array: tag (e.g. the order N of a basis or function);
+     * of an Operator: format, n, kl, ku, offset, rank.
+     * Parts of an Operator: Dense/Banded vals; ParityTriangular u, v;
+     * CSR vals, row_ptr, cols.
+     */
+    struct Entry {
+      char name[64];
+      std::uint32_t kind;
+      std::uint32_t scalar;
+      std::uint64_t meta[6];
+      std::uint64_t offset[3];
+      std::uint64_t count[3];
+      std::uint64_t checksum;
+      std::uint64_t reserved[2];
+    };
+    static_assert(sizeof(Entry)==192, "archive entry must be 192 bytes");
+
+    constexpr char magic[8] = {'S','P','E','C','T','R','E','\0'};
+    constexpr std::uint32_t endian_tag = 0x01020304u;
+
+    inline std::size_t scalar_bytes(std::uint32_t s) {
+      switch (static_cast<ScalarType>(s)) {
+      case ScalarType::Float: return sizeof(float);
+      case ScalarType::Double: return sizeof(double);
+      case ScalarType::LongDouble: return sizeof(long double);
+      case ScalarType::UInt64: return sizeof(std::uint64_t);
+      }
+      return 0;
+    }
+    //! Element size of part k of an entry
+    inline std::size_t part_bytes(const Entry& e, int k) {
+      const bool index = e.kind==static_cast<std::uint32_t>(EntryKind::Operator) &&
+                         e.meta[0]==static_cast<std::uint64_t>(StorageFormat::CSR) && k>0;
+      return index ? sizeof(std::uint64_t) : scalar_bytes(e.scalar);
+    }
+    inline std::size_t align_up(std::size_t x) { return (x+alignment-1)/alignment*alignment; }
+    //! Scalar type, basis and order of a Functions::Function
+    template <class F> struct function_traits;
+    template <class T, class B, unsigned int N> struct function_traits<FunctionalBases::Functions::Function<T,B,N>> {
+      typedef T value_type;
+      typedef B basis_type;
+      static constexpr unsigned int order = N;
+    };
+    //! a*b==c without overflowing
+    inline bool product_is(std::uint64_t a, std::uint64_t b, std::uint64_t c) {
+      return b==0 ? c==0 : c%b==0 && c/b==a;
+    }
+    //! Operator metadata consistent with the part counts, see Entry; counts are bounded by the file size
+    inline bool valid_operator(const Entry& e) {
+      const std::uint64_t n = e.meta[1], kl = e.meta[2], ku = e.meta[3], rank = e.meta[5];
+      switch (static_cast<StorageFormat>(e.meta[0])) {
+      case StorageFormat::Dense: return product_is(n,n,e.count[0]);
+      case StorageFormat::Banded: return kl<=e.count[0] && ku<=e.count[0] && product_is(n,kl+ku+1,e.count[0]);
+      case StorageFormat::ParityTriangular: return product_is(rank,n,e.count[0]) && e.count[1]==e.count[0];
+      case StorageFormat::CSR: return n<e.count[1] && e.count[1]-1==n && e.count[2]==e.count[0];
+      }
+      return false;
+    }
+  }
+
+  /**
+   * @brief 64-bit checksum of a byte range, four interleaved multiply-xor lanes
+   * over 8-byte words, several GB/s. Detects corruption, not tampering.
+   * @param h running value, to chain several ranges
+   */
+  inline std::uint64_t checksum(const void* data, std::size_t bytes, std::uint64_t h=0xcbf29ce484222325ull)
+  {
+    constexpr std::uint64_t prime = 0x100000001b3ull;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    std::uint64_t lane[4] = {h, h^0x9e3779b97f4a7c15ull, h^0xbf58476d1ce4e5b9ull, h^0x94d049bb133111ebull};
+    std::size_t k = 0;
+    for (; k+32<=bytes; k+=32)
+      for (int l=0; l<4; l++) {
+        std::uint64_t w;
+        std::memcpy(&w,p+k+8*l,8);
+        lane[l] = (lane[l]^w)*prime;
+        lane[l] ^= lane[l] >> 29;
+      }
+    for (; k<bytes; k++) lane[0] = (lane[0]^p[k])*prime;
+    std::uint64_t r = bytes;
+    for (int l=0; l<4; l++) {
+      r = (r^lane[l])*prime;
+      r ^= r >> 32;
+    }
+    return r;
+  }
+
+  /**
+   * @brief Collects named objects and writes them as one archive.
+   * Only references to the data are kept until write(), the caller keeps
+   * arrays, operators and functions alive until then.
+   */
+  class ArchiveWriter {
+    struct Pending {
+      detail::Entry entry;
+      const void* part[3];
+    };
+    std::vector<Pending> items;
+    inline Pending& add(const std::string& name, EntryKind kind, ScalarType scalar);
+  public:
+    /**
+     * @brief Add an array
+     * @param name unique name, at most 63 characters
+     * @param data values
+     * @param tag user metadata returned by Archive::tag
+     */
+    template <class T> void add_array(const std::string& name, Span<const T> data, std::uint64_t tag=0) {
+      Pending& p = add(name,EntryKind::Array,scalar_type<T>());
+      p.entry.meta[0] = tag;
+      p.part[0] = data.data();
+      p.entry.count[0] = data.size();
+    }
+    //! Add an operator matrix in its storage format
+    template <class T> void add_operator(const std::string& name, const OperatorStorage<T>& L);
+    //! Add the spectral coefficients of a Function, tagged with its order N
+    template <class T, class B, unsigned int N> void add_function(const std::string& name, const FunctionalBases::Functions::Function<T,B,N>& f) {
+      add_array(name,Span<const T>(f.spectral_coeffs()),N);
+    }
+    //! Add the nodes and weights of a basis as name/nodes and name/weights, tagged with its order
+    template <class Basis> void add_basis(const std::string& name, const Basis& b) {
+      typedef typename Basis::value_type T;
+      add_array(name+"/nodes",Span<const T>(b.get_nodes()),b.get_N());
+      add_array(name+"/weights",Span<const T>(b.get_weights()),b.get_N());
+    }
+    inline std::size_t size() const { return items.size(); }
+    /**
+     * @brief Write the archive, replacing path
+     * @param error set to a description if the file cannot be written
+     * @return true on success
+     */
+    inline bool write(const std::string& path, std::string* error=nullptr) const;
+  };
+
+  /**
+   * @brief Read-only, memory-mapped archive.
+   * Views returned by the accessors point into the mapping and are valid as
+   * long as the Archive, which is immutable and can be shared between threads.
+   */
+  class Archive {
+    const unsigned char* base = nullptr;
+    std::size_t bytes = 0;
+    std::map<std::string,const detail::Entry*> index;
+    Archive() {}
+    //! Entry of name if it has the given kind and scalar type, nullptr otherwise
+    inline const detail::Entry* entry(const std::string& name, EntryKind kind, ScalarType scalar) const {
+      auto it = index.find(name);
+      if (it==index.end() || it->second->kind!=static_cast<std::uint32_t>(kind) ||
+          it->second->scalar!=static_cast<std::uint32_t>(scalar)) return nullptr;
+      return it->second;
+    }
+    template <class T> inline Span<const T> part(const detail::Entry& e, int k) const {
+      return Span<const T>(reinterpret_cast<const T*>(base+e.offset[k]),e.count[k]);
+    }
+  public:
+    Archive(const Archive&) = delete;
+    Archive& operator=(const Archive&) = delete;
+    ~Archive() { if (base) munmap(const_cast<unsigned char*>(base),bytes); }
+    /**
+     * @brief Map an archive
+     * @param path file written by ArchiveWriter
+     * @param verify also check the checksums of all data, O(file size); off by
+     * default, single entries can be checked later with verify(name)
+     * @param error set to a description if the file is missing, truncated, of another version or corrupt
+     * @return the archive, nullptr on failure
+     */
+    static inline std::shared_ptr<const Archive> open(const std::string& path, bool verify=false, std::string* error=nullptr);
+    inline bool contains(const std::string& name) const { return index.count(name)>0; }
+    inline std::vector<std::string> names() const {
+      std::vector<std::string> n;
+      for (const auto& kv: index) n.push_back(kv.first);
+      return n;
+    }
+    //! Size of the mapped file in bytes
+    inline std::size_t file_size() const { return bytes; }
+    //! Recompute the checksum of one entry, false if it does not match or name is missing
+    inline bool verify(const std::string& name) const;
+    //! User tag of an array, the order N for functions and bases; 0 if name is missing
+    inline std::uint64_t tag(const std::string& name) const {
+      auto it = index.find(name);
+      return it==index.end() ? 0 : it->second->meta[0];
+    }
+    //! Zero-copy view of an array of scalar type T, empty if there is no such array
+    template <class T> inline Span<const T> array(const std::string& name) const {
+      const detail::Entry* e = entry(name,EntryKind::Array,scalar_type<T>());
+      return e ? part<T>(*e,0) : Span<const T>();
+    }
+    /**
+     * @brief Zero-copy view of an operator matrix with scalar type T.
+     * n, kl, ku and rank were checked against the part counts by open(); the
+     * CSR structure (row_ptr monotone from 0 to the number of non-zeros,
+     * column indices below n) is checked here, O(non-zeros).
+     * @param error set to a description if there is no such operator or it is malformed
+     * @return the view, an empty one (n = 0) on failure
+     */
+    template <class T> inline OperatorView<T> operator_view(const std::string& name, std::string* error=nullptr) const;
+    //! Owning copy of an operator, e.g. for a LinearOperator or PlanRegistry::preload_operator; nullptr on failure, see operator_view
+    template <class T> inline std::shared_ptr<const OperatorStorage<T>> load_operator(const std::string& name, std::string* error=nullptr) const {
+      std::string err;
+      const OperatorView<T> V = operator_view<T>(name,&err);
+      if (!err.empty()) {
+        if (error) *error = err;
+        return nullptr;
+      }
+      return std::make_shared<const OperatorStorage<T>>(OperatorStorage<T>::from_view(V));
+    }
+    /**
+     * @brief Function F (a Functions::Function) rebuilt from stored coefficients on the shared basis of its order
+     * @param error set to a description if name is missing, of another scalar type,
+     * saved at another order or of the wrong length
+     * @return the function, zero on failure
+     */
+    template <class F> inline F load_function(const std::string& name, std::string* error=nullptr) const {
+      typedef detail::function_traits<F> Traits;
+      typedef typename Traits::value_type T;
+      const std::size_t nc = FunctionalBases::PlanRegistry::instance().get_basis<typename Traits::basis_type>(Traits::order)->num_coeffs();
+      auto fail = [&](const std::string& what) {
+        if (error) *error = name + ": " + what;
+        return F::from_spectral_coeffs(std::vector<T>(nc,static_cast<T>(0)));
+      };
+      if (!contains(name)) return fail("no such entry");
+      Span<const T> ft = array<T>(name);
+      if (!ft.data()) return fail("not an array of this scalar type");
+      if (tag(name)!=Traits::order) return fail("saved at order " + std::to_string(tag(name)) + ", expected " + std::to_string(Traits::order));
+      if (ft.size()!=nc) return fail(std::to_string(ft.size()) + " coefficients, expected " + std::to_string(nc));
+      return F::from_spectral_coeffs(std::vector<T>(ft.begin(),ft.end()));
+    }
+  };
+
+  // ArchiveWriter --------------------------------------------------------------
+
+  inline ArchiveWriter::Pending& ArchiveWriter::add(const std::string& name, EntryKind kind, ScalarType scalar)
+  {
+    assert(name.size()<sizeof(detail::Entry::name));
+    for (const auto& p: items) assert(name!=p.entry.name);
+    items.emplace_back();
+    Pending& p = items.back();
+    std::memset(&p.entry,0,sizeof(p.entry));
+    std::memcpy(p.entry.name,name.data(),name.size());
+    p.entry.kind = static_cast<std::uint32_t>(kind);
+    p.entry.scalar = static_cast<std::uint32_t>(scalar);
+    for (auto& q: p.part) q = nullptr;
+    return p;
+  }
+
+  template <class T> void ArchiveWriter::add_operator(const std::string& name, const OperatorStorage<T>& L)
+  {
+    const OperatorView<T> V = L.view();
+    Pending& p = add(name,EntryKind::Operator,scalar_type<T>());
+    const std::uint64_t meta[6] = {static_cast<std::uint64_t>(V.fmt),V.n,V.kl,V.ku,V.offset,V.rank};
+    std::memcpy(p.entry.meta,meta,sizeof(meta));
+    auto set = [&p](int k, const void* data, std::size_t count) {
+      p.part[k] = data;
+      p.entry.count[k] = count;
+    };
+    if (V.fmt==StorageFormat::ParityTriangular) {
+      set(0,V.u.data(),V.u.size());
+      set(1,V.v.data(),V.v.size());
+    }
+    else set(0,V.vals.data(),V.vals.size());
+    if (V.fmt==StorageFormat::CSR) {
+      set(1,V.row_ptr.data(),V.row_ptr.size());
+      set(2,V.cols.data(),V.cols.size());
+    }
+  }
+
+  inline bool ArchiveWriter::write(const std::string& path, std::string* error) const
+  {
+    std::vector<detail::Entry> dir;
+    std::size_t pos = sizeof(detail::Header);
+    for (const auto& p: items) {
+      detail::Entry e = p.entry;
+      std::uint64_t h = 0xcbf29ce484222325ull;
+      for (int k=0; k<3; k++) {
+        pos = detail::align_up(pos);
+        e.offset[k] = pos;
+        const std::size_t nb = e.count[k]*detail::part_bytes(e,k);
+        if (nb) h = checksum(p.part[k],nb,h);
+        pos += nb;
+      }
+      e.checksum = h;
+      dir.push_back(e);
+    }
+    detail::Header hdr;
+    std::memset(&hdr,0,sizeof(hdr));
+    std::memcpy(hdr.magic,detail::magic,sizeof(hdr.magic));
+    hdr.version = format_version;
+    hdr.endian = detail::endian_tag;
+    hdr.num_entries = dir.size();
+    hdr.dir_offset = detail::align_up(pos);
+    hdr.dir_checksum = checksum(dir.data(),dir.size()*sizeof(detail::Entry));
+    hdr.file_size = hdr.dir_offset + dir.size()*sizeof(detail::Entry);
+
+    std::ofstream out(path,std::ios::binary|std::ios::trunc);
+    static const char zeros[alignment] = {};
+    std::size_t written = 0;
+    auto put = [&](const void* data, std::size_t nb) {
+      out.write(static_cast<const char*>(data),nb);
+      written += nb;
+    };
+    auto pad_to = [&](std::size_t target) { put(zeros,target-written); };
+    put(&hdr,sizeof(hdr));
+    for (std::size_t i=0; i<items.size(); i++)
+      for (int k=0; k<3; k++) {
+        pad_to(dir[i].offset[k]);
+        put(items[i].part[k],dir[i].count[k]*detail::part_bytes(dir[i],k));
+      }
+    pad_to(hdr.dir_offset);
+    put(dir.data(),dir.size()*sizeof(detail::Entry));
+    out.close();
+    if (!out) {
+      if (error) *error = "cannot write " + path;
+      return false;
+    }
+    return true;
+  }
+
+  // Archive ---------------------------------------------------------------------
+
+  inline std::shared_ptr<const Archive> Archive::open(const std::string& path, bool verify, std::string* error)
+  {
+    auto fail = [&](const std::string& what) {
+      if (error) *error = path + ": " + what;
+      return std::shared_ptr<const Archive>();
+    };
+    const int fd = ::open(path.c_str(),O_RDONLY);
+    if (fd<0) return fail("cannot open");
+    struct stat st;
+    if (fstat(fd,&st)!=0 || st.st_size<static_cast<off_t>(sizeof(detail::Header))) {
+      ::close(fd);
+      return fail("not an archive, too short");
+    }
+    void* map = mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    ::close(fd);
+    if (map==MAP_FAILED) return fail("mmap failed");
+    std::shared_ptr<Archive> a(new Archive());
+    a->base = static_cast<const unsigned char*>(map);
+    a->bytes = st.st_size;
+
+    const detail::Header& hdr = *reinterpret_cast<const detail::Header*>(a->base);
+    if (std::memcmp(hdr.magic,detail::magic,sizeof(hdr.magic))!=0) return fail("not an archive, bad magic");
+    if (hdr.endian!=detail::endian_tag) return fail("written with another byte order");
+    if (hdr.version!=format_version) return fail("format version " + std::to_string(hdr.version) + ", expected " + std::to_string(format_version));
+    if (hdr.file_size!=a->bytes || hdr.dir_offset>a->bytes ||
+        hdr.num_entries>(a->bytes-hdr.dir_offset)/sizeof(detail::Entry)) return fail("truncated");
+    const detail::Entry* dir = reinterpret_cast<const detail::Entry*>(a->base+hdr.dir_offset);
+    if (checksum(dir,hdr.num_entries*sizeof(detail::Entry))!=hdr.dir_checksum) return fail("directory checksum mismatch");
+    for (std::size_t i=0; i<hdr.num_entries; i++) {
+      const detail::Entry& e = dir[i];
+      const std::string name(e.name,strnlen(e.name,sizeof(e.name)));
+      if (name.size()==sizeof(e.name) || detail::scalar_bytes(e.scalar)==0) return fail("bad directory entry");
+      for (int k=0; k<3; k++)
+        if (e.offset[k]%alignment || e.offset[k]>hdr.dir_offset ||
+            e.count[k]>(hdr.dir_offset-e.offset[k])/detail::part_bytes(e,k)) return fail("bad extent of " + name);
+      if (e.kind==static_cast<std::uint32_t>(EntryKind::Operator) && !detail::valid_operator(e)) return fail("bad operator metadata of " + name);
+      a->index[name] = &e;
+    }
+    if (verify)
+      for (const auto& kv: a->index)
+        if (!a->verify(kv.first)) return fail("checksum mismatch in " + kv.first);
+    return a;
+  }
+
+  inline bool Archive::verify(const std::string& name) const
+  {
+    auto it = index.find(name);
+    if (it==index.end()) return false;
+    const detail::Entry& e = *it->second;
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (int k=0; k<3; k++) {
+      const std::size_t nb = e.count[k]*detail::part_bytes(e,k);
+      if (nb) h = checksum(base+e.offset[k],nb,h);
+    }
+    return h==e.checksum;
+  }
+
+  template <class T> inline OperatorView<T> Archive::operator_view(const std::string& name, std::string* error) const
+  {
+    auto fail = [&](const std::string& what) {
+      if (error) *error = name + ": " + what;
+      return OperatorView<T>();
+    };
+    const detail::Entry* p = entry(name,EntryKind::Operator,scalar_type<T>());
+    if (!p) return fail(contains(name) ? "not an operator of this scalar type" : "no such entry");
+    const detail::Entry& e = *p;
+    OperatorView<T> V;
+    V.fmt = static_cast<StorageFormat>(e.meta[0]);
+    V.n = e.meta[1];
+    V.kl = e.meta[2];
+    V.ku = e.meta[3];
+    V.offset = e.meta[4];
+    V.rank = e.meta[5];
+    if (V.fmt==StorageFormat::ParityTriangular) {
+      V.u = part<T>(e,0);
+      V.v = part<T>(e,1);
+    }
+    else V.vals = part<T>(e,0);
+    if (V.fmt==StorageFormat::CSR) {
+      V.row_ptr = part<std::size_t>(e,1);
+      V.cols = part<std::size_t>(e,2);
+      if (V.row_ptr[0]!=0 || V.row_ptr[V.n]!=V.cols.size()) return fail("bad CSR row pointers");
+      for (std::size_t i=0; i<V.n; i++)
+        if (V.row_ptr[i]>V.row_ptr[i+1]) return fail("bad CSR row pointers");
+      for (auto j: V.cols)
+        if (j>=V.n) return fail("CSR column index out of range");
+    }
+    return V;
+  }
+
+} // namespace IO
+
+#endif
@@ -0,0 +1,357 @@
+/**
+ * @file barycentric.hpp
+ * @brief Barycentric interpolation on collocation grids and grid-to-grid resampling.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * The second-kind (true) barycentric formula
+ *   p(x) = sum_j w_j f_j/(x - x_j) / sum_j w_j/(x - x_j)
+ * evaluates the interpolant of nodal values in O(N) per point without going
+ * through the coefficients, and is forward stable on Chebyshev grids. The
+ * weights of the Gauss-Lobatto grid of ChebyshevBase are known in closed
+ * form, w_j = (-1)^j delta_j with delta_0 = delta_N = 1/2 and 1 otherwise;
+ * arbitrary node sets get theirs in O(N^2). A ResamplingMatrix stores the
+ * Lagrange basis l_j(y_i) between two grids once, so repeated transfers of
+ * many fields are a (batched) matrix product. For double the point loop
+ * runs AVX2 or AVX-512 kernels selected at runtime, as in simd_eval.hpp,
+ * since the divisions are not vectorised by the compiler on its own.
+ */
+#ifndef _MY_SPECTRE_BARYCENTRIC_HPP
+#define _MY_SPECTRE_BARYCENTRIC_HPP
+
+#include <vector>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+#include "span.hpp"
+#include "parallel.hpp"
+#include "gemm.hpp"
+#include "polybases.hpp"
+
+namespace FunctionalBases {
+
+  namespace Barycentric {
+
+    //! Points per task of the parallel evaluators
+    constexpr std::size_t point_block = 256;
+    //! Points interleaved by the evaluation kernel, as in simd_eval.hpp
+    constexpr std::size_t lanes = 8;
+
+    //! Weights of the N+1 Chebyshev Gauss-Lobatto nodes, up to a common factor
+    template <class T> inline std::vector<T> lobatto_weights(unsigned int N)
+    {
+      std::vector<T> w(N+1);
+      for (unsigned int j=0; j<=N; j++) w[j] = (j%2) ? static_cast<T>(-1) : static_cast<T>(1);
+      w[0] *= static_cast<T>(0.5);
+      w[N] *= static_cast<T>(0.5);
+      return w;
+    }
+
+    /**
+     * @brief Weights 1/prod_{k!=j} (x_j - x_k) of arbitrary distinct nodes, O(N^2).
+     * Differences are scaled by 4/(max-min) so the products neither over- nor
+     * underflow for large N; the common factor cancels in the formula.
+     */
+    template <class T> inline std::vector<T> weights(const std::vector<T>& x)
+    {
+      assert(!x.empty());
+      const auto mm = std::minmax_element(x.begin(),x.end());
+      const T scale = x.size()>1 ? static_cast<T>(4)/(*mm.second-*mm.first) : static_cast<T>(1);
+      std::vector<T> w(x.size(),static_cast<T>(1));
+      for (std::size_t j=0; j<x.size(); j++) {
+        for (std::size_t k=0; k<x.size(); k++)
+          if (k!=j) w[j] *= scale*(x[j]-x[k]);
+        w[j] = static_cast<T>(1)/w[j];
+      }
+      return w;
+    }
+
+#ifdef SPECTRE_X86_SIMD
+    namespace detail {
+      /*
+       * Sums of npts/8 blocks of 8 points over all nodes; lanes whose point
+       * equals a node are flagged in hit (one byte per point) and left to the
+       * caller. Two vectors per block hide the latency of the divisions.
+       */
+      __attribute__((target("avx2,fma")))
+      inline void eval_avx2(const double* x, const double* w, const double* f, std::size_t n,
+                            const double* xq, std::size_t npts, double* out, unsigned char* hit)
+      {
+        for (std::size_t p=0; p+8<=npts; p+=8) {
+          const __m256d q0 = _mm256_loadu_pd(xq+p), q1 = _mm256_loadu_pd(xq+p+4);
+          __m256d num0 = _mm256_setzero_pd(), den0 = _mm256_setzero_pd(), h0 = _mm256_setzero_pd();
+          __m256d num1 = _mm256_setzero_pd(), den1 = _mm256_setzero_pd(), h1 = _mm256_setzero_pd();
+          for (std::size_t j=0; j<n; j++) {
+            const __m256d xj = _mm256_set1_pd(x[j]), wj = _mm256_set1_pd(w[j]), fj = _mm256_set1_pd(f[j]);
+            const __m256d d0 = _mm256_sub_pd(q0,xj), d1 = _mm256_sub_pd(q1,xj);
+            h0 = _mm256_or_pd(h0,_mm256_cmp_pd(d0,_mm256_setzero_pd(),_CMP_EQ_OQ));
+            h1 = _mm256_or_pd(h1,_mm256_cmp_pd(d1,_mm256_setzero_pd(),_CMP_EQ_OQ));
+            const __m256d t0 = _mm256_div_pd(wj,d0), t1 = _mm256_div_pd(wj,d1);
+            num0 = _mm256_fmadd_pd(t0,fj,num0);
+            num1 = _mm256_fmadd_pd(t1,fj,num1);
+            den0 = _mm256_add_pd(den0,t0);
+            den1 = _mm256_add_pd(den1,t1);
+          }
+          _mm256_storeu_pd(out+p,_mm256_div_pd(num0,den0));
+          _mm256_storeu_pd(out+p+4,_mm256_div_pd(num1,den1));
+          const int m = _mm256_movemask_pd(h0) | (_mm256_movemask_pd(h1) << 4);
+          for (int l=0; l<8; l++) hit[p+l] = (m >> l) & 1;
+        }
+      }
+
+      __attribute__((target("avx512f")))
+      inline void eval_avx512(const double* x, const double* w, const double* f, std::size_t n,
+                              const double* xq, std::size_t npts, double* out, unsigned char* hit)
+      {
+        for (std::size_t p=0; p+16<=npts; p+=16) {
+          const __m512d q0 = _mm512_loadu_pd(xq+p), q1 = _mm512_loadu_pd(xq+p+8);
+          __m512d num0 = _mm512_setzero_pd(), den0 = _mm512_setzero_pd();
+          __m512d num1 = _mm512_setzero_pd(), den1 = _mm512_setzero_pd();
+          __mmask8 h0 = 0, h1 = 0;
+          for (std::size_t j=0; j<n; j++) {
+            const __m512d xj = _mm512_set1_pd(x[j]), wj = _mm512_set1_pd(w[j]), fj = _mm512_set1_pd(f[j]);
+            const __m512d d0 = _mm512_sub_pd(q0,xj), d1 = _mm512_sub_pd(q1,xj);
+            h0 |= _mm512_cmp_pd_mask(d0,_mm512_setzero_pd(),_CMP_EQ_OQ);
+            h1 |= _mm512_cmp_pd_mask(d1,_mm512_setzero_pd(),_CMP_EQ_OQ);
+            const __m512d t0 = _mm512_div_pd(wj,d0), t1 = _mm512_div_pd(wj,d1);
+            num0 = _mm512_fmadd_pd(t0,fj,num0);
+            num1 = _mm512_fmadd_pd(t1,fj,num1);
+            den0 = _mm512_add_pd(den0,t0);
+            den1 = _mm512_add_pd(den1,t1);
+          }
+          _mm512_storeu_pd(out+p,_mm512_div_pd(num0,den0));
+          _mm512_storeu_pd(out+p+8,_mm512_div_pd(num1,den1));
+          for (int l=0; l<8; l++) {
+            hit[p+l] = (h0 >> l) & 1;
+            hit[p+8+l] = (h1 >> l) & 1;
+          }
+        }
+      }
+    }
+#endif
+
+  }
+
+  /**
+   * @brief Barycentric evaluator of the polynomial interpolant of nodal values.
+   * Immutable after construction, so one instance can be shared between threads.
+   */
+  template <class T>
+  class BarycentricInterpolator {
+    std::vector<T> x; //! Interpolation nodes
+    std::vector<T> w; //! Barycentric weights
+    /**
+     * @brief Sum w_j v_j/(xq - x_j) and w_j/(xq - x_j) in a branch-free loop.
+     * Returns the index of a node equal to xq, or size() if there is none.
+     */
+    inline std::size_t sums(const T& xq, const T* v, T& num, T& den) const;
+    /**
+     * @brief Interpolant at npts points, Barycentric::lanes points at a time
+     * so the divisions are vectorised across points. Lanes that hit a node
+     * are redone by eval().
+     */
+    inline void eval_block(const T* xq, std::size_t npts, const T* f, T* out) const;
+  public:
+    typedef T value_type;
+    /**
+     * @brief Constructor
+     * @param nodes distinct interpolation nodes
+     * @param weights their barycentric weights, computed by Barycentric::weights() if empty
+     */
+    BarycentricInterpolator(const std::vector<T>& nodes, const std::vector<T>& weights=std::vector<T>()):
+      x(nodes), w(weights.empty() ? Barycentric::weights(nodes) : weights) {
+      assert(w.size()==x.size());
+    }
+    //! Evaluator on the Gauss-Lobatto grid of a Chebyshev basis, closed-form weights
+    explicit BarycentricInterpolator(const ChebyshevBase<T>& basis):
+      x(basis.get_nodes()), w(Barycentric::lobatto_weights<T>(basis.get_N())) {}
+    inline std::size_t size() const { return x.size(); }
+    inline const std::vector<T>& get_nodes() const { return x; }
+    inline const std::vector<T>& get_weights() const { return w; }
+    /**
+     * @brief Value of the interpolant of f at xq, O(N)
+     * @param xq point of evaluation, returns f_j exactly if xq is the node x_j
+     * @param f values at the nodes
+     */
+    inline T eval(const T& xq, Span<const T> f) const {
+      assert(f.size()==x.size());
+      T num, den;
+      const std::size_t j = sums(xq,f.data(),num,den);
+      return j<x.size() ? f[j] : num/den;
+    }
+    /**
+     * @brief Values of the interpolant at many points, blocks of points in parallel
+     * @param xq points of evaluation
+     * @param f values at the nodes
+     * @param out one value per point
+     * @param nthreads maximum number of threads
+     */
+    inline void eval(Span<const T> xq, Span<const T> f, Span<T> out, unsigned int nthreads=Parallel::default_threads()) const {
+      assert(f.size()==x.size() && out.size()==xq.size());
+      const std::size_t nblocks = (xq.size()+Barycentric::point_block-1)/Barycentric::point_block;
+      Parallel::parallel_for(nblocks,[&](std::size_t b) {
+        const std::size_t p0 = b*Barycentric::point_block, p1 = std::min(xq.size(),p0+Barycentric::point_block);
+        eval_block(xq.data()+p0,p1-p0,f.data(),out.data()+p0);
+      },nthreads);
+    }
+    /**
+     * @brief Lagrange basis l_j(xq) of all nodes
+     * @param xq point of evaluation, a node gives a unit row
+     * @param row size() values
+     */
+    inline void lagrange_row(const T& xq, Span<T> row) const;
+  };
+
+  template <class T> inline std::size_t BarycentricInterpolator<T>::sums(const T& xq, const T* v, T& num, T& den) const
+  {
+    const std::size_t n = x.size();
+    num = den = static_cast<T>(0);
+    bool hit = false;
+    for (std::size_t j=0; j<n; j++) {
+      const T d = xq-x[j];
+      hit |= (d==static_cast<T>(0));
+      const T t = w[j]/d;
+      num += t*v[j];
+      den += t;
+    }
+    if (!hit) return n;
+    return std::find(x.begin(),x.end(),xq)-x.begin();
+  }
+
+  template <class T> inline void BarycentricInterpolator<T>::eval_block(const T* xq, std::size_t npts, const T* f, T* out) const
+  {
+    constexpr std::size_t L = Barycentric::lanes;
+    const std::size_t n = x.size();
+    std::size_t p = 0;
+#ifdef SPECTRE_X86_SIMD
+    if constexpr (std::is_same<T,double>::value) {
+      const Chebyshev::SimdLevel level = Chebyshev::detected_simd_level();
+      const std::size_t width = level==Chebyshev::SimdLevel::AVX512 ? 16 : level==Chebyshev::SimdLevel::AVX2 ? 8 : 0;
+      if (width) {
+        unsigned char hit[Barycentric::point_block];
+        for (std::size_t p0=0; p0<npts; p0+=Barycentric::point_block) {
+          const std::size_t np = std::min(npts-p0,Barycentric::point_block)/width*width;
+          if (level==Chebyshev::SimdLevel::AVX512) Barycentric::detail::eval_avx512(x.data(),w.data(),f,n,xq+p0,np,out+p0,hit);
+          else Barycentric::detail::eval_avx2(x.data(),w.data(),f,n,xq+p0,np,out+p0,hit);
+          for (std::size_t l=0; l<np; l++)
+            if (hit[l]) out[p0+l] = eval(xq[p0+l],Span<const T>(f,n));
+          p = p0+np;
+          if (np<Barycentric::point_block) break;
+        }
+      }
+    }
+#endif
+    for (; p+L<=npts; p+=L) {
+      T num[L], den[L];
+      bool hit[L];
+      for (std::size_t l=0; l<L; l++) {
+        num[l] = den[l] = static_cast<T>(0);
+        hit[l] = false;
+      }
+      for (std::size_t j=0; j<n; j++) {
+        for (std::size_t l=0; l<L; l++) {
+          const T d = xq[p+l]-x[j];
+          hit[l] |= (d==static_cast<T>(0));
+          const T t = w[j]/d;
+          num[l] += t*f[j];
+          den[l] += t;
+        }
+      }
+      for (std::size_t l=0; l<L; l++) out[p+l] = hit[l] ? eval(xq[p+l],Span<const T>(f,n)) : num[l]/den[l];
+    }
+    for (; p<npts; p++) out[p] = eval(xq[p],Span<const T>(f,n));
+  }
+
+  template <class T> inline void BarycentricInterpolator<T>::lagrange_row(const T& xq, Span<T> row) const
+  {
+    assert(row.size()==x.size());
+    const std::size_t n = x.size();
+    const std::size_t j = std::find(x.begin(),x.end(),xq)-x.begin();
+    if (j<n) {
+      std::fill(row.begin(),row.end(),static_cast<T>(0));
+      row[j] = static_cast<T>(1);
+      return;
+    }
+    T den = static_cast<T>(0);
+    for (std::size_t k=0; k<n; k++) {
+      row[k] = w[k]/(xq-x[k]);
+      den += row[k];
+    }
+    const T inv = static_cast<T>(1)/den;
+    for (std::size_t k=0; k<n; k++) row[k] *= inv;
+  }
+
+  /**
+   * @brief Precomputed interpolation from one grid to another, R_ij = l_j(y_i).
+   * Applying it is a matrix-vector product, batches of fields go through
+   * GEMM. Built in O(N_in N_out); immutable afterwards.
+   */
+  template <class T>
+  class ResamplingMatrix {
+    std::size_t nin, nout;
+    std::vector<T> R;  //! nout x nin, row-major
+    std::vector<T> RT; //! transpose of R
+  public:
+    typedef T value_type;
+    /**
+     * @brief Constructor
+     * @param from interpolator on the source grid
+     * @param to target points
+     * @param nthreads maximum number of threads for the assembly
+     */
+    ResamplingMatrix(const BarycentricInterpolator<T>& from, Span<const T> to, unsigned int nthreads=Parallel::default_threads()):
+      nin(from.size()), nout(to.size()), R(nin*nout), RT(nin*nout) {
+      Parallel::parallel_for(nout,[&](std::size_t i) {
+        from.lagrange_row(to[i],Span<T>(&R[i*nin],nin));
+        for (std::size_t j=0; j<nin; j++) RT[j*nout+i] = R[i*nin+j];
+      },nthreads);
+    }
+    //! Transfer between the Gauss-Lobatto grids of two Chebyshev bases of any orders
+    ResamplingMatrix(const ChebyshevBase<T>& from, const ChebyshevBase<T>& to):
+      ResamplingMatrix(BarycentricInterpolator<T>(from),Span<const T>(to.get_nodes())) {}
+    inline std::size_t rows() const { return nout; }
+    inline std::size_t cols() const { return nin; }
+    inline T get(std::size_t i, std::size_t j) const { return R[i*nin+j]; }
+    /**
+     * @brief Values on the target grid, out = R in
+     * @param in cols() values on the source grid
+     * @param out rows() values on the target grid, must not alias in
+     */
+    inline void apply(Span<const T> in, Span<T> out) const {
+      assert(in.size()==nin && out.size()==nout);
+      for (std::size_t i=0; i<nout; i++) {
+        const T* r = &R[i*nin];
+        T s = static_cast<T>(0);
+        for (std::size_t j=0; j<nin; j++) s += r[j]*in[j];
+        out[i] = s;
+      }
+    }
+    /**
+     * @brief Resample M fields at once
+     * @param in M*cols() values, field-major (SoA) or node-major (AoS)
+     * @param out M*rows() values in the same layout, must not alias in
+     * @param M number of fields
+     * @param layout memory layout of in and out
+     * @param nthreads maximum number of threads
+     */
+    inline void apply_batch(Span<const T> in, Span<T> out, std::size_t M, BatchLayout layout=BatchLayout::SoA,
+                            unsigned int nthreads=Parallel::default_threads()) const;
+  };
+
+  template <class T> inline void ResamplingMatrix<T>::apply_batch(Span<const T> in, Span<T> out, std::size_t M,
+                                                                  BatchLayout layout, unsigned int nthreads) const
+  {
+    assert(in.size()==M*nin && out.size()==M*nout);
+    const std::size_t block = layout==BatchLayout::SoA ? GEMM::MC : GEMM::NC/2;
+    const std::size_t nblocks = (M+block-1)/block;
+    Parallel::parallel_for(nblocks,[&](std::size_t b) {
+      const std::size_t m0 = b*block, mb = std::min(block,M-m0);
+      if (layout==BatchLayout::SoA)
+        GEMM::gemm<T>(mb,nout,nin,static_cast<T>(1),in.data()+m0*nin,nin,RT.data(),nout,static_cast<T>(0),out.data()+m0*nout,nout);
+      else
+        GEMM::gemm<T>(nout,mb,nin,static_cast<T>(1),R.data(),nin,in.data()+m0,M,static_cast<T>(0),out.data()+m0,M);
+    },nthreads);
+  }
+
+} // namespace FunctionalBases
+
+#endif
@@ -2,50 +2,243 @@
  * @file chebyshev.hpp
  * @brief Somewhat efficient implementation of Chebyshev polynomial evaluation
  * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Single polynomials are evaluated with the iterative three-term recurrence
+ * T_{n+1} = 2x T_n - T_{n-1}, whole tables T_0..T_N in one pass and full
+ * series with Clenshaw's backward summation. Everything is O(N) per point.
+ * Derivatives, antiderivatives and integrals of a series are O(N) recurrences
+ * on its coefficients, no operator matrix involved.
  */
 #ifndef _MY_CHEBYSHEV_HPP
 #define _MY_CHEBYSHEV_HPP
 
 
 #include <cmath>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
 
 namespace Chebyshev {
 
+  //! pi, rounded once to C; M_PI is a double and would cap long double at double accuracy
+  template <class C> constexpr C pi = static_cast<C>(3.141592653589793238462643383279502884L);
 
-  /*
-  template <unsigned int N> inline auto Tn(const double& x)
+  /**
+   * @brief cos(pi k/N) to the precision of C.
+   * k is reduced mod 2N and the cosine taken as sin(pi (N-2k)/(2N)) in long
+   * double, so the result is exactly antisymmetric about k = N/2 and no
+   * accuracy is lost for large k.
+   */
+  template <class C> inline C cos_pi_ratio(std::size_t k, std::size_t N)
   {
-    return ( (2*x*Tn<N-1>(x)) - Tn<N-2>(x)  );
+    k %= 2*N;
+    if (k > N) k = 2*N-k;
+    const long double arg = pi<long double>*(static_cast<long double>(N)-2.0L*static_cast<long double>(k))/(2.0L*N);
+    return static_cast<C>(std::sin(arg));
   }
 
-  template <> inline auto Tn<0>(const double& x)
+  /**
+   * @brief Evaluate T_N(x) with the three-term recurrence.
+   * @param x point of evaluation
+   * @param N order of the polynomial
+   */
+  template <class C> inline C Tn(const C& x, unsigned int N)
   {
-    return 1.0;
+    if (N==0) return static_cast<C>(1);
+    C tkm1 = static_cast<C>(1);
+    C tk = x;
+    const C two_x = static_cast<C>(2)*x;
+    for (unsigned int k=1; k<N; k++){
+      const C tkp1 = two_x*tk - tkm1;
+      tkm1 = tk;
+      tk = tkp1;
+    }
+    return tk;
+  }
+
+  /**
+   * @brief Fill T_0(x)..T_N(x) in a single pass.
+   * @param x point of evaluation
+   * @param N highest order
+   * @param T output array of length N+1
+   */
+  template <class C> inline void Tn_all(const C& x, unsigned int N, C* T)
+  {
+    T[0] = static_cast<C>(1);
+    if (N==0) return;
+    T[1] = x;
+    const C two_x = static_cast<C>(2)*x;
+    for (unsigned int k=2; k<=N; k++) T[k] = two_x*T[k-1] - T[k-2];
+  }
+
+  //! Vector overload of Tn_all, resizes T to N+1
+  template <class C> inline void Tn_all(const C& x, unsigned int N, std::vector<C>& T)
+  {
+    T.resize(N+1);
+    Tn_all(x,N,T.data());
+  }
+
+  /**
+   * @brief Clenshaw summation of sum_{n<ncoeffs} a_n T_n(x).
+   * @param x point of evaluation
+   * @param a coefficients
+   * @param ncoeffs number of coefficients
+   */
+  template <class C> inline C clenshaw(const C& x, const C* a, std::size_t ncoeffs)
+  {
+    if (ncoeffs==0) return static_cast<C>(0);
+    const C two_x = static_cast<C>(2)*x;
+    C b1 = static_cast<C>(0);
+    C b2 = static_cast<C>(0);
+    for (std::size_t n=ncoeffs-1; n>0; n--){
+      const C b0 = a[n] + two_x*b1 - b2;
+      b2 = b1;
+      b1 = b0;
+    }
+    return a[0] + x*b1 - b2;
+  }
+
+  //! Vector overload of clenshaw
+  template <class C> inline C clenshaw(const C& x, const std::vector<C>& a)
+  {
+    return clenshaw(x,a.data(),a.size());
+  }
+
+
+  //! Series handled together by the strided coefficient kernels below
+  constexpr std::size_t coeff_lanes = 32;
+
+  /**
+   * @brief Coefficients of d/dx sum_k a_k T_k for `lanes` series at once.
+   * Backward recurrence b_{k-1} = b_{k+1} + 2k a_k, then b_0 /= 2; O(n) per series.
+   * Coefficient k of series l is at a[k*ld+l], b may alias a.
+   * @param a n coefficients per series
+   * @param b output, n coefficients per series, the last one is zero
+   * @param n number of coefficients
+   * @param lanes number of series
+   * @param ld distance between consecutive coefficients of a series
+   */
+  template <class C> inline void derivative_coeffs(const C* a, C* b, std::size_t n, std::size_t lanes, std::size_t ld)
+  {
+    if (n==0) return;
+    for (std::size_t l0=0; l0<lanes; l0+=coeff_lanes) {
+      const std::size_t nl = std::min(coeff_lanes,lanes-l0);
+      C ak[coeff_lanes], bk[coeff_lanes], bk1[coeff_lanes];
+      for (std::size_t l=0; l<nl; l++) {
+        ak[l] = a[(n-1)*ld+l0+l];
+        bk[l] = bk1[l] = static_cast<C>(0);
+        b[(n-1)*ld+l0+l] = static_cast<C>(0);
+      }
+      for (std::size_t k=n-1; k>0; k--) {
+        const C two_k = static_cast<C>(2*k);
+        for (std::size_t l=0; l<nl; l++) {
+          const C akm1 = a[(k-1)*ld+l0+l];
+          const C bkm1 = bk1[l] + two_k*ak[l];
+          b[(k-1)*ld+l0+l] = bkm1;
+          bk1[l] = bk[l];
+          bk[l] = bkm1;
+          ak[l] = akm1;
+        }
+      }
+      for (std::size_t l=0; l<nl; l++) b[l0+l] *= static_cast<C>(0.5);
+    }
   }
 
-  template <> inline auto Tn<1>(const double& x)
+  //! Derivative coefficients of a single series, b may alias a
+  template <class C> inline void derivative_coeffs(const C* a, C* b, std::size_t n)
   {
-    return x; 
+    derivative_coeffs(a,b,n,1,1);
   }
-  */
 
-  template <class C> inline auto Tn(const C& x, unsigned int N)
+  /**
+   * @brief Coefficients of the antiderivative vanishing at x = -1, for `lanes` series at once.
+   * c_1 = a_0 - a_2/2, c_k = (a_{k-1} - a_{k+1})/(2k), truncated to n terms:
+   * the dropped term is a_{n-1}/(2n) T_n. Layout as in derivative_coeffs, c may alias a.
+   * @param a n coefficients per series
+   * @param c output, n coefficients per series
+   * @param n number of coefficients
+   * @param lanes number of series
+   * @param ld distance between consecutive coefficients of a series
+   */
+  template <class C> inline void antiderivative_coeffs(const C* a, C* c, std::size_t n, std::size_t lanes, std::size_t ld)
   {
-    switch(N){
-    case 0: {
-      return static_cast<C>(1);
-    };
-    case 1: {
-      return x;
-    };
-    default:
-    {
-    return ( static_cast<C>(2)*x*Tn(x,N-1) - Tn(x,N-2) ) ;
-    };
+    if (n==0) return;
+    for (std::size_t l0=0; l0<lanes; l0+=coeff_lanes) {
+      const std::size_t nl = std::min(coeff_lanes,lanes-l0);
+      C prev[coeff_lanes], cur[coeff_lanes], sum[coeff_lanes];
+      for (std::size_t l=0; l<nl; l++) {
+        prev[l] = static_cast<C>(2)*a[l0+l];
+        cur[l] = n > 1 ? a[ld+l0+l] : static_cast<C>(0);
+        sum[l] = static_cast<C>(0);
+      }
+      C sign = static_cast<C>(-1);
+      for (std::size_t k=1; k<n; k++) {
+        const C inv_2k = static_cast<C>(1)/static_cast<C>(2*k);
+        for (std::size_t l=0; l<nl; l++) {
+          const C next = k+1<n ? a[(k+1)*ld+l0+l] : static_cast<C>(0);
+          const C ck = (prev[l] - next)*inv_2k;
+          c[k*ld+l0+l] = ck;
+          sum[l] += sign*ck;
+          prev[l] = cur[l];
+          cur[l] = next;
+        }
+        sign = -sign;
+      }
+      for (std::size_t l=0; l<nl; l++) c[l0+l] = -sum[l];
     }
   }
 
+  //! Antiderivative coefficients of a single series, c may alias a
+  template <class C> inline void antiderivative_coeffs(const C* a, C* c, std::size_t n)
+  {
+    antiderivative_coeffs(a,c,n,1,1);
+  }
+
+  /**
+   * @brief Clenshaw-Curtis integral over [-1,1] of `lanes` series at once,
+   * sum over even k of 2 a_k/(1-k^2). Layout as in derivative_coeffs.
+   * @param a n coefficients per series
+   * @param n number of coefficients
+   * @param lanes number of series
+   * @param ld distance between consecutive coefficients of a series
+   * @param out lanes integrals
+   */
+  template <class C> inline void integral(const C* a, std::size_t n, std::size_t lanes, std::size_t ld, C* out)
+  {
+    for (std::size_t l=0; l<lanes; l++) out[l] = static_cast<C>(0);
+    for (std::size_t k=0; k<n; k+=2) {
+      const C wk = static_cast<C>(2)/static_cast<C>(1-static_cast<long>(k*k));
+      for (std::size_t l=0; l<lanes; l++) out[l] += wk*a[k*ld+l];
+    }
+  }
+
+  //! Clenshaw-Curtis integral over [-1,1] of a single series
+  template <class C> inline C integral(const C* a, std::size_t n)
+  {
+    C out;
+    integral(a,n,1,1,&out);
+    return out;
+  }
+
+
+  /**
+   * @brief Coefficients of the product of two series truncated to n terms,
+   * by direct convolution with T_i T_j = (T_{i+j} + T_{|i-j|})/2; O(n^2).
+   * @param a n coefficients
+   * @param b n coefficients
+   * @param n number of coefficients
+   * @param c output, n coefficients, must not alias a or b
+   */
+  template <class C> inline void product_coeffs(const C* a, const C* b, std::size_t n, C* c)
+  {
+    for (std::size_t k=0; k<n; k++) c[k] = static_cast<C>(0);
+    for (std::size_t i=0; i<n; i++) {
+      const C ai = static_cast<C>(0.5)*a[i];
+      for (std::size_t j=0; j<n-i; j++) c[i+j] += ai*b[j];
+      for (std::size_t j=0; j<=i; j++) c[i-j] += ai*b[j];
+      for (std::size_t j=i+1; j<n; j++) c[j-i] += ai*b[j];
+    }
+  }
 
 }
 
-#endif 
\ No newline at end of file
+#endif
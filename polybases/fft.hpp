@@ -0,0 +1,389 @@
+/**
+ * @file fft.hpp
+ * @brief Self-contained FFT and DCT-I plans used by the fast spectral transforms.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Complex FFT of arbitrary length (iterative radix-2 for powers of two,
+ * Stockham autosort mixed radix 2/3/4/5/7 for other lengths with only
+ * those prime factors, Bluestein's chirp-z algorithm otherwise), a real FFT
+ * of half the complex length and a type-I discrete cosine transform built on
+ * top of them. Plans precompute twiddles and are immutable once constructed,
+ * so a single plan can be shared between threads; scratch space is kept in
+ * thread-local buffers.
+ */
+#ifndef _MY_SPECTRE_FFT_HPP
+#define _MY_SPECTRE_FFT_HPP
+
+#include <cmath>
+#include <complex>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <assert.h>
+
+namespace FFT {
+
+  namespace detail {
+    /**
+     * @brief Thread-local scratch buffer, grown on demand and never shrunk.
+     * @param slot index of the buffer, different callers on the same thread use different slots
+     * @param n minimum size of the buffer
+     */
+    template <class C> inline C* workspace(const unsigned int slot, const std::size_t n)
+    {
+      static thread_local std::vector<C> buffers[4];
+      assert(slot<4);
+      if(buffers[slot].size() < n) buffers[slot].resize(n);
+      return buffers[slot].data();
+    }
+
+    inline bool is_pow2(const std::size_t n) { return n && !(n & (n-1)); }
+
+    inline std::size_t next_pow2(const std::size_t n)
+    {
+      std::size_t m = 1;
+      while(m < n) m <<= 1;
+      return m;
+    }
+
+    //! exp(-2 pi i k / n), evaluated in long double to keep float/double twiddles exact to rounding
+    template <class T> inline std::complex<T> unit_root(const long double k, const long double n)
+    {
+      const long double pi = 3.141592653589793238462643383279502884L;
+      const long double arg = -2.0L * pi * k / n;
+      return std::complex<T>(static_cast<T>(std::cos(arg)), static_cast<T>(std::sin(arg)));
+    }
+
+    /**
+     * @brief Radices of a Stockham factorisation of n, fours first.
+     * @return false if n has a prime factor above 7
+     */
+    inline bool smooth_factors(std::size_t n, std::vector<unsigned int>& radices)
+    {
+      radices.clear();
+      while(n%4==0){ radices.push_back(4); n /= 4; }
+      for(unsigned int r: {2u,3u,5u,7u})
+        while(n%r==0){ radices.push_back(r); n /= r; }
+      return n==1;
+    }
+  }
+
+  /**
+   * @brief Plan for a complex FFT of fixed length n.
+   * Forward transform is X_k = sum_j x_j exp(-2 pi i jk/n), the inverse is
+   * unnormalised (no 1/n factor).
+   */
+  template <class T>
+  class ComplexPlan {
+    //! One pass of the Stockham transform: radix r on sub-transforms of length len = r*m, stride s
+    struct Stage {
+      unsigned int r;
+      std::size_t m, s;
+      std::vector<std::complex<T>> twiddles; //! exp(-2 pi i pk/len) at p*r+k
+      std::vector<std::complex<T>> roots;    //! exp(-2 pi i k/r)
+    };
+    std::size_t n;                           //! transform length
+    std::size_t m;                           //! length of the radix-2 kernel (n, or padded length for Bluestein; 0 for Stockham)
+    std::vector<std::complex<T>> twiddles;   //! radix-2 twiddles for length m
+    std::vector<std::size_t> bitrev;         //! bit reversal permutation for length m
+    std::vector<Stage> stages;               //! Stockham passes, for n with prime factors up to 7 only
+    std::vector<std::complex<T>> chirp;      //! Bluestein chirp exp(-i pi j^2/n)
+    std::vector<std::complex<T>> chirp_hat;  //! FFT of the conjugate chirp, zero padded to m
+    /**
+     * @brief In-place radix-2 transform of length m.
+     * @param x data
+     * @param inverse conjugate twiddles
+     */
+    inline void radix2(std::complex<T>* x, const bool inverse) const;
+    //! In-place self-sorting mixed-radix transform, ping-pongs with a thread-local buffer
+    inline void stockham(std::complex<T>* x, const bool inverse) const;
+    inline void bluestein(std::complex<T>* x, const bool inverse) const;
+  public:
+    /**
+     * @brief Constructor
+     * @param n length of the transform
+     */
+    ComplexPlan<T>(const std::size_t n=1);
+    //! In-place forward transform
+    inline void forward(std::complex<T>* x) const {
+      if(m==n) radix2(x,false); else if(m==0) stockham(x,false); else bluestein(x,false);
+    }
+    //! In-place unnormalised inverse transform
+    inline void inverse(std::complex<T>* x) const {
+      if(m==n) radix2(x,true); else if(m==0) stockham(x,true); else bluestein(x,true);
+    }
+    inline std::size_t size() const { return n; }
+  };
+
+  template <class T> ComplexPlan<T>::ComplexPlan(const std::size_t n) : n(n)
+  {
+    assert(n>0);
+    std::vector<unsigned int> radices;
+    if(!detail::is_pow2(n) && detail::smooth_factors(n,radices)){
+      m = 0;
+      std::size_t len = n, s = 1;
+      for(unsigned int r: radices){
+        Stage st;
+        st.r = r;
+        st.m = len/r;
+        st.s = s;
+        st.twiddles.resize(len);
+        for(std::size_t p=0; p<st.m; p++)
+          for(unsigned int k=0; k<r; k++) st.twiddles[p*r+k] = detail::unit_root<T>(static_cast<long double>((p*k) % len), len);
+        st.roots.resize(r);
+        for(unsigned int k=0; k<r; k++) st.roots[k] = detail::unit_root<T>(k,r);
+        stages.push_back(st);
+        len /= r;
+        s *= r;
+      }
+      return;
+    }
+    m = detail::is_pow2(n) ? n : detail::next_pow2(2*n-1);
+    twiddles.resize(m/2);
+    for(std::size_t k=0; k<m/2; k++) twiddles[k] = detail::unit_root<T>(k,m);
+    bitrev.resize(m);
+    unsigned int logm = 0;
+    while((std::size_t(1) << logm) < m) logm++;
+    for(std::size_t i=0; i<m; i++){
+      std::size_t r = 0;
+      for(unsigned int b=0; b<logm; b++) if(i & (std::size_t(1) << b)) r |= std::size_t(1) << (logm-1-b);
+      bitrev[i] = r;
+    }
+    if(m!=n){
+      // j^2 mod 2n keeps the chirp argument small for large n
+      chirp.resize(n);
+      for(std::size_t j=0; j<n; j++) chirp[j] = detail::unit_root<T>( static_cast<long double>((j*j) % (2*n)), 2.0L*n );
+      chirp_hat.assign(m, std::complex<T>(0));
+      chirp_hat[0] = std::conj(chirp[0]);
+      for(std::size_t j=1; j<n; j++) chirp_hat[j] = chirp_hat[m-j] = std::conj(chirp[j]);
+      radix2(chirp_hat.data(),false);
+    }
+  }
+
+  template <class T> inline void ComplexPlan<T>::radix2(std::complex<T>* x, const bool inverse) const
+  {
+    for(std::size_t i=0; i<m; i++) if(i < bitrev[i]) std::swap(x[i],x[bitrev[i]]);
+    for(std::size_t len=2; len<=m; len<<=1){
+      const std::size_t half = len/2;
+      const std::size_t stride = m/len;
+      for(std::size_t start=0; start<m; start+=len){
+        for(std::size_t k=0; k<half; k++){
+          std::complex<T> w = twiddles[k*stride];
+          if(inverse) w = std::conj(w);
+          const std::complex<T> u = x[start+k];
+          const std::complex<T> v = x[start+k+half] * w;
+          x[start+k] = u + v;
+          x[start+k+half] = u - v;
+        }
+      }
+    }
+  }
+
+  template <class T> inline void ComplexPlan<T>::stockham(std::complex<T>* x, const bool inverse) const
+  {
+    std::complex<T>* buf = detail::workspace<std::complex<T>>(2,n);
+    std::complex<T>* in = x;
+    std::complex<T>* out = buf;
+    const T half = static_cast<T>(0.5);
+    const T sin60 = static_cast<T>(0.866025403784438646763723170752936183L);
+    // multiplication by -i (forward) or +i (inverse)
+    auto rot = [inverse](const std::complex<T>& z) {
+      return inverse ? std::complex<T>(-z.imag(),z.real()) : std::complex<T>(z.imag(),-z.real());
+    };
+    std::complex<T> a[7], b[7];
+    for(const Stage& st: stages){
+      const std::size_t sm = st.s*st.m;
+      for(std::size_t p=0; p<st.m; p++){
+        const std::complex<T>* w = &st.twiddles[p*st.r];
+        for(std::size_t q=0; q<st.s; q++){
+          const std::complex<T>* src = in + q + st.s*p;
+          for(unsigned int j=0; j<st.r; j++) a[j] = src[j*sm];
+          switch(st.r){
+          case 2:
+            b[0] = a[0]+a[1];
+            b[1] = a[0]-a[1];
+            break;
+          case 3: {
+            const std::complex<T> t = a[1]+a[2], u = a[0]-half*t, v = sin60*rot(a[1]-a[2]);
+            b[0] = a[0]+t;
+            b[1] = u+v;
+            b[2] = u-v;
+            break;
+          }
+          case 4: {
+            const std::complex<T> t0 = a[0]+a[2], t1 = a[0]-a[2], t2 = a[1]+a[3], t3 = rot(a[1]-a[3]);
+            b[0] = t0+t2;
+            b[1] = t1+t3;
+            b[2] = t0-t2;
+            b[3] = t1-t3;
+            break;
+          }
+          default:
+            for(unsigned int k=0; k<st.r; k++){
+              b[k] = a[0];
+              for(unsigned int j=1; j<st.r; j++){
+                const std::complex<T>& z = st.roots[(j*k) % st.r];
+                b[k] += a[j] * (inverse ? std::conj(z) : z);
+              }
+            }
+          }
+          std::complex<T>* dst = out + q + st.s*st.r*p;
+          dst[0] = b[0];
+          for(unsigned int k=1; k<st.r; k++) dst[k*st.s] = b[k] * (inverse ? std::conj(w[k]) : w[k]);
+        }
+      }
+      std::swap(in,out);
+    }
+    if(in!=x) std::copy(in,in+n,x);
+  }
+
+  template <class T> inline void ComplexPlan<T>::bluestein(std::complex<T>* x, const bool inverse) const
+  {
+    std::complex<T>* a = detail::workspace<std::complex<T>>(0,m);
+    for(std::size_t j=0; j<n; j++) a[j] = x[j] * (inverse ? std::conj(chirp[j]) : chirp[j]);
+    for(std::size_t j=n; j<m; j++) a[j] = std::complex<T>(0);
+    radix2(a,false);
+    for(std::size_t j=0; j<m; j++) a[j] *= (inverse ? std::conj(chirp_hat[(m-j)%m]) : chirp_hat[j]);
+    radix2(a,true);
+    const T scale = static_cast<T>(1) / static_cast<T>(m);
+    for(std::size_t k=0; k<n; k++) x[k] = a[k] * scale * (inverse ? std::conj(chirp[k]) : chirp[k]);
+  }
+
+  /**
+   * @brief Plan for the FFT of n real values.
+   * Spectra are packed into n reals in the FFTPACK order
+   *   Re X_0, Re X_1, Im X_1, Re X_2, Im X_2, ..., [Re X_{n/2} if n even],
+   * the remaining X_k follow from X_{n-k} = conj(X_k). For even n the values
+   * are paired into n/2 complex numbers, transformed by a complex FFT of
+   * length n/2 and separated with the cached twiddles exp(-2 pi i k/n); odd
+   * n goes through a complex FFT of length n.
+   */
+  template <class T>
+  class RealPlan {
+    std::size_t n;                           //! transform length
+    ComplexPlan<T> fft;                      //! length n/2 for even n, n otherwise
+    std::vector<std::complex<T>> twiddles;   //! exp(-2 pi i k/n), k <= n/2
+  public:
+    /**
+     * @brief Constructor
+     * @param n number of real values
+     */
+    RealPlan<T>(const std::size_t n=2) : n(n), fft(n%2 ? n : n/2) {
+      assert(n>0);
+      if(n%2==0){
+        twiddles.resize(n/2+1);
+        for(std::size_t k=0; k<=n/2; k++) twiddles[k] = detail::unit_root<T>(k,n);
+      }
+    }
+    /**
+     * @brief Forward transform, in and out may alias.
+     * @param in n real values
+     * @param out n reals, the packed spectrum
+     */
+    inline void forward(const T* in, T* out) const;
+    /**
+     * @brief Unnormalised inverse of forward (n times the values), in and out may alias.
+     * @param in n reals, a packed spectrum
+     * @param out n real values
+     */
+    inline void inverse(const T* in, T* out) const;
+    inline std::size_t size() const { return n; }
+  };
+
+  template <class T> inline void RealPlan<T>::forward(const T* in, T* out) const
+  {
+    if(n%2){
+      std::complex<T>* z = detail::workspace<std::complex<T>>(3,n);
+      for(std::size_t j=0; j<n; j++) z[j] = std::complex<T>(in[j]);
+      fft.forward(z);
+      out[0] = z[0].real();
+      for(std::size_t k=1; 2*k<n; k++){
+        out[2*k-1] = z[k].real();
+        out[2*k] = z[k].imag();
+      }
+      return;
+    }
+    const std::size_t h = n/2;
+    std::complex<T>* z = detail::workspace<std::complex<T>>(3,h);
+    for(std::size_t j=0; j<h; j++) z[j] = std::complex<T>(in[2*j],in[2*j+1]);
+    fft.forward(z);
+    // X_k = E_k + w^k O_k with E = (Z_k + conj Z_{h-k})/2 and O = (Z_k - conj Z_{h-k})/(2i)
+    const T half = static_cast<T>(0.5);
+    out[0] = z[0].real()+z[0].imag();
+    out[n-1] = z[0].real()-z[0].imag();
+    for(std::size_t k=1; 2*k<n; k++){
+      const std::complex<T> zk = z[k], zc = std::conj(z[h-k]);
+      const std::complex<T> e = half*(zk+zc), o = half*(zk-zc);
+      const std::complex<T> X = e + twiddles[k]*std::complex<T>(o.imag(),-o.real());
+      out[2*k-1] = X.real();
+      out[2*k] = X.imag();
+    }
+  }
+
+  template <class T> inline void RealPlan<T>::inverse(const T* in, T* out) const
+  {
+    // X_k for 0 <= k <= n/2 from the packed layout
+    auto X = [&](std::size_t k) {
+      if(k==0) return std::complex<T>(in[0]);
+      if(2*k==n) return std::complex<T>(in[n-1]);
+      return std::complex<T>(in[2*k-1],in[2*k]);
+    };
+    if(n%2){
+      std::complex<T>* z = detail::workspace<std::complex<T>>(3,n);
+      z[0] = X(0);
+      for(std::size_t k=1; 2*k<n; k++){
+        z[k] = X(k);
+        z[n-k] = std::conj(z[k]);
+      }
+      fft.inverse(z);
+      for(std::size_t j=0; j<n; j++) out[j] = z[j].real();
+      return;
+    }
+    const std::size_t h = n/2;
+    std::complex<T>* z = detail::workspace<std::complex<T>>(3,h);
+    // Z_k = 2 E_k + 2i O_k, E and O the spectra of the even and odd samples
+    for(std::size_t k=0; k<h; k++){
+      const std::complex<T> xk = X(k), xc = std::conj(X(h-k));
+      const std::complex<T> o = (xk-xc)*std::conj(twiddles[k]);
+      z[k] = xk + xc + std::complex<T>(-o.imag(),o.real());
+    }
+    fft.inverse(z);
+    for(std::size_t j=0; j<h; j++){
+      out[2*j] = z[j].real();
+      out[2*j+1] = z[j].imag();
+    }
+  }
+
+  /**
+   * @brief Plan for a type-I discrete cosine transform of N+1 points.
+   * Computes y_k = x_0 + (-1)^k x_N + 2 sum_{j=1}^{N-1} x_j cos(pi jk/N)
+   * through a complex FFT of the even extension of x (length 2N).
+   */
+  template <class T>
+  class DCT1Plan {
+    std::size_t N;           //! Order, the transform acts on N+1 points
+    ComplexPlan<T> fft;      //! FFT of length 2N
+  public:
+    /**
+     * @brief Constructor
+     * @param N order, the transform acts on N+1 points
+     */
+    DCT1Plan<T>(const std::size_t N=1) : N(N), fft(2*N) { assert(N>0); };
+    /**
+     * @brief Execute the transform, in and out may alias.
+     * @param in N+1 input values
+     * @param out N+1 output values
+     */
+    inline void execute(const T* in, T* out) const
+    {
+      std::complex<T>* z = detail::workspace<std::complex<T>>(1,2*N);
+      for(std::size_t j=0; j<=N; j++) z[j] = std::complex<T>(in[j]);
+      for(std::size_t j=1; j<N; j++) z[2*N-j] = z[j];
+      fft.forward(z);
+      for(std::size_t k=0; k<=N; k++) out[k] = z[k].real();
+    }
+    inline std::size_t get_N() const { return N; }
+  };
+
+} // namespace FFT
+
+#endif
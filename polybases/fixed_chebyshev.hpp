@@ -0,0 +1,164 @@
+/**
+ * @file fixed_chebyshev.hpp
+ * @brief Compile-time Chebyshev tables and fixed-size kernels.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Gauss-Lobatto nodes, quadrature weights and transform matrices for a
+ * given order N are generated as constexpr std::arrays, and the transform
+ * and Clenshaw kernels have trip counts fixed at compile time. Used by the
+ * Function<T,FixedChebyshevBase<T>,N> specialisation, intended for small
+ * orders (N <= 64).
+ */
+#ifndef _MY_SPECTRE_FIXED_CHEBYSHEV_HPP
+#define _MY_SPECTRE_FIXED_CHEBYSHEV_HPP
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+namespace FunctionalBases {
+
+  /**
+   * @brief Tag selecting the compile-time Chebyshev basis.
+   * Not a FunctionalBase: everything it needs is in ChebyshevTables<T,N>.
+   */
+  template <class T>
+  struct FixedChebyshevBase {
+    typedef T value_type;
+  };
+
+  namespace detail {
+    constexpr long double pi_ld = 3.141592653589793238462643383279502884L;
+
+    /**
+     * @brief cos(pi k/N) as a constant expression.
+     * Reduced to an angle in [0,pi/2] and summed as a Taylor series, which
+     * converges to long double precision in a few terms there.
+     */
+    constexpr long double cos_pi_frac(std::size_t k, const std::size_t N)
+    {
+      k %= 2*N;
+      if (k > N) k = 2*N - k;
+      long double sign = 1.0L;
+      if (2*k == N) return 0.0L;
+      if (2*k > N) {
+        k = N - k;
+        sign = -1.0L;
+      }
+      const long double theta = pi_ld * static_cast<long double>(k) / static_cast<long double>(N);
+      long double term = 1.0L, sum = 1.0L;
+      for (int n=1; n<20; n++) {
+        term *= -theta*theta / static_cast<long double>((2*n-1)*(2*n));
+        sum += term;
+      }
+      return sign*sum;
+    }
+  }
+
+  /**
+   * @brief Compile-time Gauss-Lobatto tables for order N.
+   * fwd maps values to coefficients (ft = fwd f), inv maps coefficients
+   * back to values (f = inv ft); both are stored row-major.
+   */
+  template <class T, unsigned int N>
+  struct ChebyshevTables {
+    static_assert(N>0, "ChebyshevTables needs N > 0");
+    static constexpr std::size_t M = N+1;
+
+    static constexpr std::array<T,M> make_nodes() {
+      std::array<T,M> x{};
+      for (std::size_t i=0; i<M; i++) x[i] = static_cast<T>(detail::cos_pi_frac(i,N));
+      return x;
+    }
+    static constexpr std::array<T,M> make_weights() {
+      std::array<T,M> w{};
+      for (std::size_t i=0; i<M; i++) w[i] = static_cast<T>(detail::pi_ld / ((i==0 || i==N) ? 2*N : N));
+      return w;
+    }
+    //! inv[i][n] = T_n(x_i) = cos(pi n i/N)
+    static constexpr std::array<T,M*M> make_inv() {
+      std::array<T,M*M> P{};
+      for (std::size_t i=0; i<M; i++)
+        for (std::size_t n=0; n<M; n++) P[i*M+n] = static_cast<T>(detail::cos_pi_frac(n*i,N));
+      return P;
+    }
+    //! fwd[n][i] = 2/(N c_n c_i) cos(pi n i/N), c_0 = c_N = 2, c = 1 otherwise
+    static constexpr std::array<T,M*M> make_fwd() {
+      std::array<T,M*M> F{};
+      for (std::size_t n=0; n<M; n++)
+        for (std::size_t i=0; i<M; i++) {
+          long double c = ((n==0 || n==N) ? 2.0L : 1.0L) * ((i==0 || i==N) ? 2.0L : 1.0L);
+          F[n*M+i] = static_cast<T>(2.0L / (N*c) * detail::cos_pi_frac(n*i,N));
+        }
+      return F;
+    }
+
+    static constexpr std::array<T,M> nodes = make_nodes();
+    static constexpr std::array<T,M> weights = make_weights();
+    static constexpr std::array<T,M*M> inv = make_inv();
+    static constexpr std::array<T,M*M> fwd = make_fwd();
+  };
+
+  namespace detail {
+    template <class T, std::size_t M, std::size_t... I>
+    inline T clenshaw_unrolled(const T& x, const T* a, std::index_sequence<I...>)
+    {
+      const T two_x = static_cast<T>(2)*x;
+      T b0 = static_cast<T>(0), b1 = static_cast<T>(0), b2 = static_cast<T>(0);
+      ((b0 = a[M-1-I] + two_x*b1 - b2, b2 = b1, b1 = b0), ...);
+      return a[0] + x*b1 - b2;
+    }
+  }
+
+  /**
+   * @brief Fully unrolled Clenshaw summation of a fixed-length series.
+   * @param x point of evaluation
+   * @param a M coefficients
+   */
+  template <class T, std::size_t M> inline T clenshaw_fixed(const T& x, const std::array<T,M>& a)
+  {
+    return detail::clenshaw_unrolled<T,M>(x,a.data(),std::make_index_sequence<M-1>{});
+  }
+
+  /**
+   * @brief Fixed-size forward transform, values to coefficients.
+   * Pairs x_i with x_{N-i} = -x_i, since T_n is even/odd for even/odd n
+   * this halves the multiply count of the dense product.
+   */
+  template <class T, unsigned int N> inline void fixed_spectral_coeffs(const std::array<T,N+1>& f, std::array<T,N+1>& ft)
+  {
+    typedef ChebyshevTables<T,N> tab;
+    constexpr std::size_t M = N+1, H = (N+1)/2;
+    std::array<T,H> s{}, d{};
+    for (std::size_t i=0; i<H; i++) {
+      s[i] = f[i] + f[N-i];
+      d[i] = f[i] - f[N-i];
+    }
+    for (std::size_t n=0; n<M; n++) {
+      const T* row = &tab::fwd[n*M];
+      const std::array<T,H>& sd = (n%2) ? d : s;
+      T acc = (N%2==0 && n%2==0) ? row[N/2]*f[N/2] : static_cast<T>(0);
+      for (std::size_t i=0; i<H; i++) acc += row[i]*sd[i];
+      ft[n] = acc;
+    }
+  }
+
+  /**
+   * @brief Fixed-size inverse transform, coefficients to values.
+   */
+  template <class T, unsigned int N> inline void fixed_function_values(const std::array<T,N+1>& ft, std::array<T,N+1>& f)
+  {
+    typedef ChebyshevTables<T,N> tab;
+    constexpr std::size_t M = N+1;
+    for (std::size_t i=0; i<=N/2; i++) {
+      const T* row = &tab::inv[i*M];
+      T even = static_cast<T>(0), odd = static_cast<T>(0);
+      for (std::size_t n=0; n<M; n+=2) even += row[n]*ft[n];
+      for (std::size_t n=1; n<M; n+=2) odd += row[n]*ft[n];
+      f[i] = even + odd;
+      f[N-i] = even - odd;
+    }
+  }
+
+} // namespace FunctionalBases
+
+#endif
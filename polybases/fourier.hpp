@@ -0,0 +1,322 @@
+/**
+ * @file fourier.hpp
+ * @brief Fourier basis for periodic functions, transforms by the real FFT.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * FourierBase<T>(N) represents functions of period L (2 pi by default) by
+ * their trigonometric interpolant on the M = N+1 equispaced nodes
+ * x_j = j L/M, j = 0..N:
+ *   f(x) = a_0 + sum_{0<k<M/2} (a_k cos(k w x) + b_k sin(k w x)) [+ a_{M/2} cos(M w x/2)],
+ * with w = 2 pi/L and the last term only for even M. The coefficients are
+ * real and stored as
+ *   a_0, a_1, b_1, a_2, b_2, ..., [a_{M/2}],
+ * so num_coeffs() = M and index 2k-1 holds the cosine, 2k the sine
+ * coefficient of wavenumber k. Transforms are one FFT::RealPlan of length M
+ * and a scaling, O(M log M) for every M (mixed radix for M with prime
+ * factors up to 7, Bluestein otherwise). Differentiation is diagonal in
+ * the wavenumber: in this real layout it couples only a_k and b_k, so the
+ * first derivative is block diagonal with 2x2 blocks (tridiagonal storage)
+ * and the second derivative is diagonal. These operators have no boundary
+ * rows to replace, so ODE::ODESolver and the IMEX integrators, which lower
+ * Chebyshev operators only, reject them.
+ */
+#ifndef _MY_SPECTRE_FOURIER_HPP
+#define _MY_SPECTRE_FOURIER_HPP
+
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <assert.h>
+#include "polybases.hpp"
+#include "chebyshev.hpp"
+#include "fft.hpp"
+#include "parallel.hpp"
+#include "span.hpp"
+
+namespace FunctionalBases {
+
+  /**
+   * @brief Fourier basis on [0,L) with M = N+1 equispaced nodes.
+   * @tparam T scalar type
+   */
+  template <class T>
+  class FourierBase final : public FunctionalBase<T> {
+    unsigned int N;          //! number of nodes minus one
+    T L;                     //! period
+    T omega;                 //! fundamental wavenumber 2 pi/L
+    FFT::RealPlan<T> plan;   //! real FFT of length N+1
+    std::vector<T> nodes;    //! j L/(N+1)
+    std::vector<T> weights;  //! trapezoidal rule, L/(N+1) each
+    mutable std::shared_ptr<const FourierBase<T>> padded; //! grid of multiply_coeffs, built on first use
+    //! Points evaluated per task by evaluate_series_batch
+    static constexpr std::size_t eval_chunk = 2048;
+  public:
+    typedef T value_type;
+    // constructors ----------------------
+    /**
+     * @brief Constructor
+     * @param N order, the basis has N+1 nodes and coefficients
+     * @param period period L of the functions, the nodes cover [0,L)
+     */
+    FourierBase(unsigned int N, T period=2*Chebyshev::pi<T>):
+      FunctionalBase<T>(N), N(N), L(period), omega(2*Chebyshev::pi<T>/period), plan(N+1) {
+      calc_nodes_and_weights();
+    }
+    // class methods ---------------------
+    inline void calc_nodes_and_weights() {
+      nodes.resize(N+1);
+      weights.assign(N+1,L/static_cast<T>(N+1));
+      for (unsigned int j=0; j<=N; j++) nodes[j] = L*static_cast<T>(j)/static_cast<T>(N+1);
+    }
+    //! Wavenumber (in units of the fundamental) of coefficient n
+    static inline unsigned int wavenumber(unsigned int n) { return (n+1)/2; }
+    /**
+     * @brief Basis function n: 1 for n = 0, cos(k w x) for n = 2k-1, sin(k w x) for n = 2k
+     */
+    inline T evaluate_function(const T& x, const unsigned int n) const {
+      if (n==0) return static_cast<T>(1);
+      const T arg = static_cast<T>(wavenumber(n))*omega*x;
+      return n%2 ? std::cos(arg) : std::sin(arg);
+    };
+    /**
+     * @brief Sum of the series at x, cos(k w x) and sin(k w x) by the angle
+     * addition recurrence from one cos/sin pair.
+     */
+    inline T evaluate_series(const T& x, const std::vector<T>& coeffs) const {
+      assert(coeffs.size()==num_coeffs());
+      return sum(x,coeffs.data());
+    };
+    //! Evaluation at a batch of points, chunks of points run in parallel
+    inline void evaluate_series_batch(Span<const T> x, const std::vector<T>& coeffs, Span<T> out) const {
+      assert(x.size()==out.size() && coeffs.size()==num_coeffs());
+      const std::size_t nchunks = (x.size()+eval_chunk-1)/eval_chunk;
+      Parallel::parallel_for(nchunks,[&](std::size_t c) {
+        const std::size_t p1 = std::min(x.size(),(c+1)*eval_chunk);
+        for (std::size_t p=c*eval_chunk; p<p1; p++) out[p] = sum(x[p],coeffs.data());
+      },Parallel::default_threads());
+    }
+    /**
+     * @brief Coefficients of the trigonometric interpolant
+     * @param f N+1 values at the nodes
+     * @param ftilde output, N+1 coefficients
+     */
+    inline void calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde) const {
+      ftilde.resize(N+1);
+      calc_spectral_coeffs(Span<const T>(f),Span<T>(ftilde));
+    }
+    inline void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const {
+      f.resize(N+1);
+      calc_function_values(Span<const T>(ftilde),Span<T>(f));
+    }
+    //! Allocation-free transforms into caller-provided buffers, FFT scratch is thread-local
+    inline void calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const;
+    inline void calc_function_values(Span<const T> ftilde, Span<T> f) const;
+    /**
+     * @brief d/dx, a_k' = k w b_k and b_k' = -k w a_k, as a tridiagonal operator.
+     * The derivative of the Nyquist mode cos(M w x/2) is not in the basis and is dropped.
+     */
+    inline OperatorStorage<T> deriv_storage() const;
+    //! d2/dx2, -(k w)^2 on both coefficients of wavenumber k, as a diagonal operator
+    inline OperatorStorage<T> second_deriv_storage() const;
+    /**
+     * @brief Multiplication by x, by collocation: values times the nodes,
+     * transformed back. x is not periodic, so the result is the interpolant
+     * of the product at the nodes, with the jump at x = L spread over all
+     * coefficients. Dense.
+     */
+    inline OperatorStorage<T> times_x_storage() const;
+    inline void calc_deriv(std::vector<T>& Lij) const { deriv_storage().to_dense(Lij); }
+    inline void calc_second_deriv(std::vector<T>& Lij) const { second_deriv_storage().to_dense(Lij); }
+    inline void calc_times_x(std::vector<T>& Lij) const { times_x_storage().to_dense(Lij); }
+    /**
+     * @brief Coefficients of the k-th derivative, O(N), no operator matrix is built
+     * @param ftilde N+1 coefficients
+     * @param out N+1 coefficients, may alias ftilde
+     * @param k order of the derivative
+     */
+    inline void differentiate_coeffs(Span<const T> ftilde, Span<T> out, unsigned int k=1) const;
+    //! Integral over one period, L a_0
+    inline T integrate_coeffs(Span<const T> ftilde) const {
+      assert(ftilde.size()==N+1);
+      return L*ftilde[0];
+    }
+    /**
+     * @brief Coefficients of the product of two series, truncated without aliasing.
+     * Both factors are zero-padded to padded_size() nodes, multiplied there
+     * and transformed back. Work buffers are thread-local.
+     * @param a N+1 coefficients
+     * @param b N+1 coefficients
+     * @param c N+1 coefficients, may alias a or b
+     */
+    inline void multiply_coeffs(Span<const T> a, Span<const T> b, Span<T> c) const;
+    /**
+     * @brief Number of nodes of the product grid. Wavenumbers up to K = (N+1)/2
+     * multiply to 2K, which P nodes alias to 2K-P; the first K are exact for
+     * P > 3K. P is rounded up to a power of two.
+     */
+    inline unsigned int padded_size() const {
+      unsigned int P = 1;
+      while (P <= 3*((N+1)/2) || P < N+1) P *= 2;
+      return P;
+    }
+    // access ----------------
+    inline void get_nodes(std::vector<T>& pts) const { pts = nodes; };
+    inline void get_weights(std::vector<T>& w) const { w = weights; };
+    inline const std::vector<T>& get_nodes() const { return nodes; };
+    inline const std::vector<T>& get_weights() const { return weights; };
+    inline void print_nodes() const {
+      std::cout << "Length of nodes vector: " << nodes.size() << "\n";
+      for (const auto& val : nodes) std::cout << val << " ";
+      std::cout << "\n";
+    }
+    inline void print_weights() const {
+      std::cout << "Length of weights vector: " << weights.size() << "\n";
+      for (const auto& val : weights) std::cout << val << " ";
+      std::cout << "\n";
+    }
+    inline int get_N() const { return N; }
+    inline std::size_t num_coeffs() const { return N+1; }
+    inline T get_period() const { return L; }
+    //! The period, keeps operators of different periods apart in the PlanRegistry
+    inline std::string plan_key() const { return exact_plan_key(&L,1); }
+  private:
+    inline T sum(const T& x, const T* a) const {
+      const T c1 = std::cos(omega*x), s1 = std::sin(omega*x);
+      T c = static_cast<T>(1), s = static_cast<T>(0), f = a[0];
+      for (unsigned int n=1; n<=N; n+=2) {
+        const T cn = c*c1 - s*s1;
+        s = s*c1 + c*s1;
+        c = cn;
+        f += a[n]*c;
+        if (n+1<=N) f += a[n+1]*s;
+      }
+      return f;
+    }
+  };
+
+  template <class T> inline void FourierBase<T>::calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const
+  {
+    assert(f.size()==N+1 && ftilde.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("FourierBase::calc_spectral_coeffs",N,2*(N+1)*sizeof(T));
+    plan.forward(f.data(),ftilde.data());
+    // a_0 = X_0/M, a_k = 2 Re X_k/M, b_k = -2 Im X_k/M, a_{M/2} = X_{M/2}/M
+    const T s = static_cast<T>(1)/static_cast<T>(N+1), s2 = 2*s;
+    ftilde[0] *= s;
+    for (unsigned int n=1; n+1<=N; n+=2) {
+      ftilde[n] *= s2;
+      ftilde[n+1] *= -s2;
+    }
+    if (N%2) ftilde[N] *= s;
+  }
+
+  template <class T> inline void FourierBase<T>::calc_function_values(Span<const T> ftilde, Span<T> f) const
+  {
+    assert(ftilde.size()==N+1 && f.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("FourierBase::calc_function_values",N,2*(N+1)*sizeof(T));
+    // packed spectrum X/M, whose unnormalised inverse is f at the nodes
+    const T half = static_cast<T>(0.5);
+    f[0] = ftilde[0];
+    for (unsigned int n=1; n+1<=N; n+=2) {
+      f[n] = half*ftilde[n];
+      f[n+1] = -half*ftilde[n+1];
+    }
+    if (N%2) f[N] = ftilde[N];
+    plan.inverse(f.data(),f.data());
+  }
+
+  template <class T> inline OperatorStorage<T> FourierBase<T>::deriv_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("FourierBase::deriv_storage",N,3*(N+1)*sizeof(T));
+    // row i holds columns i-1, i, i+1
+    std::vector<T> band(3*(N+1),static_cast<T>(0));
+    for (unsigned int n=1; n+1<=N; n+=2) {
+      const T k = static_cast<T>(wavenumber(n))*omega;
+      band[3*n+2] = k;
+      band[3*(n+1)] = -k;
+    }
+    return OperatorStorage<T>::banded(N+1,1,1,band);
+  }
+
+  template <class T> inline OperatorStorage<T> FourierBase<T>::second_deriv_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("FourierBase::second_deriv_storage",N,(N+1)*sizeof(T));
+    std::vector<T> diag(N+1);
+    for (unsigned int n=0; n<=N; n++) {
+      const T k = static_cast<T>(wavenumber(n))*omega;
+      diag[n] = -k*k;
+    }
+    return OperatorStorage<T>::banded(N+1,0,0,diag);
+  }
+
+  template <class T> inline OperatorStorage<T> FourierBase<T>::times_x_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("FourierBase::times_x_storage",N,(N+1)*(N+1)*sizeof(T));
+    const std::size_t n = N+1;
+    std::vector<T> Lij(n*n), col(n);
+    for (std::size_t j=0; j<n; j++) {
+      std::fill(col.begin(),col.end(),static_cast<T>(0));
+      col[j] = static_cast<T>(1);
+      calc_function_values(Span<const T>(col),Span<T>(col));
+      for (std::size_t i=0; i<n; i++) col[i] *= nodes[i];
+      calc_spectral_coeffs(Span<const T>(col),Span<T>(col));
+      for (std::size_t i=0; i<n; i++) Lij[i*n+j] = col[i];
+    }
+    return OperatorStorage<T>::compress(n,Lij);
+  }
+
+  template <class T> inline void FourierBase<T>::differentiate_coeffs(Span<const T> ftilde, Span<T> out, unsigned int k) const
+  {
+    assert(ftilde.size()==N+1 && out.size()==N+1);
+    out[0] = k ? static_cast<T>(0) : ftilde[0];
+    // (a_k, b_k) -> k w (b_k, -a_k), applied k times
+    for (unsigned int n=1; n+1<=N; n+=2) {
+      const T kw = static_cast<T>(wavenumber(n))*omega;
+      T a = ftilde[n], b = ftilde[n+1];
+      for (unsigned int d=0; d<k; d++) {
+        const T an = kw*b;
+        b = -kw*a;
+        a = an;
+      }
+      out[n] = a;
+      out[n+1] = b;
+    }
+    if (N%2) {
+      // Nyquist mode: its odd derivatives are dropped, as in deriv_storage
+      const T kw2 = -std::pow(static_cast<T>(wavenumber(N))*omega,2);
+      T a = ftilde[N];
+      for (unsigned int d=0; d<k; d+=2) a = d+1<k ? kw2*a : static_cast<T>(0);
+      out[N] = a;
+    }
+  }
+
+  template <class T> inline void FourierBase<T>::multiply_coeffs(Span<const T> a, Span<const T> b, Span<T> c) const
+  {
+    assert(a.size()==N+1 && b.size()==N+1 && c.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("FourierBase::multiply_coeffs",N,3*(N+1)*sizeof(T));
+    auto P = std::atomic_load(&padded);
+    if (!P) {
+      P = std::make_shared<const FourierBase<T>>(padded_size()-1,L);
+      std::atomic_store(&padded,P);
+    }
+    const std::size_t m = P->get_N()+1;
+    static thread_local std::vector<T> pa, pb;
+    const bool square = a.data()==b.data();
+    // the layouts agree on the first N+1 entries, padding appends wavenumbers
+    pa.assign(m,static_cast<T>(0));
+    std::copy(a.begin(),a.end(),pa.begin());
+    P->calc_function_values(Span<const T>(pa),Span<T>(pa));
+    if (!square) {
+      pb.assign(m,static_cast<T>(0));
+      std::copy(b.begin(),b.end(),pb.begin());
+      P->calc_function_values(Span<const T>(pb),Span<T>(pb));
+    }
+    const std::vector<T>& vb = square ? pa : pb;
+    for (std::size_t i=0; i<m; i++) pa[i] *= vb[i];
+    P->calc_spectral_coeffs(Span<const T>(pa),Span<T>(pa));
+    std::copy(pa.begin(),pa.begin()+N+1,c.begin());
+  }
+
+} // namespace FunctionalBases
+
+#endif
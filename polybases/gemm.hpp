@@ -0,0 +1,176 @@
+/**
+ * @file gemm.hpp
+ * @brief Cache-blocked, register-tiled matrix-matrix product.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * C = alpha A B + beta C for row-major matrices with leading dimensions, in
+ * the usual three-level blocking: a KC x NC panel of B and an MC x KC block
+ * of A are packed into contiguous buffers (sized for L2 and L1), and an
+ * MR x NR micro-kernel keeps its tile of C in registers while streaming
+ * through the packed panels. The portable micro-kernel is plain C++ written
+ * so the compiler vectorises it across the NR columns; for double an AVX2/FMA
+ * kernel is compiled with a function-level target attribute and picked at
+ * runtime, as in simd_eval.hpp.
+ */
+#ifndef _MY_SPECTRE_GEMM_HPP
+#define _MY_SPECTRE_GEMM_HPP
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+#include "simd_eval.hpp"
+
+namespace GEMM {
+
+  //! Register tile of the micro-kernel
+  constexpr std::size_t MR = 4;
+  constexpr std::size_t NR = 8;
+  //! Cache blocks: MC x KC of A, KC x NC of B
+  constexpr std::size_t MC = 64;
+  constexpr std::size_t KC = 256;
+  constexpr std::size_t NC = 512;
+
+  namespace detail {
+    //! Pack an mc x kc block of A into MR-row slivers, zero padded, column by column
+    template <class T> inline void pack_a(std::size_t mc, std::size_t kc, const T* A, std::size_t lda, T* buf)
+    {
+      for (std::size_t i0=0; i0<mc; i0+=MR) {
+        const std::size_t mr = std::min(MR,mc-i0);
+        for (std::size_t p=0; p<kc; p++) {
+          for (std::size_t i=0; i<mr; i++) buf[i] = A[(i0+i)*lda+p];
+          for (std::size_t i=mr; i<MR; i++) buf[i] = static_cast<T>(0);
+          buf += MR;
+        }
+      }
+    }
+
+    //! Pack a kc x nc panel of B into NR-column slivers, zero padded, row by row
+    template <class T> inline void pack_b(std::size_t kc, std::size_t nc, const T* B, std::size_t ldb, T* buf)
+    {
+      for (std::size_t j0=0; j0<nc; j0+=NR) {
+        const std::size_t nr = std::min(NR,nc-j0);
+        for (std::size_t p=0; p<kc; p++) {
+          const T* b = B+p*ldb+j0;
+          for (std::size_t j=0; j<nr; j++) buf[j] = b[j];
+          for (std::size_t j=nr; j<NR; j++) buf[j] = static_cast<T>(0);
+          buf += NR;
+        }
+      }
+    }
+
+    //! MR x NR tile: C += alpha * (packed A sliver) * (packed B sliver)
+    template <class T> inline void micro_kernel(std::size_t kc, const T* __restrict a, const T* __restrict b,
+                                                T* C, std::size_t ldc, std::size_t mr, std::size_t nr, const T& alpha)
+    {
+      T acc[MR][NR] = {};
+      for (std::size_t p=0; p<kc; p++) {
+        for (std::size_t i=0; i<MR; i++) {
+          const T ai = a[i];
+          for (std::size_t j=0; j<NR; j++) acc[i][j] += ai*b[j];
+        }
+        a += MR;
+        b += NR;
+      }
+      for (std::size_t i=0; i<mr; i++)
+        for (std::size_t j=0; j<nr; j++) C[i*ldc+j] += alpha*acc[i][j];
+    }
+
+#ifdef SPECTRE_X86_SIMD
+    //! 4 x 8 tile in eight ymm accumulators, two independent FMA chains per row
+    __attribute__((target("avx2,fma")))
+    inline void micro_kernel_avx2(std::size_t kc, const double* __restrict a, const double* __restrict b,
+                                  double* C, std::size_t ldc, std::size_t mr, std::size_t nr, const double& alpha)
+    {
+      static_assert(MR==4 && NR==8, "AVX2 kernel is written for a 4 x 8 tile");
+      __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd(), c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+      __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd(), c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+      for (std::size_t p=0; p<kc; p++) {
+        const __m256d b0 = _mm256_loadu_pd(b), b1 = _mm256_loadu_pd(b+4);
+        __m256d ai = _mm256_broadcast_sd(a);
+        c00 = _mm256_fmadd_pd(ai,b0,c00); c01 = _mm256_fmadd_pd(ai,b1,c01);
+        ai = _mm256_broadcast_sd(a+1);
+        c10 = _mm256_fmadd_pd(ai,b0,c10); c11 = _mm256_fmadd_pd(ai,b1,c11);
+        ai = _mm256_broadcast_sd(a+2);
+        c20 = _mm256_fmadd_pd(ai,b0,c20); c21 = _mm256_fmadd_pd(ai,b1,c21);
+        ai = _mm256_broadcast_sd(a+3);
+        c30 = _mm256_fmadd_pd(ai,b0,c30); c31 = _mm256_fmadd_pd(ai,b1,c31);
+        a += MR;
+        b += NR;
+      }
+      const __m256d al = _mm256_set1_pd(alpha);
+      const __m256d acc[MR][2] = {{c00,c01},{c10,c11},{c20,c21},{c30,c31}};
+      if (mr==MR && nr==NR) {
+        for (std::size_t i=0; i<MR; i++) {
+          double* c = C+i*ldc;
+          _mm256_storeu_pd(c,_mm256_fmadd_pd(al,acc[i][0],_mm256_loadu_pd(c)));
+          _mm256_storeu_pd(c+4,_mm256_fmadd_pd(al,acc[i][1],_mm256_loadu_pd(c+4)));
+        }
+        return;
+      }
+      double tile[MR][NR];
+      for (std::size_t i=0; i<MR; i++) {
+        _mm256_storeu_pd(tile[i],acc[i][0]);
+        _mm256_storeu_pd(tile[i]+4,acc[i][1]);
+      }
+      for (std::size_t i=0; i<mr; i++)
+        for (std::size_t j=0; j<nr; j++) C[i*ldc+j] += alpha*tile[i][j];
+    }
+#endif
+
+    template <class T> using kernel_t = void (*)(std::size_t, const T*, const T*, T*, std::size_t, std::size_t, std::size_t, const T&);
+
+    //! Fastest micro-kernel for T on the running CPU
+    template <class T> inline kernel_t<T> select_kernel()
+    {
+#ifdef SPECTRE_X86_SIMD
+      if constexpr (std::is_same<T,double>::value) {
+        if (Chebyshev::detected_simd_level()!=Chebyshev::SimdLevel::Scalar) return &micro_kernel_avx2;
+      }
+#endif
+      return &micro_kernel<T>;
+    }
+  }
+
+  /**
+   * @brief C = alpha A B + beta C
+   * @param m rows of A and C
+   * @param n columns of B and C
+   * @param k columns of A, rows of B
+   * @param A row-major m x k, leading dimension lda
+   * @param B row-major k x n, leading dimension ldb
+   * @param C row-major m x n, leading dimension ldc, must not alias A or B
+   */
+  template <class T> inline void gemm(std::size_t m, std::size_t n, std::size_t k, const T& alpha,
+                                      const T* A, std::size_t lda, const T* B, std::size_t ldb,
+                                      const T& beta, T* C, std::size_t ldc)
+  {
+    for (std::size_t i=0; i<m; i++) {
+      T* c = C+i*ldc;
+      if (beta==static_cast<T>(0)) std::fill(c,c+n,static_cast<T>(0));
+      else if (beta!=static_cast<T>(1)) for (std::size_t j=0; j<n; j++) c[j] *= beta;
+    }
+    if (m==0 || n==0 || k==0) return;
+    const detail::kernel_t<T> kernel = detail::select_kernel<T>();
+    static thread_local std::vector<T> abuf, bbuf;
+    abuf.resize(MC*KC);
+    bbuf.resize(KC*(NC+NR));
+    for (std::size_t j0=0; j0<n; j0+=NC) {
+      const std::size_t nc = std::min(NC,n-j0);
+      for (std::size_t p0=0; p0<k; p0+=KC) {
+        const std::size_t kc = std::min(KC,k-p0);
+        detail::pack_b(kc,nc,B+p0*ldb+j0,ldb,bbuf.data());
+        for (std::size_t i0=0; i0<m; i0+=MC) {
+          const std::size_t mc = std::min(MC,m-i0);
+          detail::pack_a(mc,kc,A+i0*lda+p0,lda,abuf.data());
+          for (std::size_t jr=0; jr<nc; jr+=NR)
+            for (std::size_t ir=0; ir<mc; ir+=MR)
+              kernel(kc,&abuf[ir*kc],&bbuf[jr*kc],C+(i0+ir)*ldc+j0+jr,ldc,
+                     std::min(MR,mc-ir),std::min(NR,nc-jr),alpha);
+        }
+      }
+    }
+  }
+
+}
+
+#endif
@@ -0,0 +1,301 @@
+/**
+ * @file instrument.hpp
+ * @brief Compile-time switchable per-kernel counters and timers.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Hot kernels open a scope with SPECTRE_PROFILE_SCOPE(name, N, bytes). When
+ * SPECTRE_INSTRUMENT is not defined the macro expands to nothing and the
+ * functions below are empty, so instrumentation costs nothing. When it is
+ * defined, every scope adds to the counters of its (kernel, N) pair:
+ *   - calls
+ *   - cycles, from the time-stamp counter on x86 (nanoseconds elsewhere),
+ *     inclusive of nested scopes
+ *   - bytes moved, as estimated by the kernel
+ *   - heap allocations, if one translation unit defines
+ *     SPECTRE_INSTRUMENT_ALLOCATIONS, which replaces operator new there
+ * Counters and trace events go into a buffer owned by the calling thread, so
+ * recording takes no locks; buffers outlive their threads and are merged when
+ * a report is written. Enabled builds allocate while recording only the first
+ * time a thread records (its buffer, with room for max_events() events) and
+ * the first time it sees each (kernel, N) pair (that counter); steady-state
+ * calls do not touch the heap. At exit the environment variable SPECTRE_INSTRUMENT_OUT
+ * selects the output: unset or "summary" prints a table to stderr,
+ * "trace:FILE" writes Chrome-trace JSON (chrome://tracing, Perfetto),
+ * "none" prints nothing. summary() and write_trace() can also be called
+ * directly while no instrumented work is running.
+ */
+#ifndef _MY_SPECTRE_INSTRUMENT_HPP
+#define _MY_SPECTRE_INSTRUMENT_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+
+#ifdef SPECTRE_INSTRUMENT
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace Instrument {
+
+  //! Counters of one (kernel, N) pair
+  struct Counters {
+    std::uint64_t calls = 0;
+    std::uint64_t cycles = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t allocs = 0;
+  };
+
+#ifdef SPECTRE_INSTRUMENT
+
+  constexpr bool enabled = true;
+
+  namespace detail {
+
+    inline std::uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    //! Heap allocations made by this thread, counted by the optional operator new
+    inline std::uint64_t& thread_allocs() {
+      static thread_local std::uint64_t count = 0;
+      return count;
+    }
+
+    struct Event {
+      const char* name;
+      unsigned int N;
+      std::uint64_t start, duration;
+    };
+
+    //! Per-thread buffer, written only by its thread
+    struct ThreadLog {
+      unsigned int tid;
+      std::map<std::pair<const char*,unsigned int>,Counters> counters;
+      std::vector<Event> events;
+      std::uint64_t dropped = 0;
+    };
+
+    //! Owner of all thread buffers, with the tick/second calibration point
+    struct Registry {
+      std::mutex mtx;
+      std::vector<std::shared_ptr<ThreadLog>> logs;
+      std::uint64_t tick0;
+      std::chrono::steady_clock::time_point time0;
+      std::size_t max_events = 1u << 16; //! trace events kept per thread, reserved up front
+      Registry(): tick0(ticks()), time0(std::chrono::steady_clock::now()) {}
+      static Registry& instance() {
+        static Registry r;
+        return r;
+      }
+      //! Seconds per tick, measured since the registry was created
+      double seconds_per_tick() {
+        const std::uint64_t dt = ticks()-tick0;
+        const double ds = std::chrono::duration<double>(std::chrono::steady_clock::now()-time0).count();
+        return dt ? ds/dt : 1e-9;
+      }
+    };
+
+    inline ThreadLog& thread_log() {
+      static thread_local ThreadLog* log = nullptr;
+      if (!log) {
+        Registry& r = Registry::instance();
+        std::lock_guard<std::mutex> lock(r.mtx);
+        r.logs.push_back(std::make_shared<ThreadLog>());
+        log = r.logs.back().get();
+        log->tid = r.logs.size()-1;
+        log->events.reserve(r.max_events);
+      }
+      return *log;
+    }
+
+    //! Counters merged over threads, keyed by kernel name and N
+    inline std::map<std::pair<std::string,unsigned int>,Counters> merged() {
+      Registry& r = Registry::instance();
+      std::lock_guard<std::mutex> lock(r.mtx);
+      std::map<std::pair<std::string,unsigned int>,Counters> all;
+      for (const auto& log: r.logs)
+        for (const auto& kv: log->counters) {
+          Counters& c = all[{kv.first.first,kv.first.second}];
+          c.calls += kv.second.calls;
+          c.cycles += kv.second.cycles;
+          c.bytes += kv.second.bytes;
+          c.allocs += kv.second.allocs;
+        }
+      return all;
+    }
+  }
+
+  /**
+   * @brief Records one call of a kernel from construction to destruction.
+   * @param name kernel name, a string literal (its address is the key)
+   * @param N order of the basis or problem size
+   * @param bytes estimated bytes read and written by the call
+   */
+  class Scope {
+    const char* name;
+    unsigned int N;
+    std::uint64_t bytes, allocs0, start;
+  public:
+    Scope(const char* name, unsigned int N, std::uint64_t bytes):
+      name(name), N(N), bytes(bytes), allocs0(detail::thread_allocs()), start(detail::ticks()) {}
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    //! Add to the bytes of this call, for sizes only known at the end
+    inline void add_bytes(std::uint64_t b) { bytes += b; }
+    ~Scope() {
+      const std::uint64_t dt = detail::ticks()-start;
+      // read before the bookkeeping below, which may allocate itself
+      const std::uint64_t allocs = detail::thread_allocs()-allocs0;
+      detail::ThreadLog& log = detail::thread_log();
+      // allocates a node only on the first call of this (name, N) on this thread
+      Counters& c = log.counters[{name,N}];
+      c.calls++;
+      c.cycles += dt;
+      c.bytes += bytes;
+      c.allocs += allocs;
+      if (log.events.size() < detail::Registry::instance().max_events) log.events.push_back(detail::Event{name,N,start,dt});
+      else log.dropped++;
+    }
+  };
+
+  //! Counters of one kernel and N, summed over threads
+  inline Counters get(const std::string& name, unsigned int N) {
+    const auto all = detail::merged();
+    auto it = all.find({name,N});
+    return it==all.end() ? Counters() : it->second;
+  }
+
+  //! Trace events kept per thread, later ones are counted as dropped
+  inline std::size_t max_events() { return detail::Registry::instance().max_events; }
+  /**
+   * @brief Change the number of trace events kept per thread and reserve them
+   * in every existing buffer. Call while no instrumented work is running.
+   */
+  inline void set_max_events(std::size_t n) {
+    detail::Registry& r = detail::Registry::instance();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    r.max_events = n;
+    for (auto& log: r.logs) log->events.reserve(n);
+  }
+
+  //! Drop all counters and events, e.g. after a warm-up phase; buffers keep their capacity
+  inline void reset() {
+    detail::Registry& r = detail::Registry::instance();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    for (auto& log: r.logs) {
+      log->counters.clear();
+      log->events.clear();
+      log->dropped = 0;
+    }
+  }
+
+  //! Table of all kernels sorted by total cycles
+  inline void summary(std::FILE* out=stderr) {
+    const auto all = detail::merged();
+    std::vector<std::pair<std::pair<std::string,unsigned int>,Counters>> rows(all.begin(),all.end());
+    std::sort(rows.begin(),rows.end(),[](const auto& a, const auto& b) { return a.second.cycles > b.second.cycles; });
+    std::uint64_t total = 0;
+    for (const auto& r: rows) total += r.second.cycles;
+    const double spt = detail::Registry::instance().seconds_per_tick();
+    std::fprintf(out,"%-40s %7s %12s %12s %7s %12s %12s %10s\n","kernel","N","calls","cycles","%","seconds","bytes","allocs");
+    for (const auto& r: rows)
+      std::fprintf(out,"%-40s %7u %12llu %12llu %6.2f%% %12.4e %12llu %10llu\n", r.first.first.c_str(), r.first.second,
+                   (unsigned long long)r.second.calls, (unsigned long long)r.second.cycles,
+                   total ? 100.0*r.second.cycles/total : 0.0, r.second.cycles*spt,
+                   (unsigned long long)r.second.bytes, (unsigned long long)r.second.allocs);
+  }
+
+  /**
+   * @brief Write all recorded calls as Chrome-trace JSON ("X" complete events)
+   * @return false if the file cannot be written
+   */
+  inline bool write_trace(const std::string& path) {
+    std::FILE* out = std::fopen(path.c_str(),"w");
+    if (!out) return false;
+    detail::Registry& r = detail::Registry::instance();
+    const double us = 1e6*r.seconds_per_tick();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    std::fprintf(out,"{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    bool first = true;
+    for (const auto& log: r.logs)
+      for (const auto& e: log->events) {
+        std::fprintf(out,"%s\n{\"name\": \"%s\", \"cat\": \"spectre\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, "
+                     "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"N\": %u}}",
+                     first ? "" : ",", e.name, log->tid, (e.start-r.tick0)*us, e.duration*us, e.N);
+        first = false;
+      }
+    std::fprintf(out,"\n]}\n");
+    return std::fclose(out)==0;
+  }
+
+  namespace detail {
+    //! Writes the output chosen by SPECTRE_INSTRUMENT_OUT when the program exits
+    struct ExitReport {
+      ExitReport() { Registry::instance(); }
+      ~ExitReport() {
+        const char* env = std::getenv("SPECTRE_INSTRUMENT_OUT");
+        const std::string mode = env ? env : "summary";
+        if (mode=="none") return;
+        if (mode.compare(0,6,"trace:")==0) {
+          if (!write_trace(mode.substr(6))) std::fprintf(stderr,"instrument: cannot write %s\n",mode.c_str()+6);
+          return;
+        }
+        summary(stderr);
+      }
+    };
+    inline ExitReport exit_report;
+  }
+
+#define SPECTRE_PROFILE_CONCAT2(a,b) a##b
+#define SPECTRE_PROFILE_CONCAT(a,b) SPECTRE_PROFILE_CONCAT2(a,b)
+  //! Profile the rest of the enclosing block as kernel name at order N moving bytes
+#define SPECTRE_PROFILE_SCOPE(name,N,bytes) ::Instrument::Scope SPECTRE_PROFILE_CONCAT(spectre_profile_,__LINE__)((name),(N),(bytes))
+
+#else
+
+  constexpr bool enabled = false;
+  inline Counters get(const std::string&, unsigned int) { return Counters(); }
+  inline std::size_t max_events() { return 0; }
+  inline void set_max_events(std::size_t) {}
+  inline void reset() {}
+  inline void summary(std::FILE* =stderr) {}
+  inline bool write_trace(const std::string&) { return false; }
+
+#define SPECTRE_PROFILE_SCOPE(name,N,bytes) ((void)0)
+
+#endif
+
+}
+
+#if defined(SPECTRE_INSTRUMENT) && defined(SPECTRE_INSTRUMENT_ALLOCATIONS)
+#include <new>
+// malloc/free pair by construction, GCC cannot see that through inlining
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(std::size_t size) {
+  Instrument::detail::thread_allocs()++;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+#endif
+
+#endif
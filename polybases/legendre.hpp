@@ -0,0 +1,725 @@
+/**
+ * @file legendre.hpp
+ * @brief Legendre basis on Gauss-Lobatto-Legendre nodes and fast Chebyshev-Legendre conversion.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Gauss-Lobatto-Legendre (GLL) nodes are the zeros of (1-x^2) P_N'(x). They
+ * are found by Newton's method in theta = arccos x. P_N and P_{N-1} are
+ * evaluated by the three-term recurrence near the ends of the interval
+ * (and for small N), and by their Stieltjes asymptotic series elsewhere.
+ * Building the nodes is therefore O(N) for large N.
+ *
+ * Coefficients convert between the Chebyshev and the Legendre series of
+ * the same polynomial through the upper triangular matrices of Alpert and
+ * Rokhlin:
+ *   leg2cheb  M_jk = (2/pi) Lambda((k-j)/2) Lambda((k+j)/2), row 0 halved,
+ *   cheb2leg  L_jk = -(j+1/2) k Lambda((k-j-2)/2)/(k-j) Lambda((k+j-1)/2)/(k+j+1),
+ * for k-j even, with Lambda(z) = Gamma(z+1/2)/Gamma(z+1). Each is the
+ * entrywise product of a Toeplitz matrix (function of k-j) with a Hankel
+ * matrix (function of k+j), up to diagonal scalings. The Hankel factor is
+ * positive semi-definite and numerically of rank O(log N log 1/eps); a
+ * pivoted Cholesky factorisation writes it as sum_r a_r a_r^T. Then
+ *   (T o H) x = sum_r diag(a_r) T diag(a_r) x,
+ * and every Toeplitz product is one FFT convolution, O(N log^2 N) in all.
+ * Small sizes use the O(N^2) sums directly.
+ *
+ * The operators of LegendreBase act on Legendre coefficients; ODE::ODESolver
+ * and the IMEX integrators lower Chebyshev operators only and reject them.
+ */
+#ifndef _MY_SPECTRE_LEGENDRE_HPP
+#define _MY_SPECTRE_LEGENDRE_HPP
+
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <complex>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include "polybases.hpp"
+#include "plan_registry.hpp"
+#include "chebyshev.hpp"
+#include "fft.hpp"
+#include "parallel.hpp"
+#include "span.hpp"
+
+namespace Legendre {
+
+  //! Coefficient count from which ConversionPlan uses the Toeplitz-Hankel path
+  constexpr std::size_t conversion_direct_threshold = 4096;
+  //! Order from which GLL nodes away from the ends use the asymptotic series
+  constexpr unsigned int asymptotic_threshold = 128;
+
+  /**
+   * @brief Lambda(s/2) = Gamma(s/2+1/2)/Gamma(s/2+1) for s = 0..S-1, in long double.
+   * Up from Lambda(0) = sqrt(pi) and Lambda(1/2) = 2/sqrt(pi) by
+   * Lambda(z+1) = Lambda(z) (z+1/2)/(z+1) below z = 200, above it by the
+   * asymptotic series, whose seven terms are then exact to long double.
+   */
+  inline std::vector<long double> lambda_half(std::size_t S)
+  {
+    std::vector<long double> lam(S);
+    const long double z_asym = 200.0L;
+    for (std::size_t s=0; s<S; s++) {
+      const long double z = 0.5L*s;
+      if (s<2) lam[s] = s==0 ? std::sqrt(Chebyshev::pi<long double>) : 2.0L/std::sqrt(Chebyshev::pi<long double>);
+      else if (z < z_asym) lam[s] = lam[s-2]*(z-0.5L)/z;
+      else {
+        const long double t = 1.0L/z;
+        lam[s] = (1.0L + t*(-1.0L/8 + t*(1.0L/128 + t*(5.0L/1024 + t*(-21.0L/32768 + t*(-399.0L/262144 + t*(869.0L/4194304)))))))/std::sqrt(z);
+      }
+    }
+    return lam;
+  }
+
+  /**
+   * @brief P_n(x) and P_{n-1}(x) by the three-term recurrence, O(n)
+   * @param n order, at least 1
+   */
+  template <class C> inline void Pn_pair(const C& x, unsigned int n, C& pn, C& pnm1)
+  {
+    C p0 = static_cast<C>(1), p1 = x;
+    for (unsigned int k=1; k<n; k++) {
+      const C p2 = (static_cast<C>(2*k+1)*x*p1 - static_cast<C>(k)*p0)/static_cast<C>(k+1);
+      p0 = p1;
+      p1 = p2;
+    }
+    pn = p1;
+    pnm1 = p0;
+  }
+
+  //! P_n(x) by the three-term recurrence
+  template <class C> inline C Pn(const C& x, unsigned int n)
+  {
+    if (n==0) return static_cast<C>(1);
+    C pn, pnm1;
+    Pn_pair(x,n,pn,pnm1);
+    return pn;
+  }
+
+  /**
+   * @brief Sum of a Legendre series by Clenshaw's backward recurrence, O(n)
+   * @param x point of evaluation
+   * @param a coefficients
+   * @param ncoeffs number of coefficients
+   */
+  template <class C> inline C clenshaw(const C& x, const C* a, std::size_t ncoeffs)
+  {
+    // b_k = a_k + (2k+1)/(k+1) x b_{k+1} - (k+1)/(k+2) b_{k+2}
+    C b1 = static_cast<C>(0), b2 = static_cast<C>(0);
+    for (std::size_t k=ncoeffs; k-- > 0; ) {
+      const C b0 = a[k] + static_cast<C>(2*k+1)/static_cast<C>(k+1)*x*b1 - static_cast<C>(k+1)/static_cast<C>(k+2)*b2;
+      b2 = b1;
+      b1 = b0;
+    }
+    return b1;
+  }
+
+  namespace detail {
+    /**
+     * @brief P_n(cos theta) by its Stieltjes series,
+     *   P_n(cos t) = C_n sum_m h_m cos((n+m+1/2) t - (m+1/2) pi/2)/(2 sin t)^(m+1/2),
+     *   C_n = (2/sqrt(pi)) Gamma(n+1)/Gamma(n+3/2), h_0 = 1,
+     *   h_m = h_{m-1} (m-1/2)^2/(m (n+m+1/2)).
+     * The cosines are advanced by rotation, two trigonometric calls per series.
+     * @param lam_n Lambda(n), C_n = (2/sqrt(pi))/((n+1/2) Lambda(n))
+     * @return false if the terms stop decreasing before reaching long double accuracy
+     */
+    inline bool stieltjes(unsigned int n, long double t, long double lam_n, long double& p)
+    {
+      const long double st = std::sin(t), ct = std::cos(t), two_st = 2*st;
+      const long double phi0 = (n+0.5L)*t - 0.25L*Chebyshev::pi<long double>;
+      long double c = std::cos(phi0), s = std::sin(phi0);
+      long double h = 1.0L, scale = 1.0L/std::sqrt(two_st), sum = c*scale;
+      const long double eps = std::numeric_limits<long double>::epsilon();
+      for (unsigned int m=1; m<60; m++) {
+        const long double hn = h*(m-0.5L)*(m-0.5L)/(m*(n+m+0.5L));
+        const long double scale_n = scale/two_st;
+        if (hn*scale_n >= h*scale) return false;
+        h = hn;
+        scale = scale_n;
+        // phi_m = phi_{m-1} + t - pi/2
+        const long double cn = c*st + s*ct;
+        s = s*st - c*ct;
+        c = cn;
+        sum += h*c*scale;
+        if (h*scale < 0.25L*eps*std::abs(sum)) {
+          p = 2.0L/(std::sqrt(Chebyshev::pi<long double>)*(n+0.5L)*lam_n)*sum;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    //! P_N and P_{N-1} at cos t, asymptotically where possible
+    inline void Pn_pair_theta(unsigned int N, long double t, long double lam_N, long double lam_Nm1, long double& pn, long double& pnm1)
+    {
+      if (N >= asymptotic_threshold && N*std::sin(t) > 20.0L && stieltjes(N,t,lam_N,pn) && stieltjes(N-1,t,lam_Nm1,pnm1)) return;
+      Pn_pair(std::cos(t),N,pn,pnm1);
+    }
+
+    //! Smallest 2^a 3^b >= n, a length the Stockham FFT handles
+    inline std::size_t next_smooth(std::size_t n)
+    {
+      std::size_t best = FFT::detail::next_pow2(n);
+      for (std::size_t p3=1; p3<best; p3*=3)
+        best = std::min(best,p3*FFT::detail::next_pow2((n+p3-1)/p3));
+      return best;
+    }
+  }
+
+  /**
+   * @brief Gauss-Lobatto-Legendre nodes and weights, nodes descending from 1 to -1.
+   * Interior nodes solve g(x) = P_{N-1}(x) - x P_N(x) = 0, (1-x^2) P_N' = N g,
+   * by Newton's method in theta, with g' = -(N+1) P_N. The initial guesses
+   * theta_k = (k+1/4) pi/(N+1/2) are the asymptotic zeros of the Jacobi
+   * polynomial P^(1,1)_{N-1}. The weights are 2/(N(N+1) P_N(x_k)^2). Only
+   * half the nodes are computed, the rest by symmetry.
+   * @param N order, at least 1
+   */
+  template <class T> inline void gll_nodes_and_weights(unsigned int N, std::vector<T>& x, std::vector<T>& w)
+  {
+    assert(N>=1);
+    x.assign(N+1,static_cast<T>(0));
+    w.assign(N+1,static_cast<T>(0));
+    const long double wend = 2.0L/(static_cast<long double>(N)*(N+1));
+    x[0] = static_cast<T>(1);
+    x[N] = static_cast<T>(-1);
+    w[0] = w[N] = static_cast<T>(wend);
+    const std::vector<long double> lam = lambda_half(2*N+1);
+    const long double eps = std::numeric_limits<long double>::epsilon();
+    const long double pi = Chebyshev::pi<long double>;
+    Parallel::parallel_for(N/2,[&](std::size_t i) {
+      const unsigned int k = static_cast<unsigned int>(i)+1;
+      long double t = (k+0.25L)*pi/(N+0.5L), pn = 0.0L, pnm1 = 0.0L;
+      for (int it=0; it<20; it++) {
+        detail::Pn_pair_theta(N,t,lam[2*N],lam[2*N-2],pn,pnm1);
+        const long double dx = (pnm1 - std::cos(t)*pn)/((N+1)*pn);
+        const long double dt = -dx/std::sin(t);
+        t += dt;
+        if (std::abs(dt) <= 4*eps*t) break;
+      }
+      detail::Pn_pair_theta(N,t,lam[2*N],lam[2*N-2],pn,pnm1);
+      const T xk = static_cast<T>(std::cos(t)), wk = static_cast<T>(wend/(pn*pn));
+      x[k] = xk;
+      x[N-k] = -xk;
+      w[k] = w[N-k] = wk;
+    },Parallel::default_threads());
+    if (N%2==0) {
+      // x = 0, P_N(0) = (-1)^{N/2} Lambda(N/2)/sqrt(pi)
+      const long double p0 = lam[N]/std::sqrt(pi);
+      x[N/2] = static_cast<T>(0);
+      w[N/2] = static_cast<T>(wend/(p0*p0));
+    }
+  }
+
+  /**
+   * @brief Plan converting n coefficients between Chebyshev and Legendre series.
+   * Immutable once built, so it can be shared between threads; scratch space
+   * is thread-local.
+   */
+  template <class T>
+  class ConversionPlan {
+    //! One conversion as (T o H) with H = sum_r a_r b_r^T, b_r = a_r shifted by shift
+    struct ToeplitzHankel {
+      std::vector<std::complex<T>> kernel; //! FFT of the Toeplitz entries at even offsets, length P
+      std::vector<T> factors;              //! rank x n, row r is a_r
+      std::size_t rank = 0;
+      std::size_t shift = 0;
+    };
+    std::size_t n;                 //! number of coefficients
+    std::vector<T> lam;            //! Lambda(s/2), s < 2n
+    std::vector<T> ldiag;          //! diagonal of cheb2leg
+    std::size_t m = 0, P = 0;      //! entries of one parity, FFT length
+    FFT::ComplexPlan<T> fft;       //! length P, fast path only
+    ToeplitzHankel to_cheb, to_leg;
+    inline void build(ToeplitzHankel& op, const std::vector<long double>& lamld, bool legendre);
+    inline void apply(const ToeplitzHankel& op, const T* x, T* y) const;
+  public:
+    /**
+     * @brief Constructor
+     * @param n number of coefficients (order + 1)
+     */
+    explicit ConversionPlan(std::size_t n);
+    /**
+     * @brief Chebyshev coefficients of a Legendre series, in and out may alias
+     * @param in n Legendre coefficients
+     * @param out n Chebyshev coefficients
+     */
+    inline void leg2cheb(const T* in, T* out) const;
+    //! Legendre coefficients of a Chebyshev series, in and out may alias
+    inline void cheb2leg(const T* in, T* out) const;
+    inline std::size_t size() const { return n; }
+    //! True if the Toeplitz-Hankel path is used
+    inline bool fast() const { return P>0; }
+    //! Ranks of the Hankel factors of leg2cheb and cheb2leg, 0 on the direct path
+    inline std::size_t rank_leg2cheb() const { return to_cheb.rank; }
+    inline std::size_t rank_cheb2leg() const { return to_leg.rank; }
+  };
+
+  template <class T> ConversionPlan<T>::ConversionPlan(std::size_t n) : n(n)
+  {
+    assert(n>0);
+    const std::vector<long double> lamld = lambda_half(2*n+1);
+    lam.assign(lamld.begin(),lamld.end());
+    ldiag.resize(n);
+    ldiag[0] = static_cast<T>(1);
+    for (std::size_t j=1; j<n; j++) ldiag[j] = static_cast<T>(std::sqrt(Chebyshev::pi<long double>)/(2*lamld[2*j]));
+    if (n < conversion_direct_threshold) return;
+    m = (n+1)/2;
+    P = detail::next_smooth(2*m-1);
+    fft = FFT::ComplexPlan<T>(P);
+    build(to_cheb,lamld,false);
+    build(to_leg,lamld,true);
+  }
+
+  /*
+   * leg2cheb: Toeplitz t_{2e} = Lambda(e), Hankel Lambda((j+k)/2).
+   * cheb2leg: Toeplitz t_{2e} = Lambda(e-1)/(2e), t_0 = 0, and with k = k'+1
+   * the PSD Hankel (j+1)(k'+1) Lambda((j+k')/2)/(j+k'+2). Its scaling absorbs
+   * the factor k and leaves (j+1/2)/(j+1) on the output.
+   */
+  template <class T> inline void ConversionPlan<T>::build(ToeplitzHankel& op, const std::vector<long double>& lamld, bool legendre)
+  {
+    std::vector<std::complex<T>> t(P,std::complex<T>(0));
+    for (std::size_t e=0; e<m; e++) {
+      const long double te = legendre ? (e==0 ? 0.0L : lamld[2*e-2]/(2*e)) : lamld[2*e];
+      // reversed on input, so the convolution below is a correlation
+      t[e] = std::complex<T>(static_cast<T>(te));
+    }
+    fft.forward(t.data());
+    op.kernel = t;
+    op.shift = legendre ? 1 : 0;
+    auto entry = [&](std::size_t a, std::size_t b) -> long double {
+      const std::size_t s = a+b;
+      if (!legendre) return lamld[s];
+      return static_cast<long double>(a+1)*(b+1)*lamld[s]/(s+2);
+    };
+    // pivoted Cholesky, stopped once the residual diagonal bounds every entry of the error by eps
+    std::vector<T> d(n), col(n);
+    for (std::size_t a=0; a<n; a++) d[a] = static_cast<T>(entry(a,a));
+    const T dmax = *std::max_element(d.begin(),d.end());
+    const T tol = std::numeric_limits<T>::epsilon()*dmax;
+    op.factors.clear();
+    for (op.rank=0; op.rank<n; op.rank++) {
+      const std::size_t p = std::max_element(d.begin(),d.end())-d.begin();
+      if (d[p] <= tol) break;
+      for (std::size_t a=0; a<n; a++) col[a] = static_cast<T>(entry(a,p));
+      for (std::size_t r=0; r<op.rank; r++) {
+        const T* ar = &op.factors[r*n];
+        const T arp = ar[p];
+        for (std::size_t a=0; a<n; a++) col[a] -= ar[a]*arp;
+      }
+      const T piv = std::sqrt(d[p]);
+      for (std::size_t a=0; a<n; a++) {
+        col[a] /= piv;
+        d[a] -= col[a]*col[a];
+      }
+      d[p] = static_cast<T>(0);
+      op.factors.insert(op.factors.end(),col.begin(),col.end());
+    }
+  }
+
+  /*
+   * y += sum_r a_r o T (b_r o x), T upper triangular Toeplitz at even offsets.
+   * Even and odd entries decouple; they travel together as the real and
+   * imaginary part of one complex sequence of length m, reversed so the
+   * product is a linear convolution, and are convolved with the kernel by FFT.
+   */
+  template <class T> inline void ConversionPlan<T>::apply(const ToeplitzHankel& op, const T* x, T* y) const
+  {
+    static thread_local std::vector<std::complex<T>> u;
+    u.resize(P);
+    const T scale = static_cast<T>(1)/static_cast<T>(P);
+    for (std::size_t r=0; r<op.rank; r++) {
+      const T* a = &op.factors[r*n];
+      auto b = [&](std::size_t k) { return k<op.shift ? static_cast<T>(0) : a[k-op.shift]; };
+      std::fill(u.begin()+m,u.end(),std::complex<T>(0));
+      for (std::size_t i=0; i<m; i++) {
+        const T even = b(2*i)*x[2*i];
+        const T odd = 2*i+1<n ? b(2*i+1)*x[2*i+1] : static_cast<T>(0);
+        u[m-1-i] = std::complex<T>(even,odd);
+      }
+      fft.forward(u.data());
+      for (std::size_t q=0; q<P; q++) u[q] *= op.kernel[q];
+      fft.inverse(u.data());
+      for (std::size_t i=0; i<m; i++) {
+        const std::complex<T> Y = u[m-1-i]*scale;
+        y[2*i] += a[2*i]*Y.real();
+        if (2*i+1<n) y[2*i+1] += a[2*i+1]*Y.imag();
+      }
+    }
+  }
+
+  template <class T> inline void ConversionPlan<T>::leg2cheb(const T* in, T* out) const
+  {
+    static thread_local std::vector<T> x, y;
+    x.assign(in,in+n);
+    y.assign(n,static_cast<T>(0));
+    if (fast()) apply(to_cheb,x.data(),y.data());
+    else
+      for (std::size_t j=0; j<n; j++) {
+        T s = static_cast<T>(0);
+        for (std::size_t k=j; k<n; k+=2) s += lam[k-j]*lam[k+j]*x[k];
+        y[j] = s;
+      }
+    const T two_pi = 2/Chebyshev::pi<T>;
+    out[0] = static_cast<T>(0.5)*two_pi*y[0];
+    for (std::size_t j=1; j<n; j++) out[j] = two_pi*y[j];
+  }
+
+  template <class T> inline void ConversionPlan<T>::cheb2leg(const T* in, T* out) const
+  {
+    static thread_local std::vector<T> x, y;
+    x.assign(in,in+n);
+    y.assign(n,static_cast<T>(0));
+    if (fast()) {
+      apply(to_leg,x.data(),y.data());
+      for (std::size_t j=0; j<n; j++)
+        out[j] = ldiag[j]*in[j] - (static_cast<T>(j)+static_cast<T>(0.5))/static_cast<T>(j+1)*y[j];
+      return;
+    }
+    for (std::size_t j=0; j<n; j++) {
+      T s = static_cast<T>(0);
+      for (std::size_t k=j+2; k<n; k+=2)
+        s += static_cast<T>(k)*lam[k-j-2]/static_cast<T>(k-j)*lam[k+j-1]/static_cast<T>(k+j+1)*x[k];
+      y[j] = ldiag[j]*x[j] - (static_cast<T>(j)+static_cast<T>(0.5))*s;
+    }
+    std::copy(y.begin(),y.end(),out);
+  }
+
+  /**
+   * @brief Chebyshev coefficients of a Legendre series with a one-off plan,
+   * keep a ConversionPlan (or a LegendreBase) around for repeated conversions
+   */
+  template <class T> inline void leg2cheb(const T* in, T* out, std::size_t n) { ConversionPlan<T>(n).leg2cheb(in,out); }
+  //! Legendre coefficients of a Chebyshev series with a one-off plan
+  template <class T> inline void cheb2leg(const T* in, T* out, std::size_t n) { ConversionPlan<T>(n).cheb2leg(in,out); }
+
+} // namespace Legendre
+
+namespace FunctionalBases {
+
+  //! Order up to which LegendreBase caches the (N+1)x(N+1) matrix P_n(x_i)
+  constexpr unsigned int legendre_matrix_threshold = 1024;
+
+  /**
+   * @brief Legendre polynomial basis on the Gauss-Lobatto-Legendre nodes.
+   * The transforms are the discrete Legendre transform on the GLL grid,
+   * exact for polynomials of degree N:
+   *   l_n = (1/g_n) sum_i w_i f_i P_n(x_i),  g_n = 2/(2n+1), g_N = 2/N,
+   * O(N^2) since the nodes are not equispaced in any angle. Data on the
+   * Chebyshev-Gauss-Lobatto grid take the fast path instead:
+   * calc_spectral_coeffs_chebyshev goes through the DCT of ChebyshevBase
+   * and cheb2leg, O(N log^2 N). The GLL weights integrate polynomials of
+   * degree 2N-1 exactly, which is what Galerkin inner products need.
+   */
+  template <class T>
+  class LegendreBase final : public FunctionalBase<T> {
+    unsigned int N;            //! Order
+    std::vector<T> nodes;      //! GLL nodes, descending from 1 to -1
+    std::vector<T> weights;    //! GLL weights
+    std::vector<T> gammas;     //! discrete norms sum_i w_i P_n(x_i)^2
+    std::vector<T> Pmat;       //! P_n(x_i) row-major by node, below legendre_matrix_threshold only
+    mutable std::shared_ptr<const Legendre::ConversionPlan<T>> conversion; //! built on first use
+    mutable std::shared_ptr<const Legendre::ConversionPlan<T>> conversion2; //! 2N+1 coefficients, for products
+    //! Points evaluated per task by evaluate_series_batch
+    static constexpr std::size_t eval_chunk = 2048;
+  public:
+    typedef T value_type;
+    // constructor ----------------------
+    /**
+     * @brief Constructor
+     * @param N order of the polynomial basis, at least 1
+     */
+    LegendreBase(unsigned int N) : FunctionalBase<T>(N), N(N) { calc_nodes_and_weights(); }
+    // class methods ---------------------
+    inline void calc_nodes_and_weights();
+    inline T evaluate_function(const T& x, const unsigned int n) const { return Legendre::Pn<T>(x,n); };
+    //! Clenshaw summation of the Legendre series, O(N)
+    inline T evaluate_series(const T& x, const std::vector<T>& coeffs) const {
+      return Legendre::clenshaw<T>(x,coeffs.data(),coeffs.size());
+    };
+    //! Evaluation at a batch of points, chunks of points run in parallel
+    inline void evaluate_series_batch(Span<const T> x, const std::vector<T>& coeffs, Span<T> out) const {
+      assert(x.size()==out.size());
+      const std::size_t nchunks = (x.size()+eval_chunk-1)/eval_chunk;
+      Parallel::parallel_for(nchunks,[&](std::size_t c) {
+        const std::size_t p1 = std::min(x.size(),(c+1)*eval_chunk);
+        for (std::size_t p=c*eval_chunk; p<p1; p++) out[p] = Legendre::clenshaw<T>(x[p],coeffs.data(),coeffs.size());
+      },Parallel::default_threads());
+    }
+    /**
+     * @brief Legendre coefficients from the values at the GLL nodes
+     * @param f N+1 values at the nodes
+     * @param ftilde output, N+1 coefficients
+     */
+    inline void calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde) const {
+      ftilde.resize(N+1);
+      calc_spectral_coeffs(Span<const T>(f),Span<T>(ftilde));
+    }
+    inline void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const {
+      f.resize(N+1);
+      calc_function_values(Span<const T>(ftilde),Span<T>(f));
+    }
+    //! Allocation-free transforms on the GLL grid, f and ftilde must not overlap
+    inline void calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const;
+    inline void calc_function_values(Span<const T> ftilde, Span<T> f) const;
+    /**
+     * @brief Legendre coefficients from the values at the Chebyshev-Gauss-Lobatto
+     * nodes cos(pi i/N), by the DCT of ChebyshevBase and cheb2leg, O(N log^2 N)
+     * @param f N+1 values at the Chebyshev nodes
+     * @param ftilde N+1 Legendre coefficients
+     */
+    inline void calc_spectral_coeffs_chebyshev(Span<const T> f, Span<T> ftilde) const;
+    //! Values at the Chebyshev-Gauss-Lobatto nodes, by leg2cheb and the inverse DCT
+    inline void calc_function_values_chebyshev(Span<const T> ftilde, Span<T> f) const;
+    //! Chebyshev coefficients of the same polynomial, out may alias in
+    inline void to_chebyshev_coeffs(Span<const T> in, Span<T> out) const {
+      assert(in.size()==N+1 && out.size()==N+1);
+      conversion_plan().leg2cheb(in.data(),out.data());
+    }
+    //! Legendre coefficients of a Chebyshev series, out may alias in
+    inline void from_chebyshev_coeffs(Span<const T> in, Span<T> out) const {
+      assert(in.size()==N+1 && out.size()==N+1);
+      conversion_plan().cheb2leg(in.data(),out.data());
+    }
+    /**
+     * @brief Derivative as a rank-1 parity-triangular operator, D_ij = 2i+1 for j > i, j-i odd
+     */
+    inline OperatorStorage<T> deriv_storage() const;
+    //! Second derivative, rank 2: (i+1/2)(j(j+1) - i(i+1)) for j >= i+2, j-i even
+    inline OperatorStorage<T> second_deriv_storage() const;
+    //! Multiplication by x, tridiagonal from x P_n = ((n+1) P_{n+1} + n P_{n-1})/(2n+1)
+    inline OperatorStorage<T> times_x_storage() const;
+    inline void calc_deriv(std::vector<T>& Lij) const { deriv_storage().to_dense(Lij); }
+    inline void calc_second_deriv(std::vector<T>& Lij) const { second_deriv_storage().to_dense(Lij); }
+    inline void calc_times_x(std::vector<T>& Lij) const { times_x_storage().to_dense(Lij); }
+    /**
+     * @brief Coefficients of the k-th derivative by the O(N) backward recurrence
+     * d_{n-1} = (2n-1) (a_n + d_{n+1}/(2n+3)); out may alias ftilde
+     */
+    inline void differentiate_coeffs(Span<const T> ftilde, Span<T> out, unsigned int k=1) const;
+    /**
+     * @brief Antiderivative vanishing at x=-1, from int P_n = (P_{n+1} - P_{n-1})/(2n+1),
+     * truncated to N+1 terms; out may alias ftilde
+     */
+    inline void antiderivative_coeffs(Span<const T> ftilde, Span<T> out) const;
+    //! Integral over [-1,1], 2 a_0
+    inline T integrate_coeffs(Span<const T> ftilde) const {
+      assert(ftilde.size()==N+1);
+      return 2*ftilde[0];
+    }
+    /**
+     * @brief Legendre coefficients of the product, truncated to order N (the L2 projection).
+     * Both factors go to Chebyshev coefficients padded to order 2N, are
+     * multiplied at the 2N+1 Chebyshev nodes, where the product is exact, and
+     * come back through cheb2leg of length 2N+1. c may alias a or b.
+     */
+    inline void multiply_coeffs(Span<const T> a, Span<const T> b, Span<T> c) const;
+    // access ----------------
+    inline void get_nodes(std::vector<T>& pts) const { pts = nodes; };
+    inline void get_weights(std::vector<T>& w) const { w = weights; };
+    inline const std::vector<T>& get_nodes() const { return nodes; };
+    inline const std::vector<T>& get_weights() const { return weights; };
+    inline void print_nodes() const {
+      std::cout << "Length of nodes vector: " << nodes.size() << "\n";
+      for (const auto& val : nodes) std::cout << val << " ";
+      std::cout << "\n";
+    }
+    inline void print_weights() const {
+      std::cout << "Length of weights vector: " << weights.size() << "\n";
+      for (const auto& val : weights) std::cout << val << " ";
+      std::cout << "\n";
+    }
+    inline int get_N() const { return N; }
+    inline std::size_t num_coeffs() const { return N+1; }
+    //! The Chebyshev-Legendre conversion plan of N+1 coefficients
+    inline const Legendre::ConversionPlan<T>& conversion_plan() const { return *lazy_plan(conversion,N+1); }
+  private:
+    static inline std::shared_ptr<const Legendre::ConversionPlan<T>> lazy_plan(std::shared_ptr<const Legendre::ConversionPlan<T>>& slot, std::size_t n) {
+      auto P = std::atomic_load(&slot);
+      if (!P) {
+        P = std::make_shared<const Legendre::ConversionPlan<T>>(n);
+        std::atomic_store(&slot,P);
+      }
+      return P;
+    }
+  };
+
+  template <class T> inline void LegendreBase<T>::calc_nodes_and_weights()
+  {
+    assert(N>=1);
+    Legendre::gll_nodes_and_weights<T>(N,nodes,weights);
+    gammas.resize(N+1);
+    for (unsigned int n=0; n<N; n++) gammas[n] = static_cast<T>(2)/static_cast<T>(2*n+1);
+    gammas[N] = static_cast<T>(2)/static_cast<T>(N);
+    if (N < legendre_matrix_threshold) {
+      Pmat.resize((N+1)*(N+1));
+      for (unsigned int i=0; i<=N; i++) {
+        T* row = &Pmat[i*(N+1)];
+        const T x = nodes[i];
+        row[0] = static_cast<T>(1);
+        row[1] = x;
+        for (unsigned int n=1; n<N; n++) row[n+1] = (static_cast<T>(2*n+1)*x*row[n] - static_cast<T>(n)*row[n-1])/static_cast<T>(n+1);
+      }
+    }
+  }
+
+  template <class T> inline void LegendreBase<T>::calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const
+  {
+    assert(f.size()==N+1 && ftilde.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("LegendreBase::calc_spectral_coeffs",N,2*(N+1)*sizeof(T));
+    std::fill(ftilde.begin(),ftilde.end(),static_cast<T>(0));
+    for (unsigned int i=0; i<=N; i++) {
+      const T wf = weights[i]*f[i];
+      if (!Pmat.empty()) {
+        const T* row = &Pmat[i*(N+1)];
+        for (unsigned int n=0; n<=N; n++) ftilde[n] += wf*row[n];
+        continue;
+      }
+      // P_n(x_i) by the recurrence, on the fly
+      const T x = nodes[i];
+      T p0 = static_cast<T>(1), p1 = x;
+      ftilde[0] += wf;
+      ftilde[1] += wf*x;
+      for (unsigned int n=1; n<N; n++) {
+        const T p2 = (static_cast<T>(2*n+1)*x*p1 - static_cast<T>(n)*p0)/static_cast<T>(n+1);
+        p0 = p1;
+        p1 = p2;
+        ftilde[n+1] += wf*p2;
+      }
+    }
+    for (unsigned int n=0; n<=N; n++) ftilde[n] /= gammas[n];
+  }
+
+  template <class T> inline void LegendreBase<T>::calc_function_values(Span<const T> ftilde, Span<T> f) const
+  {
+    assert(ftilde.size()==N+1 && f.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("LegendreBase::calc_function_values",N,2*(N+1)*sizeof(T));
+    Parallel::parallel_for(N+1,[&](std::size_t i) {
+      if (Pmat.empty()) {
+        f[i] = Legendre::clenshaw<T>(nodes[i],ftilde.data(),N+1);
+        return;
+      }
+      const T* row = &Pmat[i*(N+1)];
+      T s = static_cast<T>(0);
+      for (unsigned int n=0; n<=N; n++) s += row[n]*ftilde[n];
+      f[i] = s;
+    },Parallel::default_threads());
+  }
+
+  template <class T> inline void LegendreBase<T>::calc_spectral_coeffs_chebyshev(Span<const T> f, Span<T> ftilde) const
+  {
+    assert(f.size()==N+1 && ftilde.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("LegendreBase::calc_spectral_coeffs_chebyshev",N,2*(N+1)*sizeof(T));
+    PlanRegistry::instance().get_basis<ChebyshevBase<T>>(N)->calc_spectral_coeffs(f,ftilde);
+    conversion_plan().cheb2leg(ftilde.data(),ftilde.data());
+  }
+
+  template <class T> inline void LegendreBase<T>::calc_function_values_chebyshev(Span<const T> ftilde, Span<T> f) const
+  {
+    assert(ftilde.size()==N+1 && f.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("LegendreBase::calc_function_values_chebyshev",N,2*(N+1)*sizeof(T));
+    static thread_local std::vector<T> c;
+    c.resize(N+1);
+    conversion_plan().leg2cheb(ftilde.data(),c.data());
+    PlanRegistry::instance().get_basis<ChebyshevBase<T>>(N)->calc_function_values(Span<const T>(c),f);
+  }
+
+  template <class T> inline OperatorStorage<T> LegendreBase<T>::deriv_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("LegendreBase::deriv_storage",N,2*(N+1)*sizeof(T));
+    std::vector<T> u(N+1), v(N+1,static_cast<T>(1));
+    for (unsigned int i=0; i<=N; i++) u[i] = static_cast<T>(2*i+1);
+    return OperatorStorage<T>::parity_triangular(N+1,1,1,u,v);
+  }
+
+  template <class T> inline OperatorStorage<T> LegendreBase<T>::second_deriv_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("LegendreBase::second_deriv_storage",N,4*(N+1)*sizeof(T));
+    std::vector<T> u(2*(N+1)), v(2*(N+1));
+    for (unsigned int i=0; i<=N; i++) {
+      const T h = static_cast<T>(i)+static_cast<T>(0.5), ii = static_cast<T>(i);
+      u[i] = h;
+      v[i] = ii*(ii+1);
+      u[N+1+i] = -h*ii*(ii+1);
+      v[N+1+i] = static_cast<T>(1);
+    }
+    return OperatorStorage<T>::parity_triangular(N+1,2,2,u,v);
+  }
+
+  template <class T> inline OperatorStorage<T> LegendreBase<T>::times_x_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("LegendreBase::times_x_storage",N,3*(N+1)*sizeof(T));
+    // row i holds columns i-1, i, i+1: (x f)_i = i/(2i-1) a_{i-1} + (i+1)/(2i+3) a_{i+1}
+    std::vector<T> band(3*(N+1),static_cast<T>(0));
+    for (unsigned int i=0; i<=N; i++) {
+      if (i>0) band[3*i] = static_cast<T>(i)/static_cast<T>(2*i-1);
+      if (i<N) band[3*i+2] = static_cast<T>(i+1)/static_cast<T>(2*i+3);
+    }
+    return OperatorStorage<T>::banded(N+1,1,1,band);
+  }
+
+  template <class T> inline void LegendreBase<T>::differentiate_coeffs(Span<const T> ftilde, Span<T> out, unsigned int k) const
+  {
+    assert(ftilde.size()==N+1 && out.size()==N+1);
+    if (out.data()!=ftilde.data()) std::copy(ftilde.begin(),ftilde.end(),out.begin());
+    for (unsigned int d=0; d<k; d++) {
+      // d_{n-1} = (2n-1) (a_n + d_{n+1}/(2n+3)), from the top; a_n is read before d_n overwrites it
+      T dnp1 = static_cast<T>(0), dn = static_cast<T>(0);
+      for (unsigned int n=N; n>=1; n--) {
+        const T dnm1 = static_cast<T>(2*n-1)*(out[n] + dnp1/static_cast<T>(2*n+3));
+        out[n] = dn;
+        dnp1 = dn;
+        dn = dnm1;
+      }
+      out[0] = dn;
+    }
+  }
+
+  template <class T> inline void LegendreBase<T>::antiderivative_coeffs(Span<const T> ftilde, Span<T> out) const
+  {
+    assert(ftilde.size()==N+1 && out.size()==N+1);
+    static thread_local std::vector<T> a;
+    a.assign(ftilde.begin(),ftilde.end());
+    // c_k = a_{k-1}/(2k-1) - a_{k+1}/(2k+3), c_0 from the value 0 at x=-1
+    T at_left = static_cast<T>(0);
+    for (unsigned int k=1; k<=N; k++) {
+      const T next = k<N ? a[k+1] : static_cast<T>(0);
+      out[k] = a[k-1]/static_cast<T>(2*k-1) - next/static_cast<T>(2*k+3);
+      at_left += k%2 ? -out[k] : out[k];
+    }
+    out[0] = -at_left;
+  }
+
+  template <class T> inline void LegendreBase<T>::multiply_coeffs(Span<const T> a, Span<const T> b, Span<T> c) const
+  {
+    assert(a.size()==N+1 && b.size()==N+1 && c.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("LegendreBase::multiply_coeffs",N,3*(N+1)*sizeof(T));
+    const std::size_t m = 2*N+1;
+    const Legendre::ConversionPlan<T>& P2 = *lazy_plan(conversion2,m);
+    auto cheb = PlanRegistry::instance().get_basis<ChebyshevBase<T>>(2*N);
+    static thread_local std::vector<T> pa, pb, va, vb;
+    const bool square = a.data()==b.data();
+    pa.assign(m,static_cast<T>(0));
+    va.resize(m);
+    std::copy(a.begin(),a.end(),pa.begin());
+    P2.leg2cheb(pa.data(),pa.data());
+    cheb->calc_function_values(Span<const T>(pa),Span<T>(va));
+    if (!square) {
+      pb.assign(m,static_cast<T>(0));
+      vb.resize(m);
+      std::copy(b.begin(),b.end(),pb.begin());
+      P2.leg2cheb(pb.data(),pb.data());
+      cheb->calc_function_values(Span<const T>(pb),Span<T>(vb));
+    }
+    const std::vector<T>& v2 = square ? va : vb;
+    for (std::size_t i=0; i<m; i++) va[i] *= v2[i];
+    cheb->calc_spectral_coeffs(Span<const T>(va),Span<T>(pa));
+    P2.cheb2leg(pa.data(),pa.data());
+    std::copy(pa.begin(),pa.begin()+N+1,c.begin());
+  }
+
+} // namespace FunctionalBases
+
+#endif
@@ -0,0 +1,168 @@
+/**
+ * @file mixed_precision.hpp
+ * @brief Chebyshev basis storing values and coefficients in a narrow type and computing in a wide one.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * MixedChebyshevBase<S,C> is a StaticBasis on S (float by default). It
+ * holds the shared ChebyshevBase<C> (double by default) of the same order.
+ * Transforms promote their input to C in thread-local blocks, run the C
+ * transform and round the result to S. Evaluation reads S coefficients and
+ * points and carries the Clenshaw recurrence in C. Function<S,
+ * MixedChebyshevBase<S,C>,N> therefore has half the footprint of a
+ * Function<C,...>. Its error is that of rounding the data to S once
+ * (error_bound), not that of doing the arithmetic in S. Solves are refined
+ * to C accuracy by ODE::RefinedODESolver.
+ */
+#ifndef _MY_SPECTRE_MIXED_PRECISION_HPP
+#define _MY_SPECTRE_MIXED_PRECISION_HPP
+
+#include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include "polybases.hpp"
+#include "static_basis.hpp"
+#include "plan_registry.hpp"
+#include "simd_eval.hpp"
+#include "parallel.hpp"
+#include "span.hpp"
+
+namespace FunctionalBases {
+
+  /**
+   * @brief Chebyshev basis with S storage and C arithmetic.
+   * @tparam S storage type of values, coefficients and operators
+   * @tparam C type the transforms and the Clenshaw recurrence are computed in
+   */
+  template <class S=float, class C=double>
+  class MixedChebyshevBase : public StaticBasis<MixedChebyshevBase<S,C>,S> {
+    static_assert(std::numeric_limits<C>::digits >= std::numeric_limits<S>::digits, "C must be at least as wide as S");
+    unsigned int N;
+    std::shared_ptr<const ChebyshevBase<C>> basis; //! transforms in C, shared through the PlanRegistry
+    std::vector<S> nodes, weights;                  //! rounded from those of basis
+  public:
+    typedef S value_type;
+    typedef C compute_type;
+    //! Functions promoted to C together in the batched transforms
+    static constexpr std::size_t batch_block = 16;
+    using StaticBasis<MixedChebyshevBase<S,C>,S>::calc_spectral_coeffs;
+    using StaticBasis<MixedChebyshevBase<S,C>,S>::calc_function_values;
+    using StaticBasis<MixedChebyshevBase<S,C>,S>::get_nodes;
+    using StaticBasis<MixedChebyshevBase<S,C>,S>::get_weights;
+
+    explicit MixedChebyshevBase(unsigned int N): N(N), basis(PlanRegistry::instance().get_basis<ChebyshevBase<C>>(N)) {
+      nodes.assign(basis->get_nodes().begin(),basis->get_nodes().end());
+      weights.assign(basis->get_weights().begin(),basis->get_weights().end());
+    }
+    inline int get_N() const { return N; }
+    //! The basis the arithmetic is done in
+    inline const ChebyshevBase<C>& compute_basis() const { return *basis; }
+    inline const std::vector<S>& get_nodes() const { return nodes; }
+    inline const std::vector<S>& get_weights() const { return weights; }
+
+    inline S evaluate_function(const S& x, unsigned int n) const {
+      return static_cast<S>(Chebyshev::Tn<C>(static_cast<C>(x),n));
+    }
+    inline S evaluate_series(const S& x, Span<const S> coeffs) const {
+      S out;
+      Chebyshev::clenshaw_batch_mixed<S,C>(coeffs.data(),coeffs.size(),&x,1,&out);
+      return out;
+    }
+    //! Clenshaw summation in C at a batch of S points, see Chebyshev::clenshaw_batch_mixed
+    inline void evaluate_series_batch(Span<const S> x, Span<const S> coeffs, Span<S> out) const {
+      assert(x.size()==out.size());
+      SPECTRE_PROFILE_SCOPE("MixedChebyshevBase::evaluate_series_batch",N,(2*x.size()+coeffs.size())*sizeof(S));
+      Chebyshev::clenshaw_batch_mixed<S,C>(coeffs.data(),coeffs.size(),x.data(),x.size(),out.data());
+    }
+
+    inline void calc_spectral_coeffs(Span<const S> f, Span<S> ftilde) const {
+      assert(f.size()==N+1 && ftilde.size()==N+1);
+      transform<true>(f.data(),ftilde.data(),1,BatchLayout::SoA,1);
+    }
+    inline void calc_function_values(Span<const S> ftilde, Span<S> f) const {
+      assert(ftilde.size()==N+1 && f.size()==N+1);
+      transform<false>(ftilde.data(),f.data(),1,BatchLayout::SoA,1);
+    }
+    //! Forward transform of M functions, see ChebyshevBase::calc_spectral_coeffs_batch
+    inline void calc_spectral_coeffs_batch(Span<const S> f, Span<S> ftilde, std::size_t M,
+                                           BatchLayout layout=BatchLayout::SoA,
+                                           unsigned int nthreads=Parallel::default_threads()) const {
+      assert(f.size()==M*(N+1) && ftilde.size()==M*(N+1));
+      transform<true>(f.data(),ftilde.data(),M,layout,nthreads);
+    }
+    //! Inverse transform of M functions, see ChebyshevBase::calc_function_values_batch
+    inline void calc_function_values_batch(Span<const S> ftilde, Span<S> f, std::size_t M,
+                                           BatchLayout layout=BatchLayout::SoA,
+                                           unsigned int nthreads=Parallel::default_threads()) const {
+      assert(f.size()==M*(N+1) && ftilde.size()==M*(N+1));
+      transform<false>(ftilde.data(),f.data(),M,layout,nthreads);
+    }
+
+    //! Chebyshev coefficients on [-1,1], like the ChebyshevBase it wraps
+    inline std::vector<S> chebyshev_elements() const { return {static_cast<S>(-1),static_cast<S>(1)}; }
+
+    /*
+     * Operators are stored and applied in S, by the kernels of OperatorStorage<S>.
+     * d/dx (2j/c_i) and x (1/2) are exact in S while j < 2^digits(S). d2/dx2 is
+     * the rank-2 form (j^3 - i^2 j)/c_i: its factor j^3 is rounded once j^3 >
+     * 2^digits(S) (j > 256 for float), and the two terms cancel near the
+     * diagonal. Row i of y = D2 x then carries an error of a few u_S times
+     *   sum_{j>i} (j^3 + i^2 j) |x_j| / c_i,
+     * which is O(u_S) relative to max_i (|D2| |x|)_i, but up to N/2 times u_S
+     * relative to (|D2| |x|)_i itself in the rows near i = N. For float that is
+     * within 1e-4 for N <= 2048; beyond that, or where those rows matter, apply
+     * the ChebyshevBase<C> operators to promoted coefficients, or solve with
+     * ODE::RefinedODESolver, which computes its residuals in C.
+     */
+    inline OperatorStorage<S> deriv_storage() const { return OperatorStorage<S>::converted(basis->deriv_storage()); }
+    inline OperatorStorage<S> second_deriv_storage() const { return OperatorStorage<S>::converted(basis->second_deriv_storage()); }
+    inline OperatorStorage<S> times_x_storage() const { return OperatorStorage<S>::converted(basis->times_x_storage()); }
+
+    /**
+     * @brief Bound on |p(x) - q(x)| for x in [-1,1].
+     * Here p is the series before its coefficients were rounded to S, and q
+     * is what evaluate_series_batch returns at an S point:
+     *   (2 u_S + 2 (N+1)^2 u_C) sum_n |a_n|,
+     * with u the unit roundoff. The terms are the rounding of the
+     * coefficients and of the result to S, and the Clenshaw recurrence in C.
+     * @param coeffs stored coefficients a_n
+     */
+    static C error_bound(Span<const S> coeffs) {
+      C norm = static_cast<C>(0);
+      for (const S& a: coeffs) norm += std::abs(static_cast<C>(a));
+      const C uS = std::numeric_limits<S>::epsilon()/2, uC = std::numeric_limits<C>::epsilon()/2;
+      const C n1 = static_cast<C>(coeffs.size());
+      return (2*uS + 2*n1*n1*uC)*norm;
+    }
+  private:
+    /*
+     * Blocks of up to batch_block functions are gathered into SoA scratch in C,
+     * transformed by the C basis on one thread and rounded back, so the C
+     * copies stay in cache and the S arrays are streamed once.
+     */
+    template <bool forward> void transform(const S* in, S* out, std::size_t M, BatchLayout layout, unsigned int nthreads) const {
+      const std::size_t n1 = N+1, nblocks = (M+batch_block-1)/batch_block;
+      SPECTRE_PROFILE_SCOPE(forward ? "MixedChebyshevBase::calc_spectral_coeffs" : "MixedChebyshevBase::calc_function_values",N,
+                            M*n1*(2*sizeof(S)+2*sizeof(C)));
+      Parallel::parallel_for(nblocks,[&](std::size_t blk) {
+        const std::size_t m0 = blk*batch_block, mb = std::min(batch_block,M-m0);
+        static thread_local std::vector<C> a, b;
+        a.resize(mb*n1);
+        b.resize(mb*n1);
+        for (std::size_t j=0; j<mb; j++)
+          for (std::size_t i=0; i<n1; i++) a[j*n1+i] = static_cast<C>(layout==BatchLayout::SoA ? in[(m0+j)*n1+i] : in[i*M+m0+j]);
+        if (mb==1) {
+          if (forward) basis->calc_spectral_coeffs(Span<const C>(a),Span<C>(b));
+          else basis->calc_function_values(Span<const C>(a),Span<C>(b));
+        }
+        else if (forward) basis->calc_spectral_coeffs_batch(Span<const C>(a),Span<C>(b),mb,BatchLayout::SoA,1);
+        else basis->calc_function_values_batch(Span<const C>(a),Span<C>(b),mb,BatchLayout::SoA,1);
+        for (std::size_t j=0; j<mb; j++)
+          for (std::size_t i=0; i<n1; i++) (layout==BatchLayout::SoA ? out[(m0+j)*n1+i] : out[i*M+m0+j]) = static_cast<S>(b[j*n1+i]);
+      },nthreads);
+    }
+  };
+
+} // namespace FunctionalBases
+
+#endif
@@ -0,0 +1,399 @@
+/**
+ * @file operator_storage.hpp
+ * @brief Storage formats and matrix-vector products for linear operators.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Spectral operators are rarely dense: multiplication by x is tridiagonal
+ * and the Chebyshev derivatives are upper triangular with a parity pattern
+ * whose entries factor into a row and a column term. OperatorStorage keeps
+ * an operator in the sparsest of four formats and applies it to a vector of
+ * coefficients with the matching kernel:
+ *   - Dense:            (n x n) row-major, O(n^2)
+ *   - Banded:           kl sub- and ku super-diagonals, O((kl+ku+1) n)
+ *   - ParityTriangular: L_ij = sum_r u_r(i) v_r(j) for j >= i+offset, j-i-offset even, O(rank n)
+ *   - CSR:              compressed sparse rows, O(nnz)
+ * The kernels run on an OperatorView, a non-owning view of the arrays, so
+ * operator data living elsewhere (e.g. in a memory-mapped archive, see
+ * io/archive.hpp) is applied without copying it into an OperatorStorage.
+ */
+#ifndef _MY_SPECTRE_OPERATOR_STORAGE_HPP
+#define _MY_SPECTRE_OPERATOR_STORAGE_HPP
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <assert.h>
+#include "span.hpp"
+
+namespace FunctionalBases {
+
+  enum class StorageFormat { Dense, Banded, ParityTriangular, CSR };
+
+  /**
+   * @brief Non-owning view of an operator matrix, with the layout of OperatorStorage.
+   * Valid as long as the memory it points to.
+   */
+  template <class T>
+  struct OperatorView {
+    StorageFormat fmt = StorageFormat::Dense;
+    std::size_t n = 0, kl = 0, ku = 0, offset = 0, rank = 0;
+    Span<const T> vals, u, v;
+    Span<const std::size_t> row_ptr, cols;
+    //! y = L x, y must not alias x
+    inline void apply(const T* x, T* y) const {
+      std::fill(y,y+n,static_cast<T>(0));
+      apply_add(x,y,static_cast<T>(1));
+    }
+    //! y += alpha L x with the kernel of the storage format, y must not alias x
+    inline void apply_add(const T* x, T* y, const T& alpha) const;
+  };
+
+  /**
+   * @brief Square operator matrix in one of the StorageFormats.
+   * Immutable once built; arithmetic returns new objects.
+   */
+  template <class T>
+  class OperatorStorage {
+    StorageFormat fmt;
+    std::size_t n;       //! number of rows and columns
+    std::size_t kl, ku;  //! Banded: lower and upper bandwidth
+    std::size_t offset;  //! ParityTriangular: first non-zero super-diagonal
+    std::size_t rank;    //! ParityTriangular: number of separable terms
+    std::vector<T> vals; //! Dense: n*n; Banded: n*(kl+ku+1), row i holds columns i-kl..i+ku; CSR: non-zeros
+    std::vector<T> u, v; //! ParityTriangular: rank*n row and column factors
+    std::vector<std::size_t> row_ptr, cols; //! CSR structure
+  public:
+    OperatorStorage<T>(std::size_t n=0) : fmt(StorageFormat::Dense), n(n), kl(0), ku(0), offset(0), rank(0), vals(n*n,static_cast<T>(0)) {};
+    // factories -----------------
+    //! Dense operator from a row-major (n x n) matrix
+    static OperatorStorage dense(std::size_t n, const std::vector<T>& L);
+    //! Banded operator, band is row-major with kl+ku+1 entries per row
+    static OperatorStorage banded(std::size_t n, std::size_t kl, std::size_t ku, const std::vector<T>& band);
+    static OperatorStorage identity(std::size_t n) { return banded(n,0,0,std::vector<T>(n,static_cast<T>(1))); }
+    //! Parity-split upper triangular operator with rank separable terms
+    static OperatorStorage parity_triangular(std::size_t n, std::size_t offset, std::size_t rank, const std::vector<T>& u, const std::vector<T>& v);
+    static OperatorStorage csr(std::size_t n, const std::vector<std::size_t>& row_ptr, const std::vector<std::size_t>& cols, const std::vector<T>& vals);
+    /**
+     * @brief Store a dense matrix in the format taking the least memory
+     * Exact zeros are dropped, the choice is between Banded, CSR and Dense.
+     */
+    static OperatorStorage compress(std::size_t n, const std::vector<T>& L);
+    // access ----------------
+    inline StorageFormat format() const { return fmt; }
+    inline std::size_t size() const { return n; }
+    inline std::size_t lower_bandwidth() const { return kl; }
+    inline std::size_t upper_bandwidth() const { return ku; }
+    //! Bytes used by the matrix data
+    inline std::size_t memory_bytes() const {
+      return sizeof(T)*(vals.size()+u.size()+v.size()) + sizeof(std::size_t)*(row_ptr.size()+cols.size());
+    }
+    //! View of the matrix arrays, valid while this object is alive and unmodified
+    inline OperatorView<T> view() const {
+      OperatorView<T> V;
+      V.fmt = fmt;
+      V.n = n;
+      V.kl = kl;
+      V.ku = ku;
+      V.offset = offset;
+      V.rank = rank;
+      V.vals = Span<const T>(vals);
+      V.u = Span<const T>(u);
+      V.v = Span<const T>(v);
+      V.row_ptr = Span<const std::size_t>(row_ptr);
+      V.cols = Span<const std::size_t>(cols);
+      return V;
+    }
+    //! Owning copy of the matrix behind a view
+    static OperatorStorage from_view(const OperatorView<T>& V);
+    //! Copy of an operator of another scalar type in the same format, entries rounded to T
+    template <class U> static OperatorStorage converted(const OperatorStorage<U>& A);
+    //! Entry (i,j), O(1) for Dense/Banded/ParityTriangular, O(log nnz_row) for CSR
+    inline T get(std::size_t i, std::size_t j) const;
+    //! Row-major dense copy of the matrix
+    inline void to_dense(std::vector<T>& L) const;
+    /**
+     * @brief Matrix-vector product y = L x with the kernel of the storage format
+     * @param x input, n entries
+     * @param y output, n entries, must not alias x
+     */
+    inline void apply(const T* x, T* y) const {
+      std::fill(y,y+n,static_cast<T>(0));
+      apply_add(x,y,static_cast<T>(1));
+    }
+    //! Accumulating product y += alpha L x, y must not alias x
+    inline void apply_add(const T* x, T* y, const T& alpha) const { view().apply_add(x,y,alpha); }
+    // arithmetic ----------------
+    inline OperatorStorage scaled(const T& alpha) const;
+    //! A + B, in the format of A and B if both agree, otherwise compressed
+    static OperatorStorage sum(const OperatorStorage& A, const OperatorStorage& B);
+    //! A * B (apply B first), banded if both are, otherwise compressed
+    static OperatorStorage product(const OperatorStorage& A, const OperatorStorage& B);
+  };
+
+  template <class T> OperatorStorage<T> OperatorStorage<T>::dense(std::size_t n, const std::vector<T>& L)
+  {
+    assert(L.size()==n*n);
+    OperatorStorage S;
+    S.n = n;
+    S.vals = L;
+    return S;
+  }
+
+  template <class T> OperatorStorage<T> OperatorStorage<T>::banded(std::size_t n, std::size_t kl, std::size_t ku, const std::vector<T>& band)
+  {
+    assert(band.size()==n*(kl+ku+1));
+    OperatorStorage S;
+    S.fmt = StorageFormat::Banded;
+    S.n = n;
+    S.kl = kl;
+    S.ku = ku;
+    S.vals = band;
+    return S;
+  }
+
+  template <class T> OperatorStorage<T> OperatorStorage<T>::parity_triangular(std::size_t n, std::size_t offset, std::size_t rank, const std::vector<T>& u, const std::vector<T>& v)
+  {
+    assert(u.size()==rank*n && v.size()==rank*n);
+    OperatorStorage S;
+    S.fmt = StorageFormat::ParityTriangular;
+    S.n = n;
+    S.offset = offset;
+    S.rank = rank;
+    S.u = u;
+    S.v = v;
+    return S;
+  }
+
+  template <class T> OperatorStorage<T> OperatorStorage<T>::csr(std::size_t n, const std::vector<std::size_t>& row_ptr, const std::vector<std::size_t>& cols, const std::vector<T>& vals)
+  {
+    assert(row_ptr.size()==n+1 && cols.size()==vals.size() && row_ptr[n]==vals.size());
+    OperatorStorage S;
+    S.fmt = StorageFormat::CSR;
+    S.n = n;
+    S.row_ptr = row_ptr;
+    S.cols = cols;
+    S.vals = vals;
+    return S;
+  }
+
+  template <class T> OperatorStorage<T> OperatorStorage<T>::compress(std::size_t n, const std::vector<T>& L)
+  {
+    assert(L.size()==n*n);
+    std::size_t nnz = 0, lo = 0, up = 0;
+    for (std::size_t i=0; i<n; i++)
+      for (std::size_t j=0; j<n; j++)
+        if (L[i*n+j]!=static_cast<T>(0)) {
+          nnz++;
+          if (i>j) lo = std::max(lo,i-j);
+          else up = std::max(up,j-i);
+        }
+    const std::size_t bytes_dense = sizeof(T)*n*n;
+    const std::size_t bytes_band = sizeof(T)*n*(lo+up+1);
+    const std::size_t bytes_csr = (sizeof(T)+sizeof(std::size_t))*nnz + sizeof(std::size_t)*(n+1);
+    if (bytes_band <= bytes_csr && bytes_band < bytes_dense) {
+      std::vector<T> band(n*(lo+up+1),static_cast<T>(0));
+      for (std::size_t i=0; i<n; i++)
+        for (std::size_t j=(i>lo ? i-lo : 0); j<std::min(n,i+up+1); j++) band[i*(lo+up+1)+j+lo-i] = L[i*n+j];
+      return banded(n,lo,up,band);
+    }
+    if (bytes_csr < bytes_dense) {
+      std::vector<std::size_t> ptr(1,0), c;
+      std::vector<T> val;
+      for (std::size_t i=0; i<n; i++) {
+        for (std::size_t j=0; j<n; j++)
+          if (L[i*n+j]!=static_cast<T>(0)) {
+            c.push_back(j);
+            val.push_back(L[i*n+j]);
+          }
+        ptr.push_back(val.size());
+      }
+      return csr(n,ptr,c,val);
+    }
+    return dense(n,L);
+  }
+
+  template <class T> inline T OperatorStorage<T>::get(std::size_t i, std::size_t j) const
+  {
+    switch (fmt) {
+    case StorageFormat::Dense:
+      return vals[i*n+j];
+    case StorageFormat::Banded:
+      if (j+kl<i || j>i+ku) return static_cast<T>(0);
+      return vals[i*(kl+ku+1)+j+kl-i];
+    case StorageFormat::ParityTriangular: {
+      if (j<i+offset || (j-i-offset)%2) return static_cast<T>(0);
+      T val = static_cast<T>(0);
+      for (std::size_t r=0; r<rank; r++) val += u[r*n+i]*v[r*n+j];
+      return val;
+    }
+    case StorageFormat::CSR: {
+      auto first = cols.begin()+row_ptr[i], last = cols.begin()+row_ptr[i+1];
+      auto it = std::lower_bound(first,last,j);
+      return (it!=last && *it==j) ? vals[it-cols.begin()] : static_cast<T>(0);
+    }
+    }
+    return static_cast<T>(0);
+  }
+
+  template <class T> inline void OperatorStorage<T>::to_dense(std::vector<T>& L) const
+  {
+    L.assign(n*n,static_cast<T>(0));
+    for (std::size_t i=0; i<n; i++)
+      for (std::size_t j=0; j<n; j++) L[i*n+j] = get(i,j);
+  }
+
+  template <class T> OperatorStorage<T> OperatorStorage<T>::from_view(const OperatorView<T>& V)
+  {
+    OperatorStorage S;
+    S.fmt = V.fmt;
+    S.n = V.n;
+    S.kl = V.kl;
+    S.ku = V.ku;
+    S.offset = V.offset;
+    S.rank = V.rank;
+    S.vals.assign(V.vals.begin(),V.vals.end());
+    S.u.assign(V.u.begin(),V.u.end());
+    S.v.assign(V.v.begin(),V.v.end());
+    S.row_ptr.assign(V.row_ptr.begin(),V.row_ptr.end());
+    S.cols.assign(V.cols.begin(),V.cols.end());
+    return S;
+  }
+
+  template <class T> template <class U> OperatorStorage<T> OperatorStorage<T>::converted(const OperatorStorage<U>& A)
+  {
+    const OperatorView<U> V = A.view();
+    OperatorStorage S;
+    S.fmt = V.fmt;
+    S.n = V.n;
+    S.kl = V.kl;
+    S.ku = V.ku;
+    S.offset = V.offset;
+    S.rank = V.rank;
+    S.vals.assign(V.vals.begin(),V.vals.end());
+    S.u.assign(V.u.begin(),V.u.end());
+    S.v.assign(V.v.begin(),V.v.end());
+    S.row_ptr.assign(V.row_ptr.begin(),V.row_ptr.end());
+    S.cols.assign(V.cols.begin(),V.cols.end());
+    return S;
+  }
+
+  template <class T> inline void OperatorView<T>::apply_add(const T* x, T* y, const T& alpha) const
+  {
+    switch (fmt) {
+    case StorageFormat::Dense:
+      for (std::size_t i=0; i<n; i++) {
+        const T* row = &vals[i*n];
+        T acc = static_cast<T>(0);
+        for (std::size_t j=0; j<n; j++) acc += row[j]*x[j];
+        y[i] += alpha*acc;
+      }
+      break;
+    case StorageFormat::Banded: {
+      const std::size_t w = kl+ku+1;
+      for (std::size_t i=0; i<n; i++) {
+        const std::size_t j0 = (i>kl) ? i-kl : 0, j1 = std::min(n,i+ku+1);
+        const T* row = &vals[i*w+kl-i];
+        T acc = static_cast<T>(0);
+        for (std::size_t j=j0; j<j1; j++) acc += row[j]*x[j];
+        y[i] += alpha*acc;
+      }
+      break;
+    }
+    case StorageFormat::ParityTriangular:
+      // y_i = sum_r u_r(i) S_r(i+offset), S_r(k) = v_r(k) x_k + S_r(k+2), built backwards
+      for (std::size_t r=0; r<rank; r++) {
+        const T* ur = &u[r*n];
+        const T* vr = &v[r*n];
+        T s_even = static_cast<T>(0), s_odd = static_cast<T>(0);
+        for (std::size_t k=n; k-- > 0; ) {
+          T& s = (k%2) ? s_odd : s_even;
+          s += vr[k]*x[k];
+          if (k>=offset) y[k-offset] += alpha*ur[k-offset]*s;
+        }
+      }
+      break;
+    case StorageFormat::CSR:
+      for (std::size_t i=0; i<n; i++) {
+        T acc = static_cast<T>(0);
+        for (std::size_t k=row_ptr[i]; k<row_ptr[i+1]; k++) acc += vals[k]*x[cols[k]];
+        y[i] += alpha*acc;
+      }
+      break;
+    }
+  }
+
+  template <class T> inline OperatorStorage<T> OperatorStorage<T>::scaled(const T& alpha) const
+  {
+    OperatorStorage S(*this);
+    for (auto& val : S.vals) val *= alpha;
+    for (auto& val : S.u) val *= alpha;
+    return S;
+  }
+
+  template <class T> OperatorStorage<T> OperatorStorage<T>::sum(const OperatorStorage& A, const OperatorStorage& B)
+  {
+    assert(A.n==B.n);
+    const std::size_t n = A.n;
+    if (A.fmt==B.fmt) {
+      switch (A.fmt) {
+      case StorageFormat::Dense: {
+        OperatorStorage S(A);
+        for (std::size_t k=0; k<S.vals.size(); k++) S.vals[k] += B.vals[k];
+        return S;
+      }
+      case StorageFormat::Banded: {
+        const std::size_t lo = std::max(A.kl,B.kl), up = std::max(A.ku,B.ku), w = lo+up+1;
+        std::vector<T> band(n*w,static_cast<T>(0));
+        for (const OperatorStorage* X : {&A,&B}) {
+          const std::size_t wx = X->kl+X->ku+1;
+          for (std::size_t i=0; i<n; i++)
+            for (std::size_t d=0; d<wx; d++) band[i*w+d+lo-X->kl] += X->vals[i*wx+d];
+        }
+        return banded(n,lo,up,band);
+      }
+      case StorageFormat::ParityTriangular:
+        if (A.offset==B.offset) {
+          std::vector<T> u(A.u), v(A.v);
+          u.insert(u.end(),B.u.begin(),B.u.end());
+          v.insert(v.end(),B.v.begin(),B.v.end());
+          return parity_triangular(n,A.offset,A.rank+B.rank,u,v);
+        }
+        break;
+      case StorageFormat::CSR:
+        break;
+      }
+    }
+    std::vector<T> LA, LB;
+    A.to_dense(LA);
+    B.to_dense(LB);
+    for (std::size_t k=0; k<LA.size(); k++) LA[k] += LB[k];
+    return compress(n,LA);
+  }
+
+  template <class T> OperatorStorage<T> OperatorStorage<T>::product(const OperatorStorage& A, const OperatorStorage& B)
+  {
+    assert(A.n==B.n);
+    const std::size_t n = A.n;
+    if (A.fmt==StorageFormat::Banded && B.fmt==StorageFormat::Banded) {
+      const std::size_t lo = std::min(n-1,A.kl+B.kl), up = std::min(n-1,A.ku+B.ku), w = lo+up+1;
+      std::vector<T> band(n*w,static_cast<T>(0));
+      for (std::size_t i=0; i<n; i++)
+        for (std::size_t k=(i>A.kl ? i-A.kl : 0); k<std::min(n,i+A.ku+1); k++) {
+          const T a = A.get(i,k);
+          for (std::size_t j=(k>B.kl ? k-B.kl : 0); j<std::min(n,k+B.ku+1); j++) band[i*w+j+lo-i] += a*B.get(k,j);
+        }
+      return banded(n,lo,up,band);
+    }
+    // column j of A*B is A applied to column j of B, O(n * cost(A)) after densifying B
+    std::vector<T> LB, C(n*n), col(n), out(n);
+    B.to_dense(LB);
+    for (std::size_t j=0; j<n; j++) {
+      for (std::size_t i=0; i<n; i++) col[i] = LB[i*n+j];
+      A.apply(col.data(),out.data());
+      for (std::size_t i=0; i<n; i++) C[i*n+j] = out[i];
+    }
+    return compress(n,C);
+  }
+
+} // namespace FunctionalBases
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * @file parallel.hpp
+ * @brief Minimal persistent thread pool and parallel_for.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Workers are started once and sleep between jobs, so parallel loops over
+ * right-hand sides, elements or batches do not pay for thread creation.
+ * Indices are handed out dynamically from an atomic counter; the calling
+ * thread takes part in the work. A parallel_for issued from inside a job
+ * runs serially on the calling thread.
+ */
+#ifndef _MY_SPECTRE_PARALLEL_HPP
+#define _MY_SPECTRE_PARALLEL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+namespace Parallel {
+
+  namespace detail {
+    //! True on pool workers and on a caller while it runs a job
+    inline bool& in_parallel_region() {
+      static thread_local bool flag = false;
+      return flag;
+    }
+  }
+
+  //! Number of hardware threads, at least one
+  inline unsigned int default_threads()
+  {
+    return std::max(1u,std::thread::hardware_concurrency());
+  }
+
+  class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cv_job, cv_done;
+    std::function<void()> job;
+    std::size_t generation = 0;   //! incremented for every job
+    unsigned int wanted = 0;      //! workers taking part in the current job
+    unsigned int active = 0;      //! workers still running the current job
+    bool stop = false;
+    std::mutex submit;            //! one job at a time
+
+    void worker_loop(unsigned int id) {
+      detail::in_parallel_region() = true;
+      std::size_t seen = 0;
+      for (;;) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_job.wait(lock,[&]() { return stop || generation!=seen; });
+        if (stop) return;
+        seen = generation;
+        if (id>=wanted) continue;
+        std::function<void()> j = job;
+        lock.unlock();
+        j();
+        lock.lock();
+        if (--active==0) cv_done.notify_all();
+      }
+    }
+  public:
+    //! Pool with nworkers threads besides the caller
+    explicit ThreadPool(unsigned int nworkers) {
+      for (unsigned int id=0; id<nworkers; id++) workers.emplace_back([this,id]() { worker_loop(id); });
+    }
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+      }
+      cv_job.notify_all();
+      for (auto& w: workers) w.join();
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    //! Shared pool with default_threads()-1 workers
+    static ThreadPool& global() {
+      static ThreadPool pool(default_threads()-1);
+      return pool;
+    }
+    unsigned int size() const { return workers.size(); }
+    /**
+     * @brief Call f(i) for every i in [0,n), on at most nthreads threads
+     * Returns once all calls have finished.
+     */
+    template <class F> void parallel_for(std::size_t n, F f, unsigned int nthreads) {
+      nthreads = std::min<std::size_t>(std::min(nthreads,size()+1),n);
+      if (nthreads<=1 || detail::in_parallel_region()) {
+        for (std::size_t i=0; i<n; i++) f(i);
+        return;
+      }
+      std::lock_guard<std::mutex> guard(submit);
+      // the job captures a single pointer so std::function stores it without allocating
+      struct Loop {
+        std::atomic<std::size_t> next{0};
+        std::size_t n;
+        F* f;
+        void operator()() { for (std::size_t i; (i = next++)<n;) (*f)(i); }
+      } loop;
+      loop.n = n;
+      loop.f = &f;
+      auto body = [&loop]() { loop(); };
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        job = body;
+        wanted = active = nthreads-1;
+        generation++;
+      }
+      cv_job.notify_all();
+      detail::in_parallel_region() = true;
+      body();
+      detail::in_parallel_region() = false;
+      std::unique_lock<std::mutex> lock(mtx);
+      cv_done.wait(lock,[&]() { return active==0; });
+      job = nullptr;
+    }
+  };
+
+  //! parallel_for on the global pool
+  template <class F> inline void parallel_for(std::size_t n, F f, unsigned int nthreads = default_threads())
+  {
+    ThreadPool::global().parallel_for(n,f,nthreads);
+  }
+
+}
+
+#endif
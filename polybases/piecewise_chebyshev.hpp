@@ -0,0 +1,365 @@
+/**
+ * @file piecewise_chebyshev.hpp
+ * @brief Multi-domain (spectral element) Chebyshev basis.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * [a,b] is split into K elements, each mapped affinely to [-1,1] and
+ * expanded in Chebyshev polynomials of order Ne. Sharp features then only
+ * need a fine resolution locally, and every transform costs K transforms of
+ * order Ne instead of one of order K*Ne.
+ * Layout:
+ *   - nodes: the K*Ne+1 distinct Gauss-Lobatto nodes of all elements in
+ *     ascending order, neighbouring elements share their interface node,
+ *     so N = K*Ne and a Function keeps one value per interface;
+ *   - coefficients: K blocks of Ne+1 Chebyshev coefficients, element-major.
+ * Going back from coefficients to values, the two one-sided values at an
+ * interface are averaged, which keeps functions continuous after operators
+ * that are not (e.g. derivatives of functions with a kink).
+ * All elements borrow the same reference ChebyshevBase(Ne) and reference
+ * operators from the PlanRegistry; transforms, evaluation and operator
+ * application run over elements on the Parallel thread pool.
+ * Operators are block diagonal, one block per element, and act element by
+ * element. Boundary value problems couple the elements in the solver:
+ * ODE::ODESolver, and through it the IMEX integrators, replaces the last tau
+ * rows of the element blocks by continuity of u and u' at every interface,
+ * see chebyshev_elements().
+ */
+#ifndef _MY_SPECTRE_PIECEWISE_CHEBYSHEV_HPP
+#define _MY_SPECTRE_PIECEWISE_CHEBYSHEV_HPP
+
+#include <array>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include "polybases.hpp"
+#include "plan_registry.hpp"
+#include "parallel.hpp"
+#include "chebyshev.hpp"
+
+namespace FunctionalBases {
+
+  /**
+   * @brief Piecewise Chebyshev basis on K elements.
+   * @tparam T scalar type
+   * @tparam K number of elements
+   */
+  template <class T, unsigned int K>
+  class PiecewiseChebyshevBase final : public FunctionalBase<T> {
+    unsigned int N;          //! K*Ne
+    unsigned int Ne;         //! order inside each element
+    std::vector<T> breaks;   //! K+1 element boundaries, ascending
+    std::vector<T> nodes;    //! global nodes, ascending
+    std::vector<T> weights;  //! reference Gauss-Lobatto weights scaled by h/2, summed at interfaces
+    std::shared_ptr<const ChebyshevBase<T>> ref; //! reference element plan
+    unsigned int nthreads;   //! threads used over elements
+    //! Points evaluated per task by evaluate_series_batch
+    static constexpr std::size_t eval_chunk = 2048;
+  public:
+    typedef T value_type;
+    // constructors ----------------------
+    /**
+     * @brief K equal elements on [a,b]
+     * @param N total order, a multiple of K
+     * @param a left end
+     * @param b right end
+     * @param nthreads threads of the global pool used over elements
+     */
+    PiecewiseChebyshevBase(unsigned int N, T a=static_cast<T>(-1), T b=static_cast<T>(1), unsigned int nthreads=Parallel::default_threads()):
+      PiecewiseChebyshevBase(N,uniform_breaks(a,b),nthreads) {}
+    /**
+     * @brief Elements between given breakpoints
+     * @param N total order, a multiple of K
+     * @param breaks K+1 ascending element boundaries
+     * @param nthreads threads of the global pool used over elements
+     */
+    PiecewiseChebyshevBase(unsigned int N, const std::vector<T>& breaks, unsigned int nthreads=Parallel::default_threads()):
+      FunctionalBase<T>(N), N(N), Ne(N/K), breaks(breaks), nthreads(nthreads) {
+      assert(K>0 && N%K==0 && Ne>0 && breaks.size()==K+1);
+      ref = PlanRegistry::instance().get_basis<ChebyshevBase<T>>(Ne);
+      calc_nodes_and_weights();
+    }
+    // class methods ---------------------
+    inline void calc_nodes_and_weights();
+    //! Element containing x, points outside [a,b] go to the nearest element
+    inline unsigned int element(const T& x) const {
+      const auto it = std::upper_bound(breaks.begin()+1,breaks.end()-1,x);
+      return static_cast<unsigned int>(it-breaks.begin()-1);
+    }
+    //! Reference coordinate of x in element k
+    inline T local_coordinate(const T& x, unsigned int k) const {
+      return (static_cast<T>(2)*x - breaks[k] - breaks[k+1]) / (breaks[k+1] - breaks[k]);
+    }
+    /**
+     * @brief Basis function n: T_m on element k for n = k(Ne+1)+m, zero elsewhere
+     */
+    inline T evaluate_function(const T& x, const unsigned int n) const {
+      const unsigned int k = n/(Ne+1);
+      if (element(x)!=k) return static_cast<T>(0);
+      return Chebyshev::Tn<T>(local_coordinate(x,k),n%(Ne+1));
+    };
+    //! Clenshaw summation of the series of the element containing x
+    inline T evaluate_series(const T& x, const std::vector<T>& coeffs) const {
+      assert(coeffs.size()==num_coeffs());
+      const unsigned int k = element(x);
+      return Chebyshev::clenshaw<T>(local_coordinate(x,k),&coeffs[k*(Ne+1)],Ne+1);
+    };
+    //! Evaluation at a batch of points, chunks of points run in parallel
+    inline void evaluate_series_batch(Span<const T> x, const std::vector<T>& coeffs, Span<T> out) const;
+    /**
+     * @brief Per-element spectral coefficients from the values at the global nodes
+     * @param f N+1 values at the nodes
+     * @param ftilde output, K(Ne+1) coefficients
+     */
+    inline void calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde) const;
+    /**
+     * @brief Values at the global nodes, averaged over the two elements at each interface
+     * @param ftilde K(Ne+1) coefficients
+     * @param f output, N+1 values
+     */
+    inline void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const;
+    //! Allocation-free transforms into caller-provided buffers, element scratch is thread-local
+    inline void calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const;
+    inline void calc_function_values(Span<const T> ftilde, Span<T> f) const;
+    /**
+     * @brief Block-diagonal operators, block k = alpha_k I + beta_k R with R the reference operator:
+     *   d/dx  = (2/h_k) D,   d2/dx2 = (2/h_k)^2 D2,   x = m_k I + (h_k/2) X,
+     * h_k and m_k the width and midpoint of element k. Stored as CSR.
+     * Elements are not coupled here, the solvers add the interface rows.
+     */
+    inline OperatorStorage<T> deriv_storage() const { return block_storage(OperatorKind::Derivative); }
+    inline OperatorStorage<T> second_deriv_storage() const { return block_storage(OperatorKind::SecondDerivative); }
+    inline OperatorStorage<T> times_x_storage() const { return block_storage(OperatorKind::TimesX); }
+    inline void calc_deriv(std::vector<T>& Lij) const { deriv_storage().to_dense(Lij); }
+    inline void calc_second_deriv(std::vector<T>& Lij) const { second_deriv_storage().to_dense(Lij); }
+    inline void calc_times_x(std::vector<T>& Lij) const { times_x_storage().to_dense(Lij); }
+    /**
+     * @brief Apply an operator element by element, in parallel over elements
+     * Uses the structured reference operator of each block (O(Ne) per element
+     * for the derivatives) rather than the assembled CSR matrix.
+     * @param kind operator
+     * @param in K(Ne+1) coefficients
+     * @param out K(Ne+1) coefficients, must not alias in
+     */
+    inline void apply_operator(OperatorKind kind, Span<const T> in, Span<T> out) const;
+    /**
+     * @brief k-th derivative by the O(Ne) coefficient recurrence in every element,
+     * scaled by (2/h_k)^k; out may alias ftilde.
+     */
+    inline void differentiate_coeffs(Span<const T> ftilde, Span<T> out, unsigned int k=1) const;
+    /**
+     * @brief Antiderivative vanishing at a, continuous across elements.
+     * Each element block is the truncated reference antiderivative scaled by
+     * h_k/2, shifted by the integral over the elements to its left; out may alias ftilde.
+     */
+    inline void antiderivative_coeffs(Span<const T> ftilde, Span<T> out) const;
+    //! Dealiased product, element by element with the reference multiply_coeffs; c may alias a or b
+    inline void multiply_coeffs(Span<const T> a, Span<const T> b, Span<T> c) const {
+      assert(a.size()==num_coeffs() && b.size()==num_coeffs() && c.size()==num_coeffs());
+      const std::size_t ne = Ne+1;
+      Parallel::parallel_for(K,[&](std::size_t e) {
+        ref->multiply_coeffs(a.subspan(e*ne,ne),b.subspan(e*ne,ne),c.subspan(e*ne,ne));
+      },nthreads);
+    }
+    //! Integral over [a,b], the sum of the Clenshaw-Curtis integrals of the elements
+    inline T integrate_coeffs(Span<const T> ftilde) const {
+      assert(ftilde.size()==num_coeffs());
+      T sum = static_cast<T>(0);
+      for (unsigned int k=0; k<K; k++)
+        sum += static_cast<T>(0.5)*(breaks[k+1]-breaks[k])*Chebyshev::integral(ftilde.data()+k*(Ne+1),Ne+1);
+      return sum;
+    }
+    // access ----------------
+    inline void get_nodes(std::vector<T>& pts) const { pts = nodes; };
+    inline void get_weights(std::vector<T>& w) const { w = weights; };
+    inline const std::vector<T>& get_nodes() const { return nodes; };
+    inline const std::vector<T>& get_weights() const { return weights; };
+    inline void get_breaks(std::vector<T>& b) const { b = breaks; };
+    inline void print_nodes() const {
+      std::cout << "Length of nodes vector: " << nodes.size() << "\n";
+      for (const auto& val : nodes) std::cout << val << " ";
+      std::cout << "\n";
+    }
+    inline void print_weights() const {
+      std::cout << "Length of weights vector: " << weights.size() << "\n";
+      for (const auto& val : weights) std::cout << val << " ";
+      std::cout << "\n";
+    }
+    inline int get_N() const { return N; }
+    inline unsigned int get_element_order() const { return Ne; }
+    inline unsigned int num_elements() const { return K; }
+    inline std::size_t num_coeffs() const { return K*(Ne+1); }
+    inline unsigned int get_num_threads() const { return nthreads; }
+    inline void set_num_threads(unsigned int n) { nthreads = n; }
+    //! The breakpoints, keeps operators of different domains apart in the PlanRegistry
+    inline std::string plan_key() const { return exact_plan_key(breaks.data(),breaks.size()); }
+    //! Every element holds a Chebyshev series on [breaks[k],breaks[k+1]]
+    inline std::vector<T> chebyshev_elements() const { return breaks; }
+  private:
+    static inline std::vector<T> uniform_breaks(T a, T b) {
+      std::vector<T> br(K+1);
+      for (unsigned int k=0; k<=K; k++) br[k] = a + (b-a)*static_cast<T>(k)/static_cast<T>(K);
+      return br;
+    }
+    //! Scaling alpha_k, beta_k of block k of an operator, see deriv_storage
+    inline void block_scaling(OperatorKind kind, unsigned int k, T& alpha, T& beta) const {
+      const T h = breaks[k+1]-breaks[k];
+      alpha = static_cast<T>(0);
+      beta = static_cast<T>(1);
+      switch (kind) {
+      case OperatorKind::Derivative: beta = static_cast<T>(2)/h; break;
+      case OperatorKind::SecondDerivative: beta = static_cast<T>(4)/(h*h); break;
+      case OperatorKind::TimesX:
+        alpha = static_cast<T>(0.5)*(breaks[k]+breaks[k+1]);
+        beta = static_cast<T>(0.5)*h;
+        break;
+      }
+    }
+    inline OperatorStorage<T> block_storage(OperatorKind kind) const;
+  };
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::calc_nodes_and_weights()
+  {
+    std::vector<T> xi, wi;
+    ref->get_nodes(xi);
+    ref->get_weights(wi);
+    nodes.assign(N+1,static_cast<T>(0));
+    weights.assign(N+1,static_cast<T>(0));
+    for (unsigned int k=0; k<K; k++) {
+      const T h = breaks[k+1]-breaks[k], mid = static_cast<T>(0.5)*(breaks[k]+breaks[k+1]);
+      // local node i = Ne-j sits at global index k Ne + j, ascending in x
+      for (unsigned int j=0; j<=Ne; j++) {
+        nodes[k*Ne+j] = mid + static_cast<T>(0.5)*h*xi[Ne-j];
+        weights[k*Ne+j] += static_cast<T>(0.5)*h*wi[Ne-j];
+      }
+    }
+    for (unsigned int k=0; k<=K; k++) nodes[k*Ne] = breaks[k];
+  }
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde) const
+  {
+    ftilde.resize(num_coeffs());
+    calc_spectral_coeffs(Span<const T>(f),Span<T>(ftilde));
+  }
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const
+  {
+    f.resize(N+1);
+    calc_function_values(Span<const T>(ftilde),Span<T>(f));
+  }
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const
+  {
+    assert(f.size()==N+1 && ftilde.size()==num_coeffs());
+    Parallel::parallel_for(K,[&](std::size_t k) {
+      static thread_local std::vector<T> loc;
+      loc.resize(Ne+1);
+      for (unsigned int i=0; i<=Ne; i++) loc[i] = f[k*Ne+Ne-i];
+      ref->calc_spectral_coeffs(Span<const T>(loc),ftilde.subspan(k*(Ne+1),Ne+1));
+    },nthreads);
+  }
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::calc_function_values(Span<const T> ftilde, Span<T> f) const
+  {
+    assert(ftilde.size()==num_coeffs() && f.size()==N+1);
+    // one-sided values at the left and right end of every element
+    std::array<T,K> left, right;
+    Parallel::parallel_for(K,[&](std::size_t k) {
+      static thread_local std::vector<T> loc;
+      loc.resize(Ne+1);
+      ref->calc_function_values(ftilde.subspan(k*(Ne+1),Ne+1),Span<T>(loc));
+      for (unsigned int j=1; j<Ne; j++) f[k*Ne+j] = loc[Ne-j];
+      left[k] = loc[Ne];
+      right[k] = loc[0];
+    },nthreads);
+    f[0] = left[0];
+    f[N] = right[K-1];
+    for (unsigned int k=1; k<K; k++) f[k*Ne] = static_cast<T>(0.5)*(right[k-1]+left[k]);
+  }
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::evaluate_series_batch(Span<const T> x, const std::vector<T>& coeffs, Span<T> out) const
+  {
+    assert(x.size()==out.size() && coeffs.size()==num_coeffs());
+    const std::size_t nchunks = (x.size()+eval_chunk-1)/eval_chunk;
+    Parallel::parallel_for(nchunks,[&](std::size_t c) {
+      const std::size_t p1 = std::min(x.size(),(c+1)*eval_chunk);
+      for (std::size_t p=c*eval_chunk; p<p1; p++) out[p] = evaluate_series(x[p],coeffs);
+    },nthreads);
+  }
+
+  template <class T, unsigned int K> inline OperatorStorage<T> PiecewiseChebyshevBase<T,K>::block_storage(OperatorKind kind) const
+  {
+    const std::shared_ptr<const OperatorStorage<T>> R = PlanRegistry::instance().get_operator<T>(*ref,kind);
+    const std::size_t ne = Ne+1;
+    std::vector<std::size_t> row_ptr(1,0), cols;
+    std::vector<T> vals;
+    for (unsigned int k=0; k<K; k++) {
+      T alpha, beta;
+      block_scaling(kind,k,alpha,beta);
+      for (std::size_t i=0; i<ne; i++) {
+        for (std::size_t j=0; j<ne; j++) {
+          const T val = beta*R->get(i,j) + (i==j ? alpha : static_cast<T>(0));
+          if (val==static_cast<T>(0)) continue;
+          cols.push_back(k*ne+j);
+          vals.push_back(val);
+        }
+        row_ptr.push_back(vals.size());
+      }
+    }
+    return OperatorStorage<T>::csr(num_coeffs(),row_ptr,cols,vals);
+  }
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::apply_operator(OperatorKind kind, Span<const T> in, Span<T> out) const
+  {
+    assert(in.size()==num_coeffs() && out.size()==num_coeffs());
+    const std::shared_ptr<const OperatorStorage<T>> R = PlanRegistry::instance().get_operator<T>(*ref,kind);
+    const std::size_t ne = Ne+1;
+    Parallel::parallel_for(K,[&](std::size_t k) {
+      T alpha, beta;
+      block_scaling(kind,k,alpha,beta);
+      const T* xk = in.data()+k*ne;
+      T* yk = out.data()+k*ne;
+      for (std::size_t i=0; i<ne; i++) yk[i] = alpha*xk[i];
+      R->apply_add(xk,yk,beta);
+    },nthreads);
+  }
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::differentiate_coeffs(Span<const T> ftilde, Span<T> out, unsigned int k) const
+  {
+    assert(ftilde.size()==num_coeffs() && out.size()==num_coeffs());
+    const std::size_t ne = Ne+1;
+    Parallel::parallel_for(K,[&](std::size_t e) {
+      const T* a = ftilde.data()+e*ne;
+      T* b = out.data()+e*ne;
+      if (k==0) std::copy(a,a+ne,b);
+      else Chebyshev::derivative_coeffs(a,b,ne);
+      for (unsigned int j=1; j<k; j++) Chebyshev::derivative_coeffs(b,b,ne);
+      const T scale = std::pow(static_cast<T>(2)/(breaks[e+1]-breaks[e]),static_cast<T>(k));
+      for (std::size_t i=0; i<ne; i++) b[i] *= scale;
+    },nthreads);
+  }
+
+  template <class T, unsigned int K> inline void PiecewiseChebyshevBase<T,K>::antiderivative_coeffs(Span<const T> ftilde, Span<T> out) const
+  {
+    assert(ftilde.size()==num_coeffs() && out.size()==num_coeffs());
+    const std::size_t ne = Ne+1;
+    Parallel::parallel_for(K,[&](std::size_t e) {
+      T* c = out.data()+e*ne;
+      Chebyshev::antiderivative_coeffs(ftilde.data()+e*ne,c,ne);
+      const T half_h = static_cast<T>(0.5)*(breaks[e+1]-breaks[e]);
+      for (std::size_t i=0; i<ne; i++) c[i] *= half_h;
+    },nthreads);
+    // T_n(1) = 1: the value at the right end of an element is the sum of its coefficients
+    T offset = static_cast<T>(0);
+    for (unsigned int e=0; e<K; e++) {
+      T* c = out.data()+e*ne;
+      T right = static_cast<T>(0);
+      for (std::size_t i=0; i<ne; i++) right += c[i];
+      c[0] += offset;
+      offset += right;
+    }
+  }
+
+} // namespace FunctionalBases
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * @file plan_registry.hpp
+ * @brief Process-wide cache of immutable basis plans and operator matrices.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Building a FunctionalBase computes nodes, weights and transform tables, and
+ * building an operator assembles its matrix. Both only depend on the basis
+ * type, the scalar type and N, so the registry builds them once and hands out
+ * shared pointers to const objects that any number of Functions and operators
+ * (on any thread) can borrow. Resampling matrices between two Chebyshev
+ * Gauss-Lobatto grids are cached the same way.
+ */
+#ifndef _MY_SPECTRE_PLAN_REGISTRY_HPP
+#define _MY_SPECTRE_PLAN_REGISTRY_HPP
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <tuple>
+#include <string>
+#include <typeindex>
+#include "polybases.hpp"
+#include "barycentric.hpp"
+
+namespace FunctionalBases {
+
+  //! Operator matrices that can be cached by the registry
+  enum class OperatorKind { Derivative, SecondDerivative, TimesX };
+
+  /**
+   * @brief Thread-safe registry of shared basis plans.
+   * Entries are keyed on (basis type, scalar type, N, kind, plan key) and
+   * never modified after insertion.
+   */
+  class PlanRegistry {
+    struct Key {
+      std::type_index basis;
+      std::type_index scalar;
+      unsigned int N;
+      int kind; //! -1 for the basis itself, OperatorKind otherwise
+      std::size_t variant; //! target order of a resampling
+      std::string params;  //! FunctionalBase::plan_key() of the basis
+      bool operator<(const Key& rhs) const {
+        return std::tie(basis,scalar,N,kind,variant,params) < std::tie(rhs.basis,rhs.scalar,rhs.N,rhs.kind,rhs.variant,rhs.params);
+      }
+    };
+    std::mutex mtx;
+    std::map<Key,std::shared_ptr<const void>> entries;
+    std::atomic<std::size_t> n_hits{0};
+    std::atomic<std::size_t> n_misses{0};
+
+    PlanRegistry() {};
+    /**
+     * @brief Look up key, building the entry with make() on a miss.
+     * The (possibly expensive) build runs outside the lock; if two threads
+     * miss concurrently the first insertion wins and both get the same object.
+     */
+    template <class V, class Make> std::shared_ptr<const V> lookup(const Key& key, Make make);
+    template <class T, class Basis> static Key operator_key(const Basis& basis, const OperatorKind kind) {
+      return Key{std::type_index(typeid(basis)),std::type_index(typeid(T)),static_cast<unsigned int>(basis.get_N()),static_cast<int>(kind),0,basis.plan_key()};
+    }
+  public:
+    PlanRegistry(const PlanRegistry&) = delete;
+    PlanRegistry& operator=(const PlanRegistry&) = delete;
+    //! The process-wide instance
+    static PlanRegistry& instance() {
+      static PlanRegistry registry;
+      return registry;
+    }
+    /**
+     * @brief Shared basis of type FuncBase and order N, built as FuncBase(N) on first use.
+     * @param N order of the basis
+     */
+    template <class FuncBase> std::shared_ptr<const FuncBase> get_basis(const unsigned int N);
+    /**
+     * @brief Shared operator of a basis, in the storage format chosen by the basis.
+     * @param basis basis the operator is assembled from, only its dynamic type, N and plan_key() enter the key.
+     * Either a FunctionalBase or a StaticBasis, whose storage calls are then bound at compile time.
+     * @param kind which operator
+     */
+    template <class T, class Basis> std::shared_ptr<const OperatorStorage<T>> get_operator(const Basis& basis, const OperatorKind kind);
+    /**
+     * @brief Seed the cache with a prebuilt operator, e.g. one loaded from an archive (io/archive.hpp).
+     * Later get_operator calls for the same basis and kind return it without assembling.
+     * @return the cached operator, an existing entry is kept
+     */
+    template <class T, class Basis> std::shared_ptr<const OperatorStorage<T>> preload_operator(const Basis& basis, const OperatorKind kind,
+                                                                                               std::shared_ptr<const OperatorStorage<T>> storage);
+    /**
+     * @brief Shared barycentric resampling from the Chebyshev grid of order Nfrom to that of order Nto.
+     * @param Nfrom order of the source basis
+     * @param Nto order of the target basis
+     */
+    template <class T> std::shared_ptr<const ResamplingMatrix<T>> get_resampling(const unsigned int Nfrom, const unsigned int Nto);
+    // statistics ------------------
+    inline std::size_t hits() const { return n_hits.load(); }
+    inline std::size_t misses() const { return n_misses.load(); }
+    inline std::size_t size() {
+      std::lock_guard<std::mutex> lock(mtx);
+      return entries.size();
+    }
+    inline void reset_counters() {
+      n_hits = 0;
+      n_misses = 0;
+    }
+    //! Drop all entries, objects still borrowed stay alive until released
+    inline void clear() {
+      std::lock_guard<std::mutex> lock(mtx);
+      entries.clear();
+    }
+  };
+
+  template <class V, class Make> std::shared_ptr<const V> PlanRegistry::lookup(const Key& key, Make make)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      auto it = entries.find(key);
+      if(it!=entries.end()){
+        n_hits++;
+        return std::static_pointer_cast<const V>(it->second);
+      }
+    }
+    n_misses++;
+    std::shared_ptr<const V> value = make();
+    std::lock_guard<std::mutex> lock(mtx);
+    auto ins = entries.emplace(key,value);
+    return std::static_pointer_cast<const V>(ins.first->second);
+  }
+
+  template <class FuncBase> std::shared_ptr<const FuncBase> PlanRegistry::get_basis(const unsigned int N)
+  {
+    typedef typename FuncBase::value_type T;
+    const Key key{std::type_index(typeid(FuncBase)),std::type_index(typeid(T)),N,-1,0,std::string()};
+    return lookup<FuncBase>(key, [N]() { return std::make_shared<const FuncBase>(N); });
+  }
+
+  template <class T, class Basis> std::shared_ptr<const OperatorStorage<T>> PlanRegistry::get_operator(const Basis& basis, const OperatorKind kind)
+  {
+    return lookup<OperatorStorage<T>>(operator_key<T>(basis,kind), [&basis,kind]() {
+      switch(kind){
+      case OperatorKind::Derivative: return std::make_shared<const OperatorStorage<T>>(basis.deriv_storage());
+      case OperatorKind::SecondDerivative: return std::make_shared<const OperatorStorage<T>>(basis.second_deriv_storage());
+      case OperatorKind::TimesX: break;
+      }
+      return std::make_shared<const OperatorStorage<T>>(basis.times_x_storage());
+    });
+  }
+
+  template <class T, class Basis> std::shared_ptr<const OperatorStorage<T>> PlanRegistry::preload_operator(const Basis& basis, const OperatorKind kind,
+                                                                                                          std::shared_ptr<const OperatorStorage<T>> storage)
+  {
+    assert(storage && storage->size()==basis.num_coeffs());
+    std::lock_guard<std::mutex> lock(mtx);
+    auto ins = entries.emplace(operator_key<T>(basis,kind),storage);
+    return std::static_pointer_cast<const OperatorStorage<T>>(ins.first->second);
+  }
+
+  template <class T> std::shared_ptr<const ResamplingMatrix<T>> PlanRegistry::get_resampling(const unsigned int Nfrom, const unsigned int Nto)
+  {
+    const Key key{std::type_index(typeid(ResamplingMatrix<T>)),std::type_index(typeid(T)),Nfrom,-1,Nto,std::string()};
+    return lookup<ResamplingMatrix<T>>(key, [this,Nfrom,Nto]() {
+      return std::make_shared<const ResamplingMatrix<T>>(*get_basis<ChebyshevBase<T>>(Nfrom),*get_basis<ChebyshevBase<T>>(Nto));
+    });
+  }
+
+} // namespace FunctionalBases
+
+#endif
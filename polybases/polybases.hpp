@@ -12,12 +12,59 @@
 
 #include <cmath>
 #include <vector>
+#include <memory>
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
+#include <sstream>
+#include <string>
 #include "chebyshev.hpp"
+#include "fft.hpp"
+#include "span.hpp"
+#include "simd_eval.hpp"
+#include "operator_storage.hpp"
+#include "parallel.hpp"
+#include "gemm.hpp"
+#include "instrument.hpp"
 
 namespace FunctionalBases {
 
+  /**
+   * @brief Algorithm used for the forward/inverse spectral transforms.
+   * Quadrature is the dense O(N^2) Gauss-Lobatto sum, DCT uses a fast
+   * type-I cosine transform over the same nodes (O(N log N)). Auto picks
+   * DCT from dct_threshold upwards.
+   */
+  enum class TransformType { Quadrature, DCT, Auto };
+
+  //! Order from which TransformType::Auto switches to the DCT path
+  constexpr unsigned int dct_threshold = 32;
+
+  /**
+   * @brief Memory layout of a batch of M functions sampled on the same grid.
+   * SoA stores each function contiguously, value i of function m at m*n+i;
+   * AoS interleaves them point by point, value i of function m at i*M+m.
+   */
+  enum class BatchLayout { SoA, AoS };
+
+  //! Order from which batched transforms in TransformType::Auto use the DCT instead of GEMM
+  constexpr unsigned int batch_dct_threshold = 256;
+
+  /**
+   * @brief Exact text form of n parameters, for FunctionalBase::plan_key.
+   * Hexadecimal floating point round-trips every value, so two keys are
+   * equal only if all parameters are.
+   */
+  template <class T> inline std::string exact_plan_key(const T* v, std::size_t n) {
+    std::ostringstream s;
+    s << std::hexfloat;
+    for (std::size_t i=0; i<n; i++) s << v[i] << ';';
+    return s.str();
+  }
+
+  //! Order from which products of series are dealiased on a padded grid instead of by direct convolution
+  constexpr unsigned int product_direct_threshold = 256;
+
   /**
    * @brief Abstract class 
    */
@@ -25,23 +72,132 @@ namespace FunctionalBases {
   class FunctionalBase {
     unsigned int N;
   public:
+    typedef T value_type;
     //constructor
     FunctionalBase<T>(unsigned int N) : N(N) {};
     // virtual member functions 
-    virtual inline T evaluate_function(const T& x, const unsigned int n){};
-    virtual void calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde){};
-    virtual void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f){};
-    virtual inline void calc_deriv(std::vector<T>& Lij) {};
-    virtual inline void calc_second_deriv(std::vector<T>& Lij) {};
-    virtual inline void calc_times_x(std::vector<T>& Lij) {};
+    virtual inline T evaluate_function(const T& x, const unsigned int n) const { return static_cast<T>(0); };
+    /**
+     * @brief Evaluate the series sum_n coeffs[n] phi_n(x).
+     * Generic fallback calling evaluate_function once per term, subclasses
+     * with a recurrence should override this.
+     */
+    virtual inline T evaluate_series(const T& x, const std::vector<T>& coeffs) const {
+      T tmp = static_cast<T>(0);
+      for(unsigned int n=0; n<coeffs.size(); n++) tmp += coeffs[n] * evaluate_function(x,n);
+      return tmp;
+    };
+    /**
+     * @brief Evaluate the series at a batch of points, out[p] = sum_n coeffs[n] phi_n(x[p]).
+     * One virtual call per batch instead of one per point.
+     */
+    virtual inline void evaluate_series_batch(Span<const T> x, const std::vector<T>& coeffs, Span<T> out) const {
+      assert(x.size()==out.size());
+      for(std::size_t p=0; p<x.size(); p++) out[p] = evaluate_series(x[p],coeffs);
+    };
+    virtual void calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde) const {};
+    virtual void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const {};
+    /**
+     * @brief Transforms into caller-provided buffers of the exact size.
+     * Subclasses override these to run without touching the heap; the
+     * defaults go through the vector versions and allocate.
+     * @param f get_N()+1 values
+     * @param ftilde num_coeffs() coefficients, must not overlap f
+     */
+    virtual inline void calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const {
+      assert(ftilde.size()==num_coeffs());
+      std::vector<T> in(f.begin(),f.end()), out;
+      calc_spectral_coeffs(in,out);
+      std::copy(out.begin(),out.end(),ftilde.begin());
+    };
+    virtual inline void calc_function_values(Span<const T> ftilde, Span<T> f) const {
+      assert(f.size()==static_cast<std::size_t>(get_N()+1));
+      std::vector<T> in(ftilde.begin(),ftilde.end()), out;
+      calc_function_values(in,out);
+      std::copy(out.begin(),out.end(),f.begin());
+    };
+    /**
+     * @brief Forward transform of M functions at once.
+     * The generic version loops over calc_spectral_coeffs, parallel over the batch.
+     * @param f M*(get_N()+1) values in the given layout
+     * @param ftilde M*num_coeffs() coefficients in the same layout
+     */
+    virtual inline void calc_spectral_coeffs_batch(Span<const T> f, Span<T> ftilde, std::size_t M,
+                                                   BatchLayout layout=BatchLayout::SoA,
+                                                   unsigned int nthreads=Parallel::default_threads()) const {
+      batch_loop(f,ftilde,M,get_N()+1,num_coeffs(),layout,nthreads,
+                 [this](const std::vector<T>& in, std::vector<T>& out) { calc_spectral_coeffs(in,out); });
+    };
+    //! Inverse transform of M functions at once, see calc_spectral_coeffs_batch
+    virtual inline void calc_function_values_batch(Span<const T> ftilde, Span<T> f, std::size_t M,
+                                                   BatchLayout layout=BatchLayout::SoA,
+                                                   unsigned int nthreads=Parallel::default_threads()) const {
+      batch_loop(ftilde,f,M,num_coeffs(),get_N()+1,layout,nthreads,
+                 [this](const std::vector<T>& in, std::vector<T>& out) { calc_function_values(in,out); });
+    };
+    virtual inline void calc_deriv(std::vector<T>& Lij) const {};
+    virtual inline void calc_second_deriv(std::vector<T>& Lij) const {};
+    virtual inline void calc_times_x(std::vector<T>& Lij) const {};
+    /**
+     * @brief Operators in their sparsest storage format.
+     * The defaults wrap the dense calc_* matrices, subclasses that know the
+     * structure of their operators should override these.
+     */
+    virtual inline OperatorStorage<T> deriv_storage() const { std::vector<T> L; calc_deriv(L); return as_storage(L); };
+    virtual inline OperatorStorage<T> second_deriv_storage() const { std::vector<T> L; calc_second_deriv(L); return as_storage(L); };
+    virtual inline OperatorStorage<T> times_x_storage() const { std::vector<T> L; calc_times_x(L); return as_storage(L); };
     // access 
-    virtual inline void get_nodes(std::vector<T>& pts)  {};
-    virtual inline void get_weights(std::vector<T>& w)  {};
-    virtual inline int get_N() { return N; };
-    virtual inline void print_nodes() {};
-    virtual inline void print_weights() {};
+    virtual inline void get_nodes(std::vector<T>& pts) const {};
+    virtual inline void get_weights(std::vector<T>& w) const {};
+    //! Nodes and weights without copying, empty unless the subclass stores them
+    virtual inline const std::vector<T>& get_nodes() const { return no_data(); };
+    virtual inline const std::vector<T>& get_weights() const { return no_data(); };
+    virtual inline int get_N() const { return N; };
+    //! Length of a vector of spectral coefficients
+    virtual inline std::size_t num_coeffs() const { return get_N()+1; };
+    /**
+     * @brief Distinguishes bases of the same type and order whose operators
+     * differ (e.g. different domains), part of the PlanRegistry key. It holds
+     * the parameters themselves (see exact_plan_key), not a hash, so distinct
+     * domains never share plans.
+     */
+    virtual inline std::string plan_key() const { return std::string(); };
+    /**
+     * @brief Breakpoints of the elements the coefficients are Chebyshev series
+     * on, one block of coefficients per element: {-1,1} for a Chebyshev series
+     * on [-1,1], empty if the coefficients are not Chebyshev coefficients.
+     * The ultraspherical ODE solvers accept operators on such bases only.
+     */
+    virtual inline std::vector<T> chebyshev_elements() const { return std::vector<T>(); };
+    virtual inline void print_nodes() const {};
+    virtual inline void print_weights() const {};
     // destructor
     virtual ~FunctionalBase<T>() {} ;
+  protected:
+    static inline const std::vector<T>& no_data() {
+      static const std::vector<T> empty;
+      return empty;
+    }
+    //! Apply a single-function transform to every member of a batch
+    template <class F> static inline void batch_loop(Span<const T> in, Span<T> out, std::size_t M, std::size_t nin, std::size_t nout,
+                                                     BatchLayout layout, unsigned int nthreads, F transform) {
+      assert(in.size()==M*nin && out.size()==M*nout);
+      const std::size_t stride = layout==BatchLayout::SoA ? 1 : M;
+      Parallel::parallel_for(M,[&](std::size_t m) {
+        static thread_local std::vector<T> a, b;
+        const T* src = in.data() + (layout==BatchLayout::SoA ? m*nin : m);
+        T* dst = out.data() + (layout==BatchLayout::SoA ? m*nout : m);
+        a.resize(nin);
+        for (std::size_t i=0; i<nin; i++) a[i] = src[i*stride];
+        transform(a,b);
+        for (std::size_t i=0; i<nout; i++) dst[i*stride] = b[i];
+      },nthreads);
+    }
+    static inline OperatorStorage<T> as_storage(const std::vector<T>& L) {
+      std::size_t n = 0;
+      while ((n+1)*(n+1) <= L.size()) n++;
+      return OperatorStorage<T>::compress(n,L);
+    }
   };
 
   /**
@@ -49,17 +205,32 @@ namespace FunctionalBases {
    * Templated subclass of abstract class FunctionalBases implementing a Chebyshev polynomial basis. 
    */
   template <class T>
-  class ChebyshevBase: public FunctionalBase<T> {
+  class ChebyshevBase final : public FunctionalBase<T> {
     unsigned int N; //! Order
     std::vector<T> nodes; //! Gauss-Lobatto collocation points
     std::vector<T> weights; //! Gaussian quadrature weights 
+    std::vector<T> gammas; //! Normalisation sum_i T_n(x_i)^2 w_i of each polynomial
+    TransformType transform; //! Requested transform algorithm
+    std::shared_ptr<const FFT::DCT1Plan<T>> dct; //! DCT-I plan, only allocated in DCT mode
+    std::vector<T> Tmat; //! T_n(x_i) stored row-major by node, only allocated in quadrature mode
+    //! Dense transform matrices for batched GEMM transforms, built on first use
+    struct BatchMatrices {
+      std::vector<T> fwd;  //! fwd[n][i] = w_i T_n(x_i)/gamma_n
+      std::vector<T> fwdT; //! transpose of fwd
+      std::vector<T> cosm; //! T_n(x_i) = cos(pi n i/N), symmetric
+    };
+    mutable std::shared_ptr<const BatchMatrices> batch_mats;
+    mutable std::shared_ptr<const ChebyshevBase<T>> padded; //! order padded_order() basis for products, built on first use
+    //! Functions per task on the batched DCT path
+    static constexpr std::size_t dct_batch_block = 8;
   public:
     // constructor ----------------------
     /**
      * @brief Constructor
      * @param N order of the polynomial basis.
+     * @param transform algorithm used by calc_spectral_coeffs and calc_function_values
      */
-    ChebyshevBase<T>(unsigned int N) : N(N), FunctionalBase<T>(N){
+    ChebyshevBase<T>(unsigned int N, TransformType transform=TransformType::Auto) : FunctionalBase<T>(N), N(N), transform(transform) {
       calc_nodes_and_weights();
     };
     // class methods ---------------------
@@ -72,45 +243,202 @@ namespace FunctionalBases {
      * @param x point of evaluation
      * @param n order of the polynomial
      */
-    inline T evaluate_function(const T& x, const unsigned int n)  {
+    inline T evaluate_function(const T& x, const unsigned int n) const {
       return Chebyshev::Tn<T>(x,n);
     };
+    /**
+     * @brief Evaluate a Chebyshev series by Clenshaw summation, O(N) per point.
+     * @param x point of evaluation
+     * @param coeffs spectral coefficients
+     */
+    inline T evaluate_series(const T& x, const std::vector<T>& coeffs) const {
+      return Chebyshev::clenshaw<T>(x,coeffs);
+    };
+    /**
+     * @brief Batched Clenshaw summation over SIMD lanes, see simd_eval.hpp.
+     * @param x points of evaluation
+     * @param coeffs spectral coefficients
+     * @param out output, same length as x
+     */
+    inline void evaluate_series_batch(Span<const T> x, const std::vector<T>& coeffs, Span<T> out) const {
+      assert(x.size()==out.size());
+      SPECTRE_PROFILE_SCOPE("ChebyshevBase::evaluate_series_batch",N,(2*x.size()+coeffs.size())*sizeof(T));
+      Chebyshev::clenshaw_batch<T>(coeffs.data(),coeffs.size(),x.data(),x.size(),out.data());
+    };
     /**
      * @brief Calculate spectral coefficients of a function given its values at collocation points 
      * @param f values of f at collocation points
      * @param ftilde output vector
      */
-    inline void calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde) ;
-    inline void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) ;
-    inline void calc_deriv(std::vector<T>& Lij);
-    inline void calc_second_deriv(std::vector<T>& Lij);
-    inline void calc_times_x(std::vector<T>& Lij);
+    inline void calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde) const;
+    /**
+     * @brief Calculate function values at collocation points given the spectral coefficients
+     * @param ftilde spectral coefficients
+     * @param f output vector
+     */
+    inline void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const;
+    /**
+     * @brief Allocation-free forward transform
+     * @param f N+1 values at the collocation points
+     * @param ftilde N+1 coefficients, must not overlap f
+     */
+    inline void calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const;
+    //! Allocation-free inverse transform, f must not overlap ftilde
+    inline void calc_function_values(Span<const T> ftilde, Span<T> f) const;
+    /**
+     * @brief Select the transform algorithm, (re)building the DCT plan if needed.
+     * @param t requested algorithm
+     */
+    inline void set_transform_type(const TransformType t) {
+      transform = t;
+      init_transform();
+    }
+    //! True if transforms go through the DCT plan
+    inline bool uses_dct() const { return static_cast<bool>(dct); }
+    /**
+     * @brief Forward transform of M functions as one cache-blocked GEMM.
+     * Below batch_dct_threshold the cached (N+1)x(N+1) transform matrix is
+     * applied to the whole batch (fwd * F for AoS, F * fwd^T for SoA), above it
+     * every function goes through the DCT plan. Parallel over blocks of functions.
+     * @param f M*(N+1) values in the given layout
+     * @param ftilde M*(N+1) coefficients in the same layout, must not overlap f
+     * @param M number of functions
+     */
+    inline void calc_spectral_coeffs_batch(Span<const T> f, Span<T> ftilde, std::size_t M,
+                                           BatchLayout layout=BatchLayout::SoA,
+                                           unsigned int nthreads=Parallel::default_threads()) const;
+    //! Inverse transform of M functions, see calc_spectral_coeffs_batch
+    inline void calc_function_values_batch(Span<const T> ftilde, Span<T> f, std::size_t M,
+                                           BatchLayout layout=BatchLayout::SoA,
+                                           unsigned int nthreads=Parallel::default_threads()) const;
+    //! True if batched transforms go through the DCT plan rather than GEMM
+    inline bool batch_uses_dct() const { return dct && (transform==TransformType::DCT || N>=batch_dct_threshold); }
+    /**
+     * @brief Floating point operations of one batched transform of M functions,
+     * 2(N+1)^2 M on the GEMM path and the nominal 2.5 (2N) log2(2N) M of a real
+     * FFT of length 2N on the DCT path. Divide by the run time for GFLOP/s.
+     */
+    inline double batch_flops(std::size_t M) const {
+      if (batch_uses_dct()) return 2.5*(2.0*N)*std::log2(2.0*N)*M;
+      return 2.0*(N+1)*(N+1)*static_cast<double>(M);
+    }
+    inline void calc_deriv(std::vector<T>& Lij) const;
+    inline void calc_second_deriv(std::vector<T>& Lij) const;
+    inline void calc_times_x(std::vector<T>& Lij) const;
+    /**
+     * @brief Derivative as a rank-1 parity-triangular operator, D_ij = (2/c_i) j.
+     */
+    inline OperatorStorage<T> deriv_storage() const;
+    /**
+     * @brief Second derivative as a rank-2 parity-triangular operator, (1/c_i) (j^3 - i^2 j).
+     */
+    inline OperatorStorage<T> second_deriv_storage() const;
+    //! Multiplication by x as a tridiagonal operator
+    inline OperatorStorage<T> times_x_storage() const;
+    /**
+     * @brief Coefficients of the k-th derivative by the O(N) backward recurrence
+     * of Chebyshev::derivative_coeffs, no operator matrix is built.
+     * @param ftilde N+1 coefficients
+     * @param out N+1 coefficients, may alias ftilde
+     * @param k order of the derivative
+     */
+    inline void differentiate_coeffs(Span<const T> ftilde, Span<T> out, unsigned int k=1) const;
+    //! Coefficients of the antiderivative vanishing at x=-1, truncated to N+1 terms, out may alias ftilde
+    inline void antiderivative_coeffs(Span<const T> ftilde, Span<T> out) const {
+      assert(ftilde.size()==N+1 && out.size()==N+1);
+      Chebyshev::antiderivative_coeffs(ftilde.data(),out.data(),N+1);
+    }
+    //! Clenshaw-Curtis integral over [-1,1] straight from the coefficients, O(N)
+    inline T integrate_coeffs(Span<const T> ftilde) const {
+      assert(ftilde.size()==N+1);
+      return Chebyshev::integral(ftilde.data(),N+1);
+    }
+    /**
+     * @brief Coefficients of the product of two series, truncated to order N without aliasing.
+     * Below product_direct_threshold by direct convolution, above it by the
+     * 3/2 rule: both factors are zero-padded to order padded_order(), multiplied
+     * at the padded nodes through the DCT and transformed back. Work buffers
+     * are thread-local, so repeated products do not allocate.
+     * @param a N+1 coefficients
+     * @param b N+1 coefficients
+     * @param c N+1 coefficients, may alias a or b
+     */
+    inline void multiply_coeffs(Span<const T> a, Span<const T> b, Span<T> c) const;
+    /**
+     * @brief Order M of the padded product grid. Aliasing on M+1 Gauss-Lobatto
+     * nodes folds T_{2M-k} onto T_k, so coefficients up to N are exact for M > 3N/2;
+     * M is rounded up to a power of two to keep the DCT on the radix-2 FFT.
+     */
+    inline unsigned int padded_order() const {
+      unsigned int M = 1;
+      while (M <= 3*N/2) M *= 2;
+      return M;
+    }
+    /**
+     * @brief differentiate_coeffs for M series in the given layout, out may alias in.
+     * SoA runs one series per task, AoS runs the recurrence across blocks of
+     * Chebyshev::coeff_lanes interleaved series, vectorised over the series.
+     */
+    inline void differentiate_coeffs_batch(Span<const T> in, Span<T> out, std::size_t M, unsigned int k=1,
+                                           BatchLayout layout=BatchLayout::SoA,
+                                           unsigned int nthreads=Parallel::default_threads()) const;
+    //! antiderivative_coeffs for M series, see differentiate_coeffs_batch
+    inline void antiderivative_coeffs_batch(Span<const T> in, Span<T> out, std::size_t M,
+                                            BatchLayout layout=BatchLayout::SoA,
+                                            unsigned int nthreads=Parallel::default_threads()) const;
+    /**
+     * @brief integrate_coeffs for M series, see differentiate_coeffs_batch
+     * @param out M integrals
+     */
+    inline void integrate_coeffs_batch(Span<const T> in, Span<T> out, std::size_t M,
+                                       BatchLayout layout=BatchLayout::SoA,
+                                       unsigned int nthreads=Parallel::default_threads()) const;
     // access ----------------
-    inline void print_nodes() {
+    inline void print_nodes() const {
       std::cout << "Length of nodes vector: " << nodes.size() << "\n";
       for (const auto& val : nodes) std::cout << val << " "; 
       std::cout << "\n";
     }
-    inline void print_weights() {
+    inline void print_weights() const {
       std::cout << "Length of weights vector: " << weights.size() << "\n";
       for (const auto& val : weights) std::cout << val << " "; 
       std::cout << "\n";
     }
     //! Return the nodes
-    inline void get_nodes(std::vector<T>& pts)  {
+    inline void get_nodes(std::vector<T>& pts) const {
       pts = nodes;
     };
     //! Return the weights
-    inline void get_weights(std::vector<T>& w)  {
+    inline void get_weights(std::vector<T>& w) const {
       w = weights;
     };
+    inline const std::vector<T>& get_nodes() const { return nodes; };
+    inline const std::vector<T>& get_weights() const { return weights; };
     inline void change_N(const unsigned int n) {
       N = n;
       calc_nodes_and_weights();
     }
-    inline int get_N() {
+  private:
+    inline void init_transform();
+    inline void quadrature_coeffs(const T* f, T* ftilde) const;
+    inline void quadrature_values(const T* ftilde, T* f) const;
+    inline void dct_coeffs(const T* f, T* ftilde) const;
+    inline void dct_values(const T* ftilde, T* f) const;
+    inline std::shared_ptr<const BatchMatrices> batch_matrices() const;
+    inline void batch_gemm(const std::vector<T>& A, const std::vector<T>& AT, const T* in, T* out,
+                           std::size_t M, BatchLayout layout, unsigned int nthreads) const;
+    template <bool forward> inline void batch_dct(const T* in, T* out, std::size_t M, BatchLayout layout, unsigned int nthreads) const;
+    /**
+     * @brief Run f(m0,lanes,ld) over a batch of M coefficient vectors: single
+     * series m0 (lanes=1, ld=1, offset m0*(N+1)) for SoA, blocks of up to
+     * Chebyshev::coeff_lanes series starting at m0 (ld=M, offset m0) for AoS.
+     */
+    template <class F> inline void for_coeff_lanes(std::size_t M, BatchLayout layout, unsigned int nthreads, F f) const;
+  public:
+    inline int get_N() const {
       return N;
     }
+    inline std::vector<T> chebyshev_elements() const { return {static_cast<T>(-1),static_cast<T>(1)}; }
     // destructor -----------------
     //! Default destructor
     ~ChebyshevBase<T>() {};
@@ -118,79 +446,243 @@ namespace FunctionalBases {
 
   template <class T> inline void ChebyshevBase<T>::calc_nodes_and_weights()
     {
-      weights.clear();
-      nodes.clear();
-      weights.push_back(static_cast<T>(M_PI/(2*N)));
-	    nodes.push_back(static_cast<T>(1));
-	    for (int i=1; i<N; i++){
-        nodes.push_back(static_cast<T>(std::cos(M_PI*i/N)));    
-        weights.push_back(static_cast<T>(M_PI/N));
-	    }
-	    nodes.push_back(static_cast<T>(-1));
-	    weights.push_back(static_cast<T>(M_PI/(2*N)));
-    }
-
-  template <class T>  inline void ChebyshevBase<T>::calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde){
-    assert(f.size()==N+1);
-    ftilde.clear();
-    T gamma_n, ft_n;
-    for(int n=0; n<N+1; n++){
-      gamma_n = static_cast<T>(0);
-      ft_n = static_cast<T>(0);
-      for(int i=0; i < N+1; i++){
-          gamma_n += std::pow(evaluate_function(nodes[i],n),2) * weights[i];
-          ft_n += f[i] * evaluate_function(nodes[i],n) * weights[i];
-      }
-      ftilde.push_back(ft_n / gamma_n) ;
-    }  
+      nodes.resize(N+1);
+      const T pi = Chebyshev::pi<T>;
+      weights.assign(N+1,pi/static_cast<T>(N));
+      for (unsigned int i=1; i<N; i++) nodes[i] = Chebyshev::cos_pi_ratio<T>(i,N);
+      nodes[0] = static_cast<T>(1);
+      nodes[N] = static_cast<T>(-1);
+      weights[0] = weights[N] = pi/static_cast<T>(2*N);
+      // discrete norms sum_i T_n(x_i)^2 w_i, exact on the Gauss-Lobatto grid
+      gammas.assign(N+1,pi/static_cast<T>(2));
+      gammas[0] = pi;
+      gammas[N] = pi;
+      init_transform();
+    }
+
+  template <class T> inline void ChebyshevBase<T>::init_transform()
+  {
+    batch_mats.reset();
+    padded.reset();
+    const bool want_dct = (transform==TransformType::DCT) || (transform==TransformType::Auto && N>=dct_threshold);
+    if(want_dct && N>0) {
+      if(!dct || dct->get_N()!=N) dct = std::make_shared<const FFT::DCT1Plan<T>>(N);
+      Tmat.clear();
+      Tmat.shrink_to_fit();
+    }
+    else {
+      dct.reset();
+      Tmat.resize((N+1)*(N+1));
+      for(unsigned int i=0; i < N+1; i++) Chebyshev::Tn_all<T>(nodes[i],N,&Tmat[i*(N+1)]);
+    }
+  }
+
+  template <class T>  inline void ChebyshevBase<T>::calc_spectral_coeffs(const std::vector<T>& f,std::vector<T>& ftilde) const {
+    ftilde.resize(N+1);
+    calc_spectral_coeffs(Span<const T>(f),Span<T>(ftilde));
+  };
+
+  template <class T>  inline void ChebyshevBase<T>::calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const {
+    f.resize(N+1);
+    calc_function_values(Span<const T>(ftilde),Span<T>(f));
+  };
+
+  template <class T>  inline void ChebyshevBase<T>::calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const {
+    assert(f.size()==N+1 && ftilde.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("ChebyshevBase::calc_spectral_coeffs",N,2*(N+1)*sizeof(T));
+    if(dct) dct_coeffs(f.data(),ftilde.data());
+    else quadrature_coeffs(f.data(),ftilde.data());
   };
 
-  template <class T>  inline void ChebyshevBase<T>::calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) {
-    assert(ftilde.size()==N+1);
-    f.clear();
-    for (const auto& xval: nodes) {
-        T tmp = static_cast<T>(0);
-        for(int n=0; n<N+1; n++) tmp += ftilde[n] * evaluate_function(xval,n);
-        f.push_back(tmp);
+  template <class T>  inline void ChebyshevBase<T>::calc_function_values(Span<const T> ftilde, Span<T> f) const {
+    assert(ftilde.size()==N+1 && f.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("ChebyshevBase::calc_function_values",N,2*(N+1)*sizeof(T));
+    if(dct) dct_values(ftilde.data(),f.data());
+    else quadrature_values(ftilde.data(),f.data());
+  };
+
+  template <class T>  inline void ChebyshevBase<T>::quadrature_coeffs(const T* f, T* ftilde) const {
+    std::fill(ftilde,ftilde+N+1,static_cast<T>(0));
+    for(unsigned int i=0; i < N+1; i++){
+      const T* Tx = &Tmat[i*(N+1)];
+      const T fw = f[i] * weights[i];
+      for(unsigned int n=0; n<N+1; n++) ftilde[n] += fw * Tx[n];
+    }
+    for(unsigned int n=0; n<N+1; n++) ftilde[n] /= gammas[n];
+  };
+
+  template <class T>  inline void ChebyshevBase<T>::quadrature_values(const T* ftilde, T* f) const {
+    for(unsigned int i=0; i < N+1; i++){
+      const T* Tx = &Tmat[i*(N+1)];
+      T tmp = static_cast<T>(0);
+      for(unsigned int n=0; n<N+1; n++) tmp += ftilde[n] * Tx[n];
+      f[i] = tmp;
     }
   };
 
-  template <class T>  inline void ChebyshevBase<T>::calc_deriv(std::vector<T>& Lij)
+  /*
+   * On the Gauss-Lobatto grid T_n(x_i) = cos(pi n i/N), so with c_0=c_N=2, c_n=1 otherwise
+   *   ft_n = 2/(N c_n) sum_i f_i cos(pi n i/N) / c_i = DCT-I(f)_n / (N c_n)
+   *   f_i  = sum_n ft_n cos(pi n i/N)              = DCT-I(c ft / 2)_i
+   */
+  template <class T>  inline void ChebyshevBase<T>::dct_coeffs(const T* f, T* ftilde) const {
+    dct->execute(f,ftilde);
+    const T scale = static_cast<T>(1) / static_cast<T>(N);
+    for(unsigned int n=0; n<N+1; n++) ftilde[n] *= scale;
+    ftilde[0] *= static_cast<T>(0.5);
+    ftilde[N] *= static_cast<T>(0.5);
+  };
+
+  template <class T>  inline void ChebyshevBase<T>::dct_values(const T* ftilde, T* f) const {
+    for(unsigned int n=1; n<N; n++) f[n] = static_cast<T>(0.5) * ftilde[n];
+    f[0] = ftilde[0];
+    f[N] = ftilde[N];
+    dct->execute(f,f);
+  };
+
+  template <class T> inline void ChebyshevBase<T>::calc_spectral_coeffs_batch(Span<const T> f, Span<T> ftilde, std::size_t M,
+                                                                          BatchLayout layout, unsigned int nthreads) const {
+    assert(f.size()==M*(N+1) && ftilde.size()==M*(N+1));
+    assert(f.data()+f.size()<=ftilde.data() || ftilde.data()+ftilde.size()<=f.data());
+    SPECTRE_PROFILE_SCOPE("ChebyshevBase::calc_spectral_coeffs_batch",N,2*M*(N+1)*sizeof(T));
+    if (batch_uses_dct()) batch_dct<true>(f.data(),ftilde.data(),M,layout,nthreads);
+    else {
+      auto mats = batch_matrices();
+      batch_gemm(mats->fwd,mats->fwdT,f.data(),ftilde.data(),M,layout,nthreads);
+    }
+  }
+
+  template <class T> inline void ChebyshevBase<T>::calc_function_values_batch(Span<const T> ftilde, Span<T> f, std::size_t M,
+                                                                          BatchLayout layout, unsigned int nthreads) const {
+    assert(f.size()==M*(N+1) && ftilde.size()==M*(N+1));
+    assert(f.data()+f.size()<=ftilde.data() || ftilde.data()+ftilde.size()<=f.data());
+    SPECTRE_PROFILE_SCOPE("ChebyshevBase::calc_function_values_batch",N,2*M*(N+1)*sizeof(T));
+    if (batch_uses_dct()) batch_dct<false>(ftilde.data(),f.data(),M,layout,nthreads);
+    else {
+      auto mats = batch_matrices();
+      batch_gemm(mats->cosm,mats->cosm,ftilde.data(),f.data(),M,layout,nthreads);
+    }
+  }
+
+  /*
+   * Built lazily since only batched users pay for the O(N^2) storage. Concurrent
+   * first calls may both build the matrices, the last store wins and both are identical.
+   * The cosines come from Chebyshev::cos_pi_ratio, which reduces n*i mod 2N
+   * so large arguments do not lose accuracy.
+   */
+  template <class T> inline std::shared_ptr<const typename ChebyshevBase<T>::BatchMatrices> ChebyshevBase<T>::batch_matrices() const
+  {
+    auto mats = std::atomic_load(&batch_mats);
+    if (mats) return mats;
+    auto m = std::make_shared<BatchMatrices>();
+    const std::size_t n1 = N+1;
+    m->fwd.resize(n1*n1);
+    m->fwdT.resize(n1*n1);
+    m->cosm.resize(n1*n1);
+    for (std::size_t n=0; n<n1; n++)
+      for (std::size_t i=0; i<n1; i++) {
+        const T c = Chebyshev::cos_pi_ratio<T>(n*i,N);
+        m->cosm[n*n1+i] = c;
+        m->fwd[n*n1+i] = weights[i]*c/gammas[n];
+        m->fwdT[i*n1+n] = m->fwd[n*n1+i];
+      }
+    mats = m;
+    std::atomic_store(&batch_mats,mats);
+    return mats;
+  }
+
+  /*
+   * AoS: the batch is an (N+1) x M matrix and out = A in, split over column blocks.
+   * SoA: the batch is an M x (N+1) matrix and out = in A^T, split over row blocks.
+   */
+  template <class T> inline void ChebyshevBase<T>::batch_gemm(const std::vector<T>& A, const std::vector<T>& AT, const T* in, T* out,
+                                                              std::size_t M, BatchLayout layout, unsigned int nthreads) const
+  {
+    const std::size_t n1 = N+1;
+    const std::size_t block = layout==BatchLayout::SoA ? GEMM::MC : GEMM::NC/2;
+    const std::size_t nblocks = (M+block-1)/block;
+    Parallel::parallel_for(nblocks,[&](std::size_t b) {
+      const std::size_t m0 = b*block, mb = std::min(block,M-m0);
+      if (layout==BatchLayout::SoA)
+        GEMM::gemm<T>(mb,n1,n1,static_cast<T>(1),in+m0*n1,n1,AT.data(),n1,static_cast<T>(0),out+m0*n1,n1);
+      else
+        GEMM::gemm<T>(n1,mb,n1,static_cast<T>(1),A.data(),n1,in+m0,M,static_cast<T>(0),out+m0,M);
+    },nthreads);
+  }
+
+  /*
+   * Per-function DCT with the same scalings as dct_coeffs/dct_values. Functions are
+   * handled in blocks of dct_batch_block, so AoS gathers read contiguous runs of a row.
+   */
+  template <class T> template <bool forward> inline void ChebyshevBase<T>::batch_dct(const T* in, T* out, std::size_t M,
+                                                                                     BatchLayout layout, unsigned int nthreads) const
+  {
+    const std::size_t n1 = N+1;
+    const T scale = static_cast<T>(1) / static_cast<T>(N);
+    const std::size_t nblocks = (M+dct_batch_block-1)/dct_batch_block;
+    Parallel::parallel_for(nblocks,[&](std::size_t blk) {
+      static thread_local std::vector<T> buf;
+      const std::size_t m0 = blk*dct_batch_block, mb = std::min(dct_batch_block,M-m0);
+      buf.resize(mb*n1);
+      if (layout==BatchLayout::SoA) std::copy(in+m0*n1,in+(m0+mb)*n1,buf.begin());
+      else {
+        for (std::size_t i=0; i<n1; i++)
+          for (std::size_t j=0; j<mb; j++) buf[j*n1+i] = in[i*M+m0+j];
+      }
+      for (std::size_t j=0; j<mb; j++) {
+        T* b = &buf[j*n1];
+        if (!forward) {
+          for (std::size_t n=1; n<N; n++) b[n] *= static_cast<T>(0.5);
+        }
+        dct->execute(b,b);
+        if (forward) {
+          for (std::size_t n=0; n<n1; n++) b[n] *= scale;
+          b[0] *= static_cast<T>(0.5);
+          b[N] *= static_cast<T>(0.5);
+        }
+      }
+      if (layout==BatchLayout::SoA) std::copy(buf.begin(),buf.end(),out+m0*n1);
+      else {
+        for (std::size_t i=0; i<n1; i++)
+          for (std::size_t j=0; j<mb; j++) out[i*M+m0+j] = buf[j*n1+i];
+      }
+    },nthreads);
+  }
+
+  template <class T>  inline void ChebyshevBase<T>::calc_deriv(std::vector<T>& Lij) const
   {
     Lij.clear();
     for (int i=0; i<N+1; i++){
       for (int j=0; j<N+1; j++){
         T val = static_cast<T>(0);
-        double delta_0n = (i==0) ? 1.0 : 0.0;
-        if (((i+j)%2)&&(j>i)) val = static_cast<T>( 2.0/(1.0 + delta_0n) * j );
+        const T c_i = static_cast<T>( (i==0) ? 2 : 1 );
+        if (((i+j)%2)&&(j>i)) val = static_cast<T>(2) / c_i * static_cast<T>(j);
         Lij.push_back(val);
       }
     }
   }
 
-  template <class T>  inline void ChebyshevBase<T>::calc_second_deriv(std::vector<T>& Lij)
+  template <class T>  inline void ChebyshevBase<T>::calc_second_deriv(std::vector<T>& Lij) const
   {
     Lij.clear();
     for (int i=0; i<N+1; i++){
       for (int j=0; j<N+1; j++){
         T val = static_cast<T>(0);
-        double delta_0n = (i==0) ? 1.0 : 0.0;
-        if ( (!((i+j)%2)) && (j>(i+1)) ) val = static_cast<T>( 1.0/(1.0 + delta_0n) * j * ( j * j - i * i));
+        const T c_i = static_cast<T>( (i==0) ? 2 : 1 );
+        if ( (!((i+j)%2)) && (j>(i+1)) ) val = static_cast<T>(j) * (static_cast<T>(j)*static_cast<T>(j) - static_cast<T>(i)*static_cast<T>(i)) / c_i;
         Lij.push_back(val);
       }
     }
   }
 
-  template <class T>  inline void ChebyshevBase<T>::calc_times_x(std::vector<T>& Lij)
+  template <class T>  inline void ChebyshevBase<T>::calc_times_x(std::vector<T>& Lij) const
   {
     Lij.clear();
     for (int i=0; i<N+1; i++){
       for (int j=0; j<N+1; j++){
         T val = static_cast<T>(0);
-        int im1 = i-1;
-        double delta_0nm1 = (im1==0) ? 1.0 : 0.0;
         if (j==(i-1)){ 
-          val = static_cast<T>( 0.5*(1.0+delta_0nm1) ); 
+          val = static_cast<T>( (i==1) ? 1 : 0.5 ); 
           }
         else if (j==(i+1)){
            val = static_cast<T>(0.5); 
@@ -200,8 +692,135 @@ namespace FunctionalBases {
     }
   }
 
-} //namespace FunctionalBases
+  template <class T>  inline OperatorStorage<T> ChebyshevBase<T>::deriv_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("ChebyshevBase::deriv_storage",N,4*(N+1)*sizeof(T));
+    std::vector<T> u(N+1), v(N+1);
+    for (unsigned int i=0; i<N+1; i++){
+      u[i] = static_cast<T>( (i==0) ? 1.0 : 2.0 );
+      v[i] = static_cast<T>(i);
+    }
+    return OperatorStorage<T>::parity_triangular(N+1,1,1,u,v);
+  }
+
+  template <class T>  inline OperatorStorage<T> ChebyshevBase<T>::second_deriv_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("ChebyshevBase::second_deriv_storage",N,8*(N+1)*sizeof(T));
+    std::vector<T> u(2*(N+1)), v(2*(N+1));
+    for (unsigned int i=0; i<N+1; i++){
+      const T c_inv = static_cast<T>( (i==0) ? 0.5 : 1.0 );
+      u[i] = c_inv;
+      v[i] = static_cast<T>(i) * static_cast<T>(i) * static_cast<T>(i);
+      u[N+1+i] = - c_inv * static_cast<T>(i) * static_cast<T>(i);
+      v[N+1+i] = static_cast<T>(i);
+    }
+    return OperatorStorage<T>::parity_triangular(N+1,2,2,u,v);
+  }
+
+  template <class T>  inline OperatorStorage<T> ChebyshevBase<T>::times_x_storage() const
+  {
+    SPECTRE_PROFILE_SCOPE("ChebyshevBase::times_x_storage",N,6*(N+1)*sizeof(T));
+    // row i holds columns i-1, i, i+1
+    std::vector<T> band(3*(N+1),static_cast<T>(0));
+    for (unsigned int i=0; i<N+1; i++){
+      if (i>0) band[3*i] = static_cast<T>( (i==1) ? 1.0 : 0.5 );
+      if (i<N) band[3*i+2] = static_cast<T>(0.5);
+    }
+    return OperatorStorage<T>::banded(N+1,1,1,band);
+  }
 
-#endif 
+  template <class T> inline void ChebyshevBase<T>::differentiate_coeffs(Span<const T> ftilde, Span<T> out, unsigned int k) const
+  {
+    assert(ftilde.size()==N+1 && out.size()==N+1);
+    if (k==0) {
+      std::copy(ftilde.begin(),ftilde.end(),out.begin());
+      return;
+    }
+    Chebyshev::derivative_coeffs(ftilde.data(),out.data(),N+1);
+    for (unsigned int j=1; j<k; j++) Chebyshev::derivative_coeffs(out.data(),out.data(),N+1);
+  }
 
+  template <class T> template <class F> inline void ChebyshevBase<T>::for_coeff_lanes(std::size_t M, BatchLayout layout, unsigned int nthreads, F f) const
+  {
+    if (layout==BatchLayout::SoA) {
+      Parallel::parallel_for(M,[&](std::size_t m) { f(m,1,1); },nthreads);
+      return;
+    }
+    const std::size_t L = Chebyshev::coeff_lanes;
+    Parallel::parallel_for((M+L-1)/L,[&](std::size_t b) { f(b*L,std::min(L,M-b*L),M); },nthreads);
+  }
+
+  template <class T> inline void ChebyshevBase<T>::differentiate_coeffs_batch(Span<const T> in, Span<T> out, std::size_t M, unsigned int k,
+                                                                             BatchLayout layout, unsigned int nthreads) const
+  {
+    assert(in.size()==M*(N+1) && out.size()==M*(N+1));
+    const std::size_t n = N+1;
+    for_coeff_lanes(M,layout,nthreads,[&](std::size_t m0, std::size_t lanes, std::size_t ld) {
+      const std::size_t off = layout==BatchLayout::SoA ? m0*n : m0;
+      if (k==0) {
+        for (std::size_t i=0; i<n; i++)
+          for (std::size_t l=0; l<lanes; l++) out[off+i*ld+l] = in[off+i*ld+l];
+        return;
+      }
+      Chebyshev::derivative_coeffs(in.data()+off,out.data()+off,n,lanes,ld);
+      for (unsigned int j=1; j<k; j++) Chebyshev::derivative_coeffs(out.data()+off,out.data()+off,n,lanes,ld);
+    });
+  }
+
+  template <class T> inline void ChebyshevBase<T>::antiderivative_coeffs_batch(Span<const T> in, Span<T> out, std::size_t M,
+                                                                              BatchLayout layout, unsigned int nthreads) const
+  {
+    assert(in.size()==M*(N+1) && out.size()==M*(N+1));
+    const std::size_t n = N+1;
+    for_coeff_lanes(M,layout,nthreads,[&](std::size_t m0, std::size_t lanes, std::size_t ld) {
+      const std::size_t off = layout==BatchLayout::SoA ? m0*n : m0;
+      Chebyshev::antiderivative_coeffs(in.data()+off,out.data()+off,n,lanes,ld);
+    });
+  }
+
+  template <class T> inline void ChebyshevBase<T>::integrate_coeffs_batch(Span<const T> in, Span<T> out, std::size_t M,
+                                                                         BatchLayout layout, unsigned int nthreads) const
+  {
+    assert(in.size()==M*(N+1) && out.size()==M);
+    const std::size_t n = N+1;
+    for_coeff_lanes(M,layout,nthreads,[&](std::size_t m0, std::size_t lanes, std::size_t ld) {
+      const std::size_t off = layout==BatchLayout::SoA ? m0*n : m0;
+      Chebyshev::integral(in.data()+off,n,lanes,ld,out.data()+m0);
+    });
+  }
+
+  template <class T> inline void ChebyshevBase<T>::multiply_coeffs(Span<const T> a, Span<const T> b, Span<T> c) const
+  {
+    assert(a.size()==N+1 && b.size()==N+1 && c.size()==N+1);
+    SPECTRE_PROFILE_SCOPE("ChebyshevBase::multiply_coeffs",N,3*(N+1)*sizeof(T));
+    static thread_local std::vector<T> pa, pb;
+    if (N < product_direct_threshold) {
+      pa.resize(N+1);
+      Chebyshev::product_coeffs(a.data(),b.data(),N+1,pa.data());
+      std::copy(pa.begin(),pa.end(),c.begin());
+      return;
+    }
+    auto P = std::atomic_load(&padded);
+    if (!P) {
+      P = std::make_shared<const ChebyshevBase<T>>(padded_order(),TransformType::DCT);
+      std::atomic_store(&padded,P);
+    }
+    const std::size_t m = P->get_N()+1;
+    const bool square = a.data()==b.data();
+    pa.assign(m,static_cast<T>(0));
+    std::copy(a.begin(),a.end(),pa.begin());
+    P->dct_values(pa.data(),pa.data());
+    if (!square) {
+      pb.assign(m,static_cast<T>(0));
+      std::copy(b.begin(),b.end(),pb.begin());
+      P->dct_values(pb.data(),pb.data());
+    }
+    const std::vector<T>& vb = square ? pa : pb;
+    for (std::size_t i=0; i<m; i++) pa[i] *= vb[i];
+    P->dct_coeffs(pa.data(),pa.data());
+    std::copy(pa.begin(),pa.begin()+N+1,c.begin());
+  }
+
+} //namespace FunctionalBases
 
+#endif
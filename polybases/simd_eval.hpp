@@ -0,0 +1,307 @@
+/**
+ * @file simd_eval.hpp
+ * @brief Batched Clenshaw evaluation of a Chebyshev series across SIMD lanes.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * One series is evaluated at many points: every lane carries its own point
+ * and Clenshaw state while the coefficients are broadcast. AVX2 and AVX-512
+ * kernels are compiled with function-level target attributes and selected
+ * at runtime from the CPU features, so the header needs no special compiler
+ * flags. Other scalar types and other architectures use a portable kernel
+ * that interleaves a block of points to give the auto-vectoriser work.
+ */
+#ifndef _MY_SPECTRE_SIMD_EVAL_HPP
+#define _MY_SPECTRE_SIMD_EVAL_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include "chebyshev.hpp"
+#include "span.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SPECTRE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace Chebyshev {
+
+  //! Instruction set used by clenshaw_batch
+  enum class SimdLevel { Scalar, AVX2, AVX512 };
+
+  /**
+   * @brief Widest instruction set supported by the running CPU.
+   * Detected once, the result is cached.
+   */
+  inline SimdLevel detected_simd_level()
+  {
+#ifdef SPECTRE_X86_SIMD
+    static const SimdLevel level = []() {
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::AVX2;
+      return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+  }
+
+  namespace detail {
+    //! Points processed together by the portable kernel
+    constexpr std::size_t batch_block = 8;
+
+    template <class C> inline void clenshaw_batch_scalar(const C* a, std::size_t ncoeffs, const C* x, std::size_t npts, C* out)
+    {
+      std::size_t p = 0;
+      if (ncoeffs==0) {
+        for (; p<npts; p++) out[p] = static_cast<C>(0);
+        return;
+      }
+      for (; p+batch_block<=npts; p+=batch_block) {
+        C tx[batch_block], b1[batch_block], b2[batch_block];
+        for (std::size_t l=0; l<batch_block; l++) {
+          tx[l] = static_cast<C>(2)*x[p+l];
+          b1[l] = static_cast<C>(0);
+          b2[l] = static_cast<C>(0);
+        }
+        for (std::size_t n=ncoeffs-1; n>0; n--) {
+          for (std::size_t l=0; l<batch_block; l++) {
+            const C b0 = a[n] + tx[l]*b1[l] - b2[l];
+            b2[l] = b1[l];
+            b1[l] = b0;
+          }
+        }
+        for (std::size_t l=0; l<batch_block; l++) out[p+l] = a[0] + x[p+l]*b1[l] - b2[l];
+      }
+      for (; p<npts; p++) out[p] = clenshaw(x[p],a,ncoeffs);
+    }
+
+    //! Portable mixed-precision kernel: S storage, Clenshaw state in C
+    template <class S, class C> inline void clenshaw_batch_mixed_scalar(const S* a, std::size_t ncoeffs, const S* x, std::size_t npts, S* out)
+    {
+      for (std::size_t p=0; p<npts; p++) {
+        const C xp = static_cast<C>(x[p]), tx = static_cast<C>(2)*xp;
+        C b1 = static_cast<C>(0), b2 = static_cast<C>(0);
+        for (std::size_t n=ncoeffs; n-->1;) {
+          const C b0 = static_cast<C>(a[n]) + tx*b1 - b2;
+          b2 = b1;
+          b1 = b0;
+        }
+        out[p] = ncoeffs ? static_cast<S>(static_cast<C>(a[0]) + xp*b1 - b2) : static_cast<S>(0);
+      }
+    }
+
+#ifdef SPECTRE_X86_SIMD
+    /*
+     * Each kernel runs two independent vectors per iteration so the FMA
+     * dependency chain of the recurrence does not stall the pipeline.
+     */
+    __attribute__((target("avx2,fma")))
+    inline void clenshaw_batch_avx2(const double* a, std::size_t ncoeffs, const double* x, std::size_t npts, double* out)
+    {
+      std::size_t p = 0;
+      for (; p+8<=npts; p+=8) {
+        const __m256d x0 = _mm256_loadu_pd(x+p), x1 = _mm256_loadu_pd(x+p+4);
+        const __m256d t0 = _mm256_add_pd(x0,x0), t1 = _mm256_add_pd(x1,x1);
+        __m256d b1_0 = _mm256_setzero_pd(), b2_0 = _mm256_setzero_pd();
+        __m256d b1_1 = _mm256_setzero_pd(), b2_1 = _mm256_setzero_pd();
+        for (std::size_t n=ncoeffs-1; n>0; n--) {
+          const __m256d an = _mm256_set1_pd(a[n]);
+          const __m256d b0_0 = _mm256_fmadd_pd(t0,b1_0,_mm256_sub_pd(an,b2_0));
+          const __m256d b0_1 = _mm256_fmadd_pd(t1,b1_1,_mm256_sub_pd(an,b2_1));
+          b2_0 = b1_0; b1_0 = b0_0;
+          b2_1 = b1_1; b1_1 = b0_1;
+        }
+        const __m256d a0 = _mm256_set1_pd(a[0]);
+        _mm256_storeu_pd(out+p, _mm256_fmadd_pd(x0,b1_0,_mm256_sub_pd(a0,b2_0)));
+        _mm256_storeu_pd(out+p+4, _mm256_fmadd_pd(x1,b1_1,_mm256_sub_pd(a0,b2_1)));
+      }
+      clenshaw_batch_scalar(a,ncoeffs,x+p,npts-p,out+p);
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline void clenshaw_batch_avx2(const float* a, std::size_t ncoeffs, const float* x, std::size_t npts, float* out)
+    {
+      std::size_t p = 0;
+      for (; p+16<=npts; p+=16) {
+        const __m256 x0 = _mm256_loadu_ps(x+p), x1 = _mm256_loadu_ps(x+p+8);
+        const __m256 t0 = _mm256_add_ps(x0,x0), t1 = _mm256_add_ps(x1,x1);
+        __m256 b1_0 = _mm256_setzero_ps(), b2_0 = _mm256_setzero_ps();
+        __m256 b1_1 = _mm256_setzero_ps(), b2_1 = _mm256_setzero_ps();
+        for (std::size_t n=ncoeffs-1; n>0; n--) {
+          const __m256 an = _mm256_set1_ps(a[n]);
+          const __m256 b0_0 = _mm256_fmadd_ps(t0,b1_0,_mm256_sub_ps(an,b2_0));
+          const __m256 b0_1 = _mm256_fmadd_ps(t1,b1_1,_mm256_sub_ps(an,b2_1));
+          b2_0 = b1_0; b1_0 = b0_0;
+          b2_1 = b1_1; b1_1 = b0_1;
+        }
+        const __m256 a0 = _mm256_set1_ps(a[0]);
+        _mm256_storeu_ps(out+p, _mm256_fmadd_ps(x0,b1_0,_mm256_sub_ps(a0,b2_0)));
+        _mm256_storeu_ps(out+p+8, _mm256_fmadd_ps(x1,b1_1,_mm256_sub_ps(a0,b2_1)));
+      }
+      clenshaw_batch_scalar(a,ncoeffs,x+p,npts-p,out+p);
+    }
+
+    __attribute__((target("avx512f")))
+    inline void clenshaw_batch_avx512(const double* a, std::size_t ncoeffs, const double* x, std::size_t npts, double* out)
+    {
+      std::size_t p = 0;
+      for (; p+16<=npts; p+=16) {
+        const __m512d x0 = _mm512_loadu_pd(x+p), x1 = _mm512_loadu_pd(x+p+8);
+        const __m512d t0 = _mm512_add_pd(x0,x0), t1 = _mm512_add_pd(x1,x1);
+        __m512d b1_0 = _mm512_setzero_pd(), b2_0 = _mm512_setzero_pd();
+        __m512d b1_1 = _mm512_setzero_pd(), b2_1 = _mm512_setzero_pd();
+        for (std::size_t n=ncoeffs-1; n>0; n--) {
+          const __m512d an = _mm512_set1_pd(a[n]);
+          const __m512d b0_0 = _mm512_fmadd_pd(t0,b1_0,_mm512_sub_pd(an,b2_0));
+          const __m512d b0_1 = _mm512_fmadd_pd(t1,b1_1,_mm512_sub_pd(an,b2_1));
+          b2_0 = b1_0; b1_0 = b0_0;
+          b2_1 = b1_1; b1_1 = b0_1;
+        }
+        const __m512d a0 = _mm512_set1_pd(a[0]);
+        _mm512_storeu_pd(out+p, _mm512_fmadd_pd(x0,b1_0,_mm512_sub_pd(a0,b2_0)));
+        _mm512_storeu_pd(out+p+8, _mm512_fmadd_pd(x1,b1_1,_mm512_sub_pd(a0,b2_1)));
+      }
+      clenshaw_batch_avx2(a,ncoeffs,x+p,npts-p,out+p);
+    }
+
+    __attribute__((target("avx512f")))
+    inline void clenshaw_batch_avx512(const float* a, std::size_t ncoeffs, const float* x, std::size_t npts, float* out)
+    {
+      std::size_t p = 0;
+      for (; p+32<=npts; p+=32) {
+        const __m512 x0 = _mm512_loadu_ps(x+p), x1 = _mm512_loadu_ps(x+p+16);
+        const __m512 t0 = _mm512_add_ps(x0,x0), t1 = _mm512_add_ps(x1,x1);
+        __m512 b1_0 = _mm512_setzero_ps(), b2_0 = _mm512_setzero_ps();
+        __m512 b1_1 = _mm512_setzero_ps(), b2_1 = _mm512_setzero_ps();
+        for (std::size_t n=ncoeffs-1; n>0; n--) {
+          const __m512 an = _mm512_set1_ps(a[n]);
+          const __m512 b0_0 = _mm512_fmadd_ps(t0,b1_0,_mm512_sub_ps(an,b2_0));
+          const __m512 b0_1 = _mm512_fmadd_ps(t1,b1_1,_mm512_sub_ps(an,b2_1));
+          b2_0 = b1_0; b1_0 = b0_0;
+          b2_1 = b1_1; b1_1 = b0_1;
+        }
+        const __m512 a0 = _mm512_set1_ps(a[0]);
+        _mm512_storeu_ps(out+p, _mm512_fmadd_ps(x0,b1_0,_mm512_sub_ps(a0,b2_0)));
+        _mm512_storeu_ps(out+p+16, _mm512_fmadd_ps(x1,b1_1,_mm512_sub_ps(a0,b2_1)));
+      }
+      clenshaw_batch_avx2(a,ncoeffs,x+p,npts-p,out+p);
+    }
+
+    /*
+     * float coefficients, points and results with the recurrence in double:
+     * the loads and stores convert, the arithmetic is that of the double kernels.
+     */
+    __attribute__((target("avx2,fma")))
+    inline void clenshaw_batch_mixed_avx2(const float* a, std::size_t ncoeffs, const float* x, std::size_t npts, float* out)
+    {
+      std::size_t p = 0;
+      for (; p+8<=npts; p+=8) {
+        const __m256d x0 = _mm256_cvtps_pd(_mm_loadu_ps(x+p)), x1 = _mm256_cvtps_pd(_mm_loadu_ps(x+p+4));
+        const __m256d t0 = _mm256_add_pd(x0,x0), t1 = _mm256_add_pd(x1,x1);
+        __m256d b1_0 = _mm256_setzero_pd(), b2_0 = _mm256_setzero_pd();
+        __m256d b1_1 = _mm256_setzero_pd(), b2_1 = _mm256_setzero_pd();
+        for (std::size_t n=ncoeffs-1; n>0; n--) {
+          const __m256d an = _mm256_set1_pd(a[n]);
+          const __m256d b0_0 = _mm256_fmadd_pd(t0,b1_0,_mm256_sub_pd(an,b2_0));
+          const __m256d b0_1 = _mm256_fmadd_pd(t1,b1_1,_mm256_sub_pd(an,b2_1));
+          b2_0 = b1_0; b1_0 = b0_0;
+          b2_1 = b1_1; b1_1 = b0_1;
+        }
+        const __m256d a0 = _mm256_set1_pd(a[0]);
+        _mm_storeu_ps(out+p, _mm256_cvtpd_ps(_mm256_fmadd_pd(x0,b1_0,_mm256_sub_pd(a0,b2_0))));
+        _mm_storeu_ps(out+p+4, _mm256_cvtpd_ps(_mm256_fmadd_pd(x1,b1_1,_mm256_sub_pd(a0,b2_1))));
+      }
+      clenshaw_batch_mixed_scalar<float,double>(a,ncoeffs,x+p,npts-p,out+p);
+    }
+
+    __attribute__((target("avx512f")))
+    inline void clenshaw_batch_mixed_avx512(const float* a, std::size_t ncoeffs, const float* x, std::size_t npts, float* out)
+    {
+      std::size_t p = 0;
+      for (; p+16<=npts; p+=16) {
+        // maskz forms: the plain conversions start from an undefined register, which GCC warns about
+        const __m512d x0 = _mm512_maskz_cvtps_pd(0xFF,_mm256_loadu_ps(x+p)), x1 = _mm512_maskz_cvtps_pd(0xFF,_mm256_loadu_ps(x+p+8));
+        const __m512d t0 = _mm512_add_pd(x0,x0), t1 = _mm512_add_pd(x1,x1);
+        __m512d b1_0 = _mm512_setzero_pd(), b2_0 = _mm512_setzero_pd();
+        __m512d b1_1 = _mm512_setzero_pd(), b2_1 = _mm512_setzero_pd();
+        for (std::size_t n=ncoeffs-1; n>0; n--) {
+          const __m512d an = _mm512_set1_pd(a[n]);
+          const __m512d b0_0 = _mm512_fmadd_pd(t0,b1_0,_mm512_sub_pd(an,b2_0));
+          const __m512d b0_1 = _mm512_fmadd_pd(t1,b1_1,_mm512_sub_pd(an,b2_1));
+          b2_0 = b1_0; b1_0 = b0_0;
+          b2_1 = b1_1; b1_1 = b0_1;
+        }
+        const __m512d a0 = _mm512_set1_pd(a[0]);
+        _mm256_storeu_ps(out+p, _mm512_maskz_cvtpd_ps(0xFF,_mm512_fmadd_pd(x0,b1_0,_mm512_sub_pd(a0,b2_0))));
+        _mm256_storeu_ps(out+p+8, _mm512_maskz_cvtpd_ps(0xFF,_mm512_fmadd_pd(x1,b1_1,_mm512_sub_pd(a0,b2_1))));
+      }
+      clenshaw_batch_mixed_avx2(a,ncoeffs,x+p,npts-p,out+p);
+    }
+#endif
+  }
+
+  /**
+   * @brief Evaluate sum_{n<ncoeffs} a_n T_n(x_p) at npts points.
+   * @param a coefficients
+   * @param ncoeffs number of coefficients
+   * @param x points of evaluation
+   * @param npts number of points
+   * @param out output, npts values
+   * @param level instruction set, clamped to what the CPU supports
+   */
+  template <class C> inline void clenshaw_batch(const C* a, std::size_t ncoeffs, const C* x, std::size_t npts, C* out,
+                                                SimdLevel level = detected_simd_level())
+  {
+#ifdef SPECTRE_X86_SIMD
+    if constexpr (std::is_same<C,double>::value || std::is_same<C,float>::value) {
+      if (level > detected_simd_level()) level = detected_simd_level();
+      if (ncoeffs > 0 && level == SimdLevel::AVX512) {
+        detail::clenshaw_batch_avx512(a,ncoeffs,x,npts,out);
+        return;
+      }
+      if (ncoeffs > 0 && level == SimdLevel::AVX2) {
+        detail::clenshaw_batch_avx2(a,ncoeffs,x,npts,out);
+        return;
+      }
+    }
+#endif
+    detail::clenshaw_batch_scalar(a,ncoeffs,x,npts,out);
+  }
+
+  /**
+   * @brief clenshaw_batch with coefficients, points and results stored in S
+   * and the recurrence carried out in the wider type C.
+   * The rounding error is then that of storing in S, not that of N steps of
+   * arithmetic in S; float/double has AVX2 and AVX-512 kernels.
+   */
+  template <class S, class C> inline void clenshaw_batch_mixed(const S* a, std::size_t ncoeffs, const S* x, std::size_t npts, S* out,
+                                                               SimdLevel level = detected_simd_level())
+  {
+#ifdef SPECTRE_X86_SIMD
+    if constexpr (std::is_same<S,float>::value && std::is_same<C,double>::value) {
+      if (level > detected_simd_level()) level = detected_simd_level();
+      if (ncoeffs > 0 && level == SimdLevel::AVX512) {
+        detail::clenshaw_batch_mixed_avx512(a,ncoeffs,x,npts,out);
+        return;
+      }
+      if (ncoeffs > 0 && level == SimdLevel::AVX2) {
+        detail::clenshaw_batch_mixed_avx2(a,ncoeffs,x,npts,out);
+        return;
+      }
+    }
+#endif
+    detail::clenshaw_batch_mixed_scalar<S,C>(a,ncoeffs,x,npts,out);
+  }
+
+  //! Span overload of clenshaw_batch, x and out must have the same length
+  template <class C> inline void clenshaw_batch(FunctionalBases::Span<const C> a, FunctionalBases::Span<const C> x, FunctionalBases::Span<C> out,
+                                                SimdLevel level = detected_simd_level())
+  {
+    assert(x.size()==out.size());
+    clenshaw_batch(a.data(),a.size(),x.data(),x.size(),out.data(),level);
+  }
+
+}
+
+#endif
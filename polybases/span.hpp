@@ -0,0 +1,60 @@
+/**
+ * @file span.hpp
+ * @brief Minimal non-owning view over contiguous memory.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * A std::span-like pointer/length pair so that kernels can read from and
+ * write into caller-owned buffers (vectors, arrays, raw memory) without
+ * resizing or copying them.
+ */
+#ifndef _MY_SPECTRE_SPAN_HPP
+#define _MY_SPECTRE_SPAN_HPP
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <assert.h>
+#include <type_traits>
+
+namespace FunctionalBases {
+
+  /**
+   * @brief Non-owning view of n contiguous elements of type T (T may be const).
+   */
+  template <class T>
+  class Span {
+    T* ptr;
+    std::size_t n;
+  public:
+    typedef T element_type;
+    typedef typename std::remove_cv<T>::type value_type;
+    constexpr Span() : ptr(nullptr), n(0) {};
+    constexpr Span(T* ptr, std::size_t n) : ptr(ptr), n(n) {};
+    //! View of a vector, only const views can be taken of const vectors
+    template <class V, class A>
+    Span(std::vector<V,A>& v) : ptr(v.data()), n(v.size()) {};
+    template <class V, class A>
+    Span(const std::vector<V,A>& v) : ptr(v.data()), n(v.size()) {};
+    template <class V, std::size_t M>
+    constexpr Span(std::array<V,M>& a) : ptr(a.data()), n(M) {};
+    template <class V, std::size_t M>
+    constexpr Span(const std::array<V,M>& a) : ptr(a.data()), n(M) {};
+    //! Span<T> converts to Span<const T>
+    template <class U, class = typename std::enable_if<std::is_convertible<U(*)[],T(*)[]>::value>::type>
+    constexpr Span(const Span<U>& s) : ptr(s.data()), n(s.size()) {};
+    // access ----------------
+    constexpr T* data() const { return ptr; }
+    constexpr std::size_t size() const { return n; }
+    constexpr bool empty() const { return n==0; }
+    constexpr T& operator[](std::size_t i) const { return ptr[i]; }
+    constexpr T* begin() const { return ptr; }
+    constexpr T* end() const { return ptr+n; }
+    //! View of elements [offset, offset+count)
+    inline Span subspan(std::size_t offset, std::size_t count) const {
+      assert(offset+count<=n);
+      return Span(ptr+offset,count);
+    }
+  };
+
+} // namespace FunctionalBases
+
+#endif
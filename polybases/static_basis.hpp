@@ -0,0 +1,145 @@
+/**
+ * @file static_basis.hpp
+ * @brief Compile-time (CRTP) basis interface and its type-erased adapter.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * FunctionalBase dispatches every call through its vtable. The generic
+ * evaluate_series then costs one indirect call per term and the compiler can
+ * neither inline evaluate_function nor vectorise the sum. A StaticBasis
+ * resolves the same interface at compile time. Function, Derivative,
+ * SecondDerivative, TimesX and Identity can be instantiated on it directly,
+ * and BasisAdapter wraps it into a FunctionalBase wherever a runtime
+ * polymorphic basis is needed.
+ */
+#ifndef _MY_SPECTRE_STATIC_BASIS_HPP
+#define _MY_SPECTRE_STATIC_BASIS_HPP
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include "polybases.hpp"
+#include "span.hpp"
+#include "operator_storage.hpp"
+
+namespace FunctionalBases {
+
+  /**
+   * @brief CRTP base of bases with statically bound member functions.
+   * Derived must provide
+   *   - Derived(unsigned int N), so that the PlanRegistry can build it,
+   *   - int get_N() const,
+   *   - T evaluate_function(const T& x, unsigned int n) const,
+   *   - calc_spectral_coeffs(Span<const T>, Span<T>) and
+   *     calc_function_values(Span<const T>, Span<T>),
+   *   - const std::vector<T>& get_nodes() const,
+   *   - deriv_storage(), second_deriv_storage() and times_x_storage().
+   * It gets the remaining members of the FunctionalBase interface from here,
+   * calling back into Derived without virtual dispatch. A Derived member
+   * replaces the default of the same name, as with a virtual override. Derived
+   * keeps the vector overloads of the transforms with
+   * `using StaticBasis<Derived,T>::calc_spectral_coeffs;` (same for
+   * calc_function_values, get_nodes and get_weights).
+   */
+  template <class Derived, class T>
+  class StaticBasis {
+  public:
+    typedef T value_type;
+    inline const Derived& derived() const { return static_cast<const Derived&>(*this); }
+    /**
+     * @brief Evaluate the series sum_n coeffs[n] phi_n(x).
+     * evaluate_function is inlined into the sum. Bases that have a recurrence
+     * should still provide their own.
+     */
+    inline T evaluate_series(const T& x, Span<const T> coeffs) const {
+      T tmp = static_cast<T>(0);
+      for (std::size_t n=0; n<coeffs.size(); n++) tmp += coeffs[n] * derived().evaluate_function(x,n);
+      return tmp;
+    }
+    //! Evaluate the series at a batch of points, out[p] = sum_n coeffs[n] phi_n(x[p])
+    inline void evaluate_series_batch(Span<const T> x, Span<const T> coeffs, Span<T> out) const {
+      assert(x.size()==out.size());
+      for (std::size_t p=0; p<x.size(); p++) out[p] = derived().evaluate_series(x[p],coeffs);
+    }
+    //! Forward transform into a vector, resized to num_coeffs()
+    inline void calc_spectral_coeffs(const std::vector<T>& f, std::vector<T>& ftilde) const {
+      ftilde.resize(derived().num_coeffs());
+      derived().calc_spectral_coeffs(Span<const T>(f),Span<T>(ftilde));
+    }
+    //! Inverse transform into a vector, resized to get_N()+1
+    inline void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const {
+      f.resize(derived().get_N()+1);
+      derived().calc_function_values(Span<const T>(ftilde),Span<T>(f));
+    }
+    //! Length of a vector of spectral coefficients
+    inline std::size_t num_coeffs() const { return derived().get_N()+1; }
+    //! See FunctionalBase::plan_key
+    inline std::string plan_key() const { return std::string(); }
+    //! See FunctionalBase::chebyshev_elements
+    inline std::vector<T> chebyshev_elements() const { return std::vector<T>(); }
+    inline void get_nodes(std::vector<T>& pts) const { pts = derived().get_nodes(); }
+    inline void get_weights(std::vector<T>& w) const { w = derived().get_weights(); }
+    //! Quadrature weights, empty unless Derived stores them
+    inline const std::vector<T>& get_weights() const {
+      static const std::vector<T> empty;
+      return empty;
+    }
+  protected:
+    // only usable as a base class
+    StaticBasis() = default;
+    ~StaticBasis() = default;
+  };
+
+  /**
+   * @brief Type-erased FunctionalBase forwarding to a StaticBasis.
+   * Every virtual call goes straight to the wrapped basis, so inside one call
+   * (a transform, a batch of points) the code is the statically bound one.
+   * @tparam B a StaticBasis
+   */
+  template <class B>
+  class BasisAdapter final : public FunctionalBase<typename B::value_type> {
+  public:
+    typedef typename B::value_type value_type;
+  private:
+    typedef value_type T;
+    B impl; //! wrapped basis
+  public:
+    //! Build B(N), the form the PlanRegistry uses
+    explicit BasisAdapter(unsigned int N) : FunctionalBase<T>(N), impl(N) {};
+    explicit BasisAdapter(const B& b) : FunctionalBase<T>(b.get_N()), impl(b) {};
+    //! The wrapped basis
+    inline const B& get() const { return impl; }
+    inline T evaluate_function(const T& x, const unsigned int n) const override { return impl.evaluate_function(x,n); }
+    inline T evaluate_series(const T& x, const std::vector<T>& coeffs) const override {
+      return impl.evaluate_series(x,Span<const T>(coeffs));
+    }
+    inline void evaluate_series_batch(Span<const T> x, const std::vector<T>& coeffs, Span<T> out) const override {
+      impl.evaluate_series_batch(x,Span<const T>(coeffs),out);
+    }
+    inline void calc_spectral_coeffs(const std::vector<T>& f, std::vector<T>& ftilde) const override {
+      ftilde.resize(impl.num_coeffs());
+      impl.calc_spectral_coeffs(Span<const T>(f),Span<T>(ftilde));
+    }
+    inline void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const override {
+      f.resize(impl.get_N()+1);
+      impl.calc_function_values(Span<const T>(ftilde),Span<T>(f));
+    }
+    inline void calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const override { impl.calc_spectral_coeffs(f,ftilde); }
+    inline void calc_function_values(Span<const T> ftilde, Span<T> f) const override { impl.calc_function_values(ftilde,f); }
+    inline void calc_deriv(std::vector<T>& Lij) const override { impl.deriv_storage().to_dense(Lij); }
+    inline void calc_second_deriv(std::vector<T>& Lij) const override { impl.second_deriv_storage().to_dense(Lij); }
+    inline void calc_times_x(std::vector<T>& Lij) const override { impl.times_x_storage().to_dense(Lij); }
+    inline OperatorStorage<T> deriv_storage() const override { return impl.deriv_storage(); }
+    inline OperatorStorage<T> second_deriv_storage() const override { return impl.second_deriv_storage(); }
+    inline OperatorStorage<T> times_x_storage() const override { return impl.times_x_storage(); }
+    inline void get_nodes(std::vector<T>& pts) const override { pts = impl.get_nodes(); }
+    inline void get_weights(std::vector<T>& w) const override { w = impl.get_weights(); }
+    inline const std::vector<T>& get_nodes() const override { return impl.get_nodes(); }
+    inline const std::vector<T>& get_weights() const override { return impl.get_weights(); }
+    inline int get_N() const override { return impl.get_N(); }
+    inline std::size_t num_coeffs() const override { return impl.num_coeffs(); }
+    inline std::string plan_key() const override { return impl.plan_key(); }
+    inline std::vector<T> chebyshev_elements() const override { return impl.chebyshev_elements(); }
+  };
+
+} // namespace FunctionalBases
+
+#endif
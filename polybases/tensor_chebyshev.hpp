@@ -0,0 +1,265 @@
+/**
+ * @file tensor_chebyshev.hpp
+ * @brief Tensor-product Chebyshev bases on D-dimensional boxes.
+ * @author Carlo Musolino (musolino@itp.uni-frankfurt.de)
+ * Axis d of the box [lo_d,hi_d] is expanded in Chebyshev polynomials of
+ * order N_d, sampled at the Gauss-Lobatto nodes mapped from [-1,1] (in the
+ * same descending order as ChebyshevBase). Values and coefficients are
+ * stored row-major with the last axis fastest.
+ * Everything is sum factorised, i.e. applied one axis at a time:
+ *   - transforms: along axis d the array is a sequence of (N_d+1) x inner
+ *     slabs, each an AoS batch for calc_spectral_coeffs_batch (for the last
+ *     axis the whole array is one SoA batch), so a full transform costs
+ *     O(N^{d+1}) as GEMMs or O(N^d log N) through the DCT;
+ *   - operators: the 1D operator of the axis from the PlanRegistry is
+ *     applied to every pencil, blocks of neighbouring pencils are gathered
+ *     together so strided axes read contiguous runs;
+ *   - evaluation: Clenshaw along the last axis, then the next, ... .
+ * Transforms and operators are parallel over slabs/pencils on the Parallel
+ * thread pool.
+ */
+#ifndef _MY_SPECTRE_TENSOR_CHEBYSHEV_HPP
+#define _MY_SPECTRE_TENSOR_CHEBYSHEV_HPP
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "polybases.hpp"
+#include "plan_registry.hpp"
+#include "parallel.hpp"
+#include "chebyshev.hpp"
+
+namespace FunctionalBases {
+
+  /**
+   * @brief Tensor product of D Chebyshev bases.
+   * @tparam T scalar type
+   * @tparam D number of dimensions
+   */
+  template <class T, unsigned int D>
+  class TensorChebyshevBase {
+  public:
+    typedef T value_type;
+    typedef std::array<T,D> point_type;
+    typedef std::array<unsigned int,D> order_type;
+  private:
+    order_type N;            //! order along every axis
+    point_type lo, hi;       //! box [lo_d,hi_d]
+    std::array<std::shared_ptr<const ChebyshevBase<T>>,D> axes; //! 1D bases from the PlanRegistry
+    unsigned int nthreads;   //! threads used over slabs, pencils and points
+    //! Pencils gathered together by apply_operator
+    static constexpr std::size_t pencil_block = 8;
+    //! Points evaluated per task by evaluate_series_batch
+    static constexpr std::size_t eval_chunk = 64;
+  public:
+    // constructors ----------------------
+    /**
+     * @brief Constructor
+     * @param N order along every axis
+     * @param lo lower corner of the box
+     * @param hi upper corner of the box
+     * @param nthreads threads of the global pool
+     */
+    TensorChebyshevBase(const order_type& N, const point_type& lo, const point_type& hi,
+                        unsigned int nthreads=Parallel::default_threads()) :
+      N(N), lo(lo), hi(hi), nthreads(nthreads) {
+      for (unsigned int d=0; d<D; d++) {
+        assert(N[d]>0 && hi[d]>lo[d]);
+        axes[d] = PlanRegistry::instance().get_basis<ChebyshevBase<T>>(N[d]);
+      }
+    }
+    //! Same order N on every axis of the cube [a,b]^D
+    TensorChebyshevBase(unsigned int N, T a=static_cast<T>(-1), T b=static_cast<T>(1),
+                        unsigned int nthreads=Parallel::default_threads()) :
+      TensorChebyshevBase(filled<unsigned int>(N),filled<T>(a),filled<T>(b),nthreads) {}
+    // class methods ---------------------
+    /**
+     * @brief Values at the grid points -> tensor Chebyshev coefficients.
+     * @param f size() values
+     * @param ftilde size() coefficients, must not overlap f
+     */
+    inline void calc_spectral_coeffs(Span<const T> f, Span<T> ftilde) const { transform<true>(f,ftilde); }
+    //! Tensor Chebyshev coefficients -> values at the grid points
+    inline void calc_function_values(Span<const T> ftilde, Span<T> f) const { transform<false>(ftilde,f); }
+    inline void calc_spectral_coeffs(const std::vector<T>& f, std::vector<T>& ftilde) const {
+      ftilde.resize(size());
+      calc_spectral_coeffs(Span<const T>(f),Span<T>(ftilde));
+    }
+    inline void calc_function_values(const std::vector<T>& ftilde, std::vector<T>& f) const {
+      f.resize(size());
+      calc_function_values(Span<const T>(ftilde),Span<T>(f));
+    }
+    /**
+     * @brief Apply a 1D operator along one axis in coefficient space.
+     * Derivatives are scaled to the box, TimesX multiplies by the coordinate of the axis.
+     * @param kind which operator
+     * @param axis axis it acts on
+     * @param in size() coefficients
+     * @param out size() coefficients, may be the same array as in
+     */
+    inline void apply_operator(OperatorKind kind, unsigned int axis, Span<const T> in, Span<T> out) const;
+    /**
+     * @brief Evaluate the tensor series at one point.
+     * @param x point inside the box
+     * @param coeffs size() coefficients
+     */
+    inline T evaluate_series(const point_type& x, Span<const T> coeffs) const;
+    //! Evaluate the tensor series at many points, parallel over chunks of points
+    inline void evaluate_series_batch(Span<const point_type> x, Span<const T> coeffs, Span<T> out) const;
+    // access ----------------
+    inline unsigned int get_N(unsigned int d) const { return N[d]; }
+    inline const order_type& get_orders() const { return N; }
+    //! Number of grid points (and coefficients) along axis d
+    inline std::size_t extent(unsigned int d) const { return N[d]+1; }
+    //! Total number of grid points, equal to the number of coefficients
+    inline std::size_t size() const {
+      std::size_t s = 1;
+      for (unsigned int d=0; d<D; d++) s *= extent(d);
+      return s;
+    }
+    inline const point_type& lower() const { return lo; }
+    inline const point_type& upper() const { return hi; }
+    //! Nodes along axis d, mapped to [lo_d,hi_d]
+    inline void get_nodes(unsigned int d, std::vector<T>& pts) const {
+      axes[d]->get_nodes(pts);
+      for (auto& v: pts) v = to_box(d,v);
+    }
+    inline const ChebyshevBase<T>& axis_basis(unsigned int d) const { return *axes[d]; }
+    inline unsigned int get_num_threads() const { return nthreads; }
+    inline void set_num_threads(unsigned int n) { nthreads = n; }
+  private:
+    template <class V> static inline std::array<V,D> filled(V v) {
+      std::array<V,D> a;
+      a.fill(v);
+      return a;
+    }
+    inline T to_box(unsigned int d, const T& xi) const {
+      return static_cast<T>(0.5)*(lo[d]+hi[d]) + static_cast<T>(0.5)*(hi[d]-lo[d])*xi;
+    }
+    inline T to_reference(unsigned int d, const T& x) const {
+      return (static_cast<T>(2)*x-lo[d]-hi[d])/(hi[d]-lo[d]);
+    }
+    //! Product of the extents before / after axis d
+    inline std::size_t outer(unsigned int d) const {
+      std::size_t s = 1;
+      for (unsigned int e=0; e<d; e++) s *= extent(e);
+      return s;
+    }
+    inline std::size_t inner(unsigned int d) const {
+      std::size_t s = 1;
+      for (unsigned int e=d+1; e<D; e++) s *= extent(e);
+      return s;
+    }
+    template <bool forward> inline void transform(Span<const T> in, Span<T> out) const;
+    template <bool forward> inline void axis_transform(unsigned int d, const T* in, T* out) const;
+  };
+
+  /*
+   * Axes are transformed one after the other, alternating between out and a
+   * thread-local work array (grown on demand, never shrunk) so that the last
+   * axis lands in out.
+   */
+  template <class T, unsigned int D> template <bool forward>
+  inline void TensorChebyshevBase<T,D>::transform(Span<const T> in, Span<T> out) const
+  {
+    assert(in.size()==size() && out.size()==size());
+    assert(in.data()+in.size()<=out.data() || out.data()+out.size()<=in.data());
+    static thread_local std::vector<T> work;
+    if (D>1 && work.size()<size()) work.resize(size());
+    const T* src = in.data();
+    for (unsigned int d=0; d<D; d++) {
+      T* dst = (D-1-d)%2==0 ? out.data() : work.data();
+      axis_transform<forward>(d,src,dst);
+      src = dst;
+    }
+  }
+
+  template <class T, unsigned int D> template <bool forward>
+  inline void TensorChebyshevBase<T,D>::axis_transform(unsigned int d, const T* in, T* out) const
+  {
+    const std::size_t n = extent(d), no = outer(d), ni = inner(d);
+    const ChebyshevBase<T>& b = *axes[d];
+    auto batch = [&](const T* src, T* dst, std::size_t M, BatchLayout layout, unsigned int threads) {
+      if (forward) b.calc_spectral_coeffs_batch(Span<const T>(src,M*n),Span<T>(dst,M*n),M,layout,threads);
+      else b.calc_function_values_batch(Span<const T>(src,M*n),Span<T>(dst,M*n),M,layout,threads);
+    };
+    if (ni==1) {
+      batch(in,out,no,BatchLayout::SoA,nthreads);
+      return;
+    }
+    // few slabs: every slab is split over the threads, otherwise one slab per task
+    if (no<nthreads) {
+      for (std::size_t o=0; o<no; o++) batch(in+o*n*ni,out+o*n*ni,ni,BatchLayout::AoS,nthreads);
+    }
+    else {
+      Parallel::parallel_for(no,[&](std::size_t o) { batch(in+o*n*ni,out+o*n*ni,ni,BatchLayout::AoS,1); },nthreads);
+    }
+  }
+
+  template <class T, unsigned int D>
+  inline void TensorChebyshevBase<T,D>::apply_operator(OperatorKind kind, unsigned int axis, Span<const T> in, Span<T> out) const
+  {
+    assert(axis<D && in.size()==size() && out.size()==size());
+    const std::shared_ptr<const OperatorStorage<T>> R = PlanRegistry::instance().get_operator<T>(*axes[axis],kind);
+    const T h = hi[axis]-lo[axis];
+    T alpha = static_cast<T>(0), beta = static_cast<T>(1);
+    switch(kind){
+    case OperatorKind::Derivative: beta = static_cast<T>(2)/h; break;
+    case OperatorKind::SecondDerivative: beta = static_cast<T>(4)/(h*h); break;
+    case OperatorKind::TimesX: alpha = static_cast<T>(0.5)*(lo[axis]+hi[axis]); beta = static_cast<T>(0.5)*h; break;
+    }
+    const std::size_t n = extent(axis), no = outer(axis), ni = inner(axis);
+    const std::size_t nblocks = (ni+pencil_block-1)/pencil_block;
+    Parallel::parallel_for(no*nblocks,[&](std::size_t task) {
+      static thread_local std::vector<T> x, y;
+      const std::size_t o = task/nblocks, j0 = (task%nblocks)*pencil_block, nb = std::min(pencil_block,ni-j0);
+      const T* src = in.data()+o*n*ni+j0;
+      T* dst = out.data()+o*n*ni+j0;
+      x.resize(nb*n);
+      y.resize(nb*n);
+      for (std::size_t i=0; i<n; i++)
+        for (std::size_t j=0; j<nb; j++) x[j*n+i] = src[i*ni+j];
+      for (std::size_t j=0; j<nb; j++) {
+        for (std::size_t i=0; i<n; i++) y[j*n+i] = alpha*x[j*n+i];
+        R->apply_add(&x[j*n],&y[j*n],beta);
+      }
+      for (std::size_t i=0; i<n; i++)
+        for (std::size_t j=0; j<nb; j++) dst[i*ni+j] = y[j*n+i];
+    },nthreads);
+  }
+
+  template <class T, unsigned int D>
+  inline T TensorChebyshevBase<T,D>::evaluate_series(const point_type& x, Span<const T> coeffs) const
+  {
+    assert(coeffs.size()==size());
+    static thread_local std::vector<T> a, b;
+    // contract the last remaining axis, the array shrinks by a factor extent(d) each time
+    const T* src = coeffs.data();
+    std::size_t len = coeffs.size();
+    for (int d=D-1; d>=0; d--) {
+      const std::size_t n = extent(d), m = len/n;
+      const T xi = to_reference(d,x[d]);
+      b.resize(m);
+      for (std::size_t p=0; p<m; p++) b[p] = Chebyshev::clenshaw(xi,src+p*n,n);
+      a.swap(b);
+      src = a.data();
+      len = m;
+    }
+    return a[0];
+  }
+
+  template <class T, unsigned int D>
+  inline void TensorChebyshevBase<T,D>::evaluate_series_batch(Span<const point_type> x, Span<const T> coeffs, Span<T> out) const
+  {
+    assert(x.size()==out.size() && coeffs.size()==size());
+    const std::size_t nchunks = (x.size()+eval_chunk-1)/eval_chunk;
+    Parallel::parallel_for(nchunks,[&](std::size_t c) {
+      const std::size_t p1 = std::min(x.size(),(c+1)*eval_chunk);
+      for (std::size_t p=c*eval_chunk; p<p1; p++) out[p] = evaluate_series(x[p],coeffs);
+    },nthreads);
+  }
+
+} // namespace FunctionalBases
+
+#endif
@@ -0,0 +1,63 @@
+#include "../functions.hpp"
+#include "../ODE/linear_diff_ops.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+template <class F> double max_error(const AdaptiveFunction<double>& f, F exact)
+{
+    double e = 0.0;
+    for (int k=0; k<=1000; k++) {
+        const double x = -1.0 + k/500.0;
+        e = std::max(e,std::abs(f(x)-exact(x)));
+    }
+    return e;
+}
+
+int main()
+{
+    int failures = 0;
+
+    // smooth functions come out short and accurate
+    auto ex = [](double x) { return std::exp(x); };
+    AdaptiveFunction<double> fexp = AdaptiveFunction<double>::from_callable(ex);
+    cout << "exp: N = " << fexp.get_N() << ", error " << max_error(fexp,ex) << "\n";
+    if (!fexp.is_resolved() || fexp.get_N() > 20 || max_error(fexp,ex) > 1e-14) failures++;
+
+    auto cubic = [](double x) { return x*x*x - x; };
+    AdaptiveFunction<double> fcub = AdaptiveFunction<double>::from_callable(cubic);
+    cout << "cubic: N = " << fcub.get_N() << "\n";
+    if (fcub.get_N() != 3 || max_error(fcub,cubic) > 1e-15) failures++;
+
+    // a steep front forces refinement; every sample is taken exactly once
+    int calls = 0;
+    auto front = [&calls](double x) { calls++; return std::tanh(50*x); };
+    AdaptiveFunction<double> ffront = AdaptiveFunction<double>::from_callable(front);
+    unsigned int grid = 16;
+    while (grid+1 < static_cast<unsigned int>(calls)) grid *= 2;
+    cout << "tanh(50x): N = " << ffront.get_N() << ", samples " << calls << ", error " << max_error(ffront,[](double x) { return std::tanh(50*x); }) << "\n";
+    if (!ffront.is_resolved() || static_cast<unsigned int>(calls) != grid+1 || ffront.get_N() >= grid
+        || max_error(ffront,[](double x) { return std::tanh(50*x); }) > 1e-12) failures++;
+
+    // non-smooth functions are reported as unresolved at Nmax
+    AdaptiveFunction<double> fabs = AdaptiveFunction<double>::from_callable([](double x) { return std::abs(x); },
+                                                                            AdaptiveFunction<double>::default_tolerance(),16,1024);
+    cout << "|x|: N = " << fabs.get_N() << ", resolved " << fabs.is_resolved() << "\n";
+    if (fabs.is_resolved() || fabs.get_N() != 1024) failures++;
+
+    // operators on the adaptive basis only cost the chosen order
+    Derivative<double> D(fexp.get_basis().get());
+    std::vector<double> ft, dft;
+    fexp.get_spectral_coeffs(ft);
+    D.apply(ft,dft);
+    AdaptiveFunction<double> dexp = AdaptiveFunction<double>::from_spectral_coeffs(dft);
+    cout << "d/dx exp: N = " << dexp.get_N() << ", error " << max_error(dexp,ex) << "\n";
+    if (D.get_N() != fexp.get_N() || max_error(dexp,ex) > 1e-12) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
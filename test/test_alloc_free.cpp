@@ -0,0 +1,122 @@
+#include "../functions.hpp"
+#include "../polybases/piecewise_chebyshev.hpp"
+#include "../ODE/odesolvers.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using namespace ODE;
+using std::cout;
+
+// count every heap allocation made by the program
+static std::size_t n_allocs = 0;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(std::size_t size) {
+    n_allocs++;
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+inline void gauss(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(-4*v*v));
+}
+
+/*
+ * A pseudo time step on caller-owned buffers: values -> coefficients,
+ * explicit operator, implicit solve, back to values, evaluation.
+ */
+template <class Base, unsigned int N>
+void step(Function<double,Base,N>& u, const LinearOperator<double>& L, const LinearOperator<double>& I, const ODESolver<double>& solver,
+          std::vector<double>& rhs, std::vector<double>& tmp, std::vector<double>& pts, std::vector<double>& out)
+{
+    const std::vector<double>& ft = u.spectral_coeffs();
+    L.apply(Span<const double>(ft),Span<double>(rhs));
+    (0.1*L + I).apply(Span<const double>(ft),Span<double>(tmp));
+    for (std::size_t i=0; i<rhs.size(); i++) rhs[i] = ft[i] + 0.01*tmp[i];
+    solver.solve(Span<const double>(rhs),Span<double>(tmp));
+    u.update_spectral_coeffs(Span<const double>(tmp));
+    u.get_basis()->calc_spectral_coeffs(Span<const double>(u.func_vals()),Span<double>(rhs));
+    u.eval(Span<const double>(pts),Span<double>(out));
+}
+
+int main()
+{
+    int failures = 0;
+
+    // Chebyshev bases on both transform paths
+    Function<double,ChebyshevBase<double>,16> u16(&gauss);
+    Function<double,ChebyshevBase<double>,128> u128(&gauss);
+    SecondDerivative<double> L16(u16.get_basis().get()), L128(u128.get_basis().get());
+    Identity<double> I16(u16.get_basis().get()), I128(u128.get_basis().get());
+    std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,0.0),
+                                               BoundaryCondition<double>::Dirichlet(Boundary::Right,0.0)};
+    ODESolver<double> s16(I16 - 0.01*L16,bcs);
+    ODESolver<double> s128(I128 - 0.01*L128,bcs);
+    // mixed precision: float factorisation, solve_system in the refinement sweeps
+    RefinedODESolver<float,double> mp128(I128 - 0.01*L128,bcs);
+    std::vector<double> ur128(129);
+    std::vector<double> r16(17), t16(17), r128(129), t128(129), pts(100), out(100);
+    for (std::size_t p=0; p<pts.size(); p++) pts[p] = -1.0 + 2.0*p/(pts.size()-1);
+
+    // piecewise basis and the batched/multi-RHS kernels
+    auto pw = std::make_shared<const PiecewiseChebyshevBase<double,4>>(64,-1.0,1.0);
+    std::vector<double> pwv(65), pwc(pw->num_coeffs());
+    for (std::size_t i=0; i<pwv.size(); i++) pwv[i] = std::sin(pw->get_nodes()[i]);
+    const std::size_t M = 40;
+    std::vector<double> F(M*129), U(M*129);
+    for (std::size_t i=0; i<F.size(); i++) F[i] = std::sin(0.1*i);
+    // nonlinear terms on both product paths
+    Function<double,ChebyshevBase<double>,16> p16(&gauss);
+    Function<double,ChebyshevBase<double>,300> g300(&gauss), p300(&gauss);
+    Parallel::ThreadPool pool(3);
+    std::vector<double> hits(64);
+
+    auto hot_loop = [&]() {
+        for (int k=0; k<10; k++) {
+            step(u16,L16,I16,s16,r16,t16,pts,out);
+            step(u128,L128,I128,s128,r128,t128,pts,out);
+            const std::vector<double>& x = u128.get_basis()->get_nodes();
+            const std::vector<double>& w = u128.get_basis()->get_weights();
+            u128.update_func_vals(Span<const double>(u128.func_vals()));
+            out[0] = x[3]*w[3];
+            pw->calc_spectral_coeffs(Span<const double>(pwv),Span<double>(pwc));
+            pw->calc_function_values(Span<const double>(pwc),Span<double>(pwv));
+            u128.get_basis()->calc_spectral_coeffs_batch(Span<const double>(F),Span<double>(U),M,BatchLayout::SoA,2);
+            s128.solve(Span<const double>(F),Span<double>(U),M,2);
+            mp128.solve(Span<const double>(F.data(),129),Span<double>(ur128));
+            pool.parallel_for(hits.size(),[&](std::size_t i) { hits[i] += 1.0; },4);
+            p16.set_product(u16,u16);
+            p16.axpy(-0.5,u16);
+            p16 *= 0.5;
+            p300.set_product(g300,g300);
+            p300 -= g300;
+        }
+    };
+    // first pass sizes thread-local scratch and the lazily built plans
+    hot_loop();
+    const std::size_t before = n_allocs;
+    hot_loop();
+    const std::size_t steady = n_allocs-before;
+    cout << "heap allocations in the steady-state loop: " << steady << "\n";
+    if (steady != 0) failures++;
+
+    // the loop did real work: the diffused profile is still a bump vanishing at the ends
+    double u0;
+    u128.eval(0.0,u0);
+    u128.eval(Span<const double>(pts),Span<double>(out));
+    cout << "u(0) = " << u0 << ", u(+-1) = " << out.front() << " " << out.back() << "\n";
+    if (!(u0 > 0.5 && u0 < 1.0) || std::abs(out.front()) > 1e-12 || std::abs(out.back()) > 1e-12) failures++;
+    if (hits[0] != 20.0) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
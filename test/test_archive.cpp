@@ -0,0 +1,212 @@
+#include "../io/archive.hpp"
+#include "../ODE/linear_diff_ops.hpp"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <iterator>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+inline void bump(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(-4*v*v)*std::sin(7*v));
+}
+
+//! Largest difference between the products of an OperatorStorage and an OperatorView
+double apply_diff(const OperatorStorage<double>& L, const OperatorView<double>& V)
+{
+    std::vector<double> x(L.size()), y1(L.size()), y2(L.size());
+    for (std::size_t i=0; i<x.size(); i++) x[i] = std::cos(1.7*i);
+    L.apply(x.data(),y1.data());
+    V.apply(x.data(),y2.data());
+    double e = 0.0;
+    for (std::size_t i=0; i<x.size(); i++) e = std::max(e,std::abs(y1[i]-y2[i]));
+    return e;
+}
+
+//! Overwrite one byte of a file
+void poke(const std::string& path, long pos, char c)
+{
+    std::fstream f(path,std::ios::binary|std::ios::in|std::ios::out);
+    f.seekp(pos);
+    f.put(c);
+}
+
+/**
+ * Write a copy of an archive with one 64-bit field of directory entry i
+ * replaced and the directory checksum redone, so that only the checks of
+ * the entry itself can catch it
+ */
+void forge(const std::string& bytes, const std::string& path, std::size_t i, std::size_t field, std::uint64_t value)
+{
+    std::string b(bytes);
+    std::uint64_t num_entries, dir_offset;
+    std::memcpy(&num_entries,&b[16],8);
+    std::memcpy(&dir_offset,&b[24],8);
+    std::memcpy(&b[dir_offset+i*sizeof(IO::detail::Entry)+field],&value,8);
+    const std::uint64_t h = IO::checksum(&b[dir_offset],num_entries*sizeof(IO::detail::Entry));
+    std::memcpy(&b[32],&h,8);
+    std::ofstream dst(path,std::ios::binary);
+    dst.write(b.data(),b.size());
+}
+
+int main()
+{
+    int failures = 0;
+    const std::string path = "test_archive.bin";
+    const unsigned int N = 200;
+
+    // every storage format, a function and a basis grid
+    typedef Function<double,ChebyshevBase<double>,N> F;
+    F u(&bump);
+    auto basis = u.get_basis();
+    const OperatorStorage<double> D = Derivative<double>(basis.get()).get_storage();
+    const OperatorStorage<double> D2 = SecondDerivative<double>(basis.get()).get_storage();
+    const OperatorStorage<double> X = TimesX<double>(basis.get()).get_storage();
+    std::vector<double> dense(25), sparse(N*N,0.0);
+    for (int k=0; k<25; k++) dense[k] = 1.0/(k+1);
+    for (unsigned int i=0; i<N; i++) { sparse[i*N+(7*i)%N] = i+1; sparse[i*N+(3*i+1)%N] = -0.5; }
+    const OperatorStorage<double> Dn = OperatorStorage<double>::dense(5,dense);
+    const OperatorStorage<double> S = OperatorStorage<double>::compress(N,sparse);
+    const std::vector<float> fl{1.5f,-2.0f,3.25f};
+
+    IO::ArchiveWriter w;
+    w.add_function("u",u);
+    w.add_basis("cheb",*basis);
+    w.add_operator("D",D);
+    w.add_operator("D2",D2);
+    w.add_operator("X",X);
+    w.add_operator("dense",Dn);
+    w.add_operator("csr",S);
+    w.add_array("floats",Span<const float>(fl),42);
+    // tagged with the order of u but too short for it
+    w.add_array("short",Span<const double>(u.spectral_coeffs().data(),10),N);
+    if (!w.write(path)) failures++;
+
+    std::string err;
+    auto a = IO::Archive::open(path,true,&err);
+    if (!a) {
+        cout << "open failed: " << err << "\nFAILED\n";
+        return 1;
+    }
+
+    // zero-copy views, bitwise equal and aligned
+    const F v = a->load_function<F>("u");
+    Span<const double> nodes = a->array<double>("cheb/nodes");
+    double e_arr = 0.0;
+    for (unsigned int i=0; i<=N; i++)
+        e_arr = std::max({e_arr,std::abs(v.spectral_coeffs()[i]-u.spectral_coeffs()[i]),std::abs(nodes[i]-basis->get_nodes()[i]),
+                          std::abs(a->array<double>("cheb/weights")[i]-basis->get_weights()[i])});
+    for (std::size_t i=0; i<fl.size(); i++) e_arr = std::max(e_arr,double(std::abs(a->array<float>("floats")[i]-fl[i])));
+    bool aligned = true;
+    for (const char* name: {"u","cheb/nodes","cheb/weights"})
+        aligned &= reinterpret_cast<std::uintptr_t>(a->array<double>(name).data())%IO::alignment==0;
+    aligned &= reinterpret_cast<std::uintptr_t>(a->array<float>("floats").data())%IO::alignment==0;
+    cout << "arrays: error " << e_arr << ", aligned " << aligned << ", " << a->names().size() << " entries, "
+         << a->file_size() << " bytes\n";
+    if (e_arr != 0.0 || !aligned || a->tag("u")!=N || a->tag("floats")!=42 || a->names().size()!=10) failures++;
+
+    double e_op = 0.0;
+    e_op = std::max(e_op,apply_diff(D,a->operator_view<double>("D")));
+    e_op = std::max(e_op,apply_diff(D2,a->operator_view<double>("D2")));
+    e_op = std::max(e_op,apply_diff(X,a->operator_view<double>("X")));
+    e_op = std::max(e_op,apply_diff(Dn,a->operator_view<double>("dense")));
+    e_op = std::max(e_op,apply_diff(S,a->operator_view<double>("csr")));
+    const bool formats = a->operator_view<double>("D").fmt==StorageFormat::ParityTriangular &&
+                         a->operator_view<double>("X").fmt==StorageFormat::Banded &&
+                         a->operator_view<double>("csr").fmt==StorageFormat::CSR &&
+                         a->operator_view<double>("dense").fmt==StorageFormat::Dense;
+    cout << "operators: error " << e_op << ", formats kept " << formats << "\n";
+    if (e_op != 0.0 || !formats) failures++;
+
+    // warm start: a loaded operator seeds the registry, the next operator built is a cache hit
+    PlanRegistry& registry = PlanRegistry::instance();
+    registry.clear();
+    auto b2 = registry.get_basis<ChebyshevBase<double>>(N);
+    registry.preload_operator<double>(*b2,OperatorKind::SecondDerivative,a->load_operator<double>("D2"));
+    registry.reset_counters();
+    SecondDerivative<double> warm(b2.get());
+    cout << "warm start: registry hits " << registry.hits() << ", misses " << registry.misses() << "\n";
+    if (registry.hits()!=1 || registry.misses()!=0 || warm.get_storage().get(3,7)!=D2.get(3,7)) failures++;
+
+    // missing names and wrong kinds or scalar types give empty views, not a crash
+    std::string e_view;
+    const bool empty = a->array<double>("nope").size()==0 && a->array<float>("u").size()==0 && a->array<double>("D").size()==0 &&
+                       a->operator_view<double>("u",&e_view).n==0 && a->operator_view<float>("D").n==0 &&
+                       !a->load_operator<double>("nope") && a->tag("nope")==0 && !a->verify("nope");
+    cout << "lookups that fail: empty " << empty << ", " << e_view << "\n";
+    if (!empty || e_view.empty()) failures++;
+    // functions are only rebuilt from an array of their scalar type, order and length
+    std::string e_missing, e_order, e_short, e_scalar, e_ok;
+    const F f_missing = a->load_function<F>("nope",&e_missing);
+    a->load_function<Function<double,ChebyshevBase<double>,100>>("u",&e_order);
+    a->load_function<F>("short",&e_short);
+    a->load_function<Function<float,ChebyshevBase<float>,N>>("u",&e_scalar);
+    a->load_function<F>("u",&e_ok);
+    cout << "functions that fail to load: " << e_missing << "; " << e_order << "; " << e_short << "; " << e_scalar << "\n";
+    if (e_missing.empty() || e_order.empty() || e_short.empty() || e_scalar.empty() || !e_ok.empty() ||
+        *std::max_element(f_missing.spectral_coeffs().begin(),f_missing.spectral_coeffs().end())!=0.0) failures++;
+    // file offset of the first CSR column index, the data start at byte 64 with "u"
+    const long csr_col0 = 64 + (reinterpret_cast<const char*>(a->operator_view<double>("csr").cols.data()) -
+                                reinterpret_cast<const char*>(a->array<double>("u").data()));
+    a.reset();
+
+    // damaged, truncated and foreign files are rejected with a reason
+    std::string bytes;
+    {
+        std::ifstream src(path,std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(src),std::istreambuf_iterator<char>());
+        std::ofstream cut("test_archive_bad.bin",std::ios::binary);
+        cut.write(bytes.data(),bytes.size()-100);
+    }
+    const bool truncated = !IO::Archive::open("test_archive_bad.bin",false,&err);
+    cout << "truncated: " << err << "\n";
+    {
+        std::ofstream dst("test_archive_bad.bin",std::ios::binary);
+        dst.write(bytes.data(),bytes.size());
+    }
+    poke("test_archive_bad.bin",64+100,'x');
+    const bool corrupt = !IO::Archive::open("test_archive_bad.bin",true,&err);
+    cout << "corrupt data: " << err << "\n";
+    const bool unverified = static_cast<bool>(IO::Archive::open("test_archive_bad.bin",false));
+    poke("test_archive_bad.bin",8,'\x07');
+    const bool version = !IO::Archive::open("test_archive_bad.bin",false,&err);
+    cout << "other version: " << err << "\n";
+    poke("test_archive_bad.bin",0,'X');
+    const bool magic = !IO::Archive::open("test_archive_bad.bin",false,&err);
+    const bool missing = !IO::Archive::open("no_such_archive.bin",false,&err);
+    cout << "missing file: " << err << "\n";
+    if (!truncated || !corrupt || !unverified || !version || !magic || !missing) failures++;
+
+    // entries with a consistent directory checksum but impossible contents: a count
+    // whose byte size wraps around 2^64, operator metadata that disagree with the
+    // part counts, and a CSR column index beyond n (data are not checksummed by default)
+    forge(bytes,"test_archive_bad.bin",0,144,std::uint64_t(1)<<61);
+    const bool wrapped = !IO::Archive::open("test_archive_bad.bin",false,&err);
+    cout << "count overflowing the extent: " << err << "\n";
+    forge(bytes,"test_archive_bad.bin",6,72+8,6);
+    const bool meta = !IO::Archive::open("test_archive_bad.bin",false,&err);
+    cout << "operator metadata: " << err << "\n";
+    {
+        std::ofstream dst("test_archive_bad.bin",std::ios::binary);
+        dst.write(bytes.data(),bytes.size());
+    }
+    poke("test_archive_bad.bin",csr_col0+7,'\x40');
+    auto bad = IO::Archive::open("test_archive_bad.bin",false,&err);
+    std::string e_csr;
+    const bool csr = bad && bad->operator_view<double>("csr",&e_csr).n==0 && !bad->load_operator<double>("csr") &&
+                     bad->operator_view<double>("D").n==N+1;
+    cout << "CSR column out of range: " << e_csr << "\n";
+    if (!wrapped || !meta || !csr) failures++;
+    std::remove(path.c_str());
+    std::remove("test_archive_bad.bin");
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
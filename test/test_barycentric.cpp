@@ -0,0 +1,95 @@
+#include "../functions.hpp"
+#include "../polybases/barycentric.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace FunctionalBases;
+using std::cout;
+
+inline double runge(double x) { return 1.0/(1.0+25*x*x); }
+
+int main()
+{
+    int failures = 0;
+    const unsigned int N = 96;
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    const std::vector<double>& x = basis->get_nodes();
+    std::vector<double> f(N+1), ft(N+1);
+    for (unsigned int i=0; i<=N; i++) f[i] = runge(x[i]);
+    basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+
+    // off-grid values against the coefficient series, serial and threaded
+    BarycentricInterpolator<double> bary(*basis);
+    const std::size_t npts = 5000;
+    std::vector<double> pts(npts), v1(npts), v4(npts);
+    unsigned int seed = 2024;
+    for (auto& p: pts) { seed = seed*1103515245u + 12345u; p = 2.0*(seed >> 8)/double(1u << 24) - 1.0; }
+    bary.eval(Span<const double>(pts),Span<const double>(f),Span<double>(v1),1);
+    bary.eval(Span<const double>(pts),Span<const double>(f),Span<double>(v4),4);
+    double e_eval = 0.0, e_thr = 0.0;
+    for (std::size_t p=0; p<npts; p++) {
+        e_eval = std::max(e_eval,std::abs(v1[p]-basis->evaluate_series(pts[p],ft)));
+        e_thr = std::max(e_thr,std::abs(v1[p]-v4[p]));
+    }
+    cout << "barycentric vs Clenshaw: " << e_eval << ", threaded vs serial: " << e_thr << "\n";
+    if (e_eval > 1e-13 || e_thr != 0.0) failures++;
+
+    // exact node hits return the nodal value, neighbouring points stay stable
+    double e_node = 0.0, e_near = 0.0;
+    for (unsigned int j=0; j<=N; j++) {
+        e_node = std::max(e_node,std::abs(bary.eval(x[j],Span<const double>(f))-f[j]));
+        const double xn = std::nextafter(x[j],0.0);
+        e_near = std::max(e_near,std::abs(bary.eval(xn,Span<const double>(f))-runge(xn)));
+    }
+    std::vector<double> vn(N+1);
+    bary.eval(Span<const double>(x),Span<const double>(f),Span<double>(vn));
+    for (unsigned int j=0; j<=N; j++) e_node = std::max(e_node,std::abs(vn[j]-f[j]));
+    cout << "at nodes: " << e_node << ", one ulp away: " << e_near << "\n";
+    if (e_node != 0.0 || e_near > 1e-13) failures++;
+
+    // generic O(N^2) weights are proportional to the closed-form ones
+    BarycentricInterpolator<double> generic(x);
+    const double ratio = generic.get_weights()[0]/bary.get_weights()[0];
+    double e_w = 0.0;
+    for (unsigned int j=0; j<=N; j++) e_w = std::max(e_w,std::abs(generic.get_weights()[j]/(ratio*bary.get_weights()[j])-1));
+    cout << "generic weights: relative error " << e_w << "\n";
+    if (e_w > 1e-12) failures++;
+
+    // resampling between different N: exact for polynomials up to the source order,
+    // cached by the registry, batches in both layouts match single transfers
+    const unsigned int Nc = 40, Nf = 131;
+    auto up = PlanRegistry::instance().get_resampling<double>(Nc,Nf);
+    auto up2 = PlanRegistry::instance().get_resampling<double>(Nc,Nf);
+    auto down = PlanRegistry::instance().get_resampling<double>(Nf,Nc);
+    auto bc = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(Nc);
+    auto bf = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(Nf);
+    auto poly = [](double y) { return Chebyshev::Tn<double>(y,40) - 0.3*Chebyshev::Tn<double>(y,17) + y; };
+    std::vector<double> gc(Nc+1), gf(Nf+1), back(Nc+1);
+    for (unsigned int i=0; i<=Nc; i++) gc[i] = poly(bc->get_nodes()[i]);
+    up->apply(Span<const double>(gc),Span<double>(gf));
+    down->apply(Span<const double>(gf),Span<double>(back));
+    double e_rs = 0.0;
+    for (unsigned int i=0; i<=Nf; i++) e_rs = std::max(e_rs,std::abs(gf[i]-poly(bf->get_nodes()[i])));
+    for (unsigned int i=0; i<=Nc; i++) e_rs = std::max(e_rs,std::abs(back[i]-gc[i]));
+    cout << "resampling " << Nc << " <-> " << Nf << ": error " << e_rs << "\n";
+    if (e_rs > 1e-12 || up!=up2 || up->rows()!=Nf+1 || up->cols()!=Nc+1) failures++;
+
+    const std::size_t M = 70;
+    std::vector<double> soa(M*(Nc+1)), aos(M*(Nc+1)), one(Nf+1);
+    for (std::size_t m=0; m<M; m++)
+        for (unsigned int i=0; i<=Nc; i++) soa[m*(Nc+1)+i] = aos[i*M+m] = std::sin((1+0.1*m)*bc->get_nodes()[i]);
+    std::vector<double> osoa(M*(Nf+1)), oaos(M*(Nf+1));
+    up->apply_batch(Span<const double>(soa),Span<double>(osoa),M,BatchLayout::SoA,3);
+    up->apply_batch(Span<const double>(aos),Span<double>(oaos),M,BatchLayout::AoS,3);
+    double e_b = 0.0;
+    for (std::size_t m=0; m<M; m++) {
+        up->apply(Span<const double>(soa.data()+m*(Nc+1),Nc+1),Span<double>(one));
+        for (unsigned int i=0; i<=Nf; i++)
+            e_b = std::max({e_b,std::abs(osoa[m*(Nf+1)+i]-one[i]),std::abs(oaos[i*M+m]-one[i])});
+    }
+    cout << "batched resampling vs single: " << e_b << "\n";
+    if (e_b > 1e-14) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
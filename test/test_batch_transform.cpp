@@ -0,0 +1,90 @@
+#include "../polybases/polybases.hpp"
+#include "../polybases/piecewise_chebyshev.hpp"
+#include "../polybases/gemm.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace FunctionalBases;
+using std::cout;
+
+// batch member m sampled at the nodes x
+inline double field(double x, std::size_t m) { return std::cos((m%7+1)*x) + 0.1*m*x*x; }
+
+// max difference between the batch result and one transform per function
+double check(const FunctionalBase<double>& basis, std::size_t M, BatchLayout layout, unsigned int nthreads)
+{
+    const std::size_t n1 = basis.get_N()+1, nc = basis.num_coeffs();
+    std::vector<double> x;
+    basis.get_nodes(x);
+    std::vector<double> f(M*n1), ft(M*nc), back(M*n1), fm, ftm;
+    auto at = [&](std::size_t m, std::size_t i, std::size_t n) { return layout==BatchLayout::SoA ? m*n+i : i*M+m; };
+    for (std::size_t m=0; m<M; m++)
+        for (std::size_t i=0; i<n1; i++) f[at(m,i,n1)] = field(x[i],m);
+    basis.calc_spectral_coeffs_batch(Span<const double>(f),Span<double>(ft),M,layout,nthreads);
+    basis.calc_function_values_batch(Span<const double>(ft),Span<double>(back),M,layout,nthreads);
+    double e = 0.0;
+    for (std::size_t m=0; m<M; m++) {
+        fm.resize(n1);
+        for (std::size_t i=0; i<n1; i++) fm[i] = f[at(m,i,n1)];
+        basis.calc_spectral_coeffs(fm,ftm);
+        for (std::size_t n=0; n<nc; n++) e = std::max(e,std::abs(ft[at(m,n,nc)]-ftm[n]));
+        for (std::size_t i=0; i<n1; i++) e = std::max(e,std::abs(back[at(m,i,n1)]-fm[i]));
+    }
+    return e;
+}
+
+int main()
+{
+    int failures = 0;
+
+    // blocked GEMM against the triple loop, sizes not multiples of the tiles or blocks
+    const std::size_t m = 70, n = 523, k = 301;
+    std::vector<double> A(m*k), B(k*n), C(m*n), R(m*n);
+    for (std::size_t i=0; i<A.size(); i++) A[i] = std::sin(0.37*i);
+    for (std::size_t i=0; i<B.size(); i++) B[i] = std::cos(0.11*i);
+    for (std::size_t i=0; i<C.size(); i++) C[i] = R[i] = 0.5*i/C.size();
+    GEMM::gemm<double>(m,n,k,2.0,A.data(),k,B.data(),n,-1.0,C.data(),n);
+    double e_gemm = 0.0;
+    for (std::size_t i=0; i<m; i++)
+        for (std::size_t j=0; j<n; j++) {
+            double s = 0.0;
+            for (std::size_t p=0; p<k; p++) s += A[i*k+p]*B[p*n+j];
+            e_gemm = std::max(e_gemm,std::abs(C[i*n+j]-(2.0*s-R[i*n+j])));
+        }
+    cout << "gemm " << m << "x" << n << "x" << k << ": error " << e_gemm << "\n";
+    if (e_gemm > 1e-11) failures++;
+
+    // GEMM path (small N, including quadrature-mode bases) and DCT path (large N)
+    for (unsigned int N: {8u, 31u, 64u, 200u, 256u, 300u}) {
+        ChebyshevBase<double> basis(N);
+        for (BatchLayout layout: {BatchLayout::SoA, BatchLayout::AoS}) {
+            const double e = check(basis,1037,layout,4);
+            cout << "N = " << N << (layout==BatchLayout::SoA ? " SoA" : " AoS") << (basis.batch_uses_dct() ? " dct " : " gemm")
+                 << ": difference to single transforms " << e << "\n";
+            if (e > 1e-12) failures++;
+        }
+    }
+
+    // forcing the transform type is respected by the batch path
+    ChebyshevBase<double> quad(300,TransformType::Quadrature), fast(16,TransformType::DCT);
+    if (quad.batch_uses_dct() || !fast.batch_uses_dct()) failures++;
+    if (check(quad,50,BatchLayout::AoS,2) > 1e-12 || check(fast,50,BatchLayout::SoA,2) > 1e-12) failures++;
+
+    // results do not depend on the number of threads
+    ChebyshevBase<double> basis(48);
+    const std::size_t M = 777, n1 = 49;
+    std::vector<double> f(M*n1), ft1(M*n1), ft4(M*n1);
+    for (std::size_t i=0; i<f.size(); i++) f[i] = std::sin(0.01*i);
+    basis.calc_spectral_coeffs_batch(Span<const double>(f),Span<double>(ft1),M,BatchLayout::AoS,1);
+    basis.calc_spectral_coeffs_batch(Span<const double>(f),Span<double>(ft4),M,BatchLayout::AoS,4);
+    if (ft1!=ft4) failures++;
+
+    // bases without a dedicated batch path fall back to one transform per function
+    PiecewiseChebyshevBase<double,4> pw(64,-1.0,1.0,1);
+    const double e_pw = check(pw,33,BatchLayout::AoS,2);
+    cout << "piecewise fallback: difference " << e_pw << "\n";
+    if (e_pw > 1e-12) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
@@ -0,0 +1,53 @@
+#include "../polybases/chebyshev.hpp"
+#include "../functions.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using std::cout;
+
+inline void ffunc(const std::vector<double>& x, std::vector<double>& y);
+
+int main()
+{
+  int failures = 0;
+  const unsigned int NMAX = 500;
+  std::vector<double> T, coeffs(NMAX+1);
+  for (unsigned int n=0; n<=NMAX; n++) coeffs[n] = 1.0/(1.0+n*n);
+
+  double e_tn = 0.0, e_all = 0.0, e_series = 0.0;
+  for (double x = -1.0; x <= 1.0; x += 0.01) {
+    Chebyshev::Tn_all(x,NMAX,T);
+    double naive = 0.0;
+    for (unsigned int n=0; n<=NMAX; n++) {
+      double exact = std::cos(n*std::acos(std::max(-1.0,std::min(1.0,x))));
+      e_tn = std::max(e_tn, std::abs(Chebyshev::Tn(x,n) - exact));
+      e_all = std::max(e_all, std::abs(T[n] - exact));
+      naive += coeffs[n] * exact;
+    }
+    e_series = std::max(e_series, std::abs(Chebyshev::clenshaw(x,coeffs) - naive));
+  }
+  cout << "Tn: " << e_tn << "\t Tn_all: " << e_all << "\t clenshaw: " << e_series << "\n";
+  if (e_tn > 1e-10 || e_all > 1e-10 || e_series > 1e-12) failures++;
+
+  // Function::eval goes through the same summation
+  using func6 = Function<double,ChebyshevBase<double>,6u>;
+  func6 f(&ffunc);
+  std::vector<double> nodes, vals, f_nodes;
+  ChebyshevBase<double>(6u).get_nodes(nodes);
+  f.get_func_vals(vals);
+  f.eval(nodes,f_nodes);
+  double e_func = 0.0;
+  for (unsigned int i=0; i<nodes.size(); i++) e_func = std::max(e_func, std::abs(f_nodes[i]-vals[i]));
+  cout << "Function::eval at nodes: " << e_func << "\n";
+  if (e_func > 1e-13) failures++;
+
+  cout << (failures ? "FAILED\n" : "PASSED\n");
+  return failures;
+}
+
+inline void ffunc(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& val: x) y.push_back( std::pow(std::cos(M_PI*val/2),3) + std::pow(val+1,3)/8.0 );
+}
@@ -0,0 +1,144 @@
+#include "../functions.hpp"
+#include "../polybases/piecewise_chebyshev.hpp"
+#include "../ODE/linear_diff_ops.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+inline void f1(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(v)*std::sin(2*v));
+}
+inline double df1(double x) { return std::exp(x)*(std::sin(2*x)+2*std::cos(2*x)); }
+inline double d2f1(double x) { return std::exp(x)*(4*std::cos(2*x)-3*std::sin(2*x)); }
+
+inline void runge(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(1.0/(1.0+25*v*v));
+}
+
+inline void cos3(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::cos(3*v));
+}
+
+int main()
+{
+    int failures = 0;
+    std::vector<double> pts(201);
+    for (std::size_t p=0; p<pts.size(); p++) pts[p] = -1.0 + 2.0*p/(pts.size()-1);
+
+    // derivatives by the recurrence against the exact ones and against the operator matrices
+    Function<double,ChebyshevBase<double>,40> u(&f1), ux(&f1), uxx(&f1);
+    ux.differentiate();
+    uxx.differentiate(2);
+    double e_d = 0.0;
+    for (auto x: pts) {
+        double a, b;
+        ux.eval(x,a);
+        uxx.eval(x,b);
+        e_d = std::max({e_d,std::abs(a-df1(x)),std::abs(b-d2f1(x))/10});
+    }
+    Derivative<double> D(u.get_basis().get());
+    SecondDerivative<double> D2(u.get_basis().get());
+    std::vector<double> a(41), b(41);
+    D.apply(Span<const double>(u.spectral_coeffs()),Span<double>(a));
+    D2.apply(Span<const double>(u.spectral_coeffs()),Span<double>(b));
+    double e_m = 0.0;
+    for (int i=0; i<=40; i++)
+        e_m = std::max({e_m,std::abs(a[i]-ux.spectral_coeffs()[i]),std::abs(b[i]-uxx.spectral_coeffs()[i])/10});
+    cout << "recurrence derivatives: error " << e_d << ", vs operator matrices " << e_m << "\n";
+    if (e_d > 1e-10 || e_m > 1e-11) failures++;
+
+    // antiderivative vanishing at -1, and differentiating it back
+    Function<double,ChebyshevBase<double>,32> c(&cos3);
+    c.antiderivative();
+    double e_a = 0.0;
+    for (auto x: pts) {
+        double v;
+        c.eval(x,v);
+        e_a = std::max(e_a,std::abs(v-(std::sin(3*x)+std::sin(3.0))/3));
+    }
+    c.differentiate();
+    std::vector<double> back;
+    c.get_func_vals(back);
+    const std::vector<double>& x32 = c.get_basis()->get_nodes();
+    for (int i=0; i<=32; i++) e_a = std::max(e_a,std::abs(back[i]-std::cos(3*x32[i])));
+    cout << "antiderivative error " << e_a << "\n";
+    if (e_a > 1e-13) failures++;
+
+    // Clenshaw-Curtis integrals
+    Function<double,ChebyshevBase<double>,20> ex(&f1);
+    Function<double,ChebyshevBase<double>,128> r(&runge);
+    const double i_f1 = 0.2*(std::exp(1.0)*(std::sin(2.0)-2*std::cos(2.0)) - std::exp(-1.0)*(-std::sin(2.0)-2*std::cos(2.0)));
+    const double e_i = std::max(std::abs(ex.integrate()-i_f1),std::abs(r.integrate()-0.4*std::atan(5.0)));
+    cout << "integrals: error " << e_i << "\n";
+    if (e_i > 1e-13) failures++;
+
+    // fixed-size specialisation matches the generic Function
+    Function<double,FixedChebyshevBase<double>,40> uf(&f1);
+    uf.differentiate(2);
+    double e_f = std::abs(Function<double,FixedChebyshevBase<double>,40>(&f1).integrate()-u.integrate());
+    for (int i=0; i<=40; i++) e_f = std::max(e_f,std::abs(uf.spectral_coeffs()[i]-uxx.spectral_coeffs()[i]));
+    cout << "fixed-size vs generic: " << e_f << "\n";
+    if (e_f > 1e-10) failures++;
+
+    // batched forms in both layouts, M not a multiple of the lane block
+    const unsigned int N = 24;
+    const std::size_t M = 45;
+    auto cheb = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    std::vector<double> soa(M*(N+1)), aos(M*(N+1)), one(N+1), ref(M*(N+1)), iref(M);
+    for (std::size_t m=0; m<M; m++)
+        for (unsigned int i=0; i<=N; i++) soa[m*(N+1)+i] = aos[i*M+m] = std::sin(0.37*m+1.3*i)/(1+i);
+    double e_b = 0.0;
+    for (int op=0; op<3; op++) {
+        for (std::size_t m=0; m<M; m++) {
+            Span<const double> in(soa.data()+m*(N+1),N+1);
+            if (op==0) cheb->differentiate_coeffs(in,Span<double>(one),2);
+            if (op==1) cheb->antiderivative_coeffs(in,Span<double>(one));
+            if (op==2) iref[m] = cheb->integrate_coeffs(in);
+            std::copy(one.begin(),one.end(),ref.begin()+m*(N+1));
+        }
+        for (BatchLayout layout: {BatchLayout::SoA,BatchLayout::AoS}) {
+            const std::vector<double>& in = layout==BatchLayout::SoA ? soa : aos;
+            std::vector<double> out(in), iout(M);
+            if (op==0) cheb->differentiate_coeffs_batch(Span<const double>(out),Span<double>(out),M,2,layout,3);
+            if (op==1) cheb->antiderivative_coeffs_batch(Span<const double>(in),Span<double>(out),M,layout,3);
+            if (op==2) {
+                cheb->integrate_coeffs_batch(Span<const double>(in),Span<double>(iout),M,layout,3);
+                for (std::size_t m=0; m<M; m++) e_b = std::max(e_b,std::abs(iout[m]-iref[m]));
+                continue;
+            }
+            for (std::size_t m=0; m<M; m++)
+                for (unsigned int i=0; i<=N; i++) {
+                    const double v = layout==BatchLayout::SoA ? out[m*(N+1)+i] : out[i*M+m];
+                    e_b = std::max(e_b,std::abs(v-ref[m*(N+1)+i])/(1+std::abs(ref[m*(N+1)+i])));
+                }
+        }
+    }
+    cout << "batched vs single: " << e_b << "\n";
+    if (e_b > 1e-14) failures++;
+
+    // piecewise basis on [0,2]: element scaling and continuity of the antiderivative
+    auto pw = std::make_shared<const PiecewiseChebyshevBase<double,4>>(64,0.0,2.0);
+    Function<double,PiecewiseChebyshevBase<double,4>,64> p(pw,&cos3), px(pw,&cos3), pi(pw,&cos3);
+    px.differentiate();
+    pi.antiderivative();
+    double e_p = std::abs(p.integrate()-std::sin(6.0)/3);
+    std::vector<double> xs(pts.size());
+    for (std::size_t k=0; k<pts.size(); k++) xs[k] = 1.0+pts[k];
+    std::vector<double> vd, va;
+    px.eval(xs,vd);
+    pi.eval(xs,va);
+    for (std::size_t k=0; k<xs.size(); k++)
+        e_p = std::max({e_p,std::abs(vd[k]+3*std::sin(3*xs[k]))/3,std::abs(va[k]-std::sin(3*xs[k])/3)});
+    cout << "piecewise: error " << e_p << "\n";
+    if (e_p > 1e-12) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
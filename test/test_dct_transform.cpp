@@ -0,0 +1,60 @@
+#include "../polybases/polybases.hpp"
+#include <iostream>
+#include <memory>
+#include <cmath>
+
+using namespace FunctionalBases;
+using std::cout;
+
+inline void func(const std::vector<double>& x, std::vector<double>& y);
+inline double max_diff(const std::vector<double>& a, const std::vector<double>& b);
+
+int main(){
+    int failures = 0;
+
+    // DCT path against the quadrature path
+    for (unsigned int N : {1u,2u,3u,4u,6u,7u,8u,12u,16u,17u}) {
+        ChebyshevBase<double> quad(N,TransformType::Quadrature);
+        ChebyshevBase<double> fast(N,TransformType::DCT);
+        std::vector<double> nodes, f, ft_q, ft_d, f_q, f_d;
+        quad.get_nodes(nodes);
+        func(nodes,f);
+        quad.calc_spectral_coeffs(f,ft_q);
+        fast.calc_spectral_coeffs(f,ft_d);
+        quad.calc_function_values(ft_q,f_q);
+        fast.calc_function_values(ft_q,f_d);
+        double e_coeffs = max_diff(ft_q,ft_d);
+        double e_vals = max_diff(f_q,f_d);
+        cout << "N = " << N << "\t coeffs: " << e_coeffs << "\t values: " << e_vals << "\n";
+        if (e_coeffs > 1e-13 || e_vals > 1e-13) failures++;
+    }
+
+    // round trip and known expansion exp(x) = I_0(1) + 2 sum I_n(1) T_n(x) at large N
+    for (unsigned int N : {64u,100u,1000u,4096u}) {
+        ChebyshevBase<double> fast(N,TransformType::DCT);
+        std::vector<double> nodes, f, ft, f_back;
+        fast.get_nodes(nodes);
+        for (auto& x: nodes) f.push_back(std::exp(x));
+        fast.calc_spectral_coeffs(f,ft);
+        fast.calc_function_values(ft,f_back);
+        double e_trip = max_diff(f,f_back);
+        double e_known = std::max(std::abs(ft[0] - std::cyl_bessel_i(0.,1.)), std::abs(ft[5] - 2*std::cyl_bessel_i(5.,1.)));
+        cout << "N = " << N << "\t round trip: " << e_trip << "\t exp(x) coeffs: " << e_known << "\n";
+        if (e_trip > 1e-12 || e_known > 1e-14) failures++;
+    }
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
+
+inline void func(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& val: x) y.push_back( std::pow(std::cos(M_PI*val/2),3) + std::pow(val+1,3)/8.0 );
+}
+
+inline double max_diff(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double e = 0.0;
+    for (unsigned int i=0; i<a.size(); i++) e = std::max(e, std::abs(a[i]-b[i]));
+    return e;
+}
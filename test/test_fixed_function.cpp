@@ -0,0 +1,59 @@
+#include "../functions.hpp"
+#include <iostream>
+#include <type_traits>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using std::cout;
+
+inline void ffunc(const std::vector<double>& x, std::vector<double>& y);
+
+template <unsigned int N> int compare()
+{
+    using fixed = Function<double,FixedChebyshevBase<double>,N>;
+    using dynamic = Function<double,ChebyshevBase<double>,N>;
+    static_assert(std::is_trivially_copyable<fixed>::value, "fixed-size Function must be trivially copyable");
+    static_assert(sizeof(fixed) == 2*(N+1)*sizeof(double), "fixed-size Function must not carry extra state");
+
+    fixed f(&ffunc);
+    dynamic g(&ffunc);
+    std::vector<double> ft_f, ft_g, x, y_f, y_g, nodes;
+    f.get_spectral_coeffs(ft_f);
+    g.get_spectral_coeffs(ft_g);
+    g.get_basis()->get_nodes(nodes);
+    double e_coeffs = 0.0, e_nodes = 0.0, e_eval = 0.0, e_trip = 0.0;
+    for (unsigned int i=0; i<N+1; i++) {
+        e_coeffs = std::max(e_coeffs, std::abs(ft_f[i]-ft_g[i]));
+        e_nodes = std::max(e_nodes, std::abs(fixed::nodes()[i]-nodes[i]));
+    }
+    for (int i=0; i<=200; i++) x.push_back(-1.0 + 0.01*i);
+    f.eval(x,y_f);
+    g.eval(x,y_g);
+    for (unsigned int i=0; i<x.size(); i++) e_eval = std::max(e_eval, std::abs(y_f[i]-y_g[i]));
+    fixed h = f;
+    h.update_spectral_coeffs(f.spectral_coeffs());
+    for (unsigned int i=0; i<N+1; i++) e_trip = std::max(e_trip, std::abs(h.func_vals()[i]-f.func_vals()[i]));
+
+    cout << "N = " << N << "\t nodes: " << e_nodes << "\t coeffs: " << e_coeffs << "\t eval: " << e_eval << "\t round trip: " << e_trip << "\n";
+    return (e_nodes > 1e-15 || e_coeffs > 1e-14 || e_eval > 1e-13 || e_trip > 1e-13) ? 1 : 0;
+}
+
+int main()
+{
+    static_assert(ChebyshevTables<double,4>::nodes[2] == 0.0, "nodes are constant expressions");
+    int failures = compare<1>() + compare<4>() + compare<7>() + compare<16>() + compare<64>();
+
+    auto f = Function<double,FixedChebyshevBase<double>,16>::from_callable([](double x) { return std::exp(x); });
+    double e_exp = std::abs(f(0.3) - std::exp(0.3));
+    cout << "exp(x), N = 16: " << e_exp << "\n";
+    if (e_exp > 1e-14) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
+
+inline void ffunc(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& val: x) y.push_back( std::pow(std::cos(M_PI*val/2),3) + std::pow(val+1,3)/8.0 );
+}
@@ -0,0 +1,221 @@
+#include "../functions.hpp"
+#include "../polybases/fourier.hpp"
+#include "../ODE/odesolvers.hpp"
+#include <iostream>
+#include <complex>
+#include <cmath>
+#include <stdexcept>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+inline void esin(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(std::sin(v)));
+}
+inline double desin(double v) { return std::cos(v)*std::exp(std::sin(v)); }
+inline double d2esin(double v) { const double c = std::cos(v); return (c*c-std::sin(v))*std::exp(std::sin(v)); }
+// period 1
+inline void wave(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::cos(2*M_PI*v) + 0.5*std::sin(6*M_PI*v));
+}
+
+/*
+ * FFT plans against the O(n^2) DFT, relative to the largest output: powers of
+ * two (radix 2), mixed radix 2/3/4/5/7 and primes (Bluestein), complex and real.
+ */
+bool check_fft(std::size_t n)
+{
+    std::vector<std::complex<double>> x(n), X(n), y(n);
+    for (std::size_t j=0; j<n; j++) x[j] = std::complex<double>(std::sin(1.3*j+0.2),std::cos(0.7*j*j));
+    double scale = 0.0;
+    for (std::size_t k=0; k<n; k++) {
+        X[k] = 0.0;
+        for (std::size_t j=0; j<n; j++) X[k] += x[j]*FFT::detail::unit_root<double>((j*k)%n,n);
+        scale = std::max(scale,std::abs(X[k]));
+    }
+    FFT::ComplexPlan<double> P(n);
+    y = x;
+    P.forward(y.data());
+    double e_fwd = 0.0, e_inv = 0.0;
+    for (std::size_t k=0; k<n; k++) e_fwd = std::max(e_fwd,std::abs(y[k]-X[k]));
+    P.inverse(y.data());
+    for (std::size_t j=0; j<n; j++) e_inv = std::max(e_inv,std::abs(y[j]/static_cast<double>(n)-x[j]));
+
+    // real input: the packed half spectrum and the round trip in place
+    std::vector<double> r(n), R(n);
+    for (std::size_t j=0; j<n; j++) r[j] = x[j].real();
+    FFT::RealPlan<double> RP(n);
+    RP.forward(r.data(),R.data());
+    double e_real = 0.0, e_rinv = 0.0;
+    for (std::size_t k=0; 2*k<=n; k++) {
+        std::complex<double> s = 0.0;
+        for (std::size_t j=0; j<n; j++) s += r[j]*FFT::detail::unit_root<double>((j*k)%n,n);
+        const std::complex<double> got = k==0 ? R[0] : (2*k==n ? R[n-1] : std::complex<double>(R[2*k-1],R[2*k]));
+        e_real = std::max(e_real,std::abs(got-s));
+    }
+    RP.inverse(R.data(),R.data());
+    for (std::size_t j=0; j<n; j++) e_rinv = std::max(e_rinv,std::abs(R[j]/static_cast<double>(n)-r[j]));
+    const double tol = 1e-15*(1+std::log2(static_cast<double>(n)));
+    cout << "fft n=" << n << ": complex " << e_fwd/scale << ", inverse " << e_inv << ", real " << e_real/scale << ", real inverse " << e_rinv << "\n";
+    return e_fwd <= 4*tol*scale && e_inv <= 4*tol && e_real <= 4*tol*scale && e_rinv <= 4*tol;
+}
+
+/*
+ * Transforms, evaluation and the operators for exp(sin x), whose coefficients
+ * decay like 1/(2^k k!): M = N+1 nodes resolve it to rounding for M >= 32.
+ */
+template <unsigned int N> bool check_basis()
+{
+    auto basis = PlanRegistry::instance().get_basis<FourierBase<double>>(N);
+    Function<double,FourierBase<double>,N> u(&esin);
+    std::vector<double> ft, vals, back;
+    u.get_spectral_coeffs(ft);
+    u.get_func_vals(vals);
+    basis->calc_function_values(ft,back);
+    double e_rt = 0.0;
+    for (unsigned int i=0; i<=N; i++) e_rt = std::max(e_rt,std::abs(back[i]-vals[i]));
+    // a_0 is the mean, I_0(1)
+    const double e_mean = std::abs(ft[0]-1.2660658777520082);
+
+    std::vector<double> pts, ev;
+    for (int p=0; p<500; p++) pts.push_back(-3.0 + 0.0257*p);
+    u.eval(pts,ev);
+    double e_ev = 0.0, e_pt = 0.0;
+    for (std::size_t p=0; p<pts.size(); p++) {
+        e_ev = std::max(e_ev,std::abs(ev[p]-std::exp(std::sin(pts[p]))));
+        double y;
+        u.eval(pts[p],y);
+        e_pt = std::max(e_pt,std::abs(y-ev[p]));
+    }
+
+    // first and second derivative by the operators, by the coefficient recurrence and the dense matrices
+    Derivative<double> D(basis.get());
+    SecondDerivative<double> D2(basis.get());
+    std::vector<double> d1(N+1), d2(N+1), r1(N+1), r2(N+1), dense;
+    D.apply(Span<const double>(ft),Span<double>(d1));
+    D2.apply(Span<const double>(ft),Span<double>(d2));
+    basis->differentiate_coeffs(Span<const double>(ft),Span<double>(r1),1);
+    basis->differentiate_coeffs(Span<const double>(ft),Span<double>(r2),2);
+    double e_d1 = 0.0, e_d2 = 0.0, e_rec = 0.0, e_dense = 0.0;
+    for (auto p: pts) {
+        e_d1 = std::max(e_d1,std::abs(basis->evaluate_series(p,d1)-desin(p)));
+        e_d2 = std::max(e_d2,std::abs(basis->evaluate_series(p,d2)-d2esin(p)));
+    }
+    for (unsigned int i=0; i<=N; i++) e_rec = std::max(e_rec,std::abs(r1[i]-d1[i])+std::abs(r2[i]-d2[i]));
+    basis->calc_deriv(dense);
+    for (unsigned int i=0; i<=N; i++) {
+        double s = 0.0;
+        for (unsigned int j=0; j<=N; j++) s += dense[i*(N+1)+j]*ft[j];
+        e_dense = std::max(e_dense,std::abs(s-d1[i]));
+    }
+    // d/dx is tridiagonal, d2/dx2 diagonal
+    const bool sparse = D.get_storage().lower_bandwidth()==1 && D2.get_storage().lower_bandwidth()==0;
+
+    // integral, product without aliasing
+    const double e_int = std::abs(u.integrate()-2*M_PI*1.2660658777520082);
+    Function<double,FourierBase<double>,N> uu = u*u;
+    std::vector<double> uuv;
+    uu.eval(pts,uuv);
+    double e_prod = 0.0;
+    for (std::size_t p=0; p<pts.size(); p++) e_prod = std::max(e_prod,std::abs(uuv[p]-std::exp(2*std::sin(pts[p]))));
+
+    cout << "N=" << N << ": round trip " << e_rt << ", mean " << e_mean << ", eval " << e_ev << " (point vs batch " << e_pt
+         << "), d/dx " << e_d1 << ", d2/dx2 " << e_d2 << ", recurrence " << e_rec << ", dense " << e_dense
+         << ", integral " << e_int << ", product " << e_prod << "\n";
+    return e_rt < 1e-14 && e_mean < 1e-14 && e_ev < 1e-13 && e_pt < 1e-13 && e_d1 < 1e-12 && e_d2 < 1e-11
+        && e_rec < 1e-12 && e_dense < 1e-13 && sparse && e_int < 1e-13 && e_prod < 1e-12;
+}
+
+int main()
+{
+    int failures = 0;
+
+    for (std::size_t n: {1, 2, 3, 7, 12, 16, 49, 60, 97, 210, 1024})
+        if (!check_fft(n)) failures++;
+
+    // even M a power of two, even M mixed radix, odd M mixed radix, prime M through Bluestein
+    if (!check_basis<63>()) failures++;
+    if (!check_basis<59>()) failures++;
+    if (!check_basis<62>()) failures++;
+    if (!check_basis<96>()) failures++;
+
+    // a different period: its own nodes and operators, kept apart in the PlanRegistry
+    {
+        const unsigned int N = 15;
+        auto unit = std::make_shared<const FourierBase<double>>(N,1.0);
+        auto basis = PlanRegistry::instance().get_basis<FourierBase<double>>(N);
+        Function<double,FourierBase<double>,N> w(unit,&wave);
+        std::vector<double> ft;
+        w.get_spectral_coeffs(ft);
+        double e_c = 0.0;
+        for (unsigned int i=0; i<=N; i++) e_c = std::max(e_c,std::abs(ft[i] - (i==1 ? 1.0 : (i==6 ? 0.5 : 0.0))));
+        // (d2/dx2 + 4 pi^2) kills the cosine and leaves -32 pi^2 times the sine
+        SecondDerivative<double> D2(unit.get());
+        Identity<double> I(unit.get());
+        std::vector<double> y(N+1);
+        (D2 + 4*M_PI*M_PI*I).apply(ft,y);
+        double e_op = 0.0;
+        for (unsigned int i=0; i<=N; i++) e_op = std::max(e_op,std::abs(y[i] - (i==6 ? -16*M_PI*M_PI : 0.0)));
+        SecondDerivative<double> D2_default(basis.get());
+        const bool apart = &D2.get_storage() != &D2_default.get_storage()
+            && D2.get_storage().get(2,2) == -4*M_PI*M_PI && D2_default.get_storage().get(2,2) == -1.0;
+        cout << "period 1: coefficients " << e_c << ", operator expression " << e_op << ", operators kept apart " << apart << "\n";
+        if (e_c > 1e-15 || e_op > 1e-12 || !apart) failures++;
+
+        // x by collocation: exact at the nodes
+        TimesX<double> X(unit.get());
+        std::vector<double> xw(N+1), vx;
+        X.apply(ft,xw);
+        unit->calc_function_values(xw,vx);
+        std::vector<double> wv;
+        w.get_func_vals(wv);
+        double e_x = 0.0;
+        for (unsigned int i=0; i<=N; i++) e_x = std::max(e_x,std::abs(vx[i]-unit->get_nodes()[i]*wv[i]));
+        cout << "times x at the nodes " << e_x << "\n";
+        if (e_x > 1e-14) failures++;
+    }
+
+    // batched transforms through the generic FunctionalBase path
+    {
+        const unsigned int N = 47;
+        const std::size_t M = 9;
+        auto basis = PlanRegistry::instance().get_basis<FourierBase<double>>(N);
+        std::vector<double> F(M*(N+1)), Ft(M*(N+1)), one(N+1);
+        for (std::size_t k=0; k<F.size(); k++) F[k] = std::sin(0.013*k*k);
+        basis->calc_spectral_coeffs_batch(Span<const double>(F),Span<double>(Ft),M);
+        double e_batch = 0.0;
+        for (std::size_t m=0; m<M; m++) {
+            basis->calc_spectral_coeffs(Span<const double>(F.data()+m*(N+1),N+1),Span<double>(one));
+            for (unsigned int i=0; i<=N; i++) e_batch = std::max(e_batch,std::abs(one[i]-Ft[m*(N+1)+i]));
+        }
+        cout << "batch vs single " << e_batch << "\n";
+        if (e_batch != 0.0) failures++;
+    }
+
+    // the ODE solvers lower Chebyshev operators only: Fourier ones are rejected
+    // instead of being solved as if their coefficients were Chebyshev ones
+    {
+        auto basis = PlanRegistry::instance().get_basis<FourierBase<double>>(16);
+        const Derivative<double> D(basis.get());
+        const SecondDerivative<double> D2(basis.get());
+        const Identity<double> I(basis.get());
+        const std::vector<ODE::BoundaryCondition<double>> bcs{ODE::BoundaryCondition<double>::Dirichlet(ODE::Boundary::Left,0.0),
+                                                              ODE::BoundaryCondition<double>::Dirichlet(ODE::Boundary::Right,0.0)};
+        auto rejected = [&](auto make) {
+            try { make(); } catch (const std::invalid_argument&) { return true; }
+            return false;
+        };
+        const bool r_d = rejected([&]() { ODE::ODESolver<double> s(D + I,{bcs[0]}); });
+        const bool r_d2 = rejected([&]() { ODE::ODESolver<double> s(D2,bcs); });
+        const bool r_imex = rejected([&]() { ODE::IMEXRungeKutta<double> s(D2,bcs,1e-3); });
+        cout << "Fourier operators rejected by the solvers: D " << r_d << ", D2 " << r_d2 << ", IMEX " << r_imex << "\n";
+        if (!(r_d && r_d2 && r_imex)) failures++;
+    }
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
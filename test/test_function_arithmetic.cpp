@@ -0,0 +1,105 @@
+#include "../functions.hpp"
+#include "../polybases/piecewise_chebyshev.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using std::cout;
+
+inline void sin3(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::sin(3*v));
+}
+inline void expx(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(v));
+}
+
+template <class F> double max_error(const F& u, double exact(double)) {
+    double e = 0.0;
+    for (int p=0; p<=200; p++) {
+        const double x = -1.0 + p/100.0;
+        double v;
+        u.eval(x,v);
+        e = std::max(e,std::abs(v-exact(x)));
+    }
+    return e;
+}
+
+int main()
+{
+    int failures = 0;
+
+    // linear combinations
+    typedef Function<double,ChebyshevBase<double>,40> F40;
+    F40 u(&sin3), v(&expx);
+    F40 w = u + v;
+    F40 d = 2.0*u - v;
+    F40 n = -u;
+    F40 ax(&sin3);
+    ax.axpy(0.5,v);
+    const double e_lin = std::max({max_error(w,[](double x) { return std::sin(3*x)+std::exp(x); }),
+                                   max_error(d,[](double x) { return 2*std::sin(3*x)-std::exp(x); }),
+                                   max_error(n,[](double x) { return -std::sin(3*x); }),
+                                   max_error(ax,[](double x) { return std::sin(3*x)+0.5*std::exp(x); })});
+    std::vector<double> wv, uv, vv;
+    w.get_func_vals(wv);
+    u.get_func_vals(uv);
+    v.get_func_vals(vv);
+    double e_nodes = 0.0;
+    for (int i=0; i<=40; i++) e_nodes = std::max(e_nodes,std::abs(wv[i]-uv[i]-vv[i]));
+    cout << "sums: error " << e_lin << ", nodal values " << e_nodes << "\n";
+    if (e_lin > 1e-13 || e_nodes > 1e-15) failures++;
+
+    // products, direct convolution (small N) and 3/2-rule padding (large N)
+    auto uv_exact = [](double x) { return std::sin(3*x)*std::exp(x); };
+    F40 p = u*v;
+    Function<double,ChebyshevBase<double>,400> U(&sin3), V(&expx);
+    Function<double,ChebyshevBase<double>,400> P = U*V;
+    Function<double,ChebyshevBase<double>,400> SQ(&sin3), SQ2(&sin3);
+    SQ.set_product(SQ,SQ);
+    SQ2.set_product(U,Function<double,ChebyshevBase<double>,400>(&sin3));
+    double e_sq = 0.0;
+    for (int i=0; i<=400; i++) e_sq = std::max(e_sq,std::abs(SQ.spectral_coeffs()[i]-SQ2.spectral_coeffs()[i]));
+    const double e_prod = std::max({max_error(p,uv_exact),max_error(P,uv_exact),
+                                    max_error(SQ,[](double x) { return std::sin(3*x)*std::sin(3*x); })});
+    cout << "products: error " << e_prod << ", u*u vs u*copy " << e_sq << "\n";
+    if (e_prod > 1e-13 || e_sq > 1e-15) failures++;
+
+    // the padded product has no aliasing: it equals the truncated convolution even
+    // for unresolved coefficients
+    const unsigned int N = 300;
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    std::vector<double> a(N+1), b(N+1), c(N+1), ref(N+1);
+    for (unsigned int i=0; i<=N; i++) { a[i] = std::cos(0.7*i); b[i] = std::sin(1.3*i+0.2); }
+    Chebyshev::product_coeffs(a.data(),b.data(),N+1,ref.data());
+    basis->multiply_coeffs(Span<const double>(a),Span<const double>(b),Span<double>(c));
+    double e_alias = 0.0, scale = 0.0;
+    for (unsigned int i=0; i<=N; i++) {
+        e_alias = std::max(e_alias,std::abs(c[i]-ref[i]));
+        scale = std::max(scale,std::abs(ref[i]));
+    }
+    cout << "padded (M = " << basis->padded_order() << ") vs direct convolution: " << e_alias/scale << "\n";
+    if (basis->padded_order() <= 3*N/2 || e_alias/scale > 1e-13) failures++;
+
+    // fixed-size Function
+    typedef Function<double,FixedChebyshevBase<double>,40> X40;
+    X40 fu(&sin3), fv(&expx);
+    X40 fp = fu*fv + 0.5*fu;
+    double e_fix = 0.0;
+    for (int i=0; i<=40; i++) e_fix = std::max(e_fix,std::abs(fp.spectral_coeffs()[i]-p.spectral_coeffs()[i]-0.5*u.spectral_coeffs()[i]));
+    cout << "fixed-size: " << e_fix << "\n";
+    if (e_fix > 1e-13) failures++;
+
+    // piecewise basis, product element by element
+    auto pw = std::make_shared<const PiecewiseChebyshevBase<double,4>>(64,-1.0,1.0);
+    typedef Function<double,PiecewiseChebyshevBase<double,4>,64> PW;
+    PW pu(pw,&sin3), pv(pw,&expx);
+    const double e_pw = max_error(pu*pv - pv,[](double x) { return (std::sin(3*x)-1)*std::exp(x); });
+    cout << "piecewise: " << e_pw << "\n";
+    if (e_pw > 1e-13) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
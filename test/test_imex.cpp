@@ -0,0 +1,120 @@
+#include "../ODE/odesolvers.hpp"
+#include "../polybases/legendre.hpp"
+#include <iostream>
+#include <cmath>
+#include <stdexcept>
+
+using namespace FunctionalBases;
+using namespace Operators;
+using namespace ODE;
+using std::cout;
+
+/*
+ * u_t = u_xx - u on [-1,1], u(+-1) = 0, with u_xx implicit and -u explicit;
+ * u = exp(-(pi^2/4+1) t) cos(pi x/2). Returns the max error at t = 0.4.
+ */
+template <class Integrator> double heat_error(Integrator& integ, std::size_t n)
+{
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(n-1);
+    std::vector<double> f(n), u(n);
+    for (std::size_t i=0; i<n; i++) f[i] = std::cos(M_PI*basis->get_nodes()[i]/2);
+    basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(u));
+    const std::size_t nsteps = static_cast<std::size_t>(std::round(0.4/integ.get_dt()));
+    integ.advance(Span<double>(u),nsteps,[](Span<const double> v, Span<double> nv) {
+        for (std::size_t i=0; i<v.size(); i++) nv[i] = -v[i];
+    });
+    double e = 0.0;
+    for (int p=0; p<=50; p++) {
+        const double x = -1.0 + p/25.0;
+        e = std::max(e,std::abs(Chebyshev::clenshaw(x,u)-std::exp(-(M_PI*M_PI/4+1)*0.4)*std::cos(M_PI*x/2)));
+    }
+    return e;
+}
+
+int main()
+{
+    int failures = 0;
+    const std::size_t n = 33;
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(n-1);
+    LinearOperator<double> L = SecondDerivative<double>(basis.get());
+    const std::vector<BoundaryCondition<double>> dirichlet{BoundaryCondition<double>::Dirichlet(Boundary::Left,0.0),
+                                                           BoundaryCondition<double>::Dirichlet(Boundary::Right,0.0)};
+
+    // observed orders of convergence in time
+    const double dt = 0.02;
+    struct Case { const char* name; IMEXTableau<double> tab; double order; };
+    for (const Case& c: {Case{"ARS(1,1,1)",IMEXTableau<double>::ars111(),1.0},
+                         Case{"ARS(2,2,2)",IMEXTableau<double>::ars222(),2.0},
+                         Case{"ARS(4,4,3)",IMEXTableau<double>::ars443(),3.0}}) {
+        IMEXRungeKutta<double> coarse(L,dirichlet,dt,c.tab), fine(L,dirichlet,dt/2,c.tab);
+        const double e1 = heat_error(coarse,n), e2 = heat_error(fine,n), p = std::log2(e1/e2);
+        cout << c.name << ": errors " << e1 << " " << e2 << ", order " << p << "\n";
+        if (std::abs(p-c.order) > 0.25) failures++;
+    }
+    for (unsigned int k=1; k<=3; k++) {
+        SBDF<double> coarse(L,dirichlet,dt/2,k), fine(L,dirichlet,dt/4,k);
+        const double e1 = heat_error(coarse,n), e2 = heat_error(fine,n), p = std::log2(e1/e2);
+        cout << "SBDF" << k << ": errors " << e1 << " " << e2 << ", order " << p << "\n";
+        if (std::abs(p-k) > 0.3) failures++;
+    }
+
+    // viscous Burgers u_t = nu u_xx - (u^2/2)_x keeps its steady front -tanh(x/(2 nu))
+    const double nu = 0.1;
+    const std::vector<BoundaryCondition<double>> front{BoundaryCondition<double>::Dirichlet(Boundary::Left,std::tanh(0.5/nu)),
+                                                       BoundaryCondition<double>::Dirichlet(Boundary::Right,-std::tanh(0.5/nu))};
+    const std::size_t nb = 65;
+    auto bb = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(nb-1);
+    LinearOperator<double> Lb = nu*SecondDerivative<double>(bb.get());
+    std::vector<double> w(nb);
+    auto burgers = [&](Span<const double> u, Span<double> nu_) {
+        bb->multiply_coeffs(u,u,Span<double>(w));
+        bb->differentiate_coeffs(Span<const double>(w),nu_);
+        for (auto& v: nu_) v *= -0.5;
+    };
+    std::vector<double> f(nb), u0(nb);
+    for (std::size_t i=0; i<nb; i++) f[i] = -std::tanh(bb->get_nodes()[i]/(2*nu));
+    bb->calc_spectral_coeffs(Span<const double>(f),Span<double>(u0));
+    IMEXRungeKutta<double> rk(Lb,front,1e-3);
+    SBDF<double> bdf(Lb,front,1e-3,3);
+    std::vector<double> ur(u0), ub(u0);
+    rk.advance(Span<double>(ur),500,burgers);
+    bdf.advance(Span<double>(ub),500,burgers);
+    double e_rk = 0.0, e_bdf = 0.0;
+    for (std::size_t i=0; i<nb; i++) {
+        e_rk = std::max(e_rk,std::abs(ur[i]-u0[i]));
+        e_bdf = std::max(e_bdf,std::abs(ub[i]-u0[i]));
+    }
+    cout << "Burgers steady front after t = 0.5: drift " << e_rk << " (ARS443), " << e_bdf << " (SBDF3)\n";
+    if (e_rk > 1e-8 || e_bdf > 1e-8) failures++;
+
+    // cached factorisations and work counters, SBDF3 takes its first two steps with the starter
+    const StepCounters& c = rk.counters();
+    cout << "ARS443: " << rk.num_factorisations() << " factorisation(s), " << c.solves << " solves, "
+         << c.nonlinear_evals << " N evaluations in " << c.steps << " steps, " << c.steps_per_second() << " steps/s\n";
+    if (rk.num_factorisations()!=1 || c.steps!=500 || c.solves!=4*500 || c.nonlinear_evals!=4*500 || bdf.counters().steps!=500 || bdf.counters().solves!=500-2) failures++;
+    IMEXRungeKutta<double> ars2(L,dirichlet,dt,IMEXTableau<double>::ars222());
+    if (ars2.num_factorisations()!=1) failures++;
+
+    // I - c L is built on the basis of L: a Legendre L is rejected rather than
+    // paired with a Chebyshev identity, and so is a matrix without a symbolic form
+    {
+        auto leg = PlanRegistry::instance().get_basis<LegendreBase<double>>(16);
+        const LinearOperator<double> Ll = SecondDerivative<double>(leg.get());
+        LinearOperator<double> M(16);
+        std::vector<double> Lij;
+        Ll.get_Lij(Lij);
+        M.set_Lij(Lij);
+        auto rejected = [&](auto make) {
+            try { make(); } catch (const std::invalid_argument&) { return true; }
+            return false;
+        };
+        const bool r_rk = rejected([&]() { IMEXRungeKutta<double> s(Ll,dirichlet,dt); });
+        const bool r_bdf = rejected([&]() { SBDF<double> s(Ll,dirichlet,dt,2); });
+        const bool r_mat = rejected([&]() { IMEXRungeKutta<double> s(M,dirichlet,dt); });
+        cout << "non-Chebyshev L rejected: ARS443 " << r_rk << ", SBDF2 " << r_bdf << ", matrix only " << r_mat << "\n";
+        failures += !(r_rk && r_bdf && r_mat);
+    }
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
@@ -0,0 +1,96 @@
+#define SPECTRE_INSTRUMENT
+#define SPECTRE_INSTRUMENT_ALLOCATIONS
+#include "../ODE/linear_diff_ops.hpp"
+#include "../functions.hpp"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <cstdio>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+inline void bump(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(-4*v*v)*std::sin(7*v));
+}
+
+int main()
+{
+    int failures = 0;
+    static_assert(Instrument::enabled, "SPECTRE_INSTRUMENT is defined");
+    const unsigned int N = 64;
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    // warm up: the first transform on a thread allocates its scratch
+    std::vector<double> f(N+1,1.0), ft(N+1);
+    basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+    // the recording itself does not allocate once the counter of the kernel exists
+    const std::uint64_t a0 = Instrument::detail::thread_allocs();
+    for (int k=0; k<1000; k++) basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+    const std::uint64_t a_rec = Instrument::detail::thread_allocs()-a0;
+    cout << "recording 1000 calls: " << a_rec << " allocs, " << Instrument::max_events() << " events reserved per thread\n";
+    if (a_rec!=0) failures++;
+    Instrument::reset();
+
+    // calls, bytes and allocations per kernel and per N
+    for (int k=0; k<10; k++) basis->calc_spectral_coeffs(Span<const double>(f),Span<double>(ft));
+    const Instrument::Counters c = Instrument::get("ChebyshevBase::calc_spectral_coeffs",N);
+    cout << "transform: calls " << c.calls << ", cycles " << c.cycles << ", bytes " << c.bytes << ", allocs " << c.allocs << "\n";
+    if (c.calls!=10 || c.bytes!=10*2*(N+1)*sizeof(double) || c.cycles==0 || c.allocs!=0) failures++;
+    if (Instrument::get("ChebyshevBase::calc_spectral_coeffs",2*N).calls!=0) failures++;
+
+    // construction, evaluation and assembly; the registry makes the second assembly a cache hit
+    Function<double,ChebyshevBase<double>,N> u(&bump);
+    double y;
+    u.eval(0.3,y);
+    std::vector<double> x(100,0.5), yv;
+    u.eval(x,yv);
+    Derivative<double> D(basis.get());
+    Derivative<double> D_again(basis.get());
+    const Instrument::Counters fc = Instrument::get("Function::Function",N);
+    const Instrument::Counters ev = Instrument::get("Function::eval",N);
+    const Instrument::Counters eb = Instrument::get("Function::eval_batch",N);
+    const Instrument::Counters as = Instrument::get("Derivative::assemble",N);
+    const Instrument::Counters st = Instrument::get("ChebyshevBase::deriv_storage",N);
+    cout << "function: " << fc.calls << " constructed (" << fc.allocs << " allocs), " << ev.calls << " point eval, "
+         << eb.calls << " batch eval\n";
+    cout << "operator: " << as.calls << " assembled, " << st.calls << " storage built, " << as.allocs << " allocs\n";
+    if (fc.calls!=1 || fc.allocs==0 || ev.calls!=1 || eb.calls!=1 || as.calls!=2 || st.calls!=1 || as.allocs==0) failures++;
+    // nested scopes are inclusive
+    if (fc.cycles < Instrument::get("ChebyshevBase::calc_spectral_coeffs",N).cycles-c.cycles) failures++;
+
+    // other threads record into their own buffers, merged in the report
+    std::vector<std::thread> threads;
+    for (int t=0; t<3; t++)
+        threads.emplace_back([&]() {
+            std::vector<double> g(N+1,2.0), gt(N+1);
+            for (int k=0; k<100; k++) basis->calc_function_values(Span<const double>(g),Span<double>(gt));
+        });
+    for (auto& t: threads) t.join();
+    const Instrument::Counters tc = Instrument::get("ChebyshevBase::calc_function_values",N);
+    cout << "threads: " << tc.calls << " calls from exited threads\n";
+    if (tc.calls < 300) failures++;
+
+    // chrome trace
+    const std::string path = "test_instrument.json";
+    if (!Instrument::write_trace(path)) failures++;
+    std::ifstream in(path);
+    const std::string json((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+    std::size_t events = 0;
+    for (std::size_t p=json.find("\"ph\": \"X\""); p!=std::string::npos; p=json.find("\"ph\": \"X\"",p+1)) events++;
+    cout << "trace: " << events << " events, " << json.size() << " bytes\n";
+    if (json.find("\"traceEvents\"")==std::string::npos) failures++;
+    if (events < 300+10 || json.find("\"name\": \"Derivative::assemble\"")==std::string::npos || json.substr(json.size()-3)!="]}\n") failures++;
+    std::remove(path.c_str());
+
+    Instrument::summary(stdout);
+    Instrument::reset();
+    if (Instrument::get("ChebyshevBase::calc_function_values",N).calls!=0) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
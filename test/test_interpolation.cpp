@@ -68,14 +68,7 @@ int main(){
 template <class T> inline void compute_interp_func(const std::vector<T> x, const std::vector<T>& ytilde,std::shared_ptr<FunctionalBase<T>> basis, std::vector<T>& y )
 {
     y.clear();
-    for (auto& val : x) {
-        T tmp = static_cast<T>(0.0);
-        for(int N=0; N<ytilde.size();N++)
-        {
-            tmp += basis->evaluate_function(val,N) * ytilde[N];
-        }
-        y.push_back(tmp);
-    }
+    for (auto& val : x) y.push_back(basis->evaluate_series(val,ytilde));
 };
 
 inline void generate_linspace(const unsigned int NPOINTS, std::vector<double>& x){
@@ -0,0 +1,272 @@
+#include "../functions.hpp"
+#include "../polybases/legendre.hpp"
+#include "../ODE/odesolvers.hpp"
+#include <iostream>
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <stdexcept>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+inline void runge(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(1.0/(1.0+4.0*v*v));
+}
+inline double drunge(double v) { const double q = 1.0+4.0*v*v; return -8.0*v/(q*q); }
+
+/*
+ * GLL nodes and weights: x_k are the zeros of (1-x^2) P_N'(x), checked through
+ * P_N' = N (P_{N-1} - x P_N)/(1-x^2) by the long double recurrence; the
+ * weights integrate x^(2N-2) exactly and sum to 2.
+ */
+bool check_gll(unsigned int N)
+{
+    std::vector<double> x, w;
+    Legendre::gll_nodes_and_weights<double>(N,x,w);
+    double e_root = 0.0, e_sym = 0.0, sum = 0.0, mom = 0.0;
+    bool sorted = true;
+    for (unsigned int k=0; k<=N; k++) {
+        sum += w[k];
+        mom += w[k]*std::pow(x[k],2*(N-1));
+        e_sym = std::max(e_sym,std::abs(x[k]+x[N-k])+std::abs(w[k]-w[N-k]));
+        if (k>0 && !(x[k] < x[k-1])) sorted = false;
+        if (k==0 || k==N) continue;
+        long double pn, pnm1;
+        const long double xk = x[k];
+        Legendre::Pn_pair<long double>(xk,N,pn,pnm1);
+        // the Newton step P_N'/P_N'' in long double: distance from x_k to the true root
+        const long double dp = N*(pnm1-xk*pn)/(1-xk*xk);
+        const long double d2p = (2*xk*dp - N*(N+1.0L)*pn)/(1-xk*xk);
+        e_root = std::max(e_root,static_cast<double>(std::abs(dp/d2p)));
+    }
+    const double e_sum = std::abs(sum-2.0), e_mom = std::abs(mom-1.0/(N-0.5));
+    cout << "GLL N=" << N << ": node displacement " << e_root << ", symmetry " << e_sym
+         << ", weight sum " << e_sum << ", x^(2N-2) moment " << e_mom << "\n";
+    return sorted && e_root < 4e-16 && e_sym == 0.0 && e_sum < 1e-13 && e_mom < 1e-13;
+}
+
+/*
+ * Conversions of n coefficients: the Toeplitz-Hankel plan against the direct
+ * sums in long double, relative to the largest output, on O(1) coefficients.
+ * A Legendre series evaluated through its Chebyshev coefficients gives the
+ * same values.
+ */
+bool check_conversion(std::size_t n)
+{
+    std::vector<double> a(n), c(n), l(n), cd(n), ld(n), back(n);
+    for (std::size_t k=0; k<n; k++) a[k] = std::sin(0.7*k+0.3)/(1.0+0.001*k);
+    Legendre::ConversionPlan<double> plan(n);
+    plan.leg2cheb(a.data(),c.data());
+    plan.cheb2leg(c.data(),back.data());
+    double e_round = 0.0, scale = 0.0;
+    for (std::size_t k=0; k<n; k++) {
+        e_round = std::max(e_round,std::abs(back[k]-a[k]));
+        scale = std::max(scale,std::abs(a[k]));
+    }
+    double e_l2c = 0.0, e_c2l = 0.0;
+    if (plan.fast()) {
+        // direct sums, O(n^2): the reference
+        std::vector<long double> lam = Legendre::lambda_half(2*n+1);
+        double cs = 0.0, ls = 0.0;
+        for (std::size_t j=0; j<n; j++) {
+            long double s = 0.0L;
+            for (std::size_t k=j; k<n; k+=2) s += lam[k-j]*lam[k+j]*a[k];
+            cd[j] = static_cast<double>((j==0 ? 1.0L : 2.0L)/Chebyshev::pi<long double>*s);
+            cs = std::max(cs,std::abs(cd[j]));
+            s = 0.0L;
+            for (std::size_t k=j+2; k<n; k+=2) s += k*lam[k-j-2]/(k-j)*lam[k+j-1]/(k+j+1)*a[k];
+            const long double dj = j==0 ? 1.0L : std::sqrt(Chebyshev::pi<long double>)/(2*lam[2*j]);
+            ld[j] = static_cast<double>(dj*a[j] - (j+0.5L)*s);
+            ls = std::max(ls,std::abs(ld[j]));
+        }
+        plan.cheb2leg(a.data(),l.data());
+        for (std::size_t j=0; j<n; j++) {
+            e_l2c = std::max(e_l2c,std::abs(c[j]-cd[j])/cs);
+            e_c2l = std::max(e_c2l,std::abs(l[j]-ld[j])/ls);
+        }
+    }
+    // evaluation at a few points both ways
+    double e_eval = 0.0;
+    for (double x: {-0.93, -0.2, 0.0, 0.51, 1.0}) {
+        const double vl = Legendre::clenshaw(x,a.data(),n);
+        const double vc = Chebyshev::clenshaw(x,c);
+        e_eval = std::max(e_eval,std::abs(vl-vc)/scale);
+    }
+    cout << "conversion n=" << n << (plan.fast() ? " (fast, ranks " : " (direct") ;
+    if (plan.fast()) cout << plan.rank_leg2cheb() << "/" << plan.rank_cheb2leg() << ")";
+    else cout << ")";
+    cout << ": leg2cheb " << e_l2c << ", cheb2leg " << e_c2l << ", round trip " << e_round/scale << ", evaluation " << e_eval << "\n";
+    const double tol = 1e-14*std::log2(static_cast<double>(n)+2);
+    // the two Clenshaw sums round like n eps
+    return e_l2c < tol && e_c2l < tol && e_round < tol*scale && e_eval < 10*n*std::numeric_limits<double>::epsilon();
+}
+
+/*
+ * The basis through Function and the operators, for the Runge function at
+ * orders where its Legendre coefficients, decaying like 0.618^n, are resolved
+ * to rounding.
+ */
+template <unsigned int N> bool check_basis()
+{
+    auto basis = PlanRegistry::instance().get_basis<LegendreBase<double>>(N);
+    Function<double,LegendreBase<double>,N> u(&runge);
+    std::vector<double> lt, vals, back;
+    u.get_spectral_coeffs(lt);
+    u.get_func_vals(vals);
+    basis->calc_function_values(lt,back);
+    double e_rt = 0.0;
+    for (unsigned int i=0; i<=N; i++) e_rt = std::max(e_rt,std::abs(back[i]-vals[i]));
+    // int 1/(1+4x^2) = atan(2)
+    const double e_int = std::abs(u.integrate()-std::atan(2.0));
+
+    // the same coefficients from values on the Chebyshev grid, by the fast path
+    const std::vector<double>& xc = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N)->get_nodes();
+    std::vector<double> fc, lc(N+1), vc(N+1);
+    runge(xc,fc);
+    basis->calc_spectral_coeffs_chebyshev(Span<const double>(fc),Span<double>(lc));
+    basis->calc_function_values_chebyshev(Span<const double>(lc),Span<double>(vc));
+    double e_cheb = 0.0, e_cheb_rt = 0.0;
+    for (unsigned int i=0; i<=N; i++) {
+        e_cheb = std::max(e_cheb,std::abs(lc[i]-lt[i]));
+        e_cheb_rt = std::max(e_cheb_rt,std::abs(vc[i]-fc[i]));
+    }
+
+    std::vector<double> pts, ev;
+    for (int p=0; p<400; p++) pts.push_back(-1.0 + 0.005*p);
+    u.eval(pts,ev);
+    double e_ev = 0.0;
+    for (std::size_t p=0; p<pts.size(); p++) e_ev = std::max(e_ev,std::abs(ev[p]-1.0/(1.0+4.0*pts[p]*pts[p])));
+
+    // derivatives by the operators, the coefficient recurrence and the dense matrix
+    Derivative<double> D(basis.get());
+    SecondDerivative<double> D2(basis.get());
+    std::vector<double> d1(N+1), d2(N+1), dd(N+1), r1(N+1), r2(N+1), dense;
+    D.apply(Span<const double>(lt),Span<double>(d1));
+    D2.apply(Span<const double>(lt),Span<double>(d2));
+    D.apply(Span<const double>(d1),Span<double>(dd));
+    basis->differentiate_coeffs(Span<const double>(lt),Span<double>(r1),1);
+    basis->differentiate_coeffs(Span<const double>(lt),Span<double>(r2),2);
+    double e_d1 = 0.0, e_d2 = 0.0, e_rec = 0.0, e_dense = 0.0, s1 = 0.0, s2 = 0.0;
+    for (auto p: pts) e_d1 = std::max(e_d1,std::abs(basis->evaluate_series(p,d1)-drunge(p)));
+    for (unsigned int i=0; i<=N; i++) {
+        s1 = std::max(s1,std::abs(d1[i]));
+        s2 = std::max(s2,std::abs(dd[i]));
+    }
+    for (unsigned int i=0; i<=N; i++) {
+        e_d2 = std::max(e_d2,std::abs(d2[i]-dd[i]));
+        e_rec = std::max(e_rec,std::abs(r1[i]-d1[i])/s1+std::abs(r2[i]-dd[i])/s2);
+    }
+    e_d2 /= s2;
+    basis->calc_deriv(dense);
+    for (unsigned int i=0; i<=N; i++) {
+        double s = 0.0;
+        for (unsigned int j=0; j<=N; j++) s += dense[i*(N+1)+j]*lt[j];
+        e_dense = std::max(e_dense,std::abs(s-d1[i])/s1);
+    }
+
+    // x u, the antiderivative and the product
+    TimesX<double> X(basis.get());
+    std::vector<double> xu(N+1), anti(N+1), uu(N+1);
+    X.apply(Span<const double>(lt),Span<double>(xu));
+    basis->antiderivative_coeffs(Span<const double>(lt),Span<double>(anti));
+    basis->multiply_coeffs(Span<const double>(lt),Span<const double>(lt),Span<double>(uu));
+    double e_x = 0.0, e_anti = 0.0, e_prod = 0.0;
+    for (auto p: pts) {
+        const double f = 1.0/(1.0+4.0*p*p);
+        e_x = std::max(e_x,std::abs(basis->evaluate_series(p,xu)-p*f));
+        e_anti = std::max(e_anti,std::abs(basis->evaluate_series(p,anti)-0.5*(std::atan(2*p)+std::atan(2.0))));
+        e_prod = std::max(e_prod,std::abs(basis->evaluate_series(p,uu)-f*f));
+    }
+
+    cout << "N=" << N << ": round trip " << e_rt << ", integral " << e_int << ", chebyshev grid " << e_cheb
+         << " (round trip " << e_cheb_rt << "), eval " << e_ev << ", d/dx " << e_d1 << ", D2 vs D^2 " << e_d2
+         << ", recurrence " << e_rec << ", dense " << e_dense << ", times x " << e_x << ", antiderivative " << e_anti
+         << ", product " << e_prod << "\n";
+    // GLL nodes rounded to double break the discrete orthogonality by O(N eps), and derivatives amplify by N^2
+    const double tol = 50*N*std::numeric_limits<double>::epsilon();
+    return e_rt < tol && e_int < 1e-14 && e_cheb < tol && e_cheb_rt < 1e-14 && e_ev < tol && e_d1 < N*N*tol
+        && e_d2 < 1e-14 && e_rec < 1e-14 && e_dense < 1e-14 && e_x < tol && e_anti < 1e-13 && e_prod < tol;
+}
+
+int main()
+{
+    int failures = 0;
+
+    // small orders by the recurrence, large ones by the asymptotic series
+    for (unsigned int N: {1u, 2u, 3u, 16u, 127u, 128u, 1001u, 20000u})
+        if (!check_gll(N)) failures++;
+
+    for (std::size_t n: {1, 2, 5, 64, 1000, 4095, 4096, 4097, 10000})
+        if (!check_conversion(n)) failures++;
+
+    // N = 10^5 both ways: round trip and timing against one DCT of the same size
+    {
+        const std::size_t n = 100001;
+        auto t0 = std::chrono::steady_clock::now();
+        Legendre::ConversionPlan<double> plan(n);
+        auto t1 = std::chrono::steady_clock::now();
+        std::vector<double> a(n), c(n), back(n);
+        for (std::size_t k=0; k<n; k++) a[k] = std::cos(0.37*k)/std::sqrt(1.0+k);
+        plan.leg2cheb(a.data(),c.data());
+        plan.cheb2leg(c.data(),back.data());
+        auto t2 = std::chrono::steady_clock::now();
+        double e = 0.0;
+        for (std::size_t k=0; k<n; k++) e = std::max(e,std::abs(back[k]-a[k]));
+        // one coefficient of the direct sum, in long double
+        std::vector<long double> lam = Legendre::lambda_half(2*n+1);
+        long double s = 0.0L;
+        const std::size_t j = 777;
+        for (std::size_t k=j; k<n; k+=2) s += lam[k-j]*lam[k+j]*a[k];
+        const double e_j = std::abs(c[j]-static_cast<double>(2.0L/Chebyshev::pi<long double>*s));
+        const double tplan = std::chrono::duration<double>(t1-t0).count(), tconv = std::chrono::duration<double>(t2-t1).count();
+        cout << "n=" << n << ": ranks " << plan.rank_leg2cheb() << "/" << plan.rank_cheb2leg() << ", round trip " << e
+             << ", c_" << j << " vs direct " << e_j << ", plan " << tplan << " s, both conversions " << tconv << " s\n";
+        if (e > 1e-12 || e_j > 1e-13 || !plan.fast()) failures++;
+    }
+
+    if (!check_basis<128>()) failures++;
+    if (!check_basis<1500>()) failures++;
+
+    // multiply by (1 - x^2) with an operator expression: the Identity minus X twice
+    {
+        const unsigned int N = 20;
+        auto basis = PlanRegistry::instance().get_basis<LegendreBase<double>>(N);
+        TimesX<double> X(basis.get());
+        Identity<double> I(basis.get());
+        std::vector<double> a(N+1,0.0), y(N+1);
+        a[3] = 1.0;
+        (I - X*X).apply(a,y);
+        double e = 0.0;
+        for (double p: {-0.8, 0.1, 0.77}) e = std::max(e,std::abs(basis->evaluate_series(p,y)-(1-p*p)*Legendre::Pn(p,3)));
+        cout << "(1-x^2) P_3 " << e << "\n";
+        if (e > 1e-15) failures++;
+    }
+
+    // u'' = 2, u(+-1) = 0 with Legendre operators: the solvers lower Chebyshev
+    // operators only and must reject D, D2 and X here rather than solve wrongly
+    {
+        auto basis = PlanRegistry::instance().get_basis<LegendreBase<double>>(16);
+        const Derivative<double> D(basis.get());
+        const SecondDerivative<double> D2(basis.get());
+        const TimesX<double> X(basis.get());
+        const std::vector<ODE::BoundaryCondition<double>> bcs{ODE::BoundaryCondition<double>::Dirichlet(ODE::Boundary::Left,0.0),
+                                                              ODE::BoundaryCondition<double>::Dirichlet(ODE::Boundary::Right,0.0)};
+        auto rejected = [&](auto make) {
+            try { make(); } catch (const std::invalid_argument&) { return true; }
+            return false;
+        };
+        const bool r_d2 = rejected([&]() { ODE::ODESolver<double> s(D2,bcs); });
+        const bool r_d = rejected([&]() { ODE::ODESolver<double> s(D,{bcs[0]}); });
+        const bool r_x = rejected([&]() { ODE::ODESolver<double> s(D2 + X*D,bcs); });
+        const bool r_imex = rejected([&]() { ODE::SBDF<double> s(D2,bcs,1e-3,1); });
+        cout << "Legendre operators rejected by the solvers: D2 " << r_d2 << ", D " << r_d << ", X " << r_x << ", SBDF " << r_imex << "\n";
+        if (!(r_d2 && r_d && r_x && r_imex)) failures++;
+    }
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
@@ -0,0 +1,57 @@
+#include "../ODE/odesolvers.hpp"
+#include "../polybases/parallel.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace Operators;
+using namespace ODE;
+using std::cout;
+
+int main()
+{
+    int failures = 0;
+
+    // every index is visited exactly once, nested loops run serially
+    {
+        Parallel::ThreadPool pool(3);
+        std::vector<std::atomic<int>> visits(1000);
+        for (int rep=0; rep<20; rep++)
+            pool.parallel_for(visits.size(),[&](std::size_t i) {
+                visits[i]++;
+                if (i==0) pool.parallel_for(4,[](std::size_t) {},4);
+            },4);
+        int bad = 0;
+        for (auto& v: visits) bad += (v.load()!=20);
+        cout << "pool with " << pool.size() << " workers, miscounted indices: " << bad << "\n";
+        failures += (bad!=0);
+    }
+
+    // a block of right-hand sides against one solve per column
+    const unsigned int N = 96;
+    const std::size_t n = N+1, nrhs = 37;
+    ChebyshevBase<double> basis(N);
+    SecondDerivative<double> D2(&basis);
+    Derivative<double> D(&basis);
+    TimesX<double> X(&basis);
+    Identity<double> I(&basis);
+    ODESolver<double> solver(D2 + X*D - 2.0*I,{BoundaryCondition<double>::Dirichlet(Boundary::Left,1.0),
+                                             BoundaryCondition<double>::Robin(Boundary::Right,1.0,2.0,-1.0)});
+    std::vector<double> F(n*nrhs), U(n*nrhs), u;
+    for (std::size_t c=0; c<nrhs; c++)
+        for (std::size_t i=0; i<n; i++) F[c*n+i] = std::cos(0.3*c+1.7*i)/(1.0+i*i);
+    for (unsigned int nthreads : {1u, Parallel::default_threads(), 4u}) {
+        std::fill(U.begin(),U.end(),0.0);
+        solver.solve(Span<const double>(F),Span<double>(U),nrhs,nthreads);
+        double e = 0.0;
+        for (std::size_t c=0; c<nrhs; c++) {
+            std::vector<double> f(F.begin()+c*n,F.begin()+(c+1)*n);
+            solver.solve(f,u);
+            for (std::size_t i=0; i<n; i++) e = std::max(e,std::abs(U[c*n+i]-u[i]));
+        }
+        cout << "block solve, " << nthreads << " threads: max difference " << e << "\n";
+        failures += (e > 1e-13);
+    }
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
@@ -0,0 +1,154 @@
+#include "../ODE/odesolvers.hpp"
+#include "../polybases/legendre.hpp"
+#include <iostream>
+#include <cmath>
+#include <stdexcept>
+
+using namespace Operators;
+using namespace ODE;
+using std::cout;
+
+// u = sin(3x) + cos(x) solves u'' + x u' - u = f1
+inline double u1(double x) { return std::sin(3*x) + std::cos(x); }
+inline double du1(double x) { return 3*std::cos(3*x) - std::sin(x); }
+inline void f1(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back( -9*std::sin(3*v) - std::cos(v) + v*du1(v) - u1(v) );
+}
+// u = cosh(x) + x^3 solves u'' - 4u = f2
+inline double u2(double x) { return std::cosh(x) + x*x*x; }
+inline double du2(double x) { return std::sinh(x) + 3*x*x; }
+inline void f2(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back( std::cosh(v) + 6*v - 4*u2(v) );
+}
+inline void zero(const std::vector<double>& x, std::vector<double>& y) { y.assign(x.size(),0.0); }
+
+template <class F> double max_error(const F& u, double exact(double)) {
+    double e = 0.0;
+    for (int k=0; k<=200; k++) {
+        const double x = -1.0 + k/100.0;
+        double ux;
+        u.eval(x,ux);
+        e = std::max(e,std::abs(ux-exact(x)));
+    }
+    return e;
+}
+
+template <unsigned int N> int check_dirichlet(double tol) {
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+    SecondDerivative<double> D2(basis.get());
+    Derivative<double> D(basis.get());
+    TimesX<double> X(basis.get());
+    Identity<double> I(basis.get());
+    auto L = D2 + X*D - I;
+    std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,u1(-1.0)),
+                                               BoundaryCondition<double>::Dirichlet(Boundary::Right,u1(1.0))};
+    Function<double,ChebyshevBase<double>,N> f(&f1);
+    // the expression is lowered without ever forming its Chebyshev matrix
+    ODESolver<double> solver(L,bcs);
+    const double e = max_error(solver.solve(f),u1);
+    cout << "dirichlet, N = " << N << ", order " << solver.order() << ": banded error " << e;
+    int failures = (e > tol || solver.order() != 2);
+    if (N <= 128) {
+        DenseODESolver<double> dense(LinearOperator<double>(L),bcs);
+        std::vector<double> ft, u;
+        f.get_spectral_coeffs(ft);
+        dense.solve(ft,u);
+        const double ed = max_error(Function<double,ChebyshevBase<double>,N>::from_spectral_coeffs(u),u1);
+        cout << ", dense error " << ed;
+        failures += (ed > tol);
+    }
+    cout << "\n";
+    return failures;
+}
+
+int main()
+{
+    int failures = 0;
+    failures += check_dirichlet<32>(1e-12);
+    failures += check_dirichlet<128>(1e-12);
+    failures += check_dirichlet<4096>(1e-11);
+
+    // Neumann on the left, Robin on the right
+    {
+        const unsigned int N = 40;
+        auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+        SecondDerivative<double> D2(basis.get());
+        Identity<double> I(basis.get());
+        LinearOperator<double> L = D2 - 4.0*I;
+        std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Neumann(Boundary::Left,du2(-1.0)),
+                                                   BoundaryCondition<double>::Robin(Boundary::Right,2.0,1.0,2*u2(1.0)+du2(1.0))};
+        ODESolver<double> solver(L,bcs);
+        const double e = max_error(solver.solve(Function<double,ChebyshevBase<double>,N>(&f2)),u2);
+        cout << "neumann/robin error " << e << "\n";
+        failures += (e > 1e-12);
+    }
+
+    // first order, u' + x u = 0 with u(-1) = exp(-1/2), u = exp(-x^2/2)
+    {
+        const unsigned int N = 40;
+        auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+        Derivative<double> D(basis.get());
+        TimesX<double> X(basis.get());
+        LinearOperator<double> L = D + X;
+        ODESolver<double> solver(L,{BoundaryCondition<double>::Dirichlet(Boundary::Left,std::exp(-0.5))});
+        const double e = max_error(solver.solve(Function<double,ChebyshevBase<double>,N>(&zero)),
+                                   [](double x) { return std::exp(-x*x/2); });
+        cout << "first order error " << e << "\n";
+        failures += (e > 1e-12 || solver.order() != 1);
+    }
+
+    // (x u')' and u' + x u'' lower to the same system
+    {
+        const unsigned int N = 48;
+        auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+        SecondDerivative<double> D2(basis.get());
+        Derivative<double> D(basis.get());
+        TimesX<double> X(basis.get());
+        Identity<double> I(basis.get());
+        std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,1.0),
+                                                   BoundaryCondition<double>::Neumann(Boundary::Right,0.5)};
+        ODESolver<double> composed(D*(X*D) + 3.0*I,bcs), expanded(D + X*D2 + 3.0*I,bcs);
+        std::vector<double> f(N+1), ua, ub;
+        for (unsigned int j=0; j<N+1; j++) f[j] = 1.0/(1.0+j*j*j);
+        composed.solve(f,ua);
+        expanded.solve(f,ub);
+        double e = 0.0;
+        for (unsigned int j=0; j<N+1; j++) e = std::max(e,std::abs(ua[j]-ub[j]));
+        cout << "composition vs expansion " << e << "\n";
+        failures += (e > 1e-12);
+    }
+
+    // the ultraspherical lowering describes Chebyshev operators on [-1,1] only: a
+    // Legendre operator, a tree mixing bases or a bare matrix is rejected, not
+    // silently solved as if its coefficients were Chebyshev ones
+    {
+        const unsigned int N = 16;
+        auto leg = PlanRegistry::instance().get_basis<LegendreBase<double>>(N);
+        auto cheb = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+        SecondDerivative<double> D2l(leg.get()), D2c(cheb.get());
+        Identity<double> Il(leg.get());
+        LinearOperator<double> M(N);
+        std::vector<double> Lij;
+        LinearOperator<double>(D2c).get_Lij(Lij);
+        M.set_Lij(Lij);
+        const std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,0.0),
+                                                         BoundaryCondition<double>::Dirichlet(Boundary::Right,0.0)};
+        auto rejected = [&](auto make) {
+            try { make(); } catch (const std::invalid_argument&) { return true; }
+            return false;
+        };
+        const bool r_leg = rejected([&]() { ODESolver<double> s(D2l,bcs); });
+        const bool r_mix = rejected([&]() { ODESolver<double> s(D2c + Il,bcs); });
+        const bool r_mat = rejected([&]() { ODESolver<double> s(M,bcs); });
+        const bool r_ref = rejected([&]() { RefinedODESolver<float,double> s(D2l,bcs); });
+        const bool accepted = !rejected([&]() { ODESolver<double> s(D2c,bcs); });
+        cout << "non-Chebyshev operators rejected: legendre " << r_leg << ", mixed " << r_mix << ", matrix only " << r_mat
+             << ", refined " << r_ref << "; chebyshev accepted " << accepted << "\n";
+        failures += !(r_leg && r_mix && r_mat && r_ref && accepted);
+    }
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
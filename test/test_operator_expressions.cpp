@@ -0,0 +1,71 @@
+#include "../ODE/linear_diff_ops.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <cmath>
+
+using namespace Operators;
+using namespace FunctionalBases;
+using std::cout;
+
+// count every heap allocation made by the program
+static std::size_t n_allocs = 0;
+// malloc/free pair by construction, GCC cannot see that through inlining
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(std::size_t size) {
+    n_allocs++;
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+double max_diff(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double e = 0.0;
+    for (std::size_t i=0; i<a.size(); i++) e = std::max(e, std::abs(a[i]-b[i]));
+    return e;
+}
+
+int main()
+{
+    int failures = 0;
+    const unsigned int N = 64;
+    ChebyshevBase<double> cheb(N);
+    Derivative<double> D(&cheb);
+    SecondDerivative<double> D2(&cheb);
+    TimesX<double> X(&cheb);
+
+    std::vector<double> x(N+1), y_lazy(N+1), y_mat(N+1);
+    for (unsigned int j=0; j<N+1; j++) x[j] = 1.0/(1.0+j*j);
+
+    // lazy application against the materialised operator
+    auto expr = D2 + X*D*2.0 - 0.5*(X*X);
+    LinearOperator<double> L = expr;
+    expr.apply(x,y_lazy);
+    L.apply(x,y_mat);
+    double e = max_diff(y_lazy,y_mat);
+    cout << "lazy vs materialised: " << e << "\t materialised format: " << static_cast<int>(L.format()) << "\n";
+    if (e > 1e-11) failures++;
+
+    // parameter sweep: rebuilding and applying the expression does not allocate
+    n_allocs = 0;
+    double acc = 0.0;
+    for (int k=0; k<100; k++) {
+        const double alpha = 0.01*k;
+        auto sweep = D2 + X*D*alpha + X*alpha*alpha;
+        sweep.apply(Span<const double>(x),Span<double>(y_lazy));
+        acc += y_lazy[0];
+    }
+    cout << "allocations in sweep: " << n_allocs << " (checksum " << acc << ")\n";
+    if (n_allocs != 0) failures++;
+
+    // materialising sums of same-format terms keeps the format
+    LinearOperator<double> band = X + X*X*3.0;
+    if (band.format() != StorageFormat::Banded) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
@@ -0,0 +1,81 @@
+#include "../ODE/linear_diff_ops.hpp"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+using namespace Operators;
+using namespace FunctionalBases;
+using std::cout;
+
+// max |A x - A_dense x| over a test vector, plus the format and memory of A
+template <class Op> double check(const char* name, const Op& A, const std::vector<double>& dense)
+{
+    const std::size_t n = A.get_storage().size();
+    std::vector<double> x(n), y, y_ref(n, 0.0);
+    for (std::size_t j=0; j<n; j++) x[j] = std::sin(1.0+j);
+    A.apply(x,y);
+    for (std::size_t i=0; i<n; i++)
+        for (std::size_t j=0; j<n; j++) y_ref[i] += dense[i*n+j]*x[j];
+    double e = 0.0, scale = 0.0;
+    for (std::size_t i=0; i<n; i++) {
+        e = std::max(e, std::abs(y[i]-y_ref[i]));
+        scale = std::max(scale, std::abs(y_ref[i]));
+    }
+    cout << name << "\t format: " << static_cast<int>(A.format()) << "\t bytes: " << A.get_storage().memory_bytes()
+         << "\t rel. error: " << e/scale << "\n";
+    return e/scale;
+}
+
+int main()
+{
+    int failures = 0;
+    const unsigned int N = 40;
+    ChebyshevBase<double> cheb(N);
+    std::vector<double> Dd, D2d, Xd;
+    cheb.calc_deriv(Dd);
+    cheb.calc_second_deriv(D2d);
+    cheb.calc_times_x(Xd);
+
+    Derivative<double> D(&cheb);
+    SecondDerivative<double> D2(&cheb);
+    TimesX<double> X(&cheb);
+    if (D.format() != StorageFormat::ParityTriangular || D2.format() != StorageFormat::ParityTriangular || X.format() != StorageFormat::Banded) failures++;
+    if (check("D", D, Dd) > 1e-14) failures++;
+    if (check("D2", D2, D2d) > 1e-14) failures++;
+    if (check("X", X, Xd) > 1e-14) failures++;
+
+    // stored entries match the dense matrices exactly
+    std::vector<double> Ds;
+    D2.get_Lij(Ds);
+    if (Ds != D2d) failures++;
+
+    // compositions keep the sparsest format that holds the result
+    const std::size_t n = N+1;
+    auto dense_sum = [n](const std::vector<double>& A, const std::vector<double>& B, double b) {
+        std::vector<double> C(n*n); for (std::size_t k=0; k<n*n; k++) C[k] = A[k] + b*B[k]; return C; };
+    auto dense_prod = [n](const std::vector<double>& A, const std::vector<double>& B) {
+        std::vector<double> C(n*n, 0.0);
+        for (std::size_t i=0; i<n; i++) for (std::size_t k=0; k<n; k++) for (std::size_t j=0; j<n; j++) C[i*n+j] += A[i*n+k]*B[k*n+j];
+        return C; };
+
+    LinearOperator<double> XX = X*X;
+    LinearOperator<double> DD2 = D2 + D2*3.0;
+    LinearOperator<double> mixed = D + X*2.0;
+    LinearOperator<double> XD = X*D;
+    if (XX.format() != StorageFormat::Banded || DD2.format() != StorageFormat::ParityTriangular) failures++;
+    if (check("X*X", XX, dense_prod(Xd,Xd)) > 1e-14) failures++;
+    if (check("D2+3*D2", DD2, dense_sum(D2d,D2d,3.0)) > 1e-14) failures++;
+    if (check("D+2*X", mixed, dense_sum(Dd,Xd,2.0)) > 1e-14) failures++;
+    if (check("X*D", XD, dense_prod(Xd,Dd)) > 1e-14) failures++;
+
+    // an operator of order N before set_Lij is an empty sparse matrix, not a dense (N+1)^2 one
+    const LinearOperator<double> Z(4096);
+    std::vector<double> z(4097,1.0), zy;
+    Z.apply(z,zy);
+    cout << "zero operator, N = 4096\t bytes: " << Z.get_storage().memory_bytes() << "\n";
+    if (Z.format() != StorageFormat::CSR || Z.get_storage().memory_bytes() > 4098*sizeof(std::size_t) ||
+        zy.size() != z.size() || *std::max_element(zy.begin(),zy.end()) != 0.0) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
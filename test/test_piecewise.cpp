@@ -0,0 +1,195 @@
+#include "../functions.hpp"
+#include "../polybases/piecewise_chebyshev.hpp"
+#include "../ODE/odesolvers.hpp"
+#include <iostream>
+#include <cmath>
+#include <stdexcept>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+inline void ffunc(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back( std::tanh(10*(v-0.3)) + std::sin(v) );
+}
+inline double dfunc(double v) { const double t = std::tanh(10*(v-0.3)); return 10*(1-t*t) + std::cos(v); }
+// u'' + x u' - 4 u for u = tanh(10(x-0.3)) + sin(x)
+inline double bvp_exact(double v) { return std::tanh(10*(v-0.3)) + std::sin(v); }
+inline void bvp_rhs(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) {
+        const double t = std::tanh(10*(v-0.3));
+        y.push_back( -200*t*(1-t*t) - std::sin(v) + v*dfunc(v) - 4*bvp_exact(v) );
+    }
+}
+inline void smooth(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back( std::exp(v)*std::cos(2*v) );
+}
+inline void mode(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back( std::cos(M_PI*v/2) );
+}
+// continuous with a kink at x = 0.5, an interface of the 8-element basis on [-1,3]
+inline void kink(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back( std::abs(v-0.5) );
+}
+
+int main()
+{
+    int failures = 0;
+    const unsigned int K = 8, Ne = 32, N = K*Ne;
+    typedef PiecewiseChebyshevBase<double,K> Base;
+    auto basis = std::make_shared<const Base>(N,-1.0,3.0);
+
+    std::vector<double> x, w;
+    basis->get_nodes(x);
+    basis->get_weights(w);
+    bool ascending = true;
+    for (unsigned int i=1; i<x.size(); i++) ascending &= x[i]>x[i-1];
+    double wsum = 0.0;
+    for (auto v: w) wsum += v;
+    cout << "nodes " << x.size() << ", ascending " << ascending << ", sum of weights " << wsum << "\n";
+    if (x.size()!=N+1 || !ascending || x[2*Ne]!=0.0 || std::abs(wsum-2*M_PI) > 1e-13) failures++;
+
+    // round trip and evaluation of a function with a sharp front
+    Function<double,Base,N> f(basis,&ffunc);
+    std::vector<double> ft, vals;
+    f.get_spectral_coeffs(ft);
+    f.get_func_vals(vals);
+    std::vector<double> back;
+    basis->calc_function_values(ft,back);
+    double e_rt = 0.0;
+    for (unsigned int i=0; i<N+1; i++) e_rt = std::max(e_rt,std::abs(back[i]-vals[i]));
+    std::vector<double> pts, ev, exact;
+    for (int p=0; p<=4000; p++) pts.push_back(-1.0 + p/1000.0);
+    ffunc(pts,exact);
+    f.eval(pts,ev);
+    double e_ev = 0.0;
+    for (unsigned int p=0; p<pts.size(); p++) e_ev = std::max(e_ev,std::abs(ev[p]-exact[p]));
+    cout << "coefficients " << ft.size() << ", round trip error " << e_rt << ", evaluation error " << e_ev << "\n";
+    if (ft.size()!=K*(Ne+1) || e_rt > 1e-13 || e_ev > 1e-6) failures++;
+
+    // the assembled operator and the element-parallel kernel agree, and differentiate correctly
+    Derivative<double> D(basis.get());
+    std::vector<double> d1, d2(ft.size());
+    D.apply(ft,d1);
+    basis->apply_operator(OperatorKind::Derivative,Span<const double>(ft),Span<double>(d2));
+    double e_op = 0.0, e_d = 0.0;
+    for (unsigned int n=0; n<ft.size(); n++) e_op = std::max(e_op,std::abs(d1[n]-d2[n]));
+    for (auto v: pts) e_d = std::max(e_d,std::abs(basis->evaluate_series(v,d1)-dfunc(v)));
+    cout << "derivative: format " << int(D.format()) << ", kernel difference " << e_op << ", error " << e_d << "\n";
+    if (D.format()!=StorageFormat::CSR || e_op > 1e-10 || e_d > 1e-5) failures++;
+
+    // operators of bases with the same N on different domains are cached separately
+    auto other = std::make_shared<const Base>(N,0.0,1.0);
+    Derivative<double> Dother(other.get());
+    if (&Dother.get_storage()==&D.get_storage()) { cout << "shared\n"; failures++; }
+    // the registry compares the breakpoints themselves: one ulp apart is another
+    // domain, the same breakpoints built twice share the operator
+    std::vector<double> br;
+    basis->get_breaks(br);
+    br[3] = std::nextafter(br[3],4.0);
+    const Base nudged(N,br), again(N,-1.0,3.0);
+    const bool apart = &Derivative<double>(&nudged).get_storage()!=&D.get_storage();
+    const bool same = &Derivative<double>(&again).get_storage()==&D.get_storage();
+    cout << "breakpoints one ulp apart cached apart " << apart << ", equal breakpoints shared " << same << "\n";
+    if (!apart || !same) failures++;
+
+    // boundary value problems: the elements are coupled by continuity of u and u'
+    {
+        typedef ODE::BoundaryCondition<double> BC;
+        // u'' + x u' - 4 u = f across the sharp front, u = tanh(10(x-0.3)) + sin(x)
+        Function<double,Base,N> rhs(basis,&bvp_rhs);
+        const std::vector<BC> dirichlet{BC::Dirichlet(ODE::Boundary::Left,bvp_exact(-1.0)),BC::Dirichlet(ODE::Boundary::Right,bvp_exact(3.0))};
+        Derivative<double> Dx(basis.get());
+        ODE::ODESolver<double> s(SecondDerivative<double>(basis.get()) + TimesX<double>(basis.get())*Dx - 4.0*Identity<double>(basis.get()),dirichlet);
+        std::vector<double> rt, ut;
+        rhs.get_spectral_coeffs(rt);
+        s.solve(rt,ut);
+        double e_bvp = 0.0, jump = 0.0, kink_u = 0.0;
+        for (auto v: pts) e_bvp = std::max(e_bvp,std::abs(basis->evaluate_series(v,ut)-bvp_exact(v)));
+        // one-sided values and slopes of neighbouring elements agree at every interface
+        for (unsigned int k=0; k+1<K; k++) {
+            const double* l = &ut[k*(Ne+1)];
+            const double* r = &ut[(k+1)*(Ne+1)];
+            double ul = 0, ur = 0, dl = 0, dr = 0;
+            for (unsigned int j=0; j<=Ne; j++) {
+                const double sg = j%2 ? -1.0 : 1.0;
+                ul += l[j]; ur += sg*r[j];
+                dl += l[j]*j*j; dr -= sg*r[j]*j*j;
+            }
+            jump = std::max(jump,std::abs(ul-ur));
+            kink_u = std::max(kink_u,std::abs(dl-dr)); // equal widths, the 2/h factors cancel
+        }
+        cout << "piecewise BVP: " << s.num_elements() << " elements, error " << e_bvp << ", interface jumps " << jump << " (u) " << kink_u << " (u')\n";
+        if (s.num_elements()!=K || e_bvp > 1e-5 || jump > 1e-12 || kink_u > 1e-10) failures++;
+
+        // uneven elements on [-1,1] reproduce the single-domain solve, with a Neumann condition
+        const unsigned int K4 = 4, N4 = 4*24;
+        typedef PiecewiseChebyshevBase<double,K4> Base4;
+        auto pw = std::make_shared<const Base4>(N4,std::vector<double>{-1.0,-0.55,0.1,0.4,1.0});
+        auto cb = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(64);
+        const std::vector<BC> mixed{BC::Dirichlet(ODE::Boundary::Left,1.0),BC::Neumann(ODE::Boundary::Right,-2.0)};
+        ODE::ODESolver<double> spw(SecondDerivative<double>(pw.get()) + TimesX<double>(pw.get())*Derivative<double>(pw.get()) - 4.0*Identity<double>(pw.get()),mixed);
+        ODE::ODESolver<double> scb(SecondDerivative<double>(cb.get()) + TimesX<double>(cb.get())*Derivative<double>(cb.get()) - 4.0*Identity<double>(cb.get()),mixed);
+        Function<double,Base4,N4> fpw(pw,&smooth);
+        Function<double,ChebyshevBase<double>,64> fcb(&smooth);
+        const auto upw = spw.solve(fpw);
+        const auto ucb = scb.solve(fcb);
+        double e_single = 0.0;
+        for (int p=0; p<=2000; p++) {
+            const double v = -1.0 + p/1000.0;
+            double a, b;
+            upw.eval(v,a);
+            ucb.eval(v,b);
+            e_single = std::max(e_single,std::abs(a-b));
+        }
+        cout << "uneven elements against the single-domain solve: " << e_single << "\n";
+        if (e_single > 1e-11) failures++;
+
+        // the IMEX integrators factorise I - c L on the elements as well: heat equation
+        // with a decaying mode, against the same scheme on the single domain
+        const std::vector<BC> zero{BC::Dirichlet(ODE::Boundary::Left,0.0),BC::Dirichlet(ODE::Boundary::Right,0.0)};
+        LinearOperator<double> Lpw = SecondDerivative<double>(pw.get()), Lcb = SecondDerivative<double>(cb.get());
+        ODE::IMEXRungeKutta<double> rpw(Lpw,zero,1e-3), rcb(Lcb,zero,1e-3);
+        Function<double,Base4,N4> h0(pw,&mode);
+        Function<double,ChebyshevBase<double>,64> c0(&mode);
+        std::vector<double> hpw, hcb;
+        h0.get_spectral_coeffs(hpw);
+        c0.get_spectral_coeffs(hcb);
+        auto none = [](Span<const double>, Span<double> out) { std::fill(out.begin(),out.end(),0.0); };
+        rpw.advance(Span<double>(hpw),100,none);
+        rcb.advance(Span<double>(hcb),100,none);
+        double e_heat = 0.0;
+        for (int p=0; p<=2000; p++) {
+            const double v = -1.0 + p/1000.0;
+            e_heat = std::max(e_heat,std::abs(pw->evaluate_series(v,hpw)-cb->evaluate_series(v,hcb)));
+        }
+        cout << "heat equation on the elements against the single domain after 100 steps: " << e_heat << "\n";
+        if (e_heat > 1e-11) failures++;
+    }
+
+    // the derivative of |x-0.5| jumps at the interface, values are averaged there
+    Function<double,Base,N> g(basis,&kink);
+    std::vector<double> gt, dg, dgv;
+    g.get_spectral_coeffs(gt);
+    D.apply(gt,dg);
+    basis->calc_function_values(dg,dgv);
+    const unsigned int iface = 3*Ne; // x = 0.5
+    cout << "kink at " << x[iface] << ": one-sided slopes averaged to " << dgv[iface] << ", neighbours " << dgv[iface-1]+1 << " " << dgv[iface+1]-1 << "\n";
+    if (std::abs(dgv[iface]) > 1e-12 || std::abs(dgv[iface-1]+1) > 1e-12 || std::abs(dgv[iface+1]-1) > 1e-12) failures++;
+
+    // results do not depend on the number of threads
+    Base serial(N,-1.0,3.0,1), threaded(N,-1.0,3.0,4);
+    std::vector<double> fs, ftt;
+    serial.calc_spectral_coeffs(vals,fs);
+    threaded.calc_spectral_coeffs(vals,ftt);
+    if (fs!=ftt || fs!=ft) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
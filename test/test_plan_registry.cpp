@@ -0,0 +1,57 @@
+#include "../functions.hpp"
+#include "../ODE/linear_diff_ops.hpp"
+#include <iostream>
+#include <thread>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+inline void ffunc(const std::vector<double>& x, std::vector<double>& y);
+
+int main()
+{
+    int failures = 0;
+    PlanRegistry& registry = PlanRegistry::instance();
+    registry.clear();
+    registry.reset_counters();
+
+    using func16 = Function<double,ChebyshevBase<double>,16u>;
+    func16 f(&ffunc);
+    func16 g(&ffunc);
+    cout << "hits: " << registry.hits() << "\t misses: " << registry.misses() << "\n";
+    if (f.get_basis() != g.get_basis() || registry.misses() != 1 || registry.hits() != 1) failures++;
+
+    // many threads creating short lived functions on the same N all share one basis
+    std::vector<std::thread> threads;
+    for (int t=0; t<4; t++) threads.emplace_back([](){
+        for (int k=0; k<1000; k++) {
+            Function<double,ChebyshevBase<double>,16u> h(&ffunc);
+            Function<double,ChebyshevBase<double>,40u> h40(&ffunc);
+        }
+    });
+    for (auto& t: threads) t.join();
+    cout << "hits: " << registry.hits() << "\t misses: " << registry.misses() << "\t entries: " << registry.size() << "\n";
+    if (registry.size() != 2 || registry.hits() + registry.misses() != 8002) failures++;
+
+    // operators borrow their matrices, in-place arithmetic does not touch the cached one
+    Derivative<double> D1(f.get_basis().get());
+    Derivative<double> D2(g.get_basis().get());
+    if (&D1.get_storage() != &D2.get_storage()) failures++;
+    std::vector<double> before, after, scaled;
+    D2.get_Lij(before);
+    D1 *= 2.0;
+    D2.get_Lij(after);
+    D1.get_Lij(scaled);
+    if (&D1.get_storage() == &D2.get_storage() || after != before || scaled[1] != 2.0*before[1]) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
+
+inline void ffunc(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& val: x) y.push_back( std::pow(std::cos(M_PI*val/2),3) + std::pow(val+1,3)/8.0 );
+}
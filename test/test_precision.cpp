@@ -0,0 +1,208 @@
+#include "../ODE/odesolvers.hpp"
+#include "../polybases/mixed_precision.hpp"
+#include <iostream>
+#include <limits>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using namespace ODE;
+using std::cout;
+
+template <class T> void expx(const std::vector<T>& x, std::vector<T>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(v));
+}
+template <class T> void xexpx(const std::vector<T>& x, std::vector<T>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(v*std::exp(v));
+}
+template <class T> void bump(const std::vector<T>& x, std::vector<T>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(-4*v*v)*std::sin(7*v));
+}
+
+/*
+ * One type end to end: nodes, transforms, the derivative operator and the
+ * ODESolver for u'' + x u' - u = x e^x, u = e^x. Errors relative to the
+ * unit roundoff of T.
+ */
+template <class T, unsigned int N> bool check_type(const char* name, T max_ulps)
+{
+    const T eps = std::numeric_limits<T>::epsilon();
+    auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<T>>(N);
+    const std::vector<T>& x = basis->get_nodes();
+    T e_nodes = 0;
+    for (unsigned int i=0; i<=N; i++) {
+        e_nodes = std::max(e_nodes,std::abs(x[i]+x[N-i]));
+        e_nodes = std::max(e_nodes,std::abs(x[i]-std::cos(Chebyshev::pi<T>*static_cast<T>(i)/static_cast<T>(N))));
+    }
+
+    Function<T,ChebyshevBase<T>,N> u(&expx<T>);
+    std::vector<T> back;
+    basis->calc_function_values(u.spectral_coeffs(),back);
+    T e_trans = 0;
+    for (unsigned int i=0; i<=N; i++) e_trans = std::max(e_trans,std::abs(back[i]-std::exp(x[i])));
+
+    // d/dx e^x = e^x
+    Derivative<T> D(basis.get());
+    std::vector<T> du(N+1);
+    D.apply(Span<const T>(u.spectral_coeffs()),Span<T>(du));
+    T e_deriv = 0;
+    for (const T& p: {static_cast<T>(-0.7),static_cast<T>(0.1),static_cast<T>(0.9)})
+        e_deriv = std::max(e_deriv,std::abs(Chebyshev::clenshaw(p,du)-std::exp(p)));
+
+    SecondDerivative<T> D2(basis.get());
+    TimesX<T> X(basis.get());
+    Identity<T> I(basis.get());
+    const std::vector<BoundaryCondition<T>> bcs{BoundaryCondition<T>::Dirichlet(Boundary::Left,std::exp(static_cast<T>(-1))),
+                                                BoundaryCondition<T>::Dirichlet(Boundary::Right,std::exp(static_cast<T>(1)))};
+    ODESolver<T> solver(D2 + X*D - I,bcs);
+    Function<T,ChebyshevBase<T>,N> f(&xexpx<T>);
+    std::vector<T> us;
+    solver.solve(f.spectral_coeffs(),us);
+    T e_solve = 0;
+    for (unsigned int i=0; i<=N; i++) e_solve = std::max(e_solve,std::abs(Chebyshev::clenshaw(x[i],us)-std::exp(x[i])));
+
+    cout << name << ": nodes " << e_nodes/eps << " ulp, transform " << e_trans/eps << " ulp, derivative "
+         << e_deriv/eps << " ulp, solve " << e_solve/eps << " ulp\n";
+    // differentiation amplifies coefficient errors by up to N^2
+    return e_nodes <= 2*eps && e_trans <= max_ulps*eps && e_deriv <= max_ulps*N*N*eps && e_solve <= max_ulps*eps;
+}
+
+int main()
+{
+    int failures = 0;
+
+    // float and long double instantiations reach their own precision, not that of double
+    if (!check_type<float,24>("float",256)) failures++;
+    if (!check_type<double,24>("double",256)) failures++;
+    if (!check_type<long double,24>("long double",256)) failures++;
+
+    // mixed precision: float storage, double arithmetic, error within the stated bound
+    constexpr unsigned int N = 200;
+    typedef MixedChebyshevBase<float,double> Mixed;
+    Function<float,Mixed,N> um(&bump<float>);
+    Function<double,ChebyshevBase<double>,N> ud(&bump<double>);
+    const double bound = Mixed::error_bound(Span<const float>(um.spectral_coeffs()));
+    std::vector<float> xq(1000), yq(1000);
+    for (std::size_t p=0; p<xq.size(); p++) xq[p] = static_cast<float>(std::cos(0.37*p));
+    um.eval(Span<const float>(xq),Span<float>(yq));
+    double e_mixed = 0, e_series = 0;
+    for (std::size_t p=0; p<xq.size(); p++) {
+        double yd;
+        ud.eval(static_cast<double>(xq[p]),yd);
+        e_mixed = std::max(e_mixed,std::abs(yq[p]-yd));
+        float y1;
+        um.eval(xq[p],y1);
+        e_series = std::max(e_series,static_cast<double>(std::abs(y1-yq[p])));
+    }
+    // float arithmetic throughout, for comparison
+    Function<float,ChebyshevBase<float>,N> uf(&bump<float>);
+    std::vector<float> yf(xq.size());
+    uf.eval(Span<const float>(xq),Span<float>(yf));
+    double e_float = 0;
+    for (std::size_t p=0; p<xq.size(); p++) {
+        double yd;
+        ud.eval(static_cast<double>(xq[p]),yd);
+        e_float = std::max(e_float,std::abs(yf[p]-yd));
+    }
+    cout << "mixed: eval error " << e_mixed << " (bound " << bound << ", all-float " << e_float
+         << "), point vs batch " << e_series << ", " << sizeof(um.spectral_coeffs()[0])*(N+1) << " bytes of coefficients\n";
+    if (e_mixed > bound || e_series != 0.0) failures++;
+
+    // D2 in float against D2 in double: O(u_S) normwise, within a few u_S of the
+    // cancelling scale sum (j^3 + i^2 j)|x_j|/c_i row by row, see mixed_precision.hpp
+    for (unsigned int n: {512u, 2048u}) {
+        Mixed mn(n);
+        const OperatorStorage<float> Sf = mn.second_deriv_storage();
+        const OperatorStorage<double> Sd = mn.compute_basis().second_deriv_storage();
+        std::vector<float> xf(n+1), yf(n+1);
+        std::vector<double> xd(n+1), yd(n+1);
+        for (unsigned int j=0; j<=n; j++) { xf[j] = static_cast<float>(std::sin(0.7*j+1)/(1.0+j)); xd[j] = xf[j]; }
+        Sf.apply(xf.data(),yf.data());
+        Sd.apply(xd.data(),yd.data());
+        const double uS = std::numeric_limits<float>::epsilon()/2;
+        double e_norm = 0, scale = 0, e_row = 0;
+        for (unsigned int i=0; i<=n; i++) {
+            double r = 0, rc = 0;
+            for (unsigned int j=i+2; j<=n; j+=2) {
+                r += double(j)*(double(j)*j-double(i)*i)*std::abs(xd[j]);
+                rc += (double(j)*j*j+double(i)*i*j)*std::abs(xd[j]);
+            }
+            if (i==0) { r /= 2; rc /= 2; }
+            const double e = std::abs(yf[i]-yd[i]);
+            e_norm = std::max(e_norm,e);
+            scale = std::max(scale,r);
+            if (rc > 0) e_row = std::max(e_row,e/rc);
+        }
+        cout << "mixed D2, N = " << n << ": error " << e_norm/scale/uS << " u_S of max |D2||x|, " << e_row/uS
+             << " u_S of the cancelling scale\n";
+        if (e_norm > 4*uS*scale || e_row > 4*uS) failures++;
+    }
+
+    // batched mixed transforms match the single ones in both layouts
+    const std::size_t M = 37;
+    Mixed mb(N);
+    std::vector<float> F(M*(N+1)), Ft(M*(N+1)), Fa(M*(N+1)), Fat(M*(N+1)), back(M*(N+1));
+    for (std::size_t k=0; k<F.size(); k++) F[k] = static_cast<float>(std::sin(0.013*k));
+    for (std::size_t m=0; m<M; m++)
+        for (unsigned int i=0; i<=N; i++) Fa[i*M+m] = F[m*(N+1)+i];
+    mb.calc_spectral_coeffs_batch(Span<const float>(F),Span<float>(Ft),M);
+    mb.calc_spectral_coeffs_batch(Span<const float>(Fa),Span<float>(Fat),M,BatchLayout::AoS,2);
+    mb.calc_function_values_batch(Span<const float>(Ft),Span<float>(back),M);
+    double e_batch = 0, e_round = 0;
+    std::vector<float> one(N+1);
+    for (std::size_t m=0; m<M; m++) {
+        mb.calc_spectral_coeffs(Span<const float>(F.data()+m*(N+1),N+1),Span<float>(one));
+        for (unsigned int i=0; i<=N; i++) {
+            e_batch = std::max(e_batch,static_cast<double>(std::abs(one[i]-Ft[m*(N+1)+i])));
+            e_batch = std::max(e_batch,static_cast<double>(std::abs(Fat[i*M+m]-Ft[m*(N+1)+i])));
+        }
+    }
+    for (std::size_t k=0; k<F.size(); k++) e_round = std::max(e_round,static_cast<double>(std::abs(back[k]-F[k])));
+    cout << "mixed batch: SoA/AoS/single difference " << e_batch << ", round trip " << e_round << "\n";
+    if (e_batch != 0.0 || e_round > 4*std::numeric_limits<float>::epsilon()) failures++;
+
+    // iterative refinement: float factorisation, double accuracy
+    {
+        auto basis = PlanRegistry::instance().get_basis<ChebyshevBase<double>>(N);
+        SecondDerivative<double> D2(basis.get());
+        Derivative<double> D(basis.get());
+        TimesX<double> X(basis.get());
+        Identity<double> I(basis.get());
+        const std::vector<BoundaryCondition<double>> bcs{BoundaryCondition<double>::Dirichlet(Boundary::Left,std::exp(-1.0)),
+                                                         BoundaryCondition<double>::Dirichlet(Boundary::Right,std::exp(1.0))};
+        ODESolver<double> exact(D2 + X*D - I,bcs);
+        RefinedODESolver<float,double> refined(D2 + X*D - I,bcs);
+        Function<double,ChebyshevBase<double>,N> f(&xexpx<double>);
+        std::vector<double> ue, ur;
+        exact.solve(f.spectral_coeffs(),ue);
+        const RefinementInfo info = refined.solve(f.spectral_coeffs(),ur);
+        double e_ref = 0;
+        for (unsigned int i=0; i<=N; i++) e_ref = std::max(e_ref,std::abs(ur[i]-ue[i]));
+        cout << "refinement: " << info.sweeps << " sweeps, promoted " << info.promoted << ", last correction "
+             << info.correction << ", difference to the double solve " << e_ref << "\n";
+        if (info.promoted || info.sweeps > 5 || e_ref > 1e-13) failures++;
+
+        // near-singular Helmholtz problem u'' + k^2 u, k^2 close to the Dirichlet eigenvalue (pi/2)^2 of the even mode cos(pi x/2):
+        // cond(S) u_float > 1, the refinement stalls and is promoted to double
+        const double k2 = Chebyshev::pi<double>*Chebyshev::pi<double>/4*(1+1e-9);
+        const std::vector<BoundaryCondition<double>> zero{BoundaryCondition<double>::Dirichlet(Boundary::Left,0.0),
+                                                          BoundaryCondition<double>::Dirichlet(Boundary::Right,0.0)};
+        RefinedODESolver<float,double> helm(D2 + k2*I,zero);
+        ODESolver<double> helm_exact(D2 + k2*I,zero);
+        std::vector<double> g(N+1,0.0), uh, uhe;
+        g[0] = 1.0;
+        const RefinementInfo hinfo = helm.solve(g,uh);
+        helm_exact.solve(g,uhe);
+        double e_helm = 0;
+        for (unsigned int i=0; i<=N; i++) e_helm = std::max(e_helm,std::abs(uh[i]-uhe[i]));
+        cout << "ill-conditioned: " << hinfo.sweeps << " sweeps, promoted " << hinfo.promoted << ", difference " << e_helm << "\n";
+        if (!hinfo.promoted || !helm.promoted() || e_helm != 0.0) failures++;
+    }
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
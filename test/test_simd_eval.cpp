@@ -0,0 +1,51 @@
+#include "../functions.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using Chebyshev::SimdLevel;
+using std::cout;
+
+template <class T> double check(SimdLevel level, unsigned int ncoeffs, unsigned int npts)
+{
+    std::vector<T> a(ncoeffs), x(npts), out(npts);
+    for (unsigned int n=0; n<ncoeffs; n++) a[n] = static_cast<T>(1.0/(1.0+n));
+    for (unsigned int p=0; p<npts; p++) x[p] = static_cast<T>(-1.0 + 2.0*p/std::max(1u,npts-1));
+    Chebyshev::clenshaw_batch<T>(a.data(),ncoeffs,x.data(),npts,out.data(),level);
+    double e = 0.0;
+    for (unsigned int p=0; p<npts; p++) e = std::max(e, static_cast<double>(std::abs(out[p] - Chebyshev::clenshaw(x[p],a))));
+    return e;
+}
+
+int main()
+{
+    int failures = 0;
+    cout << "detected SIMD level: " << static_cast<int>(Chebyshev::detected_simd_level()) << "\n";
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        double e_d = 0.0, e_f = 0.0, e_l = 0.0;
+        for (unsigned int ncoeffs : {0u,1u,2u,17u,64u}) {
+            for (unsigned int npts : {0u,1u,7u,31u,33u,100u}) {
+                e_d = std::max(e_d, check<double>(level,ncoeffs,npts));
+                e_f = std::max(e_f, check<float>(level,ncoeffs,npts));
+                e_l = std::max(e_l, check<long double>(level,ncoeffs,npts));
+            }
+        }
+        cout << "level " << static_cast<int>(level) << "\t double: " << e_d << "\t float: " << e_f << "\t long double: " << e_l << "\n";
+        if (e_d > 1e-13 || e_f > 1e-5 || e_l > 1e-16) failures++;
+    }
+
+    // span evaluation through Function writes into the caller's buffer
+    auto f = [](const std::vector<double>& x, std::vector<double>& y) { y.clear(); for (auto v: x) y.push_back(std::exp(v)); };
+    Function<double,ChebyshevBase<double>,24u> g(+f);
+    std::vector<double> x(1000), y(1000), y_ref;
+    for (unsigned int p=0; p<x.size(); p++) x[p] = -1.0 + 0.002*p;
+    g.eval(Span<const double>(x),Span<double>(y));
+    double e_func = 0.0;
+    for (unsigned int p=0; p<x.size(); p++) e_func = std::max(e_func, std::abs(y[p]-std::exp(x[p])));
+    cout << "Function::eval(span) vs exp(x): " << e_func << "\n";
+    if (e_func > 1e-13) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
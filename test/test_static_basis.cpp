@@ -0,0 +1,114 @@
+#include "../functions.hpp"
+#include "../polybases/static_basis.hpp"
+#include "../polybases/piecewise_chebyshev.hpp"
+#include "../ODE/linear_diff_ops.hpp"
+#include <iostream>
+#include <type_traits>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using namespace Operators;
+using std::cout;
+
+/*
+ * Static Chebyshev basis that only defines T_n(x), so series go through the
+ * generic StaticBasis sum. Transforms and operators come from the shared
+ * ChebyshevBase plan.
+ */
+template <class T>
+class StaticTn: public StaticBasis<StaticTn<T>,T> {
+    std::shared_ptr<const ChebyshevBase<T>> plan;
+public:
+    using StaticBasis<StaticTn<T>,T>::calc_spectral_coeffs;
+    using StaticBasis<StaticTn<T>,T>::calc_function_values;
+    using StaticBasis<StaticTn<T>,T>::get_nodes;
+    StaticTn(unsigned int N): plan(PlanRegistry::instance().get_basis<ChebyshevBase<T>>(N)) {}
+    inline int get_N() const { return plan->get_N(); }
+    inline T evaluate_function(const T& x, const unsigned int n) const { return Chebyshev::Tn<T>(x,n); }
+    inline void calc_spectral_coeffs(Span<const T> f, Span<T> ft) const { plan->calc_spectral_coeffs(f,ft); }
+    inline void calc_function_values(Span<const T> ft, Span<T> f) const { plan->calc_function_values(ft,f); }
+    inline const std::vector<T>& get_nodes() const { return plan->get_nodes(); }
+    inline OperatorStorage<T> deriv_storage() const { return plan->deriv_storage(); }
+    inline OperatorStorage<T> second_deriv_storage() const { return plan->second_deriv_storage(); }
+    inline OperatorStorage<T> times_x_storage() const { return plan->times_x_storage(); }
+};
+
+inline void bump(const std::vector<double>& x, std::vector<double>& y) {
+    y.clear();
+    for (auto& v: x) y.push_back(std::exp(-2*v*v)*std::cos(3*v));
+}
+
+static_assert(std::is_final<ChebyshevBase<double>>::value, "ChebyshevBase calls must devirtualise");
+static_assert(std::is_final<PiecewiseChebyshevBase<double,4>>::value, "PiecewiseChebyshevBase calls must devirtualise");
+
+int main()
+{
+    int failures = 0;
+    const unsigned int N = 24;
+    std::vector<double> pts(101);
+    for (std::size_t p=0; p<pts.size(); p++) pts[p] = -1.0 + 2.0*p/(pts.size()-1);
+
+    // Function on the static basis, on its adapter and on ChebyshevBase
+    Function<double,ChebyshevBase<double>,N> ref(&bump);
+    Function<double,StaticTn<double>,N> us(&bump);
+    Function<double,BasisAdapter<StaticTn<double>>,N> ua(&bump);
+    std::vector<double> vr(pts.size()), vs(pts.size()), va(pts.size());
+    ref.eval(Span<const double>(pts),Span<double>(vr));
+    us.eval(Span<const double>(pts),Span<double>(vs));
+    ua.eval(Span<const double>(pts),Span<double>(va));
+    double e_eval = 0.0;
+    for (std::size_t p=0; p<pts.size(); p++) {
+        double s, a;
+        us.eval(pts[p],s);
+        ua.eval(pts[p],a);
+        e_eval = std::max({e_eval,std::abs(vs[p]-vr[p]),std::abs(va[p]-vr[p]),std::abs(s-vr[p]),std::abs(a-vr[p])});
+    }
+    cout << "static/adapter vs virtual evaluation: " << e_eval << "\n";
+    if (e_eval > 1e-13) failures++;
+
+    // operators instantiated directly on the static basis
+    const StaticTn<double>* sb = us.get_basis().get();
+    const ChebyshevBase<double>* cb = ref.get_basis().get();
+    Derivative<double> Ds(sb), Dc(cb);
+    SecondDerivative<double> D2s(sb), D2c(cb);
+    TimesX<double> Xs(sb), Xc(cb);
+    Identity<double> Is(sb), Ic(cb);
+    const std::vector<double>& ft = ref.spectral_coeffs();
+    std::vector<double> a(N+1), b(N+1);
+    double e_op = 0.0;
+    auto compare = [&](const LinearOperator<double>& L1, const LinearOperator<double>& L2) {
+        L1.apply(Span<const double>(ft),Span<double>(a));
+        L2.apply(Span<const double>(ft),Span<double>(b));
+        for (unsigned int i=0; i<=N; i++) e_op = std::max(e_op,std::abs(a[i]-b[i]));
+    };
+    compare(Ds,Dc);
+    compare(D2s,D2c);
+    compare(Xs,Xc);
+    compare(Is,Ic);
+    compare(Ds*Xs + 2.0*Is,Dc*Xc + 2.0*Ic);
+    cout << "operators on the static basis: " << e_op << "\n";
+    if (e_op != 0.0) failures++;
+
+    // the adapter through the FunctionalBase interface
+    BasisAdapter<StaticTn<double>> adapter(N);
+    const FunctionalBase<double>& fb = adapter;
+    std::vector<double> f, ft2, x;
+    fb.get_nodes(x);
+    bump(x,f);
+    fb.calc_spectral_coeffs(f,ft2);
+    double e_ad = 0.0;
+    for (unsigned int i=0; i<=N; i++) e_ad = std::max(e_ad,std::abs(ft2[i]-ft[i]));
+    for (auto p: pts) e_ad = std::max(e_ad,std::abs(fb.evaluate_series(p,ft2)-sb->evaluate_series(p,Span<const double>(ft))));
+    Derivative<double> Da(&fb);
+    compare(Da,Dc);
+    std::vector<double> dense;
+    fb.calc_deriv(dense);
+    for (unsigned int i=0; i<=N; i++)
+        for (unsigned int j=0; j<=N; j++) e_ad = std::max(e_ad,std::abs(dense[i*(N+1)+j]-Dc.get_storage().get(i,j)));
+    cout << "adapter vs static basis: " << e_ad << ", adapter derivative: " << e_op << "\n";
+    if (e_ad > 1e-13 || e_op != 0.0 || fb.get_N()!=int(N) || fb.num_coeffs()!=N+1) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}
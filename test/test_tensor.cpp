@@ -0,0 +1,89 @@
+#include "../functions.hpp"
+#include "../polybases/tensor_chebyshev.hpp"
+#include <iostream>
+#include <cmath>
+
+using namespace FunctionalBases;
+using namespace Functions;
+using std::cout;
+
+typedef std::array<double,2> P2;
+typedef std::array<double,3> P3;
+
+int main()
+{
+    int failures = 0;
+
+    // 2D on [-1,1]x[0,2] with different orders per axis
+    auto b2 = std::make_shared<const TensorChebyshevBase<double,2>>(std::array<unsigned int,2>{24,32},P2{-1.0,0.0},P2{1.0,2.0});
+    auto f2 = [](const P2& x) { return std::exp(x[0])*std::sin(2*x[1]); };
+    TensorFunction<double,2> u(b2,f2);
+    std::vector<double> vals, ft, back;
+    u.get_func_vals(vals);
+    u.get_spectral_coeffs(ft);
+    b2->calc_function_values(ft,back);
+    double e_rt = 0.0;
+    for (std::size_t i=0; i<vals.size(); i++) e_rt = std::max(e_rt,std::abs(back[i]-vals[i]));
+    std::vector<P2> pts;
+    for (int i=0; i<=40; i++)
+        for (int j=0; j<=40; j++) pts.push_back(P2{-1.0+i/20.0,j/20.0});
+    std::vector<double> ev(pts.size());
+    u.eval(Span<const P2>(pts),Span<double>(ev));
+    double e_ev = 0.0;
+    for (std::size_t p=0; p<pts.size(); p++) e_ev = std::max(e_ev,std::abs(ev[p]-f2(pts[p])));
+    cout << "2D: size " << b2->size() << ", round trip error " << e_rt << ", evaluation error " << e_ev << "\n";
+    if (b2->size()!=25*33 || e_rt > 1e-13 || e_ev > 1e-13) failures++;
+
+    // partial derivatives, scaled to the box
+    TensorFunction<double,2> ux = u.derivative(0), uyy = u.derivative(1,2), uxyy = u.derivative(0).derivative(1,2);
+    double e_x = 0.0, e_yy = 0.0, e_xyy = 0.0;
+    for (const auto& x: pts) {
+        e_x = std::max(e_x,std::abs(ux(x)-f2(x)));
+        e_yy = std::max(e_yy,std::abs(uyy(x)+4*f2(x)));
+        e_xyy = std::max(e_xyy,std::abs(uxyy(x)+4*f2(x)));
+    }
+    cout << "2D: d/dx error " << e_x << ", d2/dy2 error " << e_yy << ", d3/dxdy2 error " << e_xyy << "\n";
+    if (e_x > 1e-11 || e_yy > 1e-9 || e_xyy > 1e-8) failures++;
+
+    // multiplication by the coordinate along an axis
+    std::vector<double> yft(ft.size());
+    b2->apply_operator(OperatorKind::TimesX,1,Span<const double>(ft),Span<double>(yft));
+    double e_y = 0.0;
+    for (const auto& x: pts) e_y = std::max(e_y,std::abs(b2->evaluate_series(x,Span<const double>(yft))-x[1]*f2(x)));
+    cout << "2D: y*f error " << e_y << "\n";
+    if (e_y > 1e-12) failures++;
+
+    // 3D cube, results do not depend on the number of threads
+    auto f3 = [](const P3& x) { return std::cos(x[0])*x[1]*x[1]*std::exp(0.5*x[2]); };
+    auto serial = std::make_shared<const TensorChebyshevBase<double,3>>(20u,-1.0,1.0,1);
+    auto threaded = std::make_shared<const TensorChebyshevBase<double,3>>(20u,-1.0,1.0,4);
+    TensorFunction<double,3> v1(serial,f3), v4(threaded,f3);
+    std::vector<double> ft1, ft4;
+    v1.get_spectral_coeffs(ft1);
+    v4.get_spectral_coeffs(ft4);
+    if (ft1!=ft4) { cout << "thread count changes the result\n"; failures++; }
+    TensorFunction<double,3> vz = v4.derivative(2);
+    double e3 = 0.0, e3z = 0.0;
+    for (int k=0; k<=200; k++) {
+        const P3 x{std::sin(0.3*k),std::cos(0.7*k),std::sin(1.1*k+0.5)};
+        e3 = std::max(e3,std::abs(v4(x)-f3(x)));
+        e3z = std::max(e3z,std::abs(vz(x)-0.5*f3(x)));
+    }
+    cout << "3D: evaluation error " << e3 << ", d/dz error " << e3z << "\n";
+    if (e3 > 1e-13 || e3z > 1e-12) failures++;
+
+    // the DCT path of the batched transforms (N >= batch_dct_threshold) along a long axis
+    auto wide = std::make_shared<const TensorChebyshevBase<double,2>>(std::array<unsigned int,2>{300,8},P2{0.0,-1.0},P2{3.0,1.0});
+    auto fw = [](const P2& x) { return std::sin(20*x[0])*(1+x[1]*x[1]); };
+    TensorFunction<double,2> w(wide,fw);
+    double e_w = 0.0;
+    for (int k=0; k<=300; k++) {
+        const P2 x{0.01*k,std::cos(0.3*k)};
+        e_w = std::max(e_w,std::abs(w(x)-fw(x)));
+    }
+    cout << "2D with a DCT axis: evaluation error " << e_w << "\n";
+    if (!wide->axis_basis(0).batch_uses_dct() || e_w > 1e-12) failures++;
+
+    cout << (failures ? "FAILED\n" : "PASSED\n");
+    return failures;
+}